@@ -0,0 +1,87 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#ifndef IP2_BENCH_HPP_INCLUDED
+#define IP2_BENCH_HPP_INCLUDED
+
+#include <chrono>
+#include <cstdint>
+
+namespace bench {
+
+	// the state of one run of a benchmark. The body of a benchmark does its
+	// setup, then loops on keep_running(). Only the loop is measured, both
+	// for time and for allocations
+	//
+	//	IP2_BENCH(name)
+	//	{
+	//		... setup ...
+	//		while (st.keep_running())
+	//		{
+	//			... one operation ...
+	//		}
+	//	}
+	struct state
+	{
+		explicit state(std::int64_t iterations) : m_iterations(iterations) {}
+
+		bool keep_running()
+		{
+			if (m_done == 0) start();
+			if (m_done++ < m_iterations) return true;
+			stop();
+			return false;
+		}
+
+		// the number of bytes one operation processes. When set, the
+		// throughput is reported
+		void set_bytes_per_op(std::int64_t const bytes) { m_bytes_per_op = bytes; }
+
+		std::int64_t iterations() const { return m_iterations; }
+		std::int64_t bytes_per_op() const { return m_bytes_per_op; }
+		std::int64_t elapsed_ns() const { return m_elapsed_ns; }
+		std::int64_t allocations() const { return m_allocations; }
+
+	private:
+
+		void start();
+		void stop();
+
+		std::int64_t m_iterations;
+		std::int64_t m_done = 0;
+		std::int64_t m_bytes_per_op = 0;
+		std::int64_t m_elapsed_ns = 0;
+		std::int64_t m_allocations = 0;
+		std::int64_t m_start_allocations = 0;
+		std::chrono::steady_clock::time_point m_start;
+	};
+
+	using bench_fun = void (*)(state&);
+
+	int register_benchmark(char const* name, bench_fun fun);
+
+	// keeps the compiler from optimizing away a result that's otherwise
+	// unused
+	template <typename T>
+	void do_not_optimize(T const& v)
+	{
+#if defined __GNUC__ || defined __clang__
+		asm volatile("" : : "r,m"(v) : "memory");
+#else
+		static_cast<void>(*static_cast<T const volatile*>(&v));
+#endif
+	}
+}
+
+#define IP2_BENCH(name) \
+	static void bench_##name(::bench::state& st); \
+	static int const bench_reg_##name = ::bench::register_benchmark(#name, &bench_##name); \
+	static void bench_##name(::bench::state& st)
+
+#endif // IP2_BENCH_HPP_INCLUDED
@@ -0,0 +1,83 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "bench.hpp"
+
+#include "ip2/config.hpp"
+#include "ip2/bdecode.hpp"
+#include "ip2/bencode.hpp"
+#include "ip2/entry.hpp"
+
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace lt;
+
+namespace {
+
+	// a put request carrying a blob segment
+	std::vector<char> put_request()
+	{
+		entry e;
+		e["y"] = "q";
+		e["q"] = "put";
+		e["t"] = "aa";
+		entry& a = e["a"];
+		a["id"] = std::string(32, 'i');
+		a["k"] = std::string(32, 'k');
+		a["sig"] = std::string(64, 's');
+		a["salt"] = std::string(20, 'u');
+		a["ts"] = 1650000000;
+		a["v"] = std::string(800, 'v');
+
+		std::vector<char> ret;
+		bencode(std::back_inserter(ret), e);
+		return ret;
+	}
+
+	// a reply with 8 nodes, in the compact form: a 32 byte id, an IPv4
+	// address and port each
+	entry find_node_reply()
+	{
+		entry e;
+		e["y"] = "r";
+		e["t"] = "aa";
+		entry& r = e["r"];
+		r["id"] = std::string(32, 'i');
+		r["nodes"] = std::string(8 * (32 + 6), 'n');
+		return e;
+	}
+}
+
+IP2_BENCH(bdecode_dht_message)
+{
+	std::vector<char> const buf = put_request();
+	bdecode_node msg;
+	error_code ec;
+	st.set_bytes_per_op(std::int64_t(buf.size()));
+	while (st.keep_running())
+	{
+		// the node is reused across packets, like the one in dht_tracker
+		bdecode(buf.data(), buf.data() + buf.size(), msg, ec);
+		bench::do_not_optimize(msg);
+	}
+}
+
+IP2_BENCH(bencode_dht_reply)
+{
+	entry const reply = find_node_reply();
+	std::vector<char> out;
+	while (st.keep_running())
+	{
+		out.clear();
+		bencode(std::back_inserter(out), reply);
+		bench::do_not_optimize(out);
+	}
+}
@@ -0,0 +1,183 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "bench.hpp"
+
+#include "ip2/config.hpp"
+#include "ip2/crypto.hpp"
+#include "ip2/hasher.hpp"
+#include "ip2/account_manager.hpp"
+#include "ip2/hex.hpp"
+#include "ip2/kademlia/ed25519.hpp"
+
+#ifdef TORRENT_ENABLE_UDP_COMPRESS
+#include <snappy-c.h>
+#endif
+
+#include <array>
+#include <string>
+#include <tuple>
+
+using namespace lt;
+
+namespace {
+
+	// about the size of a DHT packet carrying a blob segment
+	int const packet_size = 1000;
+
+	std::string packet()
+	{
+		// half repetitive, like bencoded keys and node lists, half random,
+		// like keys and signatures
+		std::string ret;
+		ret.reserve(packet_size);
+		std::uint32_t x = 1;
+		while (int(ret.size()) < packet_size)
+		{
+			ret += "d1:ad2:id32:";
+			for (int i = 0; i < 32; ++i)
+			{
+				x = x * 1103515245 + 12345;
+				ret += char(x >> 16);
+			}
+			ret += "e1:q3:put";
+		}
+		ret.resize(packet_size);
+		return ret;
+	}
+
+	std::string key()
+	{
+		return std::string(32, 'k');
+	}
+
+	std::string seed_hex(char const c)
+	{
+		std::array<char, 32> seed;
+		seed.fill(c);
+		return aux::to_hex(seed);
+	}
+}
+
+IP2_BENCH(sha1_segment)
+{
+	std::string const in = packet();
+	st.set_bytes_per_op(packet_size);
+	while (st.keep_running())
+	{
+		bench::do_not_optimize(hasher(in).final());
+	}
+}
+
+IP2_BENCH(sha256_segment)
+{
+	std::string const in = packet();
+	st.set_bytes_per_op(packet_size);
+	while (st.keep_running())
+	{
+		bench::do_not_optimize(hasher256(in).final());
+	}
+}
+
+IP2_BENCH(aes_encrypt)
+{
+	std::string const in = packet();
+	std::string const k = key();
+	std::string out;
+	std::string err;
+	st.set_bytes_per_op(packet_size);
+	while (st.keep_running())
+	{
+		out.clear();
+		aux::aes_encrypt(in, out, k, err);
+		bench::do_not_optimize(out);
+	}
+}
+
+IP2_BENCH(aes_decrypt)
+{
+	std::string const k = key();
+	std::string in;
+	std::string err;
+	aux::aes_encrypt(packet(), in, k, err);
+
+	std::string out;
+	st.set_bytes_per_op(packet_size);
+	while (st.keep_running())
+	{
+		out.clear();
+		aux::aes_decrypt(in, out, k, err);
+		bench::do_not_optimize(out);
+	}
+}
+
+// the exchange key of a peer we've already talked to, which is how most
+// packets are decrypted
+IP2_BENCH(key_exchange_cached)
+{
+	aux::account_manager am(seed_hex('a'));
+	aux::account_manager const peer(seed_hex('b'));
+	dht::public_key const pk = peer.pub_key();
+	am.key_exchange(pk);
+
+	while (st.keep_running())
+	{
+		auto const ek = am.key_exchange(pk);
+		bench::do_not_optimize(ek);
+	}
+}
+
+// the first packet from a peer, the ed25519 key exchange itself
+IP2_BENCH(key_exchange_uncached)
+{
+	dht::public_key pk;
+	dht::secret_key sk;
+	std::array<char, 32> seed;
+	seed.fill('a');
+	std::tie(pk, sk) = dht::ed25519_create_keypair(seed);
+
+	while (st.keep_running())
+	{
+		auto const ek = dht::ed25519_key_exchange(pk, sk);
+		bench::do_not_optimize(ek);
+	}
+}
+
+#ifdef TORRENT_ENABLE_UDP_COMPRESS
+IP2_BENCH(snappy_compress)
+{
+	std::string const in = packet();
+	std::string out(snappy_max_compressed_length(in.size()), '\0');
+	st.set_bytes_per_op(packet_size);
+	while (st.keep_running())
+	{
+		std::size_t len = out.size();
+		snappy_compress(in.data(), in.size(), &out[0], &len);
+		bench::do_not_optimize(len);
+	}
+}
+
+IP2_BENCH(snappy_uncompress)
+{
+	std::string const raw = packet();
+	std::string in(snappy_max_compressed_length(raw.size()), '\0');
+	std::size_t in_len = in.size();
+	snappy_compress(raw.data(), raw.size(), &in[0], &in_len);
+	in.resize(in_len);
+
+	std::string out(raw.size(), '\0');
+	st.set_bytes_per_op(packet_size);
+	while (st.keep_running())
+	{
+		std::size_t len = out.size();
+		snappy_uncompress(in.data(), in.size(), &out[0], &len);
+		bench::do_not_optimize(len);
+	}
+}
+#endif
@@ -0,0 +1,216 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "bench.hpp"
+
+#include "ip2/config.hpp"
+#include "ip2/entry.hpp"
+#include "ip2/address.hpp"
+#include "ip2/aux_/session_settings.hpp"
+#include "ip2/kademlia/dht_observer.hpp"
+#include "ip2/kademlia/ed25519.hpp"
+#include "ip2/kademlia/item.hpp"
+#include "ip2/kademlia/items_db_sqlite.hpp"
+#include "ip2/kademlia/node_entry.hpp"
+#include "ip2/kademlia/relay.hpp"
+#include "ip2/kademlia/routing_table.hpp"
+
+#include <array>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using namespace lt;
+using namespace lt::dht;
+
+namespace {
+
+	// a deterministic generator, so every run measures the same table and
+	// the same items
+	struct lcg
+	{
+		std::uint32_t operator()()
+		{
+			m_x = m_x * 1103515245 + 12345;
+			return m_x >> 8;
+		}
+	private:
+		std::uint32_t m_x = 1;
+	};
+
+	node_id random_id(lcg& r)
+	{
+		node_id ret;
+		for (auto& b : ret) b = std::uint8_t(r());
+		return ret;
+	}
+
+	// an observer without a session. The items database is in memory
+	struct bench_observer final : dht_observer
+	{
+		bench_observer()
+		{
+			sqlite3_open(":memory:", &m_db);
+		}
+
+		~bench_observer()
+		{
+			sqlite3_close(m_db);
+		}
+
+		void set_external_address(aux::listen_socket_handle const&
+			, address const&, address const&) override {}
+		int get_listen_port(aux::transport, aux::listen_socket_handle const&) override
+		{ return 0; }
+		void get_peers(sha256_hash const&) override {}
+		void outgoing_get_peers(sha256_hash const&
+			, sha256_hash const&, udp::endpoint const&) override {}
+		void announce(sha256_hash const&, address const&, int) override {}
+		bool on_dht_request(string_view, dht::msg const&, entry&) override
+		{ return false; }
+		void on_dht_item(dht::item&) override {}
+		std::int64_t get_time() override { return 0; }
+		void on_dht_relay(public_key const&, entry const&) override {}
+		sqlite3* get_items_database() override { return m_db; }
+
+#ifndef TORRENT_DISABLE_LOGGING
+		bool should_log(module_t) const override { return false; }
+		bool should_log(module_t, aux::LOG_LEVEL) const override { return false; }
+		void log(module_t, char const*, ...) override {}
+		void log_packet(message_direction_t, span<char const>
+			, udp::endpoint const&) override {}
+#endif
+
+	private:
+		sqlite3* m_db = nullptr;
+	};
+
+	aux::session_settings bench_settings()
+	{
+		aux::session_settings s;
+		s.set_bool(settings_pack::dht_prefer_verified_node_ids, false);
+		s.set_bool(settings_pack::dht_restrict_routing_ips, false);
+		return s;
+	}
+}
+
+IP2_BENCH(verify_mutable_item)
+{
+	public_key pk;
+	secret_key sk;
+	std::array<char, 32> seed;
+	seed.fill('a');
+	std::tie(pk, sk) = ed25519_create_keypair(seed);
+
+	std::string const v(800, 'v');
+	std::string const salt(20, 's');
+	signature const sig = sign_mutable_item(v, salt, timestamp(1), pk, sk);
+
+	st.set_bytes_per_op(std::int64_t(v.size()));
+	while (st.keep_running())
+	{
+		bool const ok = verify_mutable_item(v, salt, timestamp(1), pk, sig);
+		bench::do_not_optimize(ok);
+	}
+}
+
+// the closest nodes to a target, for every incoming get, put and relay
+IP2_BENCH(routing_table_find_node)
+{
+	bench_observer observer;
+	aux::session_settings const sett = bench_settings();
+	lcg r;
+	routing_table table(random_id(r), udp::v4(), 16, sett, &observer);
+
+	for (int i = 0; i < 5000; ++i)
+	{
+		address_v4 const addr(0x0a000000 | (r() & 0xffffff));
+		table.add_node(node_entry(random_id(r)
+			, udp::endpoint(addr, std::uint16_t(6881)), 50, true));
+	}
+
+	std::vector<node_id> targets;
+	for (int i = 0; i < 256; ++i) targets.push_back(random_id(r));
+
+	std::size_t i = 0;
+	while (st.keep_running())
+	{
+		auto const nodes = table.find_node(targets[i++ % targets.size()], {}, 8);
+		bench::do_not_optimize(nodes);
+	}
+}
+
+IP2_BENCH(gen_relay_hmac)
+{
+	std::string const payload(900, 'p');
+	std::string const aux_nodes(4 * (32 + 6), 'n');
+	st.set_bytes_per_op(std::int64_t(payload.size() + aux_nodes.size()));
+	while (st.keep_running())
+	{
+		relay_hmac const h = gen_relay_hmac(payload, aux_nodes);
+		bench::do_not_optimize(h);
+	}
+}
+
+IP2_BENCH(items_db_put)
+{
+	bench_observer observer;
+	aux::session_settings const sett = bench_settings();
+	items_db_sqlite db(sett, &observer);
+
+	std::string const v(800, 'v');
+	std::string const salt(20, 's');
+	public_key pk;
+	signature sig;
+	address const addr = make_address_v4("10.0.0.1");
+
+	lcg r;
+	std::vector<sha256_hash> targets;
+	for (int i = 0; i < 1024; ++i) targets.push_back(random_id(r));
+
+	std::int64_t ts = 0;
+	st.set_bytes_per_op(std::int64_t(v.size()));
+	while (st.keep_running())
+	{
+		db.put_mutable_item(targets[std::size_t(ts % 1024)], v, sig, timestamp(ts)
+			, pk, salt, addr);
+		++ts;
+	}
+}
+
+IP2_BENCH(items_db_get)
+{
+	bench_observer observer;
+	aux::session_settings const sett = bench_settings();
+	items_db_sqlite db(sett, &observer);
+
+	std::string const v(800, 'v');
+	std::string const salt(20, 's');
+	public_key pk;
+	signature sig;
+	address const addr = make_address_v4("10.0.0.1");
+
+	lcg r;
+	std::vector<sha256_hash> targets;
+	for (int i = 0; i < 1024; ++i)
+	{
+		targets.push_back(random_id(r));
+		db.put_mutable_item(targets.back(), v, sig, timestamp(i), pk, salt, addr);
+	}
+
+	std::size_t i = 0;
+	st.set_bytes_per_op(std::int64_t(v.size()));
+	while (st.keep_running())
+	{
+		entry item;
+		bool const found = db.get_mutable_item(targets[i++ % targets.size()]
+			, timestamp(0), true, item);
+		bench::do_not_optimize(found);
+	}
+}
@@ -0,0 +1,107 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "bench.hpp"
+
+#include "ip2/config.hpp"
+#include "ip2/communication/message_db_impl.hpp"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace lt;
+using namespace lt::communication;
+
+namespace {
+
+	constexpr int burst_size = 100000;
+
+	// the burst a sync of many friends brings in, the same every run
+	std::vector<message> const& burst()
+	{
+		static std::vector<message> const messages = []
+		{
+			std::vector<message> ret;
+			ret.reserve(burst_size);
+			for (int i = 0; i < burst_size; ++i)
+			{
+				dht::public_key sender;
+				sender.bytes[0] = char(i % 64);
+				dht::public_key receiver;
+				receiver.bytes[0] = char(0xff);
+				aux::bytes payload(100, char(i & 0xff));
+				ret.emplace_back(i, sender, receiver, payload);
+			}
+			return ret;
+		}();
+		return messages;
+	}
+
+	// a database file in WAL mode, set up the way the session sets up its
+	// own, so the cost of the commits is measured
+	struct file_db
+	{
+		file_db()
+		{
+			std::remove(path);
+			std::remove((std::string(path) + "-wal").c_str());
+			std::remove((std::string(path) + "-shm").c_str());
+			sqlite3_open(path, &db);
+			sqlite3_exec(db, "pragma journal_mode = WAL;", nullptr, nullptr, nullptr);
+			sqlite3_exec(db, "pragma synchronous = normal;", nullptr, nullptr, nullptr);
+		}
+
+		~file_db()
+		{
+			sqlite3_close_v2(db);
+			std::remove(path);
+			std::remove((std::string(path) + "-wal").c_str());
+			std::remove((std::string(path) + "-shm").c_str());
+		}
+
+		static constexpr char const* path = "bench_message_db.sqlite";
+		sqlite3* db = nullptr;
+	};
+
+	// one operation ingests the whole burst into an empty database.
+	// ``commit_every`` commits every message on its own, the way they were
+	// before they were committed in groups
+	void ingest(bench::state& st, bool const commit_every)
+	{
+		auto const& messages = burst();
+		std::int64_t bytes = 0;
+		for (auto const& m : messages) bytes += std::int64_t(m.payload().size());
+		st.set_bytes_per_op(bytes);
+
+		while (st.keep_running())
+		{
+			file_db f;
+			message_db_impl db(f.db);
+			db.init();
+			for (auto const& m : messages)
+			{
+				db.save_message_if_not_exist(m);
+				if (commit_every) db.commit_messages();
+			}
+			bool const ok = db.commit_messages();
+			bench::do_not_optimize(ok);
+		}
+	}
+}
+
+IP2_BENCH(message_db_ingest_100k)
+{
+	ingest(st, false);
+}
+
+IP2_BENCH(message_db_ingest_100k_commit_every)
+{
+	ingest(st, true);
+}
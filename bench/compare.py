@@ -0,0 +1,45 @@
+#!/usr/bin/env python3
+# vim: tabstop=8 expandtab shiftwidth=4 softtabstop=4
+
+# Copyright (c) 2022, Xianshui Sheng
+# All rights reserved.
+#
+# You may use, distribute and modify this code under the terms of the BSD license,
+# see LICENSE file.
+
+# compares the output of "bench --json" from two commits
+#
+#   python bench/compare.py before.json after.json
+
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        return {b['name']: b for b in json.load(f)['benchmarks']}
+
+
+def main():
+    if len(sys.argv) != 3:
+        print('usage: %s before.json after.json' % sys.argv[0])
+        sys.exit(1)
+
+    before = load(sys.argv[1])
+    after = load(sys.argv[2])
+
+    print('%-32s %12s %12s %8s %10s %10s' % ('benchmark', 'before ns', 'after ns'
+        , 'change', 'allocs', 'allocs'))
+    for name in sorted(set(before) | set(after)):
+        if name not in before or name not in after:
+            print('%-32s %s' % (name, 'only in ' + (sys.argv[1] if name in before else sys.argv[2])))
+            continue
+        b = before[name]
+        a = after[name]
+        change = (a['ns_per_op'] - b['ns_per_op']) * 100. / b['ns_per_op'] if b['ns_per_op'] > 0 else 0.
+        print('%-32s %12.1f %12.1f %+7.1f%% %10.2f %10.2f' % (name, b['ns_per_op'], a['ns_per_op']
+            , change, b['allocs_per_op'], a['allocs_per_op']))
+
+
+if __name__ == '__main__':
+    main()
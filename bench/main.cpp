@@ -0,0 +1,214 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+// runs the benchmarks registered with IP2_BENCH()
+//
+// usage: bench [options]
+//
+//   --filter <substring>  only run the benchmarks whose name contains it
+//   --min-time <ms>       the least time one measurement runs (default: 200)
+//   --repetitions <n>     measurements per benchmark. The median is
+//                         reported (default: 5)
+//   --json                print the results as JSON, to be compared across
+//                         commits with bench/compare.py
+//   --list                list the benchmarks
+
+#include "bench.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace {
+
+	std::atomic<std::int64_t> g_allocations{0};
+
+	struct benchmark
+	{
+		char const* name;
+		bench::bench_fun fun;
+	};
+
+	std::vector<benchmark>& registry()
+	{
+		static std::vector<benchmark> r;
+		return r;
+	}
+
+	struct result
+	{
+		std::string name;
+		std::int64_t iterations = 0;
+		double ns_per_op = 0;
+		double ns_per_op_min = 0;
+		double allocs_per_op = 0;
+		double bytes_per_sec = 0;
+	};
+
+	result run(benchmark const& b, std::int64_t const min_time_ns, int const repetitions)
+	{
+		// find an iteration count that runs for at least min_time
+		std::int64_t iterations = 1;
+		for (;;)
+		{
+			bench::state st(iterations);
+			b.fun(st);
+			if (st.elapsed_ns() >= min_time_ns || iterations >= 1000000000) break;
+
+			std::int64_t next = st.elapsed_ns() > 0
+				? iterations * min_time_ns / st.elapsed_ns() * 14 / 10
+				: iterations * 100;
+			next = std::max(next, iterations * 2);
+			iterations = std::min(next, iterations * 100);
+		}
+
+		std::vector<bench::state> runs;
+		for (int i = 0; i < repetitions; ++i)
+		{
+			runs.emplace_back(iterations);
+			b.fun(runs.back());
+		}
+
+		std::sort(runs.begin(), runs.end(), [](bench::state const& lhs, bench::state const& rhs)
+			{ return lhs.elapsed_ns() < rhs.elapsed_ns(); });
+		bench::state const& median = runs[runs.size() / 2];
+
+		result r;
+		r.name = b.name;
+		r.iterations = iterations;
+		r.ns_per_op = double(median.elapsed_ns()) / double(iterations);
+		r.ns_per_op_min = double(runs.front().elapsed_ns()) / double(iterations);
+		r.allocs_per_op = double(median.allocations()) / double(iterations);
+		if (median.bytes_per_op() > 0 && median.elapsed_ns() > 0)
+		{
+			r.bytes_per_sec = double(median.bytes_per_op()) * double(iterations)
+				* 1e9 / double(median.elapsed_ns());
+		}
+		return r;
+	}
+
+	void print_text(result const& r)
+	{
+		std::printf("%-32s %12lld %12.1f ns/op %8.2f allocs/op"
+			, r.name.c_str(), static_cast<long long>(r.iterations), r.ns_per_op, r.allocs_per_op);
+		if (r.bytes_per_sec > 0)
+			std::printf(" %10.1f MB/s", r.bytes_per_sec / 1000000.);
+		std::printf("\n");
+		std::fflush(stdout);
+	}
+
+	void print_json(std::vector<result> const& results)
+	{
+		std::printf("{\n\t\"benchmarks\": [");
+		for (std::size_t i = 0; i < results.size(); ++i)
+		{
+			result const& r = results[i];
+			std::printf("%s\n\t\t{\"name\": \"%s\", \"iterations\": %lld"
+				", \"ns_per_op\": %.2f, \"ns_per_op_min\": %.2f"
+				", \"allocs_per_op\": %.3f, \"bytes_per_sec\": %.0f}"
+				, i == 0 ? "" : ",", r.name.c_str()
+				, static_cast<long long>(r.iterations), r.ns_per_op, r.ns_per_op_min
+				, r.allocs_per_op, r.bytes_per_sec);
+		}
+		std::printf("\n\t]\n}\n");
+	}
+
+	void print_usage()
+	{
+		std::fprintf(stderr, "usage: bench [--filter <substring>] [--min-time <ms>] "
+			"[--repetitions <n>] [--json] [--list]\n");
+	}
+}
+
+// every allocation is counted, to report allocations per operation
+void* operator new(std::size_t const size)
+{
+	g_allocations.fetch_add(1, std::memory_order_relaxed);
+	void* ret = std::malloc(size == 0 ? 1 : size);
+	if (ret == nullptr) throw std::bad_alloc();
+	return ret;
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace bench {
+
+	int register_benchmark(char const* name, bench_fun const fun)
+	{
+		registry().push_back({name, fun});
+		return 0;
+	}
+
+	void state::start()
+	{
+		m_start_allocations = g_allocations.load(std::memory_order_relaxed);
+		m_start = std::chrono::steady_clock::now();
+	}
+
+	void state::stop()
+	{
+		auto const end = std::chrono::steady_clock::now();
+		m_allocations = g_allocations.load(std::memory_order_relaxed) - m_start_allocations;
+		m_elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - m_start).count();
+	}
+}
+
+int main(int argc, char const* argv[])
+{
+	char const* filter = nullptr;
+	std::int64_t min_time_ms = 200;
+	int repetitions = 5;
+	bool json = false;
+	bool list = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!std::strcmp(argv[i], "--json")) json = true;
+		else if (!std::strcmp(argv[i], "--list")) list = true;
+		else if (i + 1 < argc && !std::strcmp(argv[i], "--filter")) filter = argv[++i];
+		else if (i + 1 < argc && !std::strcmp(argv[i], "--min-time")) min_time_ms = std::atoi(argv[++i]);
+		else if (i + 1 < argc && !std::strcmp(argv[i], "--repetitions")) repetitions = std::atoi(argv[++i]);
+		else
+		{
+			print_usage();
+			return 1;
+		}
+	}
+	if (min_time_ms <= 0 || repetitions <= 0)
+	{
+		print_usage();
+		return 1;
+	}
+
+	std::vector<benchmark> benchmarks = registry();
+	std::sort(benchmarks.begin(), benchmarks.end(), [](benchmark const& lhs, benchmark const& rhs)
+		{ return std::strcmp(lhs.name, rhs.name) < 0; });
+
+	std::vector<result> results;
+	for (auto const& b : benchmarks)
+	{
+		if (filter != nullptr && std::strstr(b.name, filter) == nullptr) continue;
+		if (list)
+		{
+			std::printf("%s\n", b.name);
+			continue;
+		}
+		results.push_back(run(b, min_time_ms * 1000000, repetitions));
+		if (!json) print_text(results.back());
+	}
+
+	if (json) print_json(results);
+	return 0;
+}
@@ -116,6 +116,10 @@ namespace alert_category {
 	// alerts on events in assemble
 	inline constexpr alert_category_t assemble = 29_bit;
 
+	// enables get_data_segment_alert, which streams the verified prefix
+	// of a blob while it's still being got
+	inline constexpr alert_category_t assemble_progress = 30_bit;
+
 	// The full bitmask, representing all available categories.
 	//
 	// since the enum is signed, make sure this isn't
@@ -157,6 +161,7 @@ namespace alert_category {
 		static inline constexpr alert_category_t transport_log_notification = 27_bit;
 		static inline constexpr alert_category_t assemble_log_notification = 28_bit;
 		static inline constexpr alert_category_t assemble_notification = 29_bit;
+		static inline constexpr alert_category_t assemble_progress_notification = 30_bit;
 		static inline constexpr alert_category_t all_categories = alert_category_t::all();
 
 		// hidden
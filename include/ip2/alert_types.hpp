@@ -48,6 +48,7 @@ see LICENSE file.
 #include "ip2/blockchain/transaction.hpp"
 #include "ip2/blockchain/vote.hpp"
 #include "ip2/api/error_code.hpp"
+#include "ip2/assemble/blob_buffer.hpp"
 
 #include "ip2/aux_/disable_warnings_push.hpp"
 #include <boost/shared_array.hpp>
@@ -67,7 +68,7 @@ namespace ip2 {
 	constexpr int user_alert_id = 10000;
 
 	// this constant represents "max_alert_index" + 1
-	constexpr int num_alert_types = 68;
+	constexpr int num_alert_types = 69;
 
 	// internal
 	constexpr int abi_alert_count = 128;
@@ -660,10 +661,27 @@ namespace ip2 {
 		int responses;
 
 		// the branch factor for this lookup. This is the number of
-		// nodes we keep outstanding requests to in parallel by default.
-		// when nodes time out we may increase this.
+		// nodes we keep outstanding requests to in parallel. It starts at
+		// dht_search_branching, grows by one with every response bringing
+		// the lookup closer to its target, up to
+		// dht_max_search_branching, and is halved when a request times out.
 		int branch_factor;
 
+		// the number of times this lookup sent out a batch of requests
+		int rounds;
+
+		// the total number of requests this lookup sent
+		int rpcs;
+
+		// the number of milliseconds from the start of this lookup until
+		// its first response, for a put until the first node stored the
+		// item. -1 if there hasn't been a response
+		int first_response;
+
+		// the number of milliseconds this lookup has been running, or ran
+		// for if it has completed
+		int duration;
+
 		// the number of nodes left that could be queries for this
 		// lookup. Many of these are likely to be part of the trail
 		// while performing the lookup and would never end up actually
@@ -693,6 +711,7 @@ namespace ip2 {
 		TORRENT_UNEXPORT dht_stats_alert(aux::stack_allocator& alloc
 			, std::vector<dht_routing_bucket> table
 			, std::vector<dht_lookup> requests
+			, std::vector<dht_lookup> completed
 			, sha256_hash id, udp::endpoint ep);
 
 		TORRENT_DEFINE_ALERT(dht_stats_alert, 20)
@@ -703,6 +722,9 @@ namespace ip2 {
 		// a vector of the currently running DHT lookups.
 		std::vector<dht_lookup> active_requests;
 
+		// the most recently completed DHT lookups, the oldest first.
+		std::vector<dht_lookup> completed_requests;
+
 		// contains information about every bucket in the DHT routing
 		// table.
 		std::vector<dht_routing_bucket> routing_table;
@@ -727,7 +749,8 @@ namespace ip2 {
 			traversal,
 			incoming_table,
 			items_db,
-			bs_nodes_db
+			bs_nodes_db,
+			relay_mailbox
 		};
 
 		// internal
@@ -1573,6 +1596,8 @@ namespace ip2 {
 		// internal
 		TORRENT_UNEXPORT transport_log_alert(aux::stack_allocator& alloc, char const* log);
 		TORRENT_UNEXPORT transport_log_alert(aux::stack_allocator& alloc, char const* fmt, va_list v);
+		TORRENT_UNEXPORT transport_log_alert(aux::stack_allocator& alloc, char const* fmt
+			, span<char const> record);
 
 		TORRENT_DEFINE_ALERT(transport_log_alert, 60)
 
@@ -1585,6 +1610,12 @@ namespace ip2 {
 	private:
 		std::reference_wrapper<aux::stack_allocator const> m_alloc;
 		aux::allocation_slot m_str_idx;
+
+		// a message logged as a binary record (see binary_log.hpp) is only
+		// formatted, into m_message, the first time it's read
+		char const* m_fmt = nullptr;
+		int m_record_size = 0;
+		mutable std::string m_message;
 	};
 
 	// This alert is posted by assemble event. Its main purpose is
@@ -1596,6 +1627,8 @@ namespace ip2 {
 		// internal
 		TORRENT_UNEXPORT assemble_log_alert(aux::stack_allocator& alloc, char const* log);
 		TORRENT_UNEXPORT assemble_log_alert(aux::stack_allocator& alloc, char const* fmt, va_list v);
+		TORRENT_UNEXPORT assemble_log_alert(aux::stack_allocator& alloc, char const* fmt
+			, span<char const> record);
 
 		TORRENT_DEFINE_ALERT(assemble_log_alert, 61)
 
@@ -1608,6 +1641,12 @@ namespace ip2 {
 	private:
 		std::reference_wrapper<aux::stack_allocator const> m_alloc;
 		aux::allocation_slot m_str_idx;
+
+		// a message logged as a binary record (see binary_log.hpp) is only
+		// formatted, into m_message, the first time it's read
+		char const* m_fmt = nullptr;
+		int m_record_size = 0;
+		mutable std::string m_message;
 	};
 
 	// this alert is posted when putting blob is completed.
@@ -1700,7 +1739,7 @@ namespace ip2 {
 			, std::array<char, 32> const& from
 			, std::array<char, 20> const& data_uri
 			, std::int64_t ts
-			, std::vector<char> const& blob
+			, std::shared_ptr<assemble::blob_buffer const> b
 			, api::error_code const ec);
 
 		TORRENT_UNEXPORT get_data_alert(aux::stack_allocator& alloc
@@ -1724,11 +1763,56 @@ namespace ip2 {
 
 		std::int64_t timestamp;
 
-		// blob
-		std::vector<char> data;
+		// the buffer the blob was assembled in. It's shared with ip2 and
+		// is kept alive by this alert. Holding on to this pointer lets the
+		// client keep the blob beyond the lifetime of the alert without
+		// copying it. It's nullptr if getting the blob failed.
+		std::shared_ptr<assemble::blob_buffer const> blob;
+
+		// blob, a view into ``blob``
+		span<char const> data;
 
 		api::error_code error;
-    };
+	};
+
+	// this alert is posted while getting data, every time one or more
+	// segments following the already delivered ones have been got and
+	// verified. Concatenating ``data`` of these alerts, in order, yields
+	// the blob before the get_data_alert is posted. This alert is only
+	// posted if alert_category::assemble_progress is enabled.
+	struct TORRENT_EXPORT get_data_segment_alert final : alert
+	{
+		// internal
+		TORRENT_UNEXPORT get_data_segment_alert(aux::stack_allocator& alloc
+			, std::array<char, 32> const& from
+			, std::array<char, 20> const& data_uri
+			, std::int64_t ts
+			, std::shared_ptr<assemble::blob_buffer const> b
+			, std::int64_t offset
+			, span<char const> range);
+
+		TORRENT_DEFINE_ALERT(get_data_segment_alert, 68)
+
+		static inline constexpr alert_category_t static_category = alert_category::assemble_progress;
+		std::string message() const override;
+
+		// sender public key
+		std::array<char, 32> sender;
+
+		// uri
+		std::array<char, 20> uri;
+
+		std::int64_t timestamp;
+
+		// the buffer the blob is being assembled in
+		std::shared_ptr<assemble::blob_buffer const> blob;
+
+		// the offset of ``data`` within the blob
+		std::int64_t offset;
+
+		// the newly verified segments, a view into ``blob``
+		span<char const> data;
+	};
 
 	// this alert is posted when relay message is completed.
 	struct TORRENT_EXPORT relay_message_alert final : alert
@@ -1763,7 +1847,7 @@ namespace ip2 {
 		// internal
 		TORRENT_UNEXPORT incoming_relay_message_alert(aux::stack_allocator& alloc
 			, char const* from
-			, std::string const& incoming_msg);
+			, span<char const> incoming_msg);
 
 		TORRENT_DEFINE_ALERT_PRIO(incoming_relay_message_alert, 67, alert_priority::critical)
 
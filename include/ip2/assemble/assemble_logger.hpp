@@ -12,6 +12,8 @@ see LICENSE file.
 
 #include "ip2/config.hpp"
 #include "ip2/aux_/common.h"
+#include "ip2/aux_/binary_log.hpp"
+#include "ip2/span.hpp"
 
 namespace ip2 {
 namespace assemble {
@@ -21,6 +23,28 @@ struct TORRENT_EXTRA_EXPORT assemble_logger
 	virtual bool should_log(aux::LOG_LEVEL log_level) const = 0;
 	virtual void log(aux::LOG_LEVEL log_level, char const* fmt, ...) TORRENT_FORMAT(3,4) = 0;
 
+	// post a message logged as a binary record, see binary_log.hpp
+	virtual void log_record(aux::LOG_LEVEL log_level, char const* fmt
+		, span<char const> record) = 0;
+
+	// like log(), but the arguments are recorded in binary form and only
+	// formatted if the message is read. Nothing is done with the arguments
+	// unless the level is enabled, and keys or hashes passed as
+	// aux::hex_arg are only hex encoded by the reader. ``fmt`` must be a
+	// string literal.
+	template <typename... Args>
+	void log_lazy(aux::LOG_LEVEL log_level, char const* fmt, Args const&... args)
+	{
+#ifndef TORRENT_DISABLE_LOGGING
+		if (!should_log(log_level)) return;
+		log_record(log_level, fmt, aux::write_log_record(args...));
+#else
+		TORRENT_UNUSED(log_level);
+		TORRENT_UNUSED(fmt);
+		((void)args, ...);
+#endif
+	}
+
 protected:
 	~assemble_logger() = default;
 };
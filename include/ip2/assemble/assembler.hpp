@@ -11,10 +11,12 @@ see LICENSE file.
 #define IP2_ASSEMBLE_ASSEMBLER_HPP
 
 #include "ip2/assemble/assemble_logger.hpp"
+#include "ip2/assemble/direct_channel.hpp"
 #include "ip2/assemble/getter.hpp"
 #include "ip2/assemble/putter.hpp"
 #include "ip2/assemble/relayer.hpp"
 #include "ip2/assemble/relay_dispatcher.hpp"
+#include "ip2/assemble/segment_cache.hpp"
 
 #include <ip2/entry.hpp>
 #include <ip2/io_context.hpp>
@@ -65,6 +67,8 @@ public:
 	bool should_log(aux::LOG_LEVEL log_level) const override;
 	void log(aux::LOG_LEVEL log_level, char const* fmt, ...)
 		noexcept override TORRENT_FORMAT(3,4);
+	void log_record(aux::LOG_LEVEL log_level, char const* fmt
+		, span<char const> record) noexcept override;
 
 	void start();
 	void stop();
@@ -74,7 +78,8 @@ public:
 	api::error_code put(span<char const> blob, aux::uri const& blob_uri);
 
 	api::error_code get(dht::public_key const& sender
-		, aux::uri data_uri, dht::timestamp ts);
+		, aux::uri data_uri, dht::timestamp ts
+		, blob_handler handler = blob_handler());
 
 	api::error_code relay_message(dht::public_key const& receiver
 		, span<char const> message);
@@ -82,6 +87,12 @@ public:
 	api::error_code relay_uri(dht::public_key const& receiver
 		, aux::uri const& data_uri, dht::timestamp ts);
 
+	// a uTP stream opened by a direct getter
+	void on_incoming_direct(std::unique_ptr<aux::utp_stream> s);
+
+	// keep the segments cached on disk in ``dir``
+	void open_segment_cache(std::string dir);
+
 private:
 
 	io_context& m_ios;
@@ -91,6 +102,10 @@ private:
 
 	dht::public_key m_self_pubkey;
 
+	// the getter and putter refer to these, they're constructed before them
+	std::shared_ptr<direct_channel> m_direct;
+	segment_cache m_cache;
+
 	getter m_getter;
 	putter m_putter;
 	relayer m_relayer;
@@ -0,0 +1,89 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#ifndef IP2_ASSEMBLE_BLOB_BUFFER_HPP
+#define IP2_ASSEMBLE_BLOB_BUFFER_HPP
+
+#include "ip2/config.hpp"
+#include "ip2/bitfield.hpp"
+#include "ip2/span.hpp"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace ip2 {
+namespace assemble {
+
+// blob_buffer is the single backing store of a blob being retrieved.
+// It's allocated once the root index is known, and every segment is
+// copied straight into its final offset when it arrives. The buffer is
+// shared (by std::shared_ptr) between the getter and the alerts handed
+// to the client, so delivering a blob doesn't copy it again.
+//
+// Once a segment has been written it's never modified. The length of the
+// contiguous prefix is published with release/acquire ordering after its
+// bytes are copied in. This makes data(), size(), contiguous_segments()
+// and is_complete() safe to call from the client while the network thread
+// keeps filling in later segments. Everything else is network thread only.
+struct TORRENT_EXPORT blob_buffer
+{
+	// allocate a buffer for ``num_segments`` segments. Every segment, but
+	// the last one, must be exactly ``segment_size`` bytes.
+	blob_buffer(int num_segments, int segment_size);
+
+	// construct a complete buffer holding a copy of ``content``
+	explicit blob_buffer(span<char const> content);
+
+	blob_buffer(blob_buffer const&) = delete;
+	blob_buffer& operator=(blob_buffer const&) = delete;
+
+	int num_segments() const { return m_num_segments; }
+	int segment_size() const { return m_segment_size; }
+
+	bool has_segment(int index) const { return m_written.get_bit(index); }
+
+	// copy ``seg`` into the position of segment ``index``. Returns false
+	// if the index is out of range or the segment has an invalid size.
+	// Writing a segment that's already present is a no-op.
+	bool write_segment(int index, span<char const> seg);
+
+	bool is_complete() const { return contiguous_segments() == m_num_segments; }
+
+	// the number of segments, starting from the first one, which have all
+	// been written
+	int contiguous_segments() const
+	{ return m_contiguous.load(std::memory_order_acquire); }
+
+	// the whole blob once it's complete. Before that, the contiguous
+	// prefix of the blob that has been written so far.
+	span<char const> data() const;
+
+	int size() const { return int(data().size()); }
+
+private:
+
+	std::vector<char> m_buffer;
+	bitfield m_written;
+
+	int m_num_segments;
+	int m_segment_size;
+
+	// stored with release after the segments it covers (and
+	// m_last_segment_size) are written
+	std::atomic<int> m_contiguous{0};
+
+	// the size of the last segment, 0 until it has been written
+	std::atomic<int> m_last_segment_size{0};
+};
+
+} // namespace assemble
+} // namespace ip2
+
+#endif // IP2_ASSEMBLE_BLOB_BUFFER_HPP
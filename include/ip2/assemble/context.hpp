@@ -13,6 +13,7 @@ see LICENSE file.
 #include "ip2/config.hpp"
 #include "ip2/aux_/common.h"
 #include "ip2/api/error_code.hpp"
+#include "ip2/time.hpp"
 
 using namespace ip2::api;
 
@@ -31,6 +32,9 @@ public:
 
 	api::error_code get_error() { return m_error; }
 
+	// the time since the context was created, i.e. since the task started
+	time_duration elapsed() const;
+
 	virtual void done();
 
 protected:
@@ -38,6 +42,8 @@ protected:
 	std::uint32_t m_id;
 
 	api::error_code m_error;
+
+	time_point m_start_time;
 };
 
 } // namespace assemble
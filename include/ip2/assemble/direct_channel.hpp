@@ -0,0 +1,141 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#ifndef IP2_ASSEMBLE_DIRECT_CHANNEL_HPP
+#define IP2_ASSEMBLE_DIRECT_CHANNEL_HPP
+
+#include "ip2/assemble/assemble_logger.hpp"
+
+#include <ip2/io_context.hpp>
+#include "ip2/address.hpp"
+#include "ip2/error_code.hpp"
+#include "ip2/socket.hpp"
+#include "ip2/sha1_hash.hpp"
+#include "ip2/span.hpp"
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace ip2 {
+
+	struct counters;
+
+namespace aux {
+    struct session_settings;
+	struct session_interface;
+	struct utp_stream;
+}
+
+namespace assemble {
+
+// The direct channel moves blob segments over a uTP stream between two
+// peers that can reach each other, instead of through the DHT.
+//
+// The sender keeps the blobs it put recently and serves their segments by
+// hash. The getter, once it has the signed root index of a blob from the
+// DHT, asks the sender for the segments listed in it, and checks every
+// segment against its hash like one got from the DHT. What couldn't be
+// got directly is left to the DHT.
+//
+// The request is the magic "IP2D", a 2 byte big endian segment count and
+// the 20 byte hashes. The response is, for every hash in order, a 2 byte
+// big endian length and the segment, or a length of 0 if the segment isn't
+// known.
+class TORRENT_EXTRA_EXPORT direct_channel final
+	: public std::enable_shared_from_this<direct_channel>
+{
+public:
+
+	// called for every segment got, in the order they were requested.
+	// Returning false closes the stream, for instance if the segment
+	// doesn't match its hash
+	using segment_handler = std::function<bool(sha1_hash const&, span<char const>)>;
+
+	// called once the fetch is over, with the segments that were not got
+	using done_handler = std::function<void(std::vector<sha1_hash> missing)>;
+
+	direct_channel(io_context& ios
+		, aux::session_interface& session
+		, aux::session_settings const& settings
+		, counters& cnt
+		, assemble_logger& logger);
+
+	direct_channel(direct_channel const&) = delete;
+	direct_channel& operator=(direct_channel const&) = delete;
+
+	~direct_channel();
+
+	// keep ``blob`` to serve its segments to direct getters. ``hashes`` are
+	// the hashes of its segments, in order. The oldest blobs are dropped
+	// once the cache exceeds direct_transfer_cache_size
+	void serve(span<char const> blob, span<sha1_hash const> hashes);
+
+	// a stream opened by a getter
+	void incoming(std::unique_ptr<aux::utp_stream> s);
+
+	// get ``hashes`` from the peer at ``ep``. Returns false if no stream
+	// could be opened, in which case no handler is called
+	bool fetch(udp::endpoint const& ep, std::vector<sha1_hash> hashes
+		, segment_handler on_segment, done_handler on_done);
+
+	// close all streams
+	void stop();
+
+	int num_connections() const { return int(m_connections.size()); }
+
+private:
+
+	struct connection;
+
+	void serve_request(std::shared_ptr<connection> c);
+	void read_response(std::shared_ptr<connection> c);
+	void close(std::shared_ptr<connection> c, error_code const& ec);
+
+	// returns the cached segment with hash ``h``, or an empty span
+	span<char const> find_segment(sha1_hash const& h) const;
+
+	io_context& m_ios;
+	aux::session_interface& m_session;
+	aux::session_settings const& m_settings;
+	counters& m_counters;
+
+	assemble_logger& m_logger;
+
+	struct cached_blob
+	{
+		std::vector<char> data;
+		std::vector<sha1_hash> hashes;
+	};
+
+	// the blobs put most recently, oldest first
+	std::deque<std::shared_ptr<cached_blob>> m_blobs;
+	std::int64_t m_cache_size = 0;
+
+	struct segment_ref
+	{
+		cached_blob const* blob;
+		int offset;
+		int size;
+	};
+
+	// maps segment hash to where the segment is in m_blobs
+	std::map<sha1_hash, segment_ref> m_segments;
+
+	std::set<std::shared_ptr<connection>> m_connections;
+};
+
+} // namespace assemble
+} // namespace ip2
+
+#endif // IP2_ASSEMBLE_DIRECT_CHANNEL_HPP
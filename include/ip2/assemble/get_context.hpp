@@ -12,16 +12,21 @@ see LICENSE file.
 
 #include "ip2/assemble/context.hpp"
 #include "ip2/assemble/assemble_logger.hpp"
+#include "ip2/assemble/blob_buffer.hpp"
 
 #include <ip2/kademlia/item.hpp>
 #include <ip2/kademlia/node_id.hpp>
 #include <ip2/kademlia/types.hpp>
 
 #include <ip2/api/error_code.hpp>
+#include <ip2/socket.hpp>
 #include <ip2/sha1_hash.hpp>
+#include <ip2/span.hpp>
 #include <ip2/uri.hpp>
 
+#include <functional>
 #include <map>
+#include <memory>
 #include <set>
 #include <tuple>
 #include <vector>
@@ -33,6 +38,10 @@ namespace assemble {
 
 static constexpr int reget_times_limit = 3;
 
+// the blob got, or nullptr and the error. A get with a handler reports to it
+// instead of posting get_data_alert
+using blob_handler = std::function<void(std::shared_ptr<blob_buffer const>, api::error_code)>;
+
 struct TORRENT_EXTRA_EXPORT get_context final : context
 {
 public:
@@ -67,7 +76,21 @@ public:
 
 	api::error_code on_root_index_got(dht::item const& it);
 
-	api::error_code on_segment_got(dht::item const& it, sha1_hash const& seg_hash);
+	// ``value`` is set to the segment, valid as long as ``it``
+	api::error_code on_segment_got(dht::item const& it, sha1_hash const& seg_hash
+		, span<char const>& value);
+
+	// the segment got, decoded, whether from the DHT or the direct
+	// channel. It's checked against its hash before it's written
+	api::error_code on_segment_value(span<char const> value, sha1_hash const& seg_hash);
+
+	// the endpoint the sender serves the blob on directly, if it
+	// announced one
+	void set_direct_endpoint(udp::endpoint const& ep) { m_direct_endpoint = ep; }
+	udp::endpoint const& direct_endpoint() const { return m_direct_endpoint; }
+
+	void set_handler(blob_handler h) { m_handler = std::move(h); }
+	blob_handler const& handler() const { return m_handler; }
 
 	void done() override;
 
@@ -76,7 +99,16 @@ public:
 		return m_flying_segments.size() == 0;
 	}
 
-	bool get_segments_blob(std::vector<char>& value);
+	// returns the blob if all its segments have been got, otherwise nullptr
+	std::shared_ptr<blob_buffer const> get_blob() const;
+
+	// returns the blob whether or not all its segments have been got
+	std::shared_ptr<blob_buffer const> get_partial_blob() const { return m_blob; }
+
+	// returns true and sets 'offset' and 'range' if more segments have
+	// become contiguous since the last call. This is used to stream the
+	// verified prefix of the blob before all segments have arrived.
+	bool next_stream_range(std::int64_t& offset, span<char const>& range);
 
 private:
 
@@ -94,8 +126,21 @@ private:
 	std::set<sha1_hash> m_flying_segments;
 
 	std::vector<sha1_hash> m_root_index;
-	std::map<sha1_hash, std::string> m_segments;
-	std::size_t m_segments_total_size = 0;
+
+	// segments are written into this buffer at their final offsets.
+	// It's allocated when the root index is got.
+	std::shared_ptr<blob_buffer> m_blob;
+
+	// maps segment hash to its positions in the root index. The same
+	// segment may appear more than once in a blob.
+	std::map<sha1_hash, std::vector<int>> m_segment_positions;
+
+	// the number of leading segments already handed out by next_stream_range()
+	int m_streamed_segments = 0;
+
+	udp::endpoint m_direct_endpoint;
+
+	blob_handler m_handler;
 };
 
 } // namespace assemble
@@ -11,15 +11,19 @@ see LICENSE file.
 #define IP2_ASSEMBLE_GETTER_HPP
 
 #include "ip2/assemble/assemble_logger.hpp"
+#include "ip2/assemble/direct_channel.hpp"
 #include "ip2/assemble/get_context.hpp"
 #include "ip2/assemble/rpc_params_config.hpp"
+#include "ip2/assemble/segment_cache.hpp"
 
 #include <ip2/entry.hpp>
 #include <ip2/io_context.hpp>
 #include "ip2/api/error_code.hpp"
 #include "ip2/aux_/common.h"
 #include "ip2/aux_/deadline_timer.hpp"
+#include "ip2/socket.hpp"
 #include "ip2/span.hpp"
+#include "ip2/time.hpp"
 #include "ip2/uri.hpp"
 
 #include <ip2/kademlia/types.hpp>
@@ -27,6 +31,7 @@ see LICENSE file.
 #include <ip2/kademlia/node_entry.hpp>
 
 #include <functional>
+#include <map>
 #include <queue>
 #include <set>
 #include <string>
@@ -56,7 +61,9 @@ public:
 		, aux::session_interface& session
 		, aux::session_settings const& settings
 		, counters& cnt
-		, assemble_logger& logger);
+		, assemble_logger& logger
+		, direct_channel& direct
+		, segment_cache& cache);
 
 	getter(getter const&) = delete;
 	getter& operator=(getter const&) = delete;
@@ -65,11 +72,16 @@ public:
 
 	std::shared_ptr<getter> self() { return shared_from_this(); }
 
+	// the blob is reported to ``handler`` if there's one, otherwise by a
+	// get_data_alert
 	api::error_code get_blob(dht::public_key const& sender
-		, aux::uri blob_uri, dht::timestamp ts);
+		, aux::uri blob_uri, dht::timestamp ts
+		, blob_handler handler = blob_handler());
 
+	// ``ep`` is where the sender serves the blob directly, if it said so
 	void on_incoming_relay_uri(dht::public_key const& sender
-		, aux::uri blob_uri, dht::timestamp ts);
+		, aux::uri blob_uri, dht::timestamp ts
+		, udp::endpoint const& ep = udp::endpoint());
 
 	void update_node_id();
 
@@ -78,8 +90,30 @@ private:
 	void get_callback(dht::item const& it, bool auth
 		, std::shared_ptr<get_context> ctx, sha1_hash hash, bool is_seg);
 
+	// get ``hashes`` from the DHT. Returns false if the get failed and
+	// ``ctx`` has been finished
+	bool get_segments(std::shared_ptr<get_context> ctx, sha1_hash const& index_hash
+		, std::vector<sha1_hash> const& hashes);
+
+	// write the segment ``h`` into ``ctx`` if it's cached. Returns false
+	// if it has to be got from the network
+	bool get_cached_segment(std::shared_ptr<get_context> ctx, sha1_hash const& h);
+
+	// get ``hashes`` from the sender over the direct channel. Returns false
+	// if no stream could be opened to it
+	bool get_segments_direct(std::shared_ptr<get_context> ctx
+		, std::vector<sha1_hash> const& hashes);
+
+	// the segments the direct channel didn't get are got from the DHT
+	void on_direct_done(std::shared_ptr<get_context> ctx
+		, std::vector<sha1_hash> const& missing);
+
 	void post_alert(std::shared_ptr<get_context> ctx);
 
+	// stream the segments which have become contiguous, if the client
+	// has enabled alert_category::assemble_progress
+	void post_segment_alert(std::shared_ptr<get_context> ctx);
+
 	io_context& m_ios;
 	aux::session_interface& m_session;
 	aux::session_settings const& m_settings;
@@ -87,9 +121,23 @@ private:
 
 	assemble_logger& m_logger;
 
+	direct_channel& m_direct;
+
+	segment_cache& m_cache;
+
 	dht::public_key m_self_pubkey;
 
 	std::set<std::shared_ptr<get_context> > m_running_tasks;
+
+	struct direct_hint
+	{
+		udp::endpoint ep;
+		time_point expires;
+	};
+
+	// where senders said they serve their blobs directly, as told by
+	// their relayed uris
+	std::map<dht::public_key, direct_hint> m_direct_hints;
 };
 
 } // namespace assemble
@@ -10,18 +10,20 @@ see LICENSE file.
 #ifndef IP2_ASSEMBLE_PROTOCOL_HPP
 #define IP2_ASSEMBLE_PROTOCOL_HPP
 
-#include "ip2/assemble/assemble_logger.hpp"
 #include "ip2/config.hpp"
 #include "ip2/aux_/common.h"
 #include "ip2/api/error_code.hpp"
+#include "ip2/aux_/socket_io.hpp" // for read_v4_endpoint
+#include "ip2/bdecode.hpp"
 #include "ip2/entry.hpp"
 #include "ip2/uri.hpp"
 #include "ip2/sha1_hash.hpp"
+#include "ip2/span.hpp"
 
 #include "ip2/kademlia/types.hpp"
 
-#include <string>
-#include <tuple>
+#include <array>
+#include <cstring>
 #include <vector>
 
 using namespace ip2::api;
@@ -54,6 +56,7 @@ namespace protocol {
 			'v': <version number with 4 bytes>
 			'n': 'u' // uri
 			'a': {
+				'e': <endpoint the sender serves the blob on directly, optional>
 				's': <uri sender public key>
 				'u': <uri>
 				'ts': <timestamp>
@@ -72,9 +75,13 @@ namespace protocol {
 
 	constexpr int version_length = 4;
 
-	inline bool version_match(std::string const& ver, std::string const& pro_ver)
+	using version_t = std::array<char, version_length>;
+
+	// only the protocol tag and the major version have to match
+	inline bool version_match(span<char const> ver, version_t const& pro_ver)
 	{
-		return strncmp(pro_ver.c_str(), ver.c_str(), 2) == 0 ? true : false;
+		return ver.size() == version_length
+			&& std::memcmp(ver.data(), pro_ver.data(), 2) == 0;
 	}
 
 	static const std::int32_t blob_mtu = 45 * 1000;
@@ -82,160 +89,242 @@ namespace protocol {
 	static const std::int32_t index_hash_count = 45;
 	static const std::int32_t relay_msg_mtu = 950;
 
-	struct basic_protocol
+	// Every message type is described at compile time by a schema: its
+	// name, its version and how its arguments ('a') are written and read.
+	//
+	// Messages are written by encode() directly in their bencoded form into
+	// a preformatted entry, which is signed and sent by the DHT as is,
+	// without building an entry tree. They are read by decode() from either
+	// a bdecode_node or an entry into a view, which refers to the strings
+	// of the decoded message rather than copying them. A view is only valid
+	// as long as the node it was decoded from.
+
+	struct blob_seg_schema
 	{
-	public:
-
-		static std::string version;
-		static std::string name;
-
-		basic_protocol();
+		static constexpr char name = 's';
+		static constexpr version_t version = {{'S', 0, 0, 0}};
 
-		basic_protocol(std::string const& ver, std::string const& n);
-
-		virtual ~basic_protocol() {}
+		struct view
+		{
+			span<char const> value;
+		};
 
-		entry to_entry();
+		static void write_args(std::vector<char>& buf, span<char const> seg);
+	};
 
-		std::string get_version() { return m_version; }
-		std::string get_name() { return m_name; }
-		void set_version(std::string const& v) { m_version = v; }
-		void set_name(std::string const& n) { m_name = n; }
+	struct blob_index_schema
+	{
+		static constexpr char name = 'i';
+		static constexpr version_t version = {{'I', 0, 0, 0}};
 
-	protected:
+		struct view
+		{
+			// the concatenated 20 bytes segment hashes
+			span<char const> hashes;
 
-		std::string m_version;
-		std::string m_name;
+			int count() const { return int(hashes.size() / 20); }
+			sha1_hash hash(int i) const { return sha1_hash(hashes.data() + i * 20); }
+		};
 
-		entry m_arg;
+		static void write_args(std::vector<char>& buf
+			, std::vector<sha1_hash> const& hashes);
+	};
 
-	private:
+	struct relay_uri_schema
+	{
+		static constexpr char name = 'u';
+		static constexpr version_t version = {{'U', 0, 1, 0}};
 
-		static const int major = 0;
-		static const int minor = 0;
-		static const int tiny = 0;
-		static char const ver[];
+		struct view
+		{
+			dht::public_key pk;
+			aux::uri blob_uri;
+			dht::timestamp ts;
+
+			// default constructed if the sender didn't announce one
+			udp::endpoint ep;
+		};
+
+		// ``ep`` is left out if it's default constructed
+		static void write_args(std::vector<char>& buf, dht::public_key const& pk
+			, aux::uri const& blob_uri, dht::timestamp ts
+			, udp::endpoint const& ep = udp::endpoint());
 	};
 
-	struct blob_seg_protocol : public basic_protocol
+	struct relay_msg_schema
 	{
-	public:
+		static constexpr char name = 'm';
+		static constexpr version_t version = {{'M', 0, 0, 0}};
 
-		static std::string version;
-		static std::string name;
-
-		blob_seg_protocol(std::string const& ver, std::string const& n
-			, std::string const& seg_value);
+		struct view
+		{
+			span<char const> msg;
+		};
 
-		blob_seg_protocol(std::string const& seg_value);
+		static void write_args(std::vector<char>& buf, span<char const> msg);
+	};
 
-		std::string seg_value() { return m_seg_value; }
+namespace detail {
 
-	protected:
+	// write the bencoded string ``s`` into ``buf``
+	TORRENT_EXTRA_EXPORT void write_string(std::vector<char>& buf, span<char const> s);
 
-		std::string m_seg_value;
+	// write the bencoded integer ``v`` into ``buf``
+	TORRENT_EXTRA_EXPORT void write_integer(std::vector<char>& buf, std::int64_t v);
 
-	private:
+	// write the bencoded envelope of a message, up to the start of the
+	// argument dictionary
+	TORRENT_EXTRA_EXPORT void write_header(std::vector<char>& buf);
 
- 		static const int major = 0;
-		static const int minor = 0;
-		static const int tiny = 0;
-		static char const ver[];
-	};
+	// close the argument dictionary and write the name and version
+	TORRENT_EXTRA_EXPORT void write_trailer(std::vector<char>& buf, char name
+		, version_t const& version);
 
-	struct blob_index_protocol : public basic_protocol
+	// uniform read access to entry and bdecode_node dictionaries. A
+	// default constructed (or missing) node converts to false.
+	struct entry_reader
 	{
-	public:
-
-		static std::string version;
-		static std::string name;
-
-		blob_index_protocol(std::string const& ver, std::string const& n
-			, std::vector<sha1_hash> const& hashes);
-
-        blob_index_protocol(std::vector<sha1_hash> const& hashes);
+		entry const* e = nullptr;
 
-        void seg_hashes(std::vector<sha1_hash>& hashes)
+		explicit operator bool() const { return e != nullptr; }
+		bool is_dict() const { return e && e->type() == entry::dictionary_t; }
+		entry_reader operator[](char const* key) const
+		{ return {is_dict() ? e->find_key(key) : nullptr}; }
+		bool string(span<char const>& out) const
 		{
-			for (auto& h : m_seg_hashes)
-			{
-				hashes.push_back(h);
-			}
+			if (!e || e->type() != entry::string_t) return false;
+			out = e->string();
+			return true;
 		}
+		bool integer(std::int64_t& out) const
+		{
+			if (!e || e->type() != entry::int_t) return false;
+			out = e->integer();
+			return true;
+		}
+	};
 
-    protected:
-
-        std::vector<sha1_hash> m_seg_hashes;
+	struct node_reader
+	{
+		bdecode_node n;
 
-    private:
+		explicit operator bool() const { return bool(n); }
+		bool is_dict() const { return n.type() == bdecode_node::dict_t; }
+		node_reader operator[](char const* key) const
+		{ return {is_dict() ? n.dict_find(key) : bdecode_node()}; }
+		bool string(span<char const>& out) const
+		{
+			if (n.type() != bdecode_node::string_t) return false;
+			out = {n.string_ptr(), n.string_length()};
+			return true;
+		}
+		bool integer(std::int64_t& out) const
+		{
+			if (n.type() != bdecode_node::int_t) return false;
+			out = n.int_value();
+			return true;
+		}
+	};
 
-        static const int major = 0;
-        static const int minor = 0;
-        static const int tiny = 0;
-        static char const ver[];
-    };
+	inline entry_reader reader(entry const& e) { return {&e}; }
+	inline node_reader reader(bdecode_node const& n) { return {n.non_owning()}; }
 
-	struct relay_uri_protocol : public basic_protocol
+	template <typename Reader>
+	bool read_args(Reader const& a, blob_seg_schema::view& v)
 	{
-	public:
+		return a["v"].string(v.value) && v.value.size() <= blob_seg_mtu;
+	}
 
-		static std::string version;
-		static std::string name;
+	template <typename Reader>
+	bool read_args(Reader const& a, blob_index_schema::view& v)
+	{
+		return a["h"].string(v.hashes) && v.hashes.size() % 20 == 0;
+	}
 
-		relay_uri_protocol(std::string const& ver, std::string const& n
-			, dht::public_key const& pk, aux::uri const& blob_uri
-			, dht::timestamp ts);
+	template <typename Reader>
+	bool read_args(Reader const& a, relay_uri_schema::view& v)
+	{
+		span<char const> pk;
+		span<char const> u;
+		if (!a["s"].string(pk) || pk.size() != dht::public_key::len) return false;
+		if (!a["u"].string(u) || u.size() != aux::uri::len) return false;
 
-		relay_uri_protocol(dht::public_key const& pk, aux::uri const& blob_uri
-			, dht::timestamp ts);
+		std::memcpy(v.pk.bytes.data(), pk.data(), dht::public_key::len);
+		std::memcpy(v.blob_uri.bytes.data(), u.data(), aux::uri::len);
 
-		dht::public_key pk() { return m_pk; }
-		aux::uri blob_uri() { return m_uri; }
-		dht::timestamp ts() { return m_ts; }
+		// the timestamp is optional
+		std::int64_t ts = 0;
+		if (a["ts"].integer(ts)) v.ts = dht::timestamp(ts);
 
-	protected:
+		// so is the endpoint, in its compact form
+		span<char const> e;
+		if (a["e"].string(e))
+		{
+			char const* ptr = e.data();
+			if (e.size() == 6)
+				v.ep = aux::read_v4_endpoint<udp::endpoint>(ptr);
+			else if (e.size() == 18)
+				v.ep = aux::read_v6_endpoint<udp::endpoint>(ptr);
+		}
 
-		dht::public_key m_pk;
-		aux::uri m_uri;
-		dht::timestamp m_ts;
+		return true;
+	}
 
-	private:
+	template <typename Reader>
+	bool read_args(Reader const& a, relay_msg_schema::view& v)
+	{
+		return a["m"].string(v.msg) && v.msg.size() <= relay_msg_mtu;
+	}
 
-		static const int major = 0;
-		static const int minor = 0;
-		static const int tiny = 0;
-		static char const ver[];
-	};
+} // namespace detail
 
-	struct relay_msg_protocol : public basic_protocol
+	// returns the name of the message, or 0 if it's malformed
+	template <typename Node>
+	char message_name(Node const& proto)
 	{
-	public:
+		span<char const> n;
+		if (!detail::reader(proto)["n"].string(n) || n.size() != 1) return 0;
+		return n[0];
+	}
 
-		static std::string version;
-		static std::string name;
+	// write a message of type ``Schema`` with the arguments ``args``.
+	// The returned entry holds the bencoded message.
+	template <typename Schema, typename... Args>
+	entry encode(Args const&... args)
+	{
+		entry::preformatted_type buf;
+		detail::write_header(buf);
+		Schema::write_args(buf, args...);
+		detail::write_trailer(buf, Schema::name, Schema::version);
+		return entry(std::move(buf));
+	}
 
-		relay_msg_protocol(std::string const& ver, std::string const& n
-			, std::string const& msg);
+	// read a message of type ``Schema`` from ``proto``, which is either an
+	// entry or a bdecode_node.
+	template <typename Schema, typename Node>
+	api::error_code decode(Node const& proto, typename Schema::view& v)
+	{
+		auto const r = detail::reader(proto);
 
-		relay_msg_protocol(std::string const& msg);
+		span<char const> ver;
+		if (!r["v"].string(ver) || ver.size() != version_length)
+			return api::ASSEMBLE_VERSION_ERROR;
 
-		std::string msg() { return m_msg; }
+		char const n = message_name(proto);
+		if (n == 0) return api::ASSEMBLE_PROTOCOL_FORMAT_ERROR;
 
-	protected:
+		auto const a = r["a"];
+		if (!a.is_dict()) return api::ASSEMBLE_PROTOCOL_FORMAT_ERROR;
 
-		std::string m_msg;
+		if (n != Schema::name) return api::ASSEMBLE_NAME_ERROR;
 
-	private:
+		if (!version_match(ver, Schema::version))
+			return api::ASSEMBLE_PROTOCOL_VER_MISMATCH;
 
-		static const int major = 0;
-		static const int minor = 0;
-		static const int tiny = 0;
-		static char const ver[];
-	};
+		if (!detail::read_args(a, v)) return api::ASSEMBLE_PROTOCOL_FORMAT_ERROR;
 
-	// basic protocol factory method
-	std::tuple<std::shared_ptr<basic_protocol>, api::error_code>
-		construct_protocol(entry const& proto, assemble_logger& logger);
+		return api::NO_ERROR;
+	}
 
 } // namespace protocol
 } // namespace assemble
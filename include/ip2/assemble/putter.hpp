@@ -11,8 +11,10 @@ see LICENSE file.
 #define IP2_ASSEMBLE_PUTTER_HPP
 
 #include "ip2/assemble/assemble_logger.hpp"
+#include "ip2/assemble/direct_channel.hpp"
 #include "ip2/assemble/put_context.hpp"
 #include "ip2/assemble/rpc_params_config.hpp"
+#include "ip2/assemble/segment_cache.hpp"
 
 #include <ip2/entry.hpp>
 #include <ip2/io_context.hpp>
@@ -53,7 +55,9 @@ public:
 		, aux::session_interface& session
 		, aux::session_settings const& settings
 		, counters& cnt
-		, assemble_logger& logger);
+		, assemble_logger& logger
+		, direct_channel& direct
+		, segment_cache& cache);
 
 	putter(putter const&) = delete;
 	putter& operator=(putter const&) = delete;
@@ -71,8 +75,6 @@ public:
 
 private:
 
-	sha1_hash hash(std::string const& value, std::size_t value_size);
-
 	sha1_hash hash(std::vector<sha1_hash> const& hl);
 
 	sha1_hash hash(span<char const> blob, aux::uri const& blob_uri);
@@ -84,6 +86,10 @@ private:
 
 	assemble_logger& m_logger;
 
+	direct_channel& m_direct;
+
+	segment_cache& m_cache;
+
 	dht::public_key m_self_pubkey;
 
 	std::set<std::shared_ptr<put_context> > m_running_tasks;
@@ -66,7 +66,7 @@ public:
 	api::error_code relay_message(dht::public_key const& receiver
 		, span<char const> message);
 
-	void on_incoming_relay_message(dht::public_key const& pk, std::string const& msg);
+	void on_incoming_relay_message(dht::public_key const& pk, span<char const> msg);
 
 	api::error_code relay_uri(dht::public_key const& receiver
 		, aux::uri const& data_uri, dht::timestamp ts);
@@ -0,0 +1,119 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#ifndef IP2_ASSEMBLE_SEGMENT_CACHE_HPP
+#define IP2_ASSEMBLE_SEGMENT_CACHE_HPP
+
+#include "ip2/assemble/assemble_logger.hpp"
+
+#include "ip2/config.hpp"
+#include "ip2/sha1_hash.hpp"
+#include "ip2/span.hpp"
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ip2 {
+
+namespace aux {
+    struct session_settings;
+}
+
+namespace assemble {
+
+// The segment cache keeps the blob segments this node put or got, by
+// hash. A blob fanned out to many local users, or a segment shared by
+// several blobs, is then not got from the network again.
+//
+// The segments used most recently are kept in memory, up to
+// assemble_segment_cache_size bytes. The ones dropped from memory are
+// written to a file each in the cache directory, up to
+// assemble_segment_cache_disk_size bytes, and the least recently used
+// files are deleted first. A segment is addressed by the hash of its
+// content, so it's never stale, but getters still check it against its
+// hash like one got from the network.
+class TORRENT_EXTRA_EXPORT segment_cache
+{
+public:
+
+	segment_cache(aux::session_settings const& settings
+		, assemble_logger& logger);
+
+	segment_cache(segment_cache const&) = delete;
+	segment_cache& operator=(segment_cache const&) = delete;
+
+	// keep the segments dropped from memory in ``dir``. The segments
+	// already in it, from an earlier run, are used
+	void open(std::string dir);
+
+	void put(sha1_hash const& h, span<char const> seg);
+
+	// the segment with hash ``h``, or an empty span if it's not cached.
+	// The span is valid until the cache is modified
+	span<char const> get(sha1_hash const& h);
+
+	// drops a segment, for instance one that doesn't match its hash
+	void remove(sha1_hash const& h);
+
+	std::int64_t memory_size() const { return m_memory_size; }
+	std::int64_t disk_size() const { return m_disk_size; }
+
+private:
+
+	// moves the least recently used segments from memory to disk
+	void trim_memory();
+
+	// deletes the least recently used files
+	void trim_disk();
+
+	bool write_file(sha1_hash const& h, span<char const> seg);
+	bool read_file(sha1_hash const& h, int size, std::vector<char>& seg) const;
+	void remove_file(sha1_hash const& h) const;
+
+	std::string file_path(sha1_hash const& h) const;
+
+	aux::session_settings const& m_settings;
+	assemble_logger& m_logger;
+
+	// most recently used first
+	using lru_list = std::list<sha1_hash>;
+
+	struct memory_entry
+	{
+		std::vector<char> data;
+		lru_list::iterator lru;
+	};
+
+	std::map<sha1_hash, memory_entry> m_memory;
+	lru_list m_memory_lru;
+	std::int64_t m_memory_size = 0;
+
+	// the segments with a file in m_dir. A segment may be both in memory
+	// and on disk
+	struct disk_entry
+	{
+		int size;
+		lru_list::iterator lru;
+	};
+
+	std::map<sha1_hash, disk_entry> m_disk;
+	lru_list m_disk_lru;
+	std::int64_t m_disk_size = 0;
+
+	// empty until open() is called, the cache is only in memory until then
+	std::string m_dir;
+};
+
+} // namespace assemble
+} // namespace ip2
+
+#endif // IP2_ASSEMBLE_SEGMENT_CACHE_HPP
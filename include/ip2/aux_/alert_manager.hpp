@@ -18,6 +18,7 @@ see LICENSE file.
 #include "ip2/aux_/stack_allocator.hpp"
 #include "ip2/alert_types.hpp" // for abi_alert_count
 #include "ip2/aux_/array.hpp"
+#include "ip2/aux_/debug.hpp" // for single_threaded
 
 #include <functional>
 #include <utility> // for std::forward
@@ -29,6 +30,26 @@ see LICENSE file.
 namespace ip2 {
 namespace aux {
 
+	// The alerts are double buffered. The network thread posts to one
+	// generation of the buffers while the client holds the alerts of the
+	// other one, and get_all() swaps them.
+	//
+	// There is a single producer, the network thread. Posting an alert
+	// doesn't take a lock: the producer registers itself with the generation
+	// it writes to, and get_all() flips the generation and waits for the
+	// producer to leave the old one before it hands it to the client. The
+	// mutex is only taken by the client side, and by the producer when it
+	// posts to an empty queue and has to wake the client up.
+	//
+	// Nothing keeps two producers from writing the same queue at once, so
+	// alerts must not be posted from any other thread. Calls made on the
+	// client thread post their alerts through the network thread instead
+	// (see session_handle::async_call()). Debug builds assert it.
+	//
+	// Log alerts can be given a queue of their own, with its own size limit
+	// (see set_log_queue_size_limit()), so that a flood of them neither
+	// fills the queue the other alerts are limited by, nor delays them:
+	// get_all() returns the other alerts first.
 	struct TORRENT_EXTRA_EXPORT alert_manager
 	{
 		explicit alert_manager(int queue_limit
@@ -40,32 +61,20 @@ namespace aux {
 		~alert_manager();
 
 		template <class T, typename... Args>
-		void emplace_alert(Args&&... args) try
+		void emplace_alert(Args&&... args)
 		{
-			std::unique_lock<std::recursive_mutex> lock(m_mutex);
+			TORRENT_ASSERT(m_producer.is_single_thread());
 
-			heterogeneous_queue<alert>& queue = m_alerts[m_generation];
-
-			// don't add more than this number of alerts, unless it's a
-			// high priority alert, in which case we try harder to deliver it
-			// for high priority alerts, double the upper limit
-			if (queue.size() / (1 + static_cast<int>(T::priority)) >= m_queue_size_limit)
+			bool edge;
 			{
-				// record that we dropped an alert of this type
-				m_dropped.set(T::alert_type);
-				return;
+				producer_section const s(*this);
+				edge = post<T>(s.generation, std::forward<Args>(args)...);
 			}
 
-			T& alert = queue.emplace_back<T>(
-				m_allocations[m_generation], std::forward<Args>(args)...);
-
-			maybe_notify(&alert);
-		}
-		catch (std::bad_alloc const&)
-		{
-			// record that we dropped an alert of this type
-			std::unique_lock<std::recursive_mutex> lock(m_mutex);
-			m_dropped.set(T::alert_type);
+			// waking the client up takes the mutex, the producer must have
+			// left the generation by then, or get_all() could wait for it
+			// while holding the mutex
+			if (edge) maybe_notify();
 		}
 
 		bool pending() const;
@@ -89,28 +98,109 @@ namespace aux {
 			return m_alert_mask;
 		}
 
-		int alert_queue_size_limit() const noexcept { return m_queue_size_limit; }
+		int alert_queue_size_limit() const noexcept
+		{ return m_lane_limit[main_lane].load(std::memory_order_relaxed); }
 		int set_alert_queue_size_limit(int queue_size_limit_);
 
+		// the max number of log alerts queued up. 0 queues them with the
+		// other alerts, bound by alert_queue_size_limit()
+		int log_queue_size_limit() const noexcept
+		{ return m_lane_limit[log_lane].load(std::memory_order_relaxed); }
+		int set_log_queue_size_limit(int queue_size_limit_);
+
 		void set_notify_function(std::function<void()> const& fun);
 
+		// the alerts are posted from the calling thread from now on. The
+		// session calls it on the network thread when it starts
+		void thread_started() { m_producer.thread_started(); }
+
 	private:
 
-		void maybe_notify(alert* a);
+		enum lane_t { main_lane, log_lane, num_lanes };
+
+		// the categories of the alerts a log queue takes
+		static constexpr alert_category_t log_categories
+			= alert_category::session_log
+			| alert_category::port_mapping_log
+			| alert_category::dht_log
+			| alert_category::communication_log
+			| alert_category::blockchain_log
+			| alert_category::transport_log
+			| alert_category::assemble_log;
+
+		template <class T>
+		static constexpr bool is_log_alert()
+		{
+			return T::static_category != alert_category_t{}
+				&& (T::static_category & ~log_categories) == alert_category_t{};
+		}
 
-		// this mutex protects everything. Since it's held while executing user
-		// callbacks (the notify function and extension on_alert()) it must be
-		// recursive to support recursively post new alerts.
+		// registers the producer with the current generation for its
+		// lifetime. The buffers of that generation are the producer's until
+		// it's destructed
+		struct producer_section
+		{
+			explicit producer_section(alert_manager& m);
+			~producer_section();
+			producer_section(producer_section const&) = delete;
+			producer_section& operator=(producer_section const&) = delete;
+
+			alert_manager& mgr;
+			int generation;
+		};
+
+		// posts the alert to ``gen``, or records that it was dropped.
+		// Returns true if the queue was empty
+		template <class T, typename... Args>
+		bool post(int const gen, Args&&... args) try
+		{
+			int const lane = is_log_alert<T>()
+				&& m_lane_limit[log_lane].load(std::memory_order_relaxed) > 0
+				? log_lane : main_lane;
+			heterogeneous_queue<alert>& queue = m_alerts[lane][gen];
+
+			// don't add more than this number of alerts, unless it's a
+			// high priority alert, in which case we try harder to deliver it
+			// for high priority alerts, double the upper limit
+			if (queue.size() / (1 + static_cast<int>(T::priority))
+				>= m_lane_limit[lane].load(std::memory_order_relaxed))
+			{
+				// record that we dropped an alert of this type
+				m_dropped[gen].set(T::alert_type);
+				return false;
+			}
+
+			T& alert = queue.template emplace_back<T>(
+				m_allocations[lane][gen], std::forward<Args>(args)...);
+
+			if (m_queued[gen].fetch_add(1, std::memory_order_release) != 0)
+				return false;
+
+			m_first[gen].store(&alert, std::memory_order_release);
+			return true;
+		}
+		catch (std::bad_alloc const&)
+		{
+			// record that we dropped an alert of this type
+			m_dropped[gen].set(T::alert_type);
+			return false;
+		}
+
+		void maybe_notify();
+
+		// the thread the alerts are posted from
+		single_threaded m_producer;
+
+		// this mutex serializes the client side, get_all() and the like, and
+		// the producer waking the client up. Since it's held while executing
+		// the user's notify function it must be recursive to support calling
+		// back in from it.
 		mutable std::recursive_mutex m_mutex;
 		std::condition_variable_any m_condition;
 		std::atomic<alert_category_t> m_alert_mask;
-		int m_queue_size_limit;
 
-		// a bitfield where each bit represents an alert type. Every time we drop
-		// an alert (because the queue is full or of some other error) we set the
-		// corresponding bit in this mask, to communicate to the client that it
-		// may have missed an update.
-		std::bitset<abi_alert_count> m_dropped;
+		// the size limits of the queues of each lane
+		aux::array<std::atomic<int>, num_lanes> m_lane_limit;
 
 		// this function (if set) is called whenever the number of alerts in
 		// the alert queue goes from 0 to 1. The client is expected to wake up
@@ -121,22 +211,38 @@ namespace aux {
 		std::function<void()> m_notify;
 
 		// this is either 0 or 1, it indicates which m_alerts and m_allocations
-		// the alert_manager is allowed to use right now. This is swapped when
+		// the producer is allowed to use right now. This is flipped when
 		// the client calls get_all(), at which point all of the alert objects
 		// passed to the client will be owned by ip2 again, and reset.
-		int m_generation = 0;
+		std::atomic<int> m_generation{0};
+
+		// the number of producers in each generation, 0 or 1. get_all()
+		// waits for it to drop to 0 after flipping the generation
+		aux::array<std::atomic<int>, 2> m_writers;
+
+		// the number of alerts posted to each generation, and the first one
+		aux::array<std::atomic<int>, 2> m_queued;
+		aux::array<std::atomic<alert*>, 2> m_first;
+
+		// a bitfield per generation where each bit represents an alert type.
+		// Every time we drop an alert (because the queue is full or of some
+		// other error) we set the corresponding bit in this mask, to
+		// communicate to the client that it may have missed an update.
+		aux::array<std::bitset<abi_alert_count>, 2> m_dropped;
 
-		// this is where all alerts are queued up. There are two heterogeneous
-		// queues to double buffer the thread access. The std::mutex in the alert
-		// manager gives exclusive access to m_alerts[m_generation] and
-		// m_allocations[m_generation] whereas the other copy is exclusively
-		// used by the client thread.
-		aux::array<heterogeneous_queue<alert>, 2> m_alerts;
+		// this is where all alerts are queued up, per lane and generation.
+		// m_alerts[lane][m_generation] and m_allocations[lane][m_generation]
+		// belong to the producer whereas the other copy is exclusively used
+		// by the client thread.
+		aux::array<aux::array<heterogeneous_queue<alert>, 2>, num_lanes> m_alerts;
 
 		// this is a stack where alerts can allocate variable length content,
 		// such as strings, to go with the alerts.
-		aux::array<aux::stack_allocator, 2> m_allocations;
+		aux::array<aux::array<aux::stack_allocator, 2>, num_lanes> m_allocations;
 
+		// the pointers to the log alerts, before they're appended to the
+		// ones get_all() returns. Only used by the client
+		std::vector<alert*> m_log_pointers;
 	};
 }
 }
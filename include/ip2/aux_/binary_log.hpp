@@ -0,0 +1,148 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#ifndef IP2_BINARY_LOG_HPP_INCLUDED
+#define IP2_BINARY_LOG_HPP_INCLUDED
+
+#include "ip2/config.hpp"
+#include "ip2/span.hpp"
+#include "ip2/string_view.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace ip2::aux {
+
+	// A binary log record is the list of arguments of a printf style log
+	// call, each stored as a one byte type tag followed by its raw value.
+	// Together with the format string (which must be a string literal, it's
+	// referred to, not copied) it's everything needed to format the message
+	// later, by the consumer of the log, rather than by the thread that
+	// logs it.
+	//
+	// Integers, doubles and pointers are stored as 8 bytes, strings as a 4
+	// bytes length followed by the characters. Length modifiers in the
+	// format string are ignored, the type of each argument is the recorded
+	// one.
+
+	// an argument formatted as the hex encoding of ``bytes`` by a %s
+	// conversion. Only the raw bytes are recorded, so logging a key or a
+	// hash doesn't cost an encoding unless the message is read.
+	struct hex_arg
+	{
+		explicit hex_arg(span<char const> b) : bytes(b) {}
+		template <typename Container>
+		explicit hex_arg(Container const& c)
+			: bytes(reinterpret_cast<char const*>(c.data()), std::ptrdiff_t(c.size()))
+		{}
+
+		span<char const> bytes;
+	};
+
+namespace log_detail {
+
+	enum arg_tag : char
+	{
+		signed_tag = 'i',
+		unsigned_tag = 'u',
+		double_tag = 'd',
+		pointer_tag = 'p',
+		string_tag = 's',
+		hex_tag = 'x',
+	};
+
+	inline void write_raw(std::vector<char>& buf, void const* p, std::size_t n)
+	{
+		auto const* c = static_cast<char const*>(p);
+		buf.insert(buf.end(), c, c + n);
+	}
+
+	inline void write_bytes(std::vector<char>& buf, arg_tag tag
+		, char const* p, std::size_t n)
+	{
+		buf.push_back(tag);
+		std::uint32_t const len = std::uint32_t(n);
+		write_raw(buf, &len, sizeof(len));
+		write_raw(buf, p, n);
+	}
+
+	template <typename T>
+	typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type
+	write_arg(std::vector<char>& buf, T const v)
+	{
+		if (std::is_signed<T>::value)
+		{
+			buf.push_back(signed_tag);
+			std::int64_t const i = std::int64_t(v);
+			write_raw(buf, &i, sizeof(i));
+		}
+		else
+		{
+			buf.push_back(unsigned_tag);
+			std::uint64_t const u = std::uint64_t(v);
+			write_raw(buf, &u, sizeof(u));
+		}
+	}
+
+	inline void write_arg(std::vector<char>& buf, double const v)
+	{
+		buf.push_back(double_tag);
+		write_raw(buf, &v, sizeof(v));
+	}
+
+	inline void write_arg(std::vector<char>& buf, void const* v)
+	{
+		buf.push_back(pointer_tag);
+		std::uint64_t const p = std::uint64_t(reinterpret_cast<std::uintptr_t>(v));
+		write_raw(buf, &p, sizeof(p));
+	}
+
+	inline void write_arg(std::vector<char>& buf, char const* s)
+	{
+		if (s == nullptr) s = "(null)";
+		write_bytes(buf, string_tag, s, std::strlen(s));
+	}
+
+	inline void write_arg(std::vector<char>& buf, string_view s)
+	{
+		write_bytes(buf, string_tag, s.data(), s.size());
+	}
+
+	inline void write_arg(std::vector<char>& buf, std::string const& s)
+	{
+		write_bytes(buf, string_tag, s.data(), s.size());
+	}
+
+	inline void write_arg(std::vector<char>& buf, hex_arg const& h)
+	{
+		write_bytes(buf, hex_tag, h.bytes.data(), std::size_t(h.bytes.size()));
+	}
+}
+
+	// the per-thread scratch buffer log records are encoded into, before
+	// they're copied to their final destination. It's cleared by every call.
+	TORRENT_EXTRA_EXPORT std::vector<char>& log_record_buffer();
+
+	template <typename... Args>
+	span<char const> write_log_record(Args const&... args)
+	{
+		std::vector<char>& buf = log_record_buffer();
+		(log_detail::write_arg(buf, args), ...);
+		return buf;
+	}
+
+	// format a record written by write_log_record() according to ``fmt``
+	TORRENT_EXTRA_EXPORT std::string format_log_record(char const* fmt
+		, span<char const> record);
+}
+
+#endif // IP2_BINARY_LOG_HPP_INCLUDED
@@ -0,0 +1,50 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#ifndef IP2_LATENCY_HISTOGRAM_HPP_INCLUDED
+#define IP2_LATENCY_HISTOGRAM_HPP_INCLUDED
+
+#include "ip2/config.hpp"
+#include "ip2/performance_counters.hpp"
+#include "ip2/time.hpp"
+
+#include <cstdint>
+
+namespace ip2::aux {
+
+	// A latency histogram is a run of latency_buckets consecutive stats
+	// counters, starting at the counter named <histogram>0. The buckets are
+	// logarithmic: counter n counts the samples in the range
+	// [2^(n-1), 2^n) milliseconds. Bucket 0 counts samples below 1 ms and the
+	// last bucket counts everything above its lower bound.
+	//
+	// Recording a sample is a single relaxed atomic increment of a counter,
+	// so it's safe to do from any thread and never blocks.
+	constexpr int latency_buckets = 16;
+
+	inline int latency_bucket(time_duration const d)
+	{
+		std::int64_t ms = total_milliseconds(d);
+		int bucket = 0;
+		while (ms > 0 && bucket < latency_buckets - 1)
+		{
+			ms >>= 1;
+			++bucket;
+		}
+		return bucket;
+	}
+
+	inline void record_latency(counters& cnt, int const histogram
+		, time_duration const d)
+	{
+		cnt.inc_stats_counter(histogram + latency_bucket(d));
+	}
+}
+
+#endif // IP2_LATENCY_HISTOGRAM_HPP_INCLUDED
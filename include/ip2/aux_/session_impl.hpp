@@ -64,9 +64,12 @@ see LICENSE file.
 #include "ip2/kademlia/dht_state.hpp"
 #include "ip2/kademlia/announce_flags.hpp"
 #include "ip2/kademlia/items_db_sqlite.hpp"
+#include "ip2/kademlia/relay_mailbox.hpp"
 #include "ip2/kademlia/bs_nodes_storage.hpp"
 #include "ip2/kademlia/types.hpp"
 #include "ip2/kademlia/node_entry.hpp"
+#include "ip2/kademlia/packet_decoder.hpp"
+#include "ip2/aux_/submission_queue.hpp"
 
 #include "ip2/communication/message.hpp"
 #include "ip2/communication/communication.hpp"
@@ -573,6 +576,9 @@ namespace aux {
 
 			alert_manager& alerts() override { return m_alerts; }
 
+			// thread safe, may be called from any thread
+			submission_queue& submissions() { return m_submissions; }
+
 			void abort() noexcept;
 			void abort_stage2() noexcept;
 
@@ -584,6 +590,9 @@ namespace aux {
 
 			udp::endpoint external_udp_endpoint() const override;
 
+			udp::endpoint direct_endpoint() const override;
+			std::unique_ptr<utp_stream> open_direct_stream(udp::endpoint const& ep) override;
+
 			void start_ip_notifier();
 			void start_natpmp();
 			void start_upnp();
@@ -659,6 +668,7 @@ namespace aux {
 			void update_user_agent();
 			void update_connection_speed();
 			void update_alert_queue_size();
+			void update_submission_queue_size();
 			void update_disk_threads();
 			void update_outgoing_interfaces();
 			void update_listen_interfaces();
@@ -771,6 +781,15 @@ namespace aux {
 		ip2::api::error_code relay_message(std::array<char, 32> const& receiver
 			, std::vector<char> const& message);
 
+		// submit everything queued by the non-blocking calls since the last
+		// batch to the assemble module
+		void drain_submissions();
+
+		// report the result of a submission through the alert of its call.
+		// Called on the network thread, a submission rejected by a full
+		// queue is posted here to be reported
+		void post_submission_alert(submission const& s, ip2::api::error_code ec);
+
 		private:
 
 			// return the settings value for int setting "n", if the value is
@@ -794,6 +813,23 @@ namespace aux {
 			// handles delayed alerts
 			mutable alert_manager m_alerts;
 
+			// requests submitted by the non-blocking put, get and relay
+			// calls, waiting for the network thread
+			submission_queue m_submissions;
+
+			// the batch currently being drained from m_submissions. It's a
+			// member to reuse its storage between batches
+			std::vector<submission> m_submission_batch;
+
+			// the uTP streams of the assembler's direct channel. They share
+			// the DHT sockets, their packets are told apart by
+			// utp_packet_magic
+			utp_socket_manager m_utp_socket_manager;
+
+			// the packet being sent by m_utp_socket_manager, with the magic
+			// prepended
+			std::vector<char> m_utp_send_buffer;
+
 			// the peer class that all peers belong to by default
 			peer_class_t m_global_class{0};
 
@@ -954,9 +990,14 @@ namespace aux {
 
 			std::unique_ptr<dht::dht_storage_interface> m_dht_storage;
 			std::shared_ptr<dht::items_db_sqlite> m_items_db;
+			std::shared_ptr<dht::relay_mailbox> m_relay_mailbox;
 			std::unique_ptr<dht::bs_nodes_storage_interface> m_bs_nodes_storage;
 			std::string m_bs_nodes_dir;
 			std::shared_ptr<dht::dht_tracker> m_dht;
+
+			// decodes incoming DHT packets on worker threads, when
+			// dht_packet_threads is set
+			std::unique_ptr<dht::packet_decoder> m_packet_decoder;
 			dht::dht_storage_constructor_type m_dht_storage_constructor
 				= dht::dht_default_storage_constructor;
 
@@ -1055,6 +1096,17 @@ namespace aux {
 				, std::weak_ptr<listen_socket_t> ls
 				, transport ssl, error_code const& ec);
 
+			void on_decoded_dht_packet(std::weak_ptr<listen_socket_t> const& ls
+				, std::unique_ptr<dht::decoded_packet> p);
+
+			void send_utp_packet(std::weak_ptr<utp_socket_interface> sock
+				, udp::endpoint const& ep
+				, span<char const> p
+				, error_code& ec
+				, udp_send_flags_t flags);
+
+			void on_incoming_utp(socket_type s);
+
 			// the number of torrent connection boosts
 			// connections that have been made this second
 			// this is deducted from the connect speed
@@ -200,6 +200,15 @@ namespace ip2::aux {
 		virtual bool has_dht() const = 0;
 		virtual int external_udp_port(address const& local_address) const = 0;
 		virtual udp::endpoint external_udp_endpoint() const = 0;
+
+		// the endpoint other peers can open a direct uTP stream to, or a
+		// default constructed endpoint if direct transfers are disabled or
+		// the external address isn't known
+		virtual udp::endpoint direct_endpoint() const = 0;
+
+		// opens a uTP stream to ``ep`` over one of the DHT sockets. Returns
+		// nullptr if there is no socket for the address family of ``ep``
+		virtual std::unique_ptr<utp_stream> open_direct_stream(udp::endpoint const& ep) = 0;
 		virtual dht::dht_tracker* dht() = 0;
 		virtual int dht_nodes() = 0;
 
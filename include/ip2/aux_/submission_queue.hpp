@@ -0,0 +1,86 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#ifndef IP2_SUBMISSION_QUEUE_HPP_INCLUDED
+#define IP2_SUBMISSION_QUEUE_HPP_INCLUDED
+
+#include "ip2/config.hpp"
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace ip2::aux {
+
+	// a put, get or relay request submitted by one of the non-blocking
+	// session_handle calls. The payload is moved in by the caller, it's
+	// never copied on its way to the assemble module
+	struct submission
+	{
+		enum type_t : std::uint8_t
+		{
+			put_data,
+			get_data,
+			relay_data_uri,
+			relay_message,
+		};
+
+		type_t type = put_data;
+
+		// the receiver of a relay or the sender of the data to get
+		std::array<char, 32> peer{};
+		std::array<char, 20> uri{};
+		std::int64_t timestamp = 0;
+
+		// the blob to put or the message to relay
+		std::vector<char> payload;
+	};
+
+	// A bounded multi-producer, single-consumer queue of submissions. Any
+	// thread may push, the network thread takes everything queued so far in
+	// one batch, by swapping buffers with the queue, so the lock is only held
+	// for a push_back or a swap. Like the alert queue, it's double buffered,
+	// the consumer hands its drained buffer back to be reused.
+	struct TORRENT_EXTRA_EXPORT submission_queue
+	{
+		explicit submission_queue(int capacity);
+
+		enum class push_result
+		{
+			// the submission was queued and a batch is already pending
+			queued,
+
+			// the submission was queued into an empty queue. The caller is
+			// expected to schedule a drain
+			queued_first,
+
+			// the queue is full. The submission was not queued, nor moved
+			// from
+			full,
+		};
+
+		push_result push(submission&& s);
+
+		// swap everything queued so far into ``batch``. ``batch`` is
+		// expected to be empty, its capacity is kept for the next batch
+		void pop_all(std::vector<submission>& batch);
+
+		void set_capacity(int capacity);
+		int size() const;
+
+	private:
+
+		mutable std::mutex m_mutex;
+		std::vector<submission> m_queue;
+		int m_capacity;
+	};
+}
+
+#endif // IP2_SUBMISSION_QUEUE_HPP_INCLUDED
@@ -0,0 +1,235 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#ifndef IP2_TIMER_WHEEL_HPP_INCLUDED
+#define IP2_TIMER_WHEEL_HPP_INCLUDED
+
+#include "ip2/config.hpp"
+#include "ip2/assert.hpp"
+#include "ip2/time.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <list>
+#include <vector>
+
+namespace ip2::aux {
+
+	// A hierarchical timer wheel. Time is cut in ticks of ``resolution``.
+	// Level 0 has a slot per tick for the next 64 ticks, level 1 a slot per
+	// 64 ticks for the next 4096 and level 2 a slot per 4096 ticks. When the
+	// wheel turns past the start of a slot of an upper level, the timers in
+	// it are moved down to the level below. Timers further out than level 2
+	// reaches are kept in its furthest slot and placed again when it's
+	// reached.
+	//
+	// Adding and removing a timer is O(1), and advancing the wheel costs the
+	// number of ticks passed plus the number of timers expiring or moving
+	// down, not the number of timers pending. A timer never expires before
+	// its deadline, but may expire up to ``resolution`` after it.
+	template <typename T>
+	struct timer_wheel
+	{
+	private:
+
+		struct timer
+		{
+			T value;
+			std::int64_t tick;
+			int level;
+			int slot;
+		};
+
+		static constexpr int slot_bits = 6;
+		static constexpr int num_slots = 1 << slot_bits;
+		static constexpr int num_levels = 3;
+
+		using slot_list = std::list<timer>;
+
+	public:
+
+		using handle = typename slot_list::iterator;
+
+		timer_wheel(time_duration const resolution, time_point const now)
+			: m_resolution(resolution)
+			, m_start(now)
+		{
+			TORRENT_ASSERT(resolution > time_duration::zero());
+		}
+
+		timer_wheel(timer_wheel const&) = delete;
+		timer_wheel& operator=(timer_wheel const&) = delete;
+
+		// the handle stays valid until the timer expires or is removed
+		handle add(time_point const deadline, T value)
+		{
+			// a deadline that has passed expires at the next advance()
+			std::int64_t const tick = std::max(deadline_tick(deadline), m_tick + 1);
+			m_spare.push_back(timer{std::move(value), tick, -1, 0});
+			handle const h = std::prev(m_spare.end());
+			place(h);
+			++m_size;
+			return h;
+		}
+
+		void remove(handle const h)
+		{
+			TORRENT_ASSERT(m_size > 0);
+			m_levels[std::size_t(h->level)][std::size_t(h->slot)].erase(h);
+			--m_size;
+		}
+
+		// turns the wheel to ``now`` and appends the values of the timers
+		// that expired to ``expired``, earliest first
+		void advance(time_point const now, std::vector<T>& expired)
+		{
+			std::int64_t const target = current_tick(now);
+			if (m_size == 0)
+			{
+				m_tick = std::max(m_tick, target);
+				return;
+			}
+
+			while (m_tick < target)
+			{
+				++m_tick;
+
+				// move the timers down from the upper levels whose slot
+				// starts at this tick, the outermost first
+				for (int level = num_levels - 1; level > 0; --level)
+				{
+					if ((m_tick & ((std::int64_t(1) << (slot_bits * level)) - 1)) != 0)
+						continue;
+					cascade(level, slot_of(m_tick, level));
+				}
+
+				auto& l = m_levels[0][std::size_t(slot_of(m_tick, 0))];
+				for (auto& t : l) expired.push_back(std::move(t.value));
+				m_size -= int(l.size());
+				l.clear();
+
+				if (m_size == 0)
+				{
+					m_tick = target;
+					break;
+				}
+			}
+		}
+
+		// a point in time no later than the next timer expires, but maybe
+		// earlier. max() if there are no timers
+		time_point next_expiry() const
+		{
+			if (m_size == 0) return time_point::max();
+
+			// the first level 0 slot with a timer in it this turn, or the
+			// start of the next turn, when the upper levels move down
+			std::int64_t const turn_end = (m_tick | (num_slots - 1)) + 1;
+			for (std::int64_t t = m_tick + 1; t < turn_end; ++t)
+			{
+				if (!m_levels[0][std::size_t(slot_of(t, 0))].empty())
+					return to_time(t);
+			}
+			return to_time(turn_end);
+		}
+
+		int size() const { return m_size; }
+		bool empty() const { return m_size == 0; }
+
+		T const& value(handle const h) const { return h->value; }
+
+	private:
+
+		// the last tick started by ``t``
+		std::int64_t current_tick(time_point const t) const
+		{
+			if (t <= m_start) return 0;
+			return (t - m_start) / m_resolution;
+		}
+
+		// the first tick starting at or after ``t``, a timer in it
+		// doesn't expire early
+		std::int64_t deadline_tick(time_point const t) const
+		{
+			if (t <= m_start) return 0;
+			return (t - m_start + m_resolution - time_duration(1)) / m_resolution;
+		}
+
+		// the start of ``tick``, when the timers in it expire
+		time_point to_time(std::int64_t const tick) const
+		{
+			return m_start + m_resolution * tick;
+		}
+
+		static int slot_of(std::int64_t const tick, int const level)
+		{
+			return int((tick >> (slot_bits * level)) & (num_slots - 1));
+		}
+
+		// moves the timer ``h`` to the slot of its tick, from whatever list
+		// it's in
+		void place(handle const h)
+		{
+			std::int64_t const max_delta
+				= (std::int64_t(1) << (slot_bits * num_levels)) - 1;
+			std::int64_t const delta = std::min(h->tick - m_tick, max_delta);
+			std::int64_t const tick = m_tick + delta;
+
+			int level = 0;
+			while (level < num_levels - 1
+				&& delta >= (std::int64_t(1) << (slot_bits * (level + 1))))
+			{
+				++level;
+			}
+
+			int const slot = slot_of(tick, level);
+			auto& from = h->level < 0 ? m_spare
+				: m_levels[std::size_t(h->level)][std::size_t(h->slot)];
+			auto& to = m_levels[std::size_t(level)][std::size_t(slot)];
+			to.splice(to.end(), from, h);
+			h->level = level;
+			h->slot = slot;
+		}
+
+		void cascade(int const level, int const slot)
+		{
+			auto& from = m_levels[std::size_t(level)][std::size_t(slot)];
+			if (from.empty()) return;
+
+			// the timers are moved out first, one beyond the reach of the
+			// wheel is placed at this level again
+			m_spare.splice(m_spare.end(), from);
+			for (handle h = m_spare.begin(); h != m_spare.end();)
+			{
+				handle const next = std::next(h);
+				h->level = -1;
+				place(h);
+				h = next;
+			}
+		}
+
+		time_duration m_resolution;
+		time_point m_start;
+
+		// the last tick the wheel was turned to. Every timer is in a later
+		// tick
+		std::int64_t m_tick = 0;
+
+		std::array<std::array<slot_list, num_slots>, num_levels> m_levels;
+
+		// where timers are built before they're placed, always empty
+		// between calls
+		slot_list m_spare;
+
+		int m_size = 0;
+	};
+}
+
+#endif
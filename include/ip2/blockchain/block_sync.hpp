@@ -0,0 +1,125 @@
+/*
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#ifndef IP2_BLOCK_SYNC_HPP
+#define IP2_BLOCK_SYNC_HPP
+
+#include <deque>
+#include <functional>
+#include <limits>
+#include <set>
+#include <vector>
+
+#include "ip2/config.hpp"
+#include "ip2/entry.hpp"
+#include "ip2/sha1_hash.hpp"
+#include "ip2/kademlia/types.hpp"
+#include "ip2/blockchain/constants.hpp"
+
+namespace ip2 {
+namespace blockchain {
+
+    // every block whose number is a multiple of this is a checkpoint. The
+    // ancestors list of a block has the hashes of the blocks before it,
+    // back to the checkpoint before it
+    constexpr int blockchain_checkpoint_interval = 25;
+
+    // the max number of block gets a chain sync has in flight
+    constexpr int blockchain_max_sync_in_flight = 16;
+
+    // the max number of blocks a chain sync fetches. A rebranch doesn't
+    // reach beyond an epoch
+    constexpr int blockchain_max_sync_blocks = 2 * CHAIN_EPOCH_BLOCK_SIZE;
+
+    // block_sync is the download pipeline of a chain catching up on a branch.
+    //
+    // Without it, the previous block of a missing block is only known once
+    // that block has arrived, and catching up N blocks costs N round trips.
+    // Along with its blocks, a node publishes the ancestors list of its head
+    // and of the checkpoints (see blockchain_checkpoint_interval). Getting
+    // the ancestors list of the first missing block gives the hashes of the
+    // blocks back to the checkpoint before it, which are all fetched at
+    // once, up to blockchain_max_sync_in_flight of them, while the ancestors
+    // list of that checkpoint is fetched, and so on until a block we have is
+    // reached. A node that didn't publish a list is synced from the way it
+    // was before, a block at a time.
+    //
+    // block_sync only keeps track of what to fetch next, the blockchain
+    // issues the requests it pops and verifies the blocks in order, once
+    // they're all there.
+    class TORRENT_EXTRA_EXPORT block_sync {
+    public:
+        struct request {
+            enum kind_t { block, ancestors };
+
+            kind_t kind;
+            sha1_hash hash;
+        };
+
+        explicit block_sync(int max_in_flight = blockchain_max_sync_in_flight
+                , int max_blocks = std::numeric_limits<int>::max());
+
+        // ``child`` is a block on the branch, and ``hash`` the previous block
+        // of it, which is missing. Starts a sync from ``peer`` unless one is
+        // going on
+        void missing(dht::public_key const& peer, sha1_hash const& child, sha1_hash const& hash);
+
+        // the ancestors list of ``key`` arrived, nearest first. ``have``
+        // tells the blocks there's no need to fetch
+        void ancestors_received(sha1_hash const& key, std::vector<sha1_hash> const& hashes
+                , std::function<bool(sha1_hash const&)> const& have);
+
+        void ancestors_failed(sha1_hash const& key);
+
+        // the block ``hash`` arrived, or failed to
+        void block_done(sha1_hash const& hash);
+
+        // the requests to issue now. The block gets are bound by the window
+        std::vector<request> pop_requests();
+
+        // true if nothing is queued or in flight. The sync is over
+        bool idle() const;
+
+        // the peer the blocks are fetched from
+        dht::public_key const& peer() const { return m_peer; }
+
+        int in_flight() const { return int(m_blocks_in_flight.size()); }
+
+        // an ancestors list, the hashes of the blocks before a block, nearest
+        // first. Parsing returns false if ``e`` isn't one
+        static entry ancestors_entry(std::vector<sha1_hash> const& hashes);
+        static bool parse_ancestors(entry const& e, std::vector<sha1_hash>& hashes);
+
+    private:
+        // called when something is done. Forgets the sync once it's over
+        void maybe_reset();
+
+        void queue_list(sha1_hash const& key);
+
+        int m_max_in_flight;
+        int m_max_blocks;
+
+        dht::public_key m_peer;
+
+        // the blocks to fetch, in the order to fetch them
+        std::deque<sha1_hash> m_blocks;
+        std::set<sha1_hash> m_blocks_in_flight;
+
+        // the ancestors lists to fetch and in flight
+        std::vector<sha1_hash> m_lists;
+        std::set<sha1_hash> m_lists_in_flight;
+
+        // everything queued in this sync, so nothing is fetched twice
+        std::set<sha1_hash> m_seen_blocks;
+        std::set<sha1_hash> m_seen_lists;
+    };
+
+}
+}
+
+#endif //IP2_BLOCK_SYNC_HPP
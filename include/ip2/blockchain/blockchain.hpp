@@ -18,12 +18,17 @@ see LICENSE file.
 #include <ostream>
 
 #include "ip2/time.hpp"
+#include "ip2/api/error_code.hpp"
+#include "ip2/assemble/blob_buffer.hpp"
 #include "ip2/aux_/alert_manager.hpp" // for alert_manager
 #include "ip2/aux_/common.h"
 #include "ip2/aux_/deadline_timer.hpp"
 #include "ip2/aux_/session_interface.hpp"
 #include "ip2/kademlia/item.hpp"
 #include "ip2/kademlia/node_entry.hpp"
+#include "ip2/blockchain/block_sync.hpp"
+#include "ip2/blockchain/chain_scheduler.hpp"
+#include "ip2/blockchain/chain_workers.hpp"
 #include "ip2/blockchain/constants.hpp"
 #include "ip2/blockchain/pool_hash_set.hpp"
 #include "ip2/blockchain/state_hash_array.hpp"
@@ -31,6 +36,7 @@ see LICENSE file.
 #include "ip2/blockchain/repository.hpp"
 #include "ip2/blockchain/repository_impl.hpp"
 #include "ip2/blockchain/state_array.hpp"
+#include "ip2/blockchain/state_snapshot.hpp"
 #include "ip2/blockchain/tx_pool.hpp"
 #include "ip2/blockchain/transaction_wrapper.hpp"
 #include "ip2/common/entry_type.hpp"
@@ -79,6 +85,8 @@ namespace blockchain {
     const std::string key_suffix_head_block_hash = "head_block_hash";
     // state root key suffix
     const std::string key_suffix_state_root = "state_root";
+    // block ancestors key suffix
+    const std::string key_suffix_block_ancestors = "ancestors";
 
     enum GET_ITEM_TYPE {
         HEAD_BLOCK_HASH,
@@ -91,6 +99,7 @@ namespace blockchain {
         TRANSFER_TX,
         STATE_HASH_ARRAY,
         STATE_ARRAY,
+        BLOCK_ANCESTORS,
         UNKNOWN_GET_ITEM_TYPE,
     };
 
@@ -311,7 +320,8 @@ namespace blockchain {
             public std::enable_shared_from_this<blockchain>, blockchain_logger  {
     public:
         blockchain(io_context& mIoc, aux::session_interface &mSes, counters &mCounters) :
-        m_ioc(mIoc), m_ses(mSes), m_counters(mCounters), m_refresh_timer(mIoc), m_dht_tasks_timer(mIoc) {
+        m_ioc(mIoc), m_ses(mSes), m_counters(mCounters), m_refresh_timer(mIoc), m_dht_tasks_timer(mIoc)
+        , m_mining_timer(mIoc), m_scheduler(milliseconds(blockchain_mining_timer_resolution), clock_type::now()) {
             m_repository = std::make_shared<repository_impl>(m_ses.sqldb());
         }
 
@@ -409,6 +419,20 @@ namespace blockchain {
         // init chain
         bool init_chain(const aux::bytes &chain_id);
 
+        // the short chain id the relayed messages of the chain come with
+        void add_short_chain_id(const aux::bytes &chain_id);
+
+        // load the chain from the db if it isn't loaded yet
+        bool load_chain(const aux::bytes &chain_id);
+
+        // the chain is used, connect it if it isn't connected, or if it was
+        // parked. Returns false if the chain can't be used
+        bool activate_chain(const aux::bytes &chain_id);
+
+        // save what the idle chain needs and drop it from memory, until it's
+        // used again
+        void park_chain(const aux::bytes &chain_id);
+
         bool create_chain_db(const aux::bytes &chain_id);
 
         // get current time(ms)
@@ -442,7 +466,17 @@ namespace blockchain {
 
 //        void refresh_chain_status(error_code const &e, const aux::bytes &chain_id);
 
-        void refresh_mining_timeout(error_code const&, const aux::bytes &chain_id);
+        void refresh_mining_timeout(const aux::bytes &chain_id);
+
+        // mine the chain in ``interval`` ms
+        void schedule_mining(const aux::bytes &chain_id, std::int64_t interval);
+
+        void unschedule_mining(const aux::bytes &chain_id);
+
+        // arm the mining timer to the next chain to mine
+        void arm_mining_timer();
+
+        void on_mining_timer(error_code const& e);
 
         void peer_preparation(const aux::bytes &chain_id);
 
@@ -594,6 +628,18 @@ namespace blockchain {
 
         void get_all_state_from_peer(const aux::bytes &chain_id, const dht::public_key& peer, const sha1_hash &hash);
 
+        // put the state an epoch block commits to as a snapshot
+        void put_state_snapshot(const aux::bytes &chain_id, const std::vector<state_array> &arrays);
+
+        // get the state committed to by ``hash`` from the snapshot the peer
+        // put. Falls back to getting its state arrays one by one
+        void get_state_snapshot(const aux::bytes &chain_id, const dht::public_key& peer, const sha1_hash &hash);
+
+        void get_state_snapshot_part(const aux::bytes &chain_id, const dht::public_key& peer, const sha1_hash &hash, int index);
+
+        void on_state_snapshot_part(aux::bytes const& chain_id, dht::public_key const& peer, sha1_hash const& hash
+                , int index, std::shared_ptr<assemble::blob_buffer const> const& blob, api::error_code ec);
+
 //        void put_all_state(const aux::bytes &chain_id);
 
         void get_head_block_hash(const aux::bytes &chain_id, const dht::public_key& peer, std::int64_t timestamp);
@@ -620,6 +666,22 @@ namespace blockchain {
 
         void put_block_with_all_state(const aux::bytes &chain_id, const block &blk, const std::vector<state_array> &arrays);
 
+        void get_block_ancestors(const aux::bytes &chain_id, const dht::public_key& peer, const sha1_hash &hash);
+
+        // put the ancestors list of the block, back to the checkpoint before it
+        void put_block_ancestors(const aux::bytes &chain_id, const block &blk);
+
+        // the previous block ``hash`` of ``child`` on a branch is missing,
+        // fetch it along with the blocks before it
+        void sync_missing_block(const aux::bytes &chain_id, const dht::public_key& peer, const sha1_hash &child, const sha1_hash &hash);
+
+        // issue the requests of the block sync of the chain
+        void sync_blocks(const aux::bytes &chain_id);
+
+        // the block ``hash`` of the sync arrived, or failed to. Returns true
+        // if the sync is over
+        bool sync_block_done(const aux::bytes &chain_id, const sha1_hash &hash);
+
 //        void get_transaction_wrapper(const aux::bytes &chain_id, const dht::public_key& peer, const sha1_hash &hash, int times = 1);
 
 //        void put_transaction_wrapper(const aux::bytes &chain_id, const transaction_wrapper &txWrapper);
@@ -655,6 +717,11 @@ namespace blockchain {
         // mutable data callback
         void get_mutable_callback(aux::bytes chain_id, dht::item const& i, bool, GET_ITEM_TYPE type, std::int64_t timestamp, int times = 1);
 
+        // the rest of the mutable data callback for blocks and transactions,
+        // back on the network thread once the worker has checked them
+        void on_item_verified(aux::bytes const& chain_id, dht::public_key const& peer
+                , GET_ITEM_TYPE type, verified_item const& item);
+
         // get mutable item from dht
 //        void dht_get_mutable_item(aux::bytes const& chain_id, std::array<char, 32> key, std::string salt);
 
@@ -708,10 +775,26 @@ namespace blockchain {
         // dht task deadline timer
         aux::deadline_timer m_dht_tasks_timer;
 
+        // the chains are mined on a timer wheel, with one timer for all of
+        // them rather than a timer a chain
+        aux::deadline_timer m_mining_timer;
+
+        // the chains loaded, parked and due to be mined
+        chain_scheduler m_scheduler;
+
+        // when the mining timer is armed to fire, max if it isn't
+        time_point m_mining_timer_expiry = max_time();
+
         bool m_pause = false;
 
-        // chain timers
-        std::map<aux::bytes, aux::deadline_timer> m_chain_timers;
+        // the workers the items got from the DHT are checked on
+        std::unique_ptr<chain_workers> m_workers;
+
+        // the block downloads of the chains catching up on a branch
+        std::map<aux::bytes, block_sync> m_block_syncs;
+
+        // the state snapshots being got by the chains joining
+        std::map<aux::bytes, state_snapshot> m_state_snapshots;
 
 //        std::map<GET_ITEM, GET_INFO> m_get_item_info;
 
@@ -0,0 +1,125 @@
+/*
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#ifndef IP2_CHAIN_SCHEDULER_HPP
+#define IP2_CHAIN_SCHEDULER_HPP
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "ip2/config.hpp"
+#include "ip2/time.hpp"
+#include "ip2/aux_/common.h"
+#include "ip2/aux_/timer_wheel.hpp"
+
+namespace ip2 {
+namespace blockchain {
+
+    // a chain nobody used for that long is parked(1h)
+    constexpr std::int64_t blockchain_chain_idle_time = 60 * 60 * 1000;
+
+    // the resolution the chains are mined with(ms)
+    constexpr int blockchain_mining_timer_resolution = 100;
+
+    // chain_scheduler keeps the book of the chains followed: which are
+    // loaded from the db, which are parked while they're idle, when each was
+    // last used and when each is due to be mined next.
+    //
+    // A chain is loaded when it's connected, not when the blockchain starts.
+    // Only the chains we mine, or that had some activity lately, are
+    // connected in the background, the others wait to be activated. One
+    // that isn't used for blockchain_chain_idle_time is parked: it's
+    // unloaded, no longer mined and not connected again in the background,
+    // only when it's activated.
+    //
+    // The chains are mined on a timer wheel, so the blockchain needs one
+    // timer for all of them, armed to next_expiry(). It doesn't do any IO
+    // itself, times are passed in.
+    class TORRENT_EXTRA_EXPORT chain_scheduler {
+    public:
+        chain_scheduler(time_duration resolution, time_point now);
+
+        chain_scheduler(chain_scheduler const&) = delete;
+        chain_scheduler& operator=(chain_scheduler const&) = delete;
+
+        bool is_loaded(aux::bytes const& chain_id) const;
+
+        bool is_parked(aux::bytes const& chain_id) const;
+
+        // the background loop connects the chains neither loaded nor parked,
+        // that we mine or that had some activity in the
+        // blockchain_chain_idle_time before ``now``(ms)
+        bool wants_connect(aux::bytes const& chain_id, std::int64_t now) const;
+
+        // the chain had some activity at ``when``(ms), such as its head block
+        void record_activity(aux::bytes const& chain_id, std::int64_t when);
+
+        // we have mining power in the chain
+        void set_miner(aux::bytes const& chain_id);
+
+        bool is_miner(aux::bytes const& chain_id) const;
+
+        // the chain is used at ``now``(ms). Returns true if it isn't loaded,
+        // and has to be connected first
+        bool activate(aux::bytes const& chain_id, std::int64_t now);
+
+        // the chain was loaded from the db at ``now``(ms)
+        void loaded(aux::bytes const& chain_id, std::int64_t now);
+
+        // whether the chain hasn't been used since blockchain_chain_idle_time
+        // before ``now``(ms)
+        bool is_idle(aux::bytes const& chain_id, std::int64_t now) const;
+
+        // unload the chain and stop mining it, until it's activated again
+        void park(aux::bytes const& chain_id);
+
+        // forget all about the chain
+        void remove(aux::bytes const& chain_id);
+
+        void clear();
+
+        std::set<aux::bytes> const& loaded_chains() const { return m_loaded; }
+
+        // mine the chain at ``deadline``, instead of when it was due
+        void schedule(aux::bytes const& chain_id, time_point deadline);
+
+        void unschedule(aux::bytes const& chain_id);
+
+        bool is_scheduled(aux::bytes const& chain_id) const;
+
+        std::vector<aux::bytes> scheduled_chains() const;
+
+        // no later than when the next chain is due, max_time() if none is
+        time_point next_expiry() const;
+
+        // the chains due at ``now``, earliest first. None of them is
+        // scheduled any more when it returns, so mining one of them may
+        // schedule or unschedule any other
+        std::vector<aux::bytes> advance(time_point now);
+
+    private:
+        aux::timer_wheel<aux::bytes> m_wheel;
+
+        // the mining of the chains on the wheel
+        std::map<aux::bytes, aux::timer_wheel<aux::bytes>::handle> m_timers;
+
+        std::set<aux::bytes> m_loaded;
+
+        std::set<aux::bytes> m_parked;
+
+        // the last time the chains were used, or had some activity(ms)
+        std::map<aux::bytes, std::int64_t> m_last_active;
+
+        // the chains we mine
+        std::set<aux::bytes> m_miners;
+    };
+}
+}
+
+#endif //IP2_CHAIN_SCHEDULER_HPP
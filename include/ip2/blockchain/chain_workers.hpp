@@ -0,0 +1,91 @@
+/*
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#ifndef IP2_CHAIN_WORKERS_HPP
+#define IP2_CHAIN_WORKERS_HPP
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "ip2/config.hpp"
+#include "ip2/io_context.hpp"
+#include "ip2/aux_/common.h"
+#include "ip2/blockchain/block.hpp"
+#include "ip2/blockchain/transaction.hpp"
+
+namespace ip2 {
+namespace blockchain {
+
+    // a block or transaction got from the DHT, decoded and with its
+    // signatures checked on the worker of its chain
+    struct verified_item {
+        block blk;
+        transaction tx;
+
+        // false if the item is empty, malformed or a signature is bad
+        bool valid = false;
+    };
+
+    // the stateless checks of the items the workers do. They don't throw,
+    // an item that can't be decoded isn't valid
+    TORRENT_EXTRA_EXPORT verified_item verify_block_item(entry const& value);
+    TORRENT_EXTRA_EXPORT verified_item verify_transaction_item(entry const& value);
+
+    // chain_workers takes the CPU bound work of the chains (decoding the
+    // items got from the DHT and checking their signatures) off the network
+    // thread, onto a bounded pool of worker threads.
+    //
+    // Work is sharded by chain id. All the work of a chain runs in order on
+    // the same worker, as on a strand, so chains are worked on in parallel
+    // but a chain is never worked on by two threads at once, and its results
+    // come back in the order the work was posted. The results are handed
+    // back to the network thread, the only one the chain state, the
+    // repository and the DHT are touched from.
+    class TORRENT_EXTRA_EXPORT chain_workers {
+    public:
+        // results are handed back to ``ioc``. With 0 threads the work is
+        // done on the network thread, still after post() returns
+        chain_workers(io_context& ioc, int num_threads);
+        ~chain_workers();
+
+        chain_workers(chain_workers const&) = delete;
+        chain_workers& operator=(chain_workers const&) = delete;
+
+        int num_threads() const { return int(m_shards.size()); }
+
+        // runs ``work`` on the worker of ``chain_id``, after the work posted
+        // for the chain before it, then invokes ``done`` with its result on
+        // the network thread, unless the workers are stopped first
+        template <typename Work, typename Done>
+        void post(aux::bytes const& chain_id, Work work, Done done) {
+            post_impl(chain_id, [&ioc = m_ioc, work = std::move(work), done = std::move(done)]() mutable {
+                auto r = work();
+                ip2::post(ioc, [r = std::move(r), done = std::move(done)]() mutable {
+                    done(std::move(r));
+                });
+            });
+        }
+
+        // stop and join the workers. Work not yet done is dropped
+        void stop();
+
+    private:
+        struct shard;
+
+        void post_impl(aux::bytes const& chain_id, std::function<void()> f);
+
+        io_context& m_ioc;
+        std::vector<std::unique_ptr<shard>> m_shards;
+        bool m_stopped = false;
+    };
+
+}
+}
+
+#endif //IP2_CHAIN_WORKERS_HPP
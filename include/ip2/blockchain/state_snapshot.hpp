@@ -0,0 +1,85 @@
+/*
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#ifndef IP2_STATE_SNAPSHOT_HPP
+#define IP2_STATE_SNAPSHOT_HPP
+
+#include <string>
+#include <vector>
+
+#include "ip2/config.hpp"
+#include "ip2/sha1_hash.hpp"
+#include "ip2/span.hpp"
+#include "ip2/uri.hpp"
+#include "ip2/blockchain/account.hpp"
+#include "ip2/blockchain/state_array.hpp"
+#include "ip2/blockchain/state_hash_array.hpp"
+
+namespace ip2 {
+namespace blockchain {
+
+    // the state arrays in a part of a snapshot, so a part fits in a blob
+    constexpr int state_snapshot_arrays_per_part = 16;
+
+    // state_snapshot is the state of a chain at an epoch block, the block
+    // that commits to it with its state root.
+    //
+    // The accounts are cut in state arrays the way they're ordered in the
+    // state db, so the same state always gives the same snapshot, and the
+    // root is the hash of the state hash array. The snapshot is put as a few
+    // blobs, the parts. Every part has the state hash array along with its
+    // own state arrays, so it's checked against the root on its own as it
+    // arrives, and a node joining the chain imports the state in as many
+    // gets as there are parts rather than a get per state array.
+    class TORRENT_EXTRA_EXPORT state_snapshot {
+    public:
+        state_snapshot() = default;
+
+        // the snapshot to put, of the accounts in the state db order
+        explicit state_snapshot(std::vector<account> const& accounts);
+
+        explicit state_snapshot(std::vector<state_array> arrays);
+
+        // the snapshot to get, committed to by ``root``
+        explicit state_snapshot(sha1_hash const& root) : m_root(root) {}
+
+        sha1_hash const& root() const { return m_root; }
+
+        // the uri the part is put under
+        static aux::uri part_uri(sha1_hash const& root, int index);
+
+        // the number of parts, 0 until the first part arrived if the
+        // snapshot is got
+        int num_parts() const;
+
+        std::string part(int index) const;
+
+        // checks the part got as part ``index`` against the root and keeps its
+        // state arrays. Returns false if it isn't that part of the snapshot
+        bool add_part(int index, span<char const> blob);
+
+        // true if all the state arrays are there
+        bool complete() const;
+
+        std::vector<state_array> const& arrays() const { return m_arrays; }
+
+        state_hash_array const& hash_array() const { return m_hash_array; }
+
+    private:
+        sha1_hash m_root;
+
+        state_hash_array m_hash_array;
+
+        // in the order of the hash array. The ones not got yet are empty
+        std::vector<state_array> m_arrays;
+    };
+
+}
+}
+
+#endif //IP2_STATE_SNAPSHOT_HPP
@@ -27,6 +27,7 @@ see LICENSE file.
 #include "ip2/aux_/deadline_timer.hpp"
 #include "ip2/aux_/alert_manager.hpp" // for alert_manager
 #include "ip2/aux_/session_interface.hpp"
+#include "ip2/api/error_code.hpp"
 #include "ip2/kademlia/item.hpp"
 #include "ip2/common/entry_type.hpp"
 #include "ip2/communication/message_wrapper.hpp"
@@ -63,6 +64,12 @@ namespace ip2 {
         // default refresh time of main task(300)(s)
         constexpr int communication_default_refresh_time = 300;
 
+        // retry interval of the dht rpcs the transporter had no room for(ms)
+        constexpr int communication_retry_interval = 1000;
+
+        // max dht rpcs waiting for room in the transporter
+        constexpr int communication_max_deferred_rpcs = 1000;
+
         // max message list size(used in Levenshtein Distance)
         constexpr int communication_max_message_list_size = 10;
 
@@ -93,7 +100,7 @@ namespace ip2 {
         public:
 
             communication(aux::bytes device_id, aux::session_interface &mSes, io_context &mIoc, counters &mCounters) :
-                    m_device_id(std::move(device_id)), m_ioc(mIoc), m_ses(mSes), m_counters(mCounters)/*, m_refresh_timer(mIoc)*/ {
+                    m_device_id(std::move(device_id)), m_ioc(mIoc), m_ses(mSes), m_counters(mCounters), m_commit_timer(mIoc), m_retry_timer(mIoc)/*, m_refresh_timer(mIoc)*/ {
                 m_message_db = std::make_shared<message_db_impl>(m_ses.sqldb());
             }
 
@@ -252,6 +259,25 @@ namespace ip2 {
 
 //            void refresh_timeout(error_code const& e);
 
+            // commit the messages saved within the commit window, if they
+            // aren't committed by the next ones saved
+            void commit_messages_later();
+
+            void on_commit_timer(error_code const& e);
+
+            // a dht rpc handed to the transporter, kept to be retried when
+            // the queue of its class is full
+            struct deferred_rpc {
+                std::string what;
+                std::function<api::error_code()> call;
+            };
+
+            // run the rpc, if the transporter is full queue it and retry it
+            // on the next tick of the retry timer
+            void submit(deferred_rpc rpc);
+
+            void on_retry_timer(error_code const& e);
+
 //            void send_all_unconfirmed_messages(dht::public_key const& peer);
 
             void on_dht_put_mutable_item(dht::item const& i, int n);
@@ -271,6 +297,19 @@ namespace ip2 {
 
             counters& m_counters;
 
+            // the messages saved are committed when it fires
+            aux::deadline_timer m_commit_timer;
+
+            bool m_commit_timer_armed = false;
+
+            // the deferred rpcs are retried when it fires
+            aux::deadline_timer m_retry_timer;
+
+            bool m_retry_timer_armed = false;
+
+            // dht rpcs the transporter had no room for
+            std::vector<deferred_rpc> m_deferred;
+
             // deadline timer
 //            aux::deadline_timer m_refresh_timer;
 
@@ -10,18 +10,37 @@ see LICENSE file.
 #define IP2_MESSAGE_DB_IMPL_HPP
 
 
+#include <map>
+#include <string>
+
 #include <sqlite3.h>
 //#include <leveldb/db.h>
 
+#include "ip2/time.hpp"
 #include "ip2/communication/message_db_interface.hpp"
 
 namespace ip2 {
     namespace communication {
 
+        // the messages saved are committed at most that late(ms)
+        constexpr int message_db_commit_window = 200;
+
+        // or as soon as that many wait to be committed
+        constexpr int message_db_max_uncommitted = 1000;
+
+        // The ``message_db_impl`` keeps the statements it prepared on its
+        // connection, to be reset and bound again rather than prepared on
+        // every query. The messages saved are committed in groups, in one
+        // transaction, and the queries see them before they're committed.
         struct message_db_impl final : message_db_interface {
 
             explicit message_db_impl(sqlite3 *mSqlite) : m_sqlite(mSqlite) {}
 
+            message_db_impl(message_db_impl const&) = delete;
+            message_db_impl& operator=(message_db_impl const&) = delete;
+
+            ~message_db_impl() override;
+
             // init db
             bool init() override;
 
@@ -52,11 +71,28 @@ namespace ip2 {
 
             bool is_message_in_db(const sha1_hash &hash) override;
 
+            bool commit_messages() override;
+
+            int uncommitted_messages() const override { return int(m_uncommitted.size()); }
+
         private:
 
+            // the statement prepared on the connection for ``sql``. It's
+            // reset once it's used, nullptr if it can't be prepared
+            sqlite3_stmt *statement(char const *sql);
+
             // sqlite3 instance
             sqlite3 *m_sqlite;
 
+            // the statements prepared, by their sql
+            std::map<std::string, sqlite3_stmt *, std::less<>> m_statements;
+
+            // the messages saved and not committed yet
+            std::map<sha1_hash, message> m_uncommitted;
+
+            // when the first of them was saved
+            time_point m_first_uncommitted = max_time();
+
             // level db instance
 //            leveldb::DB* m_leveldb;
         };
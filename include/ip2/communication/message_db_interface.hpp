@@ -63,6 +63,13 @@ namespace ip2 {
 
             virtual bool is_message_in_db(const sha1_hash &hash) = 0;
 
+            // the messages saved may be committed later, in one transaction
+            // with the others. Commit them now
+            virtual bool commit_messages() = 0;
+
+            // the number of messages saved and not committed yet
+            virtual int uncommitted_messages() const = 0;
+
             virtual ~message_db_interface() = default;
         };
     }
@@ -155,6 +155,13 @@ namespace ip2 {
 #endif
 	};
 
+	// hashes each buffer of ``in`` into the digest at the same index of
+	// ``out``, which must be as long. It's a plain loop over the buffers,
+	// with one hasher each, it's no faster than hashing them one by one.
+	TORRENT_EXPORT void hash_batch(span<span<char const> const> in
+		, span<sha1_hash> out);
+	TORRENT_EXPORT void hash_batch(span<span<char const> const> in
+		, span<sha256_hash> out);
 }
 
 #endif // TORRENT_HASHER_HPP_INCLUDED
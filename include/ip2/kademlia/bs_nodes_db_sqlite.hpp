@@ -24,16 +24,28 @@ namespace dht {
 			 "nid VARCHAR(32) NOT NULL PRIMARY KEY,"
 			 "ts INT,"
 			 "endpoint VARCHAR(18) NOT NULL,"
-			 "v4 INT);";
+			 "v4 INT,"
+			 "rtt INT DEFAULT 65535,"
+			 "verified INT DEFAULT 0);";
+
+	// tables created before the rtt and verified columns were added are
+	// upgraded in place. Failing with a duplicate column is expected
+	static const std::string add_bs_nodes_rtt_column =
+		"ALTER TABLE bs_nodes ADD COLUMN rtt INT DEFAULT 65535;";
+
+	static const std::string add_bs_nodes_verified_column =
+		"ALTER TABLE bs_nodes ADD COLUMN verified INT DEFAULT 0;";
 
 	static const std::string create_bs_nodes_ts_index =
 		"CREATE INDEX IF NOT EXISTS index_ts ON bs_nodes (ts);";
 
 	static const std::string insert_or_replace_nodes =
-		"INSERT OR REPLACE INTO bs_nodes(nid, ts, endpoint, v4) VALUES (?, ?, ?, ?);";
+		"INSERT OR REPLACE INTO bs_nodes(nid, ts, endpoint, v4, rtt, verified) "
+		"VALUES (?, ?, ?, ?, ?, ?);";
 
 	static const std::string select_nodes =
-		"SELECT * FROM bs_nodes ORDER BY ts DESC LIMIT ?, ?;";
+		"SELECT nid, ts, endpoint, v4, rtt, verified FROM bs_nodes "
+		"ORDER BY ts DESC LIMIT ?, ?;";
 
 	static const std::string nodes_count =
 		"SELECT COUNT(*) FROM bs_nodes;";
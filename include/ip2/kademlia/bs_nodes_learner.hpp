@@ -45,6 +45,15 @@ public:
 
 	void add_bootstrap_nodes(std::vector<bs_node_entry> const& nodes);
 
+	// get up to ``count`` nodes of the last routing table snapshot to warm
+	// start from, the best candidates first. They're picked from the most
+	// recently seen nodes and ordered by bs_node_entry::operator<
+	void get_warm_start_nodes(std::vector<bs_node_entry>& nodes, int count);
+
+	// put the live nodes of the routing table, with their RTT and
+	// verification state, into storage
+	void snapshot();
+
 	void tick();
 
 private:
@@ -11,6 +11,7 @@ see LICENSE file.
 #define IP2_BOOTSTRAP_NODES_STORAGE_HPP
 
 #include <functional>
+#include <tuple>
 
 #include <ip2/kademlia/dht_observer.hpp>
 #include <ip2/kademlia/node_id.hpp>
@@ -44,14 +45,39 @@ namespace dht {
 			m_ts = ts;
 		}
 
+		bs_node_entry(node_id const& nid, udp::endpoint const& ep, timestamp const& ts
+			, int rtt, bool verified)
+		{
+			m_nid = nid;
+			m_ep = ep;
+			m_ts = ts;
+			m_rtt = std::uint16_t(rtt);
+			m_verified = verified;
+		}
+
+		// compares which bs_node_entry is the better candidate to bootstrap
+		// from. Smaller is better: verified nodes first, then the lower RTT
+		// and then the more recently seen
+		bool operator<(bs_node_entry const& rhs) const
+		{
+			return std::make_tuple(!m_verified, m_rtt, -m_ts.value)
+				< std::make_tuple(!rhs.m_verified, rhs.m_rtt, -rhs.m_ts.value);
+		}
+
 		// bootstrap node id
 		node_id m_nid;
 
 		// ip + port
 		udp::endpoint m_ep;
 
-		// sampling timestamp
+		// sampling timestamp, the time the node was last seen alive
 		timestamp m_ts;
+
+		// the RTT (ms) of the node when it was sampled, 0xffff if unknown
+		std::uint16_t m_rtt = 0xffff;
+
+		// whether the node id was verified against its ip
+		bool m_verified = false;
 	};
 
 	struct TORRENT_EXPORT bs_nodes_storage_interface
@@ -44,7 +44,8 @@ namespace dht {
 			traversal,
 			incoming_table,
 			items_db,
-			bs_nodes_db
+			bs_nodes_db,
+			relay_mailbox
 		};
 
 		enum message_direction_t
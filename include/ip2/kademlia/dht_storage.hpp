@@ -33,6 +33,8 @@ namespace ip2 {
 namespace ip2 {
 namespace dht {
 
+	class relay_mailbox;
+
 	// This structure hold the relevant counters for the storage
 	struct TORRENT_EXPORT dht_storage_counters
 	{
@@ -71,6 +73,11 @@ namespace dht {
 		// Persistence of immutable or mutable items.
 		virtual void set_backend(std::shared_ptr<dht_storage_interface> backend) = 0;
 
+		// This member function sets the mailbox relay entries are kept in.
+		//
+		// Without one, relay entries are kept in memory.
+		virtual void set_relay_mailbox(std::shared_ptr<relay_mailbox>) {}
+
 		// This function retrieves the immutable item given its target hash.
 		//
 		// For future implementers:
@@ -241,9 +241,25 @@ namespace ip2::dht {
 		std::vector<lt::dht::dht_status> dht_status() const;
 		void update_stats_counters(counters& c) const;
 
+		// whether the upload quota (dht_upload_rate_limit) has room for
+		// more packets. The transporter doesn't start new traversals when
+		// it hasn't
+		bool has_upload_quota() { return has_quota(); }
+
 		void incoming_error(error_code const& ec, udp::endpoint const& ep);
 		bool incoming_packet(aux::listen_socket_handle const& s
 			, udp::endpoint const& ep, span<char const> buf, sha256_hash const& pk);
+		// whether packets from ``ep`` are handled at all, checked before they
+		// are decrypted. A packet from a dark network or from a sender over
+		// dht_block_ratelimit is counted as dropped
+		bool incoming_source(udp::endpoint const& ep);
+
+		// a packet already bdecoded, into ``msg``, off the network thread.
+		// ``buf`` is the plain text ``msg`` refers to. Its sender was let
+		// through by incoming_source() before it was decoded
+		bool incoming_packet(aux::listen_socket_handle const& s
+			, udp::endpoint const& ep, span<char const> buf
+			, bdecode_node const& msg, error_code const& ec, sha256_hash const& pk);
 		void incoming_decryption_error(aux::listen_socket_handle const& s
 			, udp::endpoint const& ep, sha256_hash const& pk);
 
@@ -277,6 +293,15 @@ namespace ip2::dht {
 		void update_storage_node_ids();
 		node* get_node(node_id const& id, string_view family_name);
 
+		// the accounting and the checks done before a packet is decoded.
+		// Returns false if the packet should not be handled, in which case
+		// ``accepted`` is what incoming_packet() returns
+		bool filter_packet(udp::endpoint const& ep, span<char const> buf
+			, bool check_source, bool& accepted);
+		bool handle_packet(aux::listen_socket_handle const& s
+			, udp::endpoint const& ep, span<char const> buf
+			, bdecode_node const& msg, error_code const& ec, sha256_hash const& pk);
+
 		// implements socket_manager
 		bool has_quota() override;
 		bool send_packet(aux::listen_socket_handle const& s, entry& e
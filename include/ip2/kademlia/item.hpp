@@ -18,6 +18,9 @@ see LICENSE file.
 #include <ip2/span.hpp>
 #include <ip2/kademlia/types.hpp>
 
+#include <memory>
+#include <vector>
+
 namespace ip2 {
 namespace dht {
 
@@ -53,6 +56,11 @@ TORRENT_EXPORT signature sign_mutable_item(
 	, public_key const& pk
 	, secret_key const& sk);
 
+// An item keeps its value as the canonical bencoded bytes it was received
+// or built as, in a buffer shared by all copies of the item. Those bytes are
+// what's signed, verified, stored and sent on, so an item is never
+// re-encoded. The entry form of the value is only decoded, once, when
+// value() is called.
 class TORRENT_EXTRA_EXPORT item
 {
 public:
@@ -81,12 +89,30 @@ public:
 		, public_key const& pk
 		, signature const& sig);
 
-	void clear() { m_value = entry(); }
-	bool empty() const { return m_value.type() == entry::undefined_t; }
+	// ``v`` must be valid bencoding. The signature of a mutable item isn't
+	// verified, it's expected to have been by the caller
+	void assign_bencoded(span<char const> v);
+	void assign_bencoded(span<char const> v, span<char const> salt
+		, timestamp ts
+		, public_key const& pk
+		, signature const& sig);
+
+	void clear();
+	bool empty() const { return !m_buffer; }
 
 	bool is_mutable() const { return m_mutable; }
 
-	entry const& value() const { return m_value; }
+	// the value, decoded from buffer() the first time it's called. Not
+	// thread safe
+	entry const& value() const;
+
+	// the bencoded value
+	span<char const> buffer() const
+	{
+		if (!m_buffer) return {};
+		return *m_buffer;
+	}
+
 	public_key const& pk() const
 	{ return m_pk; }
 	signature const& sig() const
@@ -95,7 +121,11 @@ public:
 	std::string const& salt() const { return m_salt; }
 
 private:
-	entry m_value;
+	void set_buffer(span<char const> v);
+
+	std::shared_ptr<std::vector<char> const> m_buffer;
+	mutable entry m_value;
+	mutable bool m_decoded = false;
 	std::string m_salt;
 	public_key m_pk;
 	signature m_sig;
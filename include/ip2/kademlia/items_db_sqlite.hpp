@@ -19,14 +19,28 @@ see LICENSE file.
 namespace ip2 {
 namespace dht {
 
+	// dist is the distance exponent between the target and the closest of
+	// our node ids, 256 if it isn't known. Items far from us are evicted
+	// first
 	static const std::string create_items_table =
 		"CREATE TABLE IF NOT EXISTS mutable_items ("
 			 "target VARCHAR(32) NOT NULL PRIMARY KEY,"
 			 "ts INT,"
-			 "item VARCHAR(2000) NOT NULL);";
+			 "item VARCHAR(2000) NOT NULL,"
+			 "dist INT NOT NULL DEFAULT 256);";
 
-	static const std::string create_ts_index =
-		"CREATE INDEX IF NOT EXISTS index_ts ON mutable_items (ts);";
+	// tables created before dist was added
+	static const std::string select_dist_column =
+		"SELECT dist FROM mutable_items LIMIT 0;";
+
+	static const std::string add_dist_column =
+		"ALTER TABLE mutable_items ADD COLUMN dist INT NOT NULL DEFAULT 256;";
+
+	static const std::string drop_ts_index =
+		"DROP INDEX IF EXISTS index_ts;";
+
+	static const std::string create_eviction_index =
+		"CREATE INDEX IF NOT EXISTS index_eviction ON mutable_items (dist DESC, ts ASC);";
 
 	static const std::string select_ts_by_target =
 		"SELECT ts FROM mutable_items WHERE target=?";
@@ -34,27 +48,23 @@ namespace dht {
 	static const std::string select_item_by_target =
 		"SELECT * FROM mutable_items WHERE target=?";
 
-	static const std::string insert_or_replace_items =
-		"INSERT OR REPLACE INTO mutable_items (target, ts, item) VALUES (?, ?, ?);";
+	// an item is updated in place if it's stored, and inserted otherwise, so
+	// the number of rows is known without counting them
+	static const std::string update_items =
+		"UPDATE mutable_items SET ts=?, item=?, dist=? WHERE target=?;";
 
+	static const std::string insert_items =
+		"INSERT INTO mutable_items (target, ts, item, dist) VALUES (?, ?, ?, ?);";
+
+	// only run once, when the database is opened
 	static const std::string items_count =
 		"SELECT COUNT(*) FROM mutable_items;";
 
-	static const std::string delete_items =
-		/*
-		"DELETE FROM mutable_items "
-			 "WHERE target IN "
-			 "(SELECT target FROM mutable_items ORDER BY ts ASC LIMIT 0, ?);";
-		 */
-		/*
-		"DELETE FROM mutable_items "
-			 "WHERE ts <= (SELECT ts FROM mutable_items LIMIT ?, 1);";
-		 */
-
-		"DELETE FROM mutable_items WHERE ts <= ?;";
-
-	static const std::string select_ts_threshold =
-		"SELECT ts FROM mutable_items ORDER BY ts ASC LIMIT ?, 1;";
+	// walks the eviction index, so a batch costs the same whatever the size
+	// of the table
+	static const std::string evict_items =
+		"DELETE FROM mutable_items WHERE target IN "
+			 "(SELECT target FROM mutable_items ORDER BY dist DESC, ts ASC LIMIT ?);";
 
 	struct TORRENT_EXPORT items_db_sqlite : public dht_storage_interface
 	{
@@ -66,7 +76,10 @@ namespace dht {
 		items_db_sqlite(items_db_sqlite const&) = delete;
 		items_db_sqlite& operator=(items_db_sqlite const&) = delete;
 
-		void update_node_ids(std::vector<node_id> const& ids) override {}
+		void update_node_ids(std::vector<node_id> const& ids) override
+		{
+			m_node_ids = ids;
+		}
 
 		void set_backend(std::shared_ptr<dht_storage_interface> backend) override {}
 
@@ -131,7 +144,13 @@ namespace dht {
 		void init();
 		void prepare_statements();
 
+		// deletes at most dht_items_db_eviction_batch of the least important
+		// items, while there are more than dht_items_db_max_count
+		void evict();
+
 		void sql_error(int err_code, const char* err_str) const;
+		// check this before building the message passed to sql_log()
+		bool should_log_sql(aux::LOG_LEVEL log_level) const;
 		void sql_log(int code, const char* msg) const;
 		void sql_time_cost(int const milliseconds, const char* msg) const;
 
@@ -141,14 +160,18 @@ namespace dht {
 		// sql statements
 		sqlite3_stmt* m_select_ts_by_target_stmt = NULL;
 		sqlite3_stmt* m_select_item_by_target_stmt = NULL;
-		sqlite3_stmt* m_insert_or_replace_items_stmt = NULL;
-		sqlite3_stmt* m_items_count_stmt = NULL;
-		sqlite3_stmt* m_delete_items_stmt = NULL;
-		sqlite3_stmt* m_select_ts_threshold_stmt = NULL;
+		sqlite3_stmt* m_update_items_stmt = NULL;
+		sqlite3_stmt* m_insert_items_stmt = NULL;
+		sqlite3_stmt* m_evict_items_stmt = NULL;
 
 		// put item cache
 		std::string m_mutable_item;
 
+		// the number of rows in mutable_items
+		int m_count = 0;
+
+		std::vector<node_id> m_node_ids;
+
 		time_point m_last_refresh;
 	};
 } // namespace dht
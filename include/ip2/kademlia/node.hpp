@@ -14,6 +14,7 @@ see LICENSE file.
 #ifndef NODE_HPP
 #define NODE_HPP
 
+#include <deque>
 #include <map>
 #include <set>
 #include <mutex>
@@ -92,6 +93,7 @@ struct dht_status
 	udp::endpoint local_endpoint;
 	std::vector<dht_routing_bucket> table;
 	std::vector<dht_lookup> requests;
+	std::vector<dht_lookup> completed_requests;
 };
 
 static constexpr int relay_pkt_timeout = 10; // keep_interval / 2 seconds
@@ -180,6 +182,10 @@ public:
 	void add_router_node(node_entry const& router);
 	void add_bootstrap_nodes(std::vector<node_entry> const& nodes);
 
+	// store the live nodes of the routing table, to warm start from the
+	// next time
+	void snapshot_routing_table();
+
 	void unreachable(udp::endpoint const& ep);
 	void incoming(aux::listen_socket_handle const& s, msg const& m, node_id const& from);
 	void incoming_decryption_error(aux::listen_socket_handle const& s
@@ -334,6 +340,9 @@ public:
 		m_running_requests.erase(a);
 	}
 
+	// keeps the stats of a lookup that completed, for status()
+	void traversal_completed(dht_lookup const& l);
+
 	dht_status status() const;
 
 	std::tuple<int, int, int, std::int64_t> get_stats_counters() const;
@@ -373,6 +382,10 @@ private:
 	// since it might have references to it
 	std::set<traversal_algorithm*> m_running_requests;
 
+	// the stats of the most recently completed lookups, the oldest first
+	static constexpr int max_completed_requests = 64;
+	std::deque<dht_lookup> m_completed_requests;
+
 	std::tuple<bool, bool> incoming_request(msg const&, entry&
 		, node_id const& id, node_id *to, udp::endpoint *to_ep, node_id& push_candidate);
 
@@ -0,0 +1,97 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#ifndef IP2_PACKET_DECODER_HPP
+#define IP2_PACKET_DECODER_HPP
+
+#include "ip2/config.hpp"
+#include "ip2/bdecode.hpp"
+#include "ip2/error_code.hpp"
+#include "ip2/io_context.hpp"
+#include "ip2/sha1_hash.hpp"
+#include "ip2/socket.hpp"
+#include "ip2/span.hpp"
+#include "ip2/kademlia/types.hpp"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace ip2 {
+namespace dht {
+
+	// an incoming DHT packet after it has been decrypted, decompressed and
+	// bdecoded.
+	struct TORRENT_EXTRA_EXPORT decoded_packet
+	{
+		udp::endpoint from;
+
+		// the public key of the sender
+		sha256_hash pk;
+
+		// the plain text of the packet. ``msg`` refers to it
+		std::vector<char> buf;
+		bdecode_node msg;
+
+		// set if decryption or decompression failed. The packet should be
+		// dropped
+		bool failed = false;
+
+		// set if the plain text isn't valid bencoding
+		error_code ec;
+	};
+
+	// packet_decoder takes the CPU bound, stateless part of handling an
+	// incoming DHT packet (the key exchange, decryption, decompression and
+	// bdecoding) off the network thread, onto a pool of worker threads.
+	//
+	// Packets are sharded by the public key of their sender. All packets from
+	// one sender are decoded, in order, by the same worker, which also owns
+	// the exchange keys of the senders in its shard, so the workers never
+	// share any state. Decoded packets are handed back to the network thread,
+	// where the routing table, storage and alerts are only touched from.
+	struct TORRENT_EXTRA_EXPORT packet_decoder
+	{
+		using handler = std::function<void(std::unique_ptr<decoded_packet>)>;
+
+		// decoded packets are handed back to ``ios``. At most
+		// ``max_pending`` packets wait for each worker, 0 means no limit
+		packet_decoder(io_context& ios, int num_threads, int max_pending);
+		~packet_decoder();
+
+		packet_decoder(packet_decoder const&) = delete;
+		packet_decoder& operator=(packet_decoder const&) = delete;
+
+		int num_threads() const { return int(m_shards.size()); }
+
+		// queue ``payload``, the encrypted packet following the public key of
+		// its sender ``pk``, to be decoded with our secret key ``sk``. ``done``
+		// is invoked on the network thread with the decoded packet, unless
+		// the decoder is stopped first. Returns false, and drops the packet,
+		// if the worker of the sender already has max_pending packets
+		// waiting
+		bool post(udp::endpoint const& from, sha256_hash const& pk
+			, span<char const> payload, secret_key const& sk, handler done);
+
+		// stop and join the workers. Packets not yet decoded are dropped
+		void stop();
+
+	private:
+
+		struct shard;
+
+		io_context& m_ios;
+		std::vector<std::unique_ptr<shard>> m_shards;
+		int m_max_pending;
+	};
+
+} // namespace dht
+} // namespace ip2
+
+#endif // IP2_PACKET_DECODER_HPP
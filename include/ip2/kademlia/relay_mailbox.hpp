@@ -0,0 +1,190 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#ifndef IP2_RELAY_MAILBOX_HPP
+#define IP2_RELAY_MAILBOX_HPP
+
+#include <ip2/kademlia/dht_observer.hpp>
+#include <ip2/kademlia/relay.hpp>
+
+#include "ip2/config.hpp"
+#include "ip2/entry.hpp"
+#include "ip2/error_code.hpp"
+#include "ip2/settings_pack.hpp"
+#include "ip2/sha1_hash.hpp"
+#include "ip2/socket.hpp"
+#include "ip2/span.hpp"
+#include "ip2/time.hpp"
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/member.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ip2 {
+namespace dht {
+
+	// The relay mailbox keeps the relay entries a node stores for offline
+	// receivers on disk, so they survive a restart.
+	//
+	// Entries are appended to a log of fixed size segment files, which are
+	// memory mapped. Removing an entry appends a tombstone. Only an index
+	// (key, receiver, location and time) is kept in memory, so how much a
+	// relay can hold is bound by dht_relay_mailbox_size, not by memory.
+	//
+	// The oldest segment is compacted once most of it is dead, or once the
+	// mailbox is over its size: its live entries are appended again (or,
+	// when over size, dropped) and the file is deleted. Since segments are
+	// only ever dropped oldest first, a tombstone never outlives the
+	// segments holding the entry it removes.
+	//
+	// On open, the segments are scanned in order to rebuild the index. A
+	// record torn by a crash ends its segment.
+	class TORRENT_EXTRA_EXPORT relay_mailbox
+	{
+	public:
+
+		relay_mailbox(settings_interface const& settings
+			, dht_observer* observer
+			, std::string dir);
+
+		~relay_mailbox();
+
+		relay_mailbox(relay_mailbox const&) = delete;
+		relay_mailbox& operator=(relay_mailbox const&) = delete;
+
+		// opens the segments in the directory and rebuilds the index,
+		// creating the directory if needed
+		bool open(error_code& ec);
+
+		bool is_open() const { return !m_segments.empty(); }
+
+		// stores an entry under ``key``. An entry that's already stored is
+		// only touched. Returns false if it couldn't be written
+		bool put(sha256_hash const& key
+			, sha256_hash const& sender
+			, sha256_hash const& receiver
+			, span<char const> payload
+			, span<char const> aux_nodes
+			, udp protocol
+			, relay_hmac const& hmac);
+
+		// fills ``re`` like dht_storage_interface::get_relay_entry()
+		bool get(sha256_hash const& key, entry& re) const;
+
+		bool get_random(sha256_hash const& receiver, sha256_hash& key) const;
+
+		void remove(sha256_hash const& key);
+
+		// expires entries and compacts the oldest segment if needed
+		void tick();
+
+		// flushes and unmaps the segments
+		void close();
+
+		// the number of entries stored
+		int size() const { return int(m_index.size()); }
+
+		// the number of bytes of the segment files
+		std::int64_t disk_size() const;
+
+		// the size of one segment file
+		static constexpr int segment_size = 1024 * 1024;
+
+	private:
+
+		struct segment;
+
+		struct location
+		{
+			sha256_hash key;
+			sha256_hash receiver;
+
+			// the id of the segment the record is in, and where
+			std::uint32_t segment_id;
+			int offset;
+			int size;
+
+			time_point last_seen;
+		};
+
+		struct by_key {};
+		struct by_time {};
+		struct by_receiver {};
+
+		using index_t = boost::multi_index::multi_index_container<
+			location,
+			boost::multi_index::indexed_by<
+				boost::multi_index::ordered_unique<
+					boost::multi_index::tag<by_key>,
+					boost::multi_index::member<location, sha256_hash, &location::key>
+				>,
+				boost::multi_index::ordered_non_unique<
+					boost::multi_index::tag<by_time>,
+					boost::multi_index::member<location, time_point, &location::last_seen>
+				>,
+				boost::multi_index::ordered_non_unique<
+					boost::multi_index::tag<by_receiver>,
+					boost::multi_index::member<location, sha256_hash, &location::receiver>
+				>
+			>
+		>;
+
+		// the records
+		enum record_type : std::uint8_t { put_record = 1, remove_record = 2 };
+
+		// appends the record ``body`` to the last segment, starting a new
+		// one if it's full. Returns false on error
+		bool append(span<char const> body, std::uint32_t& segment_id, int& offset);
+
+		// maps the segment file ``id``, creating it if ``create`` is set
+		std::unique_ptr<segment> map_segment(std::uint32_t id, bool create
+			, error_code& ec) const;
+
+		// adds the records of ``s`` to the index
+		void replay(segment& s);
+
+		segment* find_segment(std::uint32_t id) const;
+
+		// the record at ``l``, without its header
+		span<char const> record(location const& l) const;
+
+		void erase(index_t::index<by_key>::type::iterator it);
+
+		// drops or moves the live entries of the oldest segment and
+		// deletes it
+		void compact_oldest(bool drop_live);
+
+		std::string segment_path(std::uint32_t id) const;
+
+#ifndef TORRENT_DISABLE_LOGGING
+		bool should_log(aux::LOG_LEVEL log_level) const;
+#endif
+
+		settings_interface const& m_settings;
+		dht_observer* m_observer;
+		std::string m_dir;
+
+		// oldest first. The last one is appended to
+		std::vector<std::unique_ptr<segment>> m_segments;
+
+		index_t m_index;
+
+		// the record being written, reused
+		std::vector<char> m_record;
+	};
+
+} // namespace dht
+} // namespace ip2
+
+#endif // IP2_RELAY_MAILBOX_HPP
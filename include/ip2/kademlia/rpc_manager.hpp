@@ -20,8 +20,10 @@ see LICENSE file.
 #include <ip2/time.hpp>
 #include <ip2/kademlia/node_id.hpp>
 #include <ip2/kademlia/observer.hpp>
+#include <ip2/kademlia/rtt_estimator.hpp>
 #include <ip2/aux_/listen_socket_handle.hpp>
 #include <ip2/aux_/pool.hpp>
+#include <ip2/aux_/timer_wheel.hpp>
 
 namespace ip2 {
 struct entry;
@@ -99,14 +101,53 @@ public:
 
 	void update_node_id(node_id const& id) { m_our_id = id; }
 
+	rtt_estimator const& rtt() const { return m_rtt; }
+
 private:
 
+	// what the timer wheel holds for an outstanding request
+	struct pending_timeout
+	{
+		std::uint16_t tid;
+		observer const* o;
+
+		// whether it's the short timeout or the timeout
+		bool is_short;
+	};
+
+	using timer_handle = aux::timer_wheel<pending_timeout>::handle;
+
+	struct transaction
+	{
+		observer_ptr o;
+
+		// the short timeout of the request, or its timeout once the short
+		// one expired
+		timer_handle timer;
+	};
+
+	using transaction_map = std::unordered_multimap<std::uint16_t, transaction>;
+
+	void add_transaction(std::uint16_t tid, observer_ptr o);
+	transaction_map::iterator find_transaction(std::uint16_t tid, observer const* o);
+
+	// removes the transaction and its timer, returning its observer
+	observer_ptr erase_transaction(transaction_map::iterator i);
+
 	void* allocate_observer();
 	void free_observer(void* ptr);
 
 	mutable lt::aux::pool m_pool_allocator;
 
-	std::unordered_multimap<std::uint16_t, observer_ptr> m_transactions;
+	transaction_map m_transactions;
+
+	// the timeouts of m_transactions. Only the ones expiring are visited
+	// on a tick
+	aux::timer_wheel<pending_timeout> m_timeouts;
+
+	// the round trip times of the endpoints requests were sent to, which
+	// the timeouts are derived from
+	rtt_estimator m_rtt;
 
 	aux::listen_socket_handle m_sock;
 	socket_manager* m_sock_man;
@@ -0,0 +1,77 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#ifndef IP2_RTT_ESTIMATOR_HPP
+#define IP2_RTT_ESTIMATOR_HPP
+
+#include "ip2/config.hpp"
+#include "ip2/socket.hpp"
+#include "ip2/time.hpp"
+
+#include <map>
+
+namespace ip2 {
+namespace dht {
+
+	// Keeps a smoothed round trip time and its variation per endpoint, the
+	// way TCP does (RFC 6298), and derives the timeouts of the requests
+	// sent to it from them.
+	//
+	// The short timeout, after which a traversal stops waiting for a node
+	// and asks another one (still taking the reply if it comes), is the
+	// retransmission timeout SRTT + 4 * RTTVAR. The timeout, after which the
+	// request is failed, is a few of those. Both are bound, and an endpoint
+	// with no sample gets the fixed defaults.
+	class TORRENT_EXTRA_EXPORT rtt_estimator
+	{
+	public:
+
+		static constexpr time_duration default_short_timeout = seconds(1);
+		static constexpr time_duration default_timeout = seconds(5);
+
+		static constexpr time_duration min_short_timeout = milliseconds(100);
+		static constexpr time_duration max_short_timeout = seconds(3);
+		static constexpr time_duration min_timeout = seconds(1);
+		static constexpr time_duration max_timeout = seconds(15);
+
+		// the max number of endpoints an estimate is kept for
+		static constexpr int max_endpoints = 2000;
+
+		// a reply came from ``ep``, ``rtt`` after its request was sent
+		void sample(udp::endpoint const& ep, time_duration rtt, time_point now);
+
+		time_duration short_timeout(udp::endpoint const& ep) const;
+		time_duration timeout(udp::endpoint const& ep) const;
+
+		int size() const { return int(m_estimates.size()); }
+
+	private:
+
+		struct estimate
+		{
+			time_duration srtt;
+			time_duration rttvar;
+			time_point last_sample;
+		};
+
+		estimate const* find(udp::endpoint const& ep) const;
+
+		// the retransmission timeout of ``e``
+		static time_duration rto(estimate const& e);
+
+		// drops the estimates not sampled for a while, or the oldest one
+		void prune(time_point now);
+
+		std::map<udp::endpoint, estimate> m_estimates;
+	};
+
+} // namespace dht
+} // namespace ip2
+
+#endif // IP2_RTT_ESTIMATOR_HPP
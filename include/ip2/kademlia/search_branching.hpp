@@ -0,0 +1,60 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#ifndef IP2_SEARCH_BRANCHING_HPP
+#define IP2_SEARCH_BRANCHING_HPP
+
+#include "ip2/config.hpp"
+
+#include <cstdint>
+
+namespace ip2 {
+namespace dht {
+
+	// The number of requests a lookup keeps in flight, its branch factor.
+	//
+	// It starts at dht_search_branching. Every reply that brings the lookup
+	// closer to its target widens it by one, up to dht_max_search_branching.
+	// A request timing out halves it, never below 1. The requests past their
+	// short timeout are unlikely to be answered, they don't hold a slot.
+	class TORRENT_EXTRA_EXPORT search_branching
+	{
+	public:
+
+		search_branching(int initial, int max);
+
+		// the lookup starts, the closest node it knows of is ``closest``
+		// (a distance_exp) away from the target
+		void start(int closest);
+
+		// a reply came in, the closest node is now ``closest`` away
+		void replied(int closest);
+
+		// a request timed out, not just its short timeout
+		void timed_out();
+
+		// how many more requests to send, with ``outstanding`` in flight,
+		// ``late`` of which are past their short timeout
+		int free_slots(int outstanding, int late) const;
+
+		int factor() const { return m_factor; }
+
+	private:
+
+		std::int8_t m_factor;
+		std::int8_t const m_max;
+
+		// the distance of the closest node when the last reply came in
+		int m_closest = 257;
+	};
+
+} // namespace dht
+} // namespace ip2
+
+#endif // IP2_SEARCH_BRANCHING_HPP
@@ -22,9 +22,11 @@ see LICENSE file.
 #include <ip2/kademlia/node_id.hpp>
 #include <ip2/kademlia/routing_table.hpp>
 #include <ip2/kademlia/observer.hpp>
+#include <ip2/kademlia/search_branching.hpp>
 #include <ip2/address.hpp>
 #include <ip2/flags.hpp>
 #include <ip2/bdecode.hpp>
+#include <ip2/time.hpp>
 
 namespace ip2 {
 
@@ -64,7 +66,7 @@ struct TORRENT_EXTRA_EXPORT traversal_algorithm
 	traversal_algorithm(traversal_algorithm const&) = delete;
 	traversal_algorithm& operator=(traversal_algorithm const&) = delete;
 	int invoke_count() const { TORRENT_ASSERT(m_invoke_count >= 0); return m_invoke_count; }
-	int branch_factor() const { TORRENT_ASSERT(m_branch_factor >= 0); return m_branch_factor; }
+	int branch_factor() const { return m_branching.factor(); }
 
 	void set_invoke_window(std::int8_t invoke_window) { m_invoke_window = invoke_window; }
 	void set_invoke_limit(std::int8_t invoke_limit) { m_invoke_limit = invoke_limit; }
@@ -92,6 +94,9 @@ protected:
 
 	std::uint32_t get_high_priority_node(std::uint32_t max);
 
+	// the distance to the target of the closest node found so far
+	int closest_distance() const;
+
 	// returns true if we're done
 	bool add_requests();
 
@@ -142,7 +147,6 @@ private:
 
 	node_id const m_target;
 	std::int8_t m_invoke_count = 0;
-	std::int8_t m_branch_factor = 3;
 	std::int8_t m_invoke_window = 3;
 	// limit the total invoked requests.
 	std::int8_t m_invoke_limit = 0;
@@ -153,6 +157,18 @@ private:
 	std::int16_t m_responses = 0;
 	std::int16_t m_timeouts = 0;
 
+	// the number of times add_requests() sent requests out
+	std::int16_t m_rounds = 0;
+
+	// the number of requests kept in flight
+	search_branching m_branching;
+
+	// when the traversal was created
+	time_point const m_start;
+
+	// when the first response came in, or max() if none has
+	time_point m_first_response = time_point::max();
+
 	// set to true when done() is called, and will prevent adding new results, as
 	// they would never be serviced and the whole traversal algorithm would stall
 	// and leak
@@ -111,6 +111,181 @@ namespace ip2 {
 			// 16384, 32768, 65536, 131072, 262144, 524288, 1048576
 			socket_recv_size3,
 
+			// the number of rpcs enqueued to the transporter, dispatched to
+			// the DHT and completed, by type
+			transport_get_enqueued,
+			transport_put_enqueued,
+			transport_send_enqueued,
+			transport_get_dispatched,
+			transport_put_dispatched,
+			transport_send_dispatched,
+			transport_get_completed,
+			transport_put_completed,
+			transport_send_completed,
+
+			// the number of rpcs dispatched of each priority class, and the
+			// milliseconds they waited in the queue in total. The mean wait
+			// of a class is its wait divided by its dispatched
+			transport_relay_dispatched,
+			transport_blob_get_dispatched,
+			transport_blob_put_dispatched,
+			transport_chain_sync_dispatched,
+			transport_maintenance_dispatched,
+			transport_relay_wait,
+			transport_blob_get_wait,
+			transport_blob_put_wait,
+			transport_chain_sync_wait,
+			transport_maintenance_wait,
+
+			// the number of times a blob segment (or its index) was put or
+			// requested again, after the previous attempt failed
+			assemble_put_retries,
+			assemble_get_retries,
+
+			// the number of blobs got over the direct channel, the segments
+			// got that way, the segments that had to be got from the DHT
+			// after all, and the segments served to direct getters
+			assemble_direct_gets,
+			assemble_direct_segments,
+			assemble_direct_fallbacks,
+			assemble_direct_served,
+
+			// the segments a getter found in the segment cache, the ones it
+			// had to get from the network, and the bytes it didn't get
+			// thanks to the cache. The hit ratio is hits / (hits + misses)
+			assemble_cache_hits,
+			assemble_cache_misses,
+			assemble_cache_bytes_saved,
+
+			// latency histograms. Each histogram is a run of 16 counters,
+			// counting samples below 1 << n milliseconds, where n is the
+			// number at the end of the counter name. See latency_histogram.hpp
+
+			// the time an rpc waits in the transporter queue before it is
+			// dispatched to the DHT
+			transport_queue_wait0,
+			transport_queue_wait1,
+			transport_queue_wait2,
+			transport_queue_wait3,
+			transport_queue_wait4,
+			transport_queue_wait5,
+			transport_queue_wait6,
+			transport_queue_wait7,
+			transport_queue_wait8,
+			transport_queue_wait9,
+			transport_queue_wait10,
+			transport_queue_wait11,
+			transport_queue_wait12,
+			transport_queue_wait13,
+			transport_queue_wait14,
+			transport_queue_wait15,
+
+			// the time from dispatching a get, put and relay (send) rpc
+			// respectively to its completion callback
+			transport_get_latency0,
+			transport_get_latency1,
+			transport_get_latency2,
+			transport_get_latency3,
+			transport_get_latency4,
+			transport_get_latency5,
+			transport_get_latency6,
+			transport_get_latency7,
+			transport_get_latency8,
+			transport_get_latency9,
+			transport_get_latency10,
+			transport_get_latency11,
+			transport_get_latency12,
+			transport_get_latency13,
+			transport_get_latency14,
+			transport_get_latency15,
+			transport_put_latency0,
+			transport_put_latency1,
+			transport_put_latency2,
+			transport_put_latency3,
+			transport_put_latency4,
+			transport_put_latency5,
+			transport_put_latency6,
+			transport_put_latency7,
+			transport_put_latency8,
+			transport_put_latency9,
+			transport_put_latency10,
+			transport_put_latency11,
+			transport_put_latency12,
+			transport_put_latency13,
+			transport_put_latency14,
+			transport_put_latency15,
+			transport_send_latency0,
+			transport_send_latency1,
+			transport_send_latency2,
+			transport_send_latency3,
+			transport_send_latency4,
+			transport_send_latency5,
+			transport_send_latency6,
+			transport_send_latency7,
+			transport_send_latency8,
+			transport_send_latency9,
+			transport_send_latency10,
+			transport_send_latency11,
+			transport_send_latency12,
+			transport_send_latency13,
+			transport_send_latency14,
+			transport_send_latency15,
+
+			// the end-to-end time of putting a blob, getting a blob and
+			// relaying a message or data uri respectively
+			assemble_put_latency0,
+			assemble_put_latency1,
+			assemble_put_latency2,
+			assemble_put_latency3,
+			assemble_put_latency4,
+			assemble_put_latency5,
+			assemble_put_latency6,
+			assemble_put_latency7,
+			assemble_put_latency8,
+			assemble_put_latency9,
+			assemble_put_latency10,
+			assemble_put_latency11,
+			assemble_put_latency12,
+			assemble_put_latency13,
+			assemble_put_latency14,
+			assemble_put_latency15,
+			assemble_get_latency0,
+			assemble_get_latency1,
+			assemble_get_latency2,
+			assemble_get_latency3,
+			assemble_get_latency4,
+			assemble_get_latency5,
+			assemble_get_latency6,
+			assemble_get_latency7,
+			assemble_get_latency8,
+			assemble_get_latency9,
+			assemble_get_latency10,
+			assemble_get_latency11,
+			assemble_get_latency12,
+			assemble_get_latency13,
+			assemble_get_latency14,
+			assemble_get_latency15,
+			assemble_relay_latency0,
+			assemble_relay_latency1,
+			assemble_relay_latency2,
+			assemble_relay_latency3,
+			assemble_relay_latency4,
+			assemble_relay_latency5,
+			assemble_relay_latency6,
+			assemble_relay_latency7,
+			assemble_relay_latency8,
+			assemble_relay_latency9,
+			assemble_relay_latency10,
+			assemble_relay_latency11,
+			assemble_relay_latency12,
+			assemble_relay_latency13,
+			assemble_relay_latency14,
+			assemble_relay_latency15,
+
+			// incoming DHT packets dropped because the decoder worker of
+			// their sender had dht_packet_queue_size packets waiting
+			dht_packets_decode_dropped,
+
 			num_stats_counters
 		};
 
@@ -153,6 +328,14 @@ namespace ip2 {
 
 			num_queued_tracker_announces,
 
+			// the number of rpcs in the transporter queue of each priority
+			// class
+			transport_relay_queued,
+			transport_blob_get_queued,
+			transport_blob_put_queued,
+			transport_chain_sync_queued,
+			transport_maintenance_queued,
+
 			num_counters,
 			num_gauges_counters = num_counters - num_stats_counters
 		};
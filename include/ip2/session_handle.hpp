@@ -51,6 +51,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "ip2/uri.hpp"
 
 #include "ip2/aux_/common.h" // for aux::bytes
+#include "ip2/aux_/submission_queue.hpp"
 
 #include "ip2/api/error_code.hpp"
 
@@ -474,6 +475,24 @@ namespace ip2 {
 		ip2::api::error_code relay_message(std::array<char, 32> const& receiver
 			, std::vector<char> const& message);
 
+		// non-blocking versions of the four calls above. They don't wait for
+		// the network thread. The request is queued, with the payload moved
+		// rather than copied, and submitted in a batch with the other
+		// requests queued by then. The result is only reported by the alert
+		// of the blocking call, including a rejection, e.g.
+		// TRANSPORT_BUFFER_FULL when more than
+		// settings_pack::submission_queue_size requests are waiting.
+		void async_put_data_into_swarm(std::vector<char> blob
+			, std::array<char, 20> const& uri);
+		void async_relay_data_uri(std::array<char, 32> const& receiver
+			, std::array<char, 20> const& uri
+			, std::int64_t timestamp = 0);
+		void async_get_data_from_swarm(std::array<char, 32> const& sender
+			, std::array<char, 20> const& uri
+			, std::int64_t timestamp = 0);
+		void async_relay_message(std::array<char, 32> const& receiver
+			, std::vector<char> message);
+
 		// This call dereferences the reference count of the specified peer
 		// class. When creating a peer class it's automatically referenced by 1.
 		// If you want to recycle a peer class, you may call this function. You
@@ -669,6 +688,8 @@ namespace ip2 {
 		template <typename Fun, typename... Args>
 		void async_call(Fun f, Args&&... a) const;
 
+		void submit(aux::submission s) const;
+
 		template <typename Fun, typename... Args>
 		void sync_call(Fun f, Args&&... a) const;
 
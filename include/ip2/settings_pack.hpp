@@ -929,6 +929,18 @@ namespace aux {
             //start blockchain module
             enable_blockchain,
 
+			// when set, blobs this node puts are kept for a while and served
+			// over uTP to getters that can reach this node, and blobs are got
+			// the same way from senders that announce a reachable endpoint.
+			// The DHT is used for what can't be got directly
+			enable_direct_transfer,
+
+			// when set, a node joining a chain gets the state of the epoch
+			// block from the snapshot the peer put, in a few blobs, rather
+			// than getting its state arrays one by one. It falls back to
+			// that if there's no snapshot
+			blockchain_fast_join,
+
 			max_bool_setting_internal
 		};
 
@@ -1851,7 +1863,8 @@ namespace aux {
 
 			// the number of concurrent search request the node will send when
 			// announcing and refreshing the routing table. This parameter is called
-			// alpha in the kademlia paper
+			// alpha in the kademlia paper. It's where a lookup starts, see
+			// dht_max_search_branching
 			dht_search_branching,
 
 			// the request range for one dht operation(etc. get_peers, get, put).
@@ -1914,7 +1927,9 @@ namespace aux {
 			// an unbounded amount of memory.
 			dht_max_torrents,
 
-			// max number of items the DHT will store
+			// max number of items the DHT will store, of each of the
+			// immutable and mutable kinds. Making room for an item costs
+			// O(log n), so nodes with memory to spare may raise it a lot
 			dht_max_dht_items,
 
 			// the max number of peers to store per torrent (for the DHT)
@@ -1956,9 +1971,96 @@ namespace aux {
 			// transport layer default invoking time interval, unit:ms
 			transport_invoking_interval,
 
-			// transport layer default invoking queue max size
+			// transport layer default invoking queue max size, of each
+			// priority class
 			transport_invoking_queue_max_size,
 
+			// the number of worker threads incoming DHT packets are
+			// decrypted, decompressed and bdecoded on. Packets are spread
+			// over the workers by the public key of their sender. 0 decodes
+			// them on the network thread. It takes effect when the DHT is
+			// (re)started
+			dht_packet_threads,
+
+			// the max number of requests submitted by the non-blocking put,
+			// get and relay calls that may wait for the network thread.
+			// Requests submitted while the queue is full are rejected with
+			// TRANSPORT_BUFFER_FULL
+			submission_queue_size,
+
+			// the number of seconds a direct transfer stream may stay open.
+			// Once it's closed, the segments not got yet are got from the DHT
+			direct_transfer_timeout,
+
+			// the max number of bytes of recently put blobs kept to serve
+			// direct transfers. The oldest blobs are dropped first
+			direct_transfer_cache_size,
+
+			// the max number of bytes of the relay mailbox files. Relay
+			// entries are kept on disk, so they survive a restart. Once the
+			// mailbox is over this size, the oldest entries are dropped. 0
+			// keeps relay entries in memory, bound by dht_relay_entry_max_count
+			dht_relay_mailbox_size,
+
+			// the max number of mutable items evicted from the items
+			// database at once. A put that takes it over
+			// dht_items_db_max_count evicts up to this many, the items
+			// furthest from our node ids first
+			dht_items_db_eviction_batch,
+
+			// the max number of bytes of blob segments, put or got, kept in
+			// memory. Getters take the segments cached instead of getting
+			// them from the network
+			assemble_segment_cache_size,
+
+			// the max number of bytes of the segments dropped from memory
+			// and kept on disk, in the segment_cache directory next to the
+			// databases. 0 keeps the cache in memory only
+			assemble_segment_cache_disk_size,
+
+			// the weights the transporter shares its dispatch budget by,
+			// between relays, blob gets, blob puts, chain sync and
+			// maintenance rpcs. A class with twice the weight of another gets
+			// twice as many rpcs dispatched while both have some queued
+			transport_relay_weight,
+			transport_blob_get_weight,
+			transport_blob_put_weight,
+			transport_chain_sync_weight,
+			transport_maintenance_weight,
+
+			// the max number of concurrent requests a DHT lookup grows to
+			// while its responses keep bringing it closer to its target.
+			// It starts at dht_search_branching and is halved when a
+			// request times out
+			dht_max_search_branching,
+
+			// the max number of log alerts (session, dht, communication,
+			// blockchain, transport and assemble logs) queued up, in a queue
+			// of their own. A flood of them can't fill alert_queue_size then,
+			// and the other alerts are popped before them. 0 queues them
+			// with the other alerts
+			alert_log_queue_size,
+
+			// the number of worker threads the blocks and transactions the
+			// chains get from the DHT are decoded and have their signatures
+			// checked on. The work of a chain always runs on the same worker,
+			// in order. 0 does it on the network thread. It takes effect when
+			// the blockchain is (re)started
+			blockchain_verify_threads,
+
+			// the max number of incoming DHT packets waiting for each of the
+			// dht_packet_threads workers. Packets arriving while the worker
+			// of their sender is that far behind are dropped, and counted in
+			// dht.dht_packets_decode_dropped. 0 means no limit
+			dht_packet_queue_size,
+
+			// the number of nodes, of the routing table snapshot stored in
+			// the bootstrap nodes db, the DHT warm starts from. The best of
+			// them, by verification, RTT and freshness, are probed in parallel
+			// when the DHT starts. 0 only bootstraps from the 4 most recently
+			// seen
+			dht_warm_start_nodes,
+
 			max_int_setting_internal
 		};
 
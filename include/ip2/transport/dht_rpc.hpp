@@ -11,27 +11,66 @@ see LICENSE file.
 #define IP2_TRANSPORT_DHT_RPC_HPP
 
 #include "ip2/entry.hpp"
+#include "ip2/time.hpp"
 
 #include <ip2/kademlia/node_id.hpp>
 #include <ip2/kademlia/types.hpp>
 
+#include <functional>
+#include <memory>
 #include <string>
 
 namespace ip2 {
 namespace transport {
 
+enum rpc_type : std::uint8_t
+{
+	GET_RPC,
+	PUT_RPC,
+	SEND_RPC,
+};
+
+// the classes rpcs are scheduled in. Every class has a queue of its own,
+// and the queues share the dispatch budget by the weight of their class
+// (transport_*_weight), so a busy class can't starve the others.
+enum priority_class : std::uint8_t
+{
+	// relays between users, someone is waiting for them
+	RELAY_CLASS,
+	BLOB_GET_CLASS,
+	BLOB_PUT_CLASS,
+	CHAIN_SYNC_CLASS,
+	// republishing state nobody is waiting for
+	MAINTENANCE_CLASS,
+	NUM_PRIORITY_CLASSES,
+};
+
 struct rpc_ctx
 {
-	explicit rpc_ctx(std::int8_t invoke_branch, std::int8_t invoke_window
-		, std::int8_t invoke_limit)
-		: m_invoke_branch(invoke_branch)
+	explicit rpc_ctx(rpc_type type, std::int8_t invoke_branch
+		, std::int8_t invoke_window, std::int8_t invoke_limit)
+		: m_type(type)
+		, m_invoke_branch(invoke_branch)
 		, m_invoke_window(invoke_window)
 		, m_invoke_limit(invoke_limit)
 	{}
 
+	rpc_type m_type;
+
 	std::int8_t m_invoke_branch;
 	std::int8_t m_invoke_window;
 	std::int8_t m_invoke_limit;
+
+	priority_class m_class = MAINTENANCE_CLASS;
+
+	// when the rpc was queued and dispatched to the DHT, for the
+	// transport latency histograms
+	time_point m_enqueued;
+	time_point m_dispatched;
+
+	// a get may call back several times, only the first completion is
+	// recorded
+	bool m_completed = false;
 };
 
 struct get_ctx : rpc_ctx
@@ -39,7 +78,7 @@ struct get_ctx : rpc_ctx
 	explicit get_ctx(dht::public_key const& pubkey, std::string const& salt
 		, std::int64_t timestamp, std::int8_t invoke_branch, std::int8_t invoke_window
 		, std::int8_t invoke_limit)
-		: rpc_ctx(invoke_branch, invoke_window, invoke_limit)
+		: rpc_ctx(GET_RPC, invoke_branch, invoke_window, invoke_limit)
 		, m_pubkey(pubkey)
 		, m_salt(salt)
 		, m_timestamp(timestamp)
@@ -55,7 +94,7 @@ struct put_ctx : rpc_ctx
 	explicit put_ctx(entry data, std::string const& salt
 		, std::int8_t invoke_branch, std::int8_t invoke_window
 		, std::int8_t invoke_limit)
-		: rpc_ctx(invoke_branch, invoke_window, invoke_limit)
+		: rpc_ctx(PUT_RPC, invoke_branch, invoke_window, invoke_limit)
 		, m_data(std::move(data))
 		, m_salt(salt)
 	{}
@@ -69,7 +108,7 @@ struct relay_ctx : rpc_ctx
 	explicit relay_ctx(dht::public_key const& to, entry payload
 		, std::int8_t invoke_branch, std::int8_t invoke_window
 		, std::int8_t invoke_limit)
-		: rpc_ctx(invoke_branch, invoke_window, invoke_limit)
+		: rpc_ctx(SEND_RPC, invoke_branch, invoke_window, invoke_limit)
 		, m_to(to)
 		, m_payload(std::move(payload))
 	{}
@@ -82,9 +121,12 @@ using rpc_method = std::function<void(void)>;
 
 struct rpc
 {
-	explicit rpc(rpc_method method) : m_method(std::move(method)) {}
+	rpc(rpc_method method, std::shared_ptr<rpc_ctx> ctx)
+		: m_method(std::move(method)), m_ctx(std::move(ctx))
+	{}
 
 	rpc_method m_method;
+	std::shared_ptr<rpc_ctx> m_ctx;
 };
 
 } // namespace transport
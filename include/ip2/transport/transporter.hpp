@@ -25,6 +25,7 @@ see LICENSE file.
 #include <ip2/kademlia/item.hpp>
 #include <ip2/kademlia/node_entry.hpp>
 
+#include <array>
 #include <functional>
 #include <queue>
 #include <set>
@@ -62,13 +63,16 @@ public:
 	bool should_log(aux::LOG_LEVEL log_level) const override;
 	void log(aux::LOG_LEVEL log_level, char const* fmt, ...)
 		noexcept override TORRENT_FORMAT(3,4);
+	void log_record(aux::LOG_LEVEL log_level, char const* fmt
+		, span<char const> record) noexcept override;
 
 	std::shared_ptr<transporter> self() { return shared_from_this(); }
 
 	void start();
 	void stop();
 
-	bool has_enough_buffer(int slots);
+	// whether ``slots`` more rpcs fit in the queue of ``cls``
+	bool has_enough_buffer(int slots, priority_class cls);
 
 	api::error_code get(dht::public_key const& key
 		, std::string salt
@@ -76,14 +80,16 @@ public:
 		, std::function<void(dht::item const&, bool)> cb
 		, std::int8_t invoke_branch
 		, std::int8_t invoke_window
-		, std::int8_t invoke_limit);
+		, std::int8_t invoke_limit
+		, priority_class cls);
 
 	api::error_code put(entry const& data
 		, std::string salt
 		, std::function<void(dht::item const&, int)> cb
 		, std::int8_t invoke_branch
 		, std::int8_t invoke_window
-		, std::int8_t invoke_limit);
+		, std::int8_t invoke_limit
+		, priority_class cls);
 
 	api::error_code send(dht::public_key const& to
 		, entry const& payload
@@ -92,7 +98,8 @@ public:
 		, std::int8_t invoke_branch
 		, std::int8_t invoke_window
 		, std::int8_t invoke_limit
-		, std::int8_t hit_limit);
+		, std::int8_t hit_limit
+		, priority_class cls);
 
 	// callback
 
@@ -130,6 +137,16 @@ public:
 
 private:
 
+	// queue an rpc in the queue of its class, stamping its enqueue time
+	void enqueue(rpc r);
+
+	// the class to dispatch the next rpc of, or NUM_PRIORITY_CLASSES if
+	// all queues are empty
+	priority_class next_class() const;
+
+	// update the completion counter and latency histogram of the rpc type
+	void on_completed(rpc_ctx& ctx);
+
 	void invoking_timeout(error_code const& e);
 
 	bool m_running;
@@ -143,7 +160,16 @@ private:
 
 	std::set<std::shared_ptr<relay_listener>> m_relay_listeners;
 
-	std::queue<rpc> m_rpc_queue;
+	// one queue per priority_class
+	std::array<std::queue<rpc>, NUM_PRIORITY_CLASSES> m_rpc_queues;
+
+	// start-time fair queuing. The head of each queue has a start tag,
+	// and the one with the lowest is dispatched. Dispatching advances the
+	// virtual time to its tag, and the tag of its class by the inverse of
+	// the class weight. A class that was idle starts at the virtual time,
+	// it doesn't accrue credit
+	std::array<std::int64_t, NUM_PRIORITY_CLASSES> m_start_tags{};
+	std::int64_t m_virtual_time = 0;
 
 	aux::deadline_timer m_invoking_timer;
 };
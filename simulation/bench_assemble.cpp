@@ -0,0 +1,591 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+// bench_assemble runs a swarm of simulated IP2 sessions, over a network with
+// a configurable latency and packet loss, and drives put, get or relay
+// workloads through their assemble modules. Everything runs on simulated
+// time and a seeded random generator, so a run is deterministic and its
+// numbers can be compared between revisions.
+//
+// usage: bench_assemble [options]
+//
+//   -m put|get|relay  the workload (default: put). get first puts the
+//                     blobs, then gets each one put successfully from
+//                     another node
+//   -n <nodes>        number of sessions (default: 50)
+//   -b <blobs>        number of blobs or messages (default: 200)
+//   -s <bytes>        blob or message size (default: 4000). A relayed
+//                     message larger than 950 bytes is rejected, and
+//                     counted as such
+//   -c <concurrency>  max operations in flight (default: 8)
+//   -l <ms>           one-way latency of every path (default: 50)
+//   -p <percent>      packet loss (default: 0)
+//   -r <percent>      churn, the share of sessions paused at any time,
+//                     rotating every 10 simulated seconds (default: 0)
+//   -S <seed>         random seed (default: 1)
+
+#include "simulator/simulator.hpp"
+#include "simulator/queue.hpp"
+
+#include "ip2/session.hpp"
+#include "ip2/session_params.hpp"
+#include "ip2/session_stats.hpp"
+#include "ip2/settings_pack.hpp"
+#include "ip2/alert_types.hpp"
+#include "ip2/hex.hpp"
+#include "ip2/time.hpp"
+#include "ip2/aux_/generate_port.hpp"
+#include "ip2/kademlia/ed25519.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace lt;
+
+namespace {
+
+	enum class workload { put, get, relay };
+
+	struct bench_settings
+	{
+		workload mode = workload::put;
+		int nodes = 50;
+		int blobs = 200;
+		int size = 4000;
+		int concurrency = 8;
+		int latency_ms = 50;
+		int loss_percent = 0;
+		int churn_percent = 0;
+		std::uint32_t seed = 1;
+	};
+
+	// drops packets at random, with a deterministic generator
+	struct lossy_link : sim::sink
+	{
+		lossy_link(int const loss_percent, std::uint32_t const seed)
+			: m_loss(loss_percent), m_rng(seed) {}
+
+		void incoming_packet(sim::aux::packet p) override
+		{
+			if (m_loss > 0 && int(m_rng() % 100) < m_loss)
+			{
+				++dropped;
+				return;
+			}
+			sim::forward_packet(std::move(p));
+		}
+
+		std::string label() const override { return "lossy link"; }
+
+		std::int64_t dropped = 0;
+
+	private:
+		int const m_loss;
+		std::mt19937 m_rng;
+	};
+
+	// every packet crosses the lossy link and a queue adding the latency,
+	// on top of the default per-host routes
+	struct bench_network : sim::default_config
+	{
+		explicit bench_network(bench_settings const& s)
+			: m_settings(s)
+			, m_loss(std::make_shared<lossy_link>(s.loss_percent, s.seed))
+		{}
+
+		void build(sim::simulation& sim) override
+		{
+			sim::default_config::build(sim);
+			m_latency = std::make_shared<sim::queue>(sim.get_io_context()
+				, 100 * 1000 * 1000
+				, sim::chrono::milliseconds(m_settings.latency_ms)
+				, 1000 * 1000 * 1000, "latency");
+		}
+
+		sim::route channel_route(sim::asio::ip::address src
+			, sim::asio::ip::address dst) override
+		{
+			sim::route ret = sim::default_config::channel_route(src, dst);
+			ret.prepend(m_latency);
+			ret.prepend(m_loss);
+			return ret;
+		}
+
+		std::int64_t dropped() const { return m_loss->dropped; }
+
+	private:
+		bench_settings const& m_settings;
+		std::shared_ptr<lossy_link> m_loss;
+		std::shared_ptr<sim::queue> m_latency;
+	};
+
+	struct bench_node
+	{
+		std::unique_ptr<sim::asio::io_context> ios;
+		std::shared_ptr<lt::session> ses;
+		std::array<char, 32> pk;
+		address addr;
+		bool paused = false;
+	};
+
+	// an operation in flight, or done
+	struct operation
+	{
+		int node = 0;
+		std::array<char, 32> peer{};
+		std::array<char, 20> uri{};
+		time_point start;
+		bool done = false;
+		bool ok = false;
+	};
+
+	std::string seed_hex(int const node, std::uint32_t const seed)
+	{
+		std::mt19937 rng(seed * 100003u + std::uint32_t(node));
+		std::array<char, 32> s;
+		for (auto& c : s) c = char(rng());
+		return aux::to_hex(s);
+	}
+
+	std::array<char, 32> public_key_of(std::string const& hex_seed)
+	{
+		std::array<char, 32> s;
+		aux::from_hex(hex_seed, s.data());
+		dht::public_key pk;
+		dht::secret_key sk;
+		std::tie(pk, sk) = dht::ed25519_create_keypair(s);
+		return pk.bytes;
+	}
+
+	template <typename T>
+	T percentile(std::vector<T> v, int const pct)
+	{
+		if (v.empty()) return T();
+		std::sort(v.begin(), v.end());
+		std::size_t idx = v.size() * std::size_t(pct) / 100;
+		if (idx >= v.size()) idx = v.size() - 1;
+		return v[idx];
+	}
+
+	bool parse_args(int argc, char const* argv[], bench_settings& s)
+	{
+		for (int i = 1; i + 1 < argc; i += 2)
+		{
+			char const* v = argv[i + 1];
+			if (!std::strcmp(argv[i], "-m"))
+			{
+				if (!std::strcmp(v, "put")) s.mode = workload::put;
+				else if (!std::strcmp(v, "get")) s.mode = workload::get;
+				else if (!std::strcmp(v, "relay")) s.mode = workload::relay;
+				else return false;
+			}
+			else if (!std::strcmp(argv[i], "-n")) s.nodes = std::atoi(v);
+			else if (!std::strcmp(argv[i], "-b")) s.blobs = std::atoi(v);
+			else if (!std::strcmp(argv[i], "-s")) s.size = std::atoi(v);
+			else if (!std::strcmp(argv[i], "-c")) s.concurrency = std::atoi(v);
+			else if (!std::strcmp(argv[i], "-l")) s.latency_ms = std::atoi(v);
+			else if (!std::strcmp(argv[i], "-p")) s.loss_percent = std::atoi(v);
+			else if (!std::strcmp(argv[i], "-r")) s.churn_percent = std::atoi(v);
+			else if (!std::strcmp(argv[i], "-S")) s.seed = std::uint32_t(std::atoi(v));
+			else return false;
+		}
+		return s.nodes > 1 && s.blobs > 0 && s.size > 0 && s.concurrency > 0;
+	}
+
+	struct bench
+	{
+		bench(sim::simulation& sim, bench_settings const& s)
+			: m_sim(sim), m_settings(s), m_rng(s.seed), m_timer(sim.get_io_context())
+		{}
+
+		void start()
+		{
+			std::string bootstrap;
+			for (int i = 0; i < m_settings.nodes; ++i)
+			{
+				bench_node n;
+				n.addr = make_address_v4("50.0." + std::to_string(i / 250)
+					+ "." + std::to_string(i % 250 + 1));
+				std::string const seed = seed_hex(i, m_settings.seed);
+				n.pk = public_key_of(seed);
+
+				// the first few nodes are everyone's bootstrap nodes
+				if (i < 8)
+				{
+					if (!bootstrap.empty()) bootstrap += ",";
+					bootstrap += "tau://" + aux::to_hex(n.pk) + "@"
+						+ n.addr.to_string() + ":6881";
+				}
+
+				n.ios = std::make_unique<sim::asio::io_context>(m_sim, n.addr);
+				m_nodes.push_back(std::move(n));
+			}
+
+			for (int i = 0; i < m_settings.nodes; ++i)
+			{
+				bench_node& n = m_nodes[std::size_t(i)];
+				settings_pack pack;
+				pack.set_str(settings_pack::listen_interfaces, n.addr.to_string() + ":6881");
+				pack.set_str(settings_pack::account_seed, seed_hex(i, m_settings.seed));
+				pack.set_str(settings_pack::dht_bootstrap_nodes, bootstrap);
+				pack.set_str(settings_pack::db_dir, "bench_assemble_db/" + std::to_string(i));
+				pack.set_bool(settings_pack::enable_dht, true);
+				pack.set_bool(settings_pack::dht_ignore_dark_internet, false);
+				pack.set_bool(settings_pack::dht_restrict_routing_ips, false);
+				pack.set_int(settings_pack::alert_mask, alert_category::assemble);
+
+				session_params params(pack);
+				n.ses = std::make_shared<lt::session>(params, *n.ios);
+			}
+
+			// give the swarm time to bootstrap before measuring
+			m_timer.expires_after(seconds(30));
+			m_timer.async_wait([this](error_code const& ec)
+			{
+				if (ec) return;
+				start_phase();
+			});
+		}
+
+		// the counters of a phase are the difference with the ones
+		// collected when it starts
+		void start_phase()
+		{
+			collect_counters([this]
+			{
+				m_baseline = m_counters;
+				m_start = clock_type::now();
+				m_last_churn = m_start;
+				tick();
+			});
+		}
+
+		// collects the stats counters of all sessions, then calls ``f``
+		template <typename F>
+		void collect_counters(F f)
+		{
+			m_counters.assign(std::size_t(counters::num_counters), 0);
+			for (auto& n : m_nodes) n.ses->post_session_stats();
+			m_timer.expires_after(seconds(1));
+			m_timer.async_wait([this, f](error_code const& ec)
+			{
+				if (ec) return;
+				for (auto& n : m_nodes) handle_alerts(n);
+				f();
+			});
+		}
+
+		void schedule(time_duration const d)
+		{
+			m_timer.expires_after(d);
+			m_timer.async_wait([this](error_code const& ec)
+			{
+				if (ec) return;
+				tick();
+			});
+		}
+
+		void tick()
+		{
+			time_point const now = clock_type::now();
+
+			for (auto& n : m_nodes) handle_alerts(n);
+
+			churn(now);
+			submit(now);
+
+			if (finished())
+			{
+				if (m_settings.mode == workload::get && !m_put_phase_done)
+				{
+					start_get_phase();
+					return;
+				}
+				report(now);
+				return;
+			}
+
+			schedule(milliseconds(100));
+		}
+
+		void churn(time_point const now)
+		{
+			if (m_settings.churn_percent <= 0) return;
+			if (now - m_last_churn < seconds(10)) return;
+			m_last_churn = now;
+
+			// the bootstrap nodes stay up
+			for (std::size_t i = 8; i < m_nodes.size(); ++i)
+			{
+				bench_node& n = m_nodes[i];
+				bool const pause = int(m_rng() % 100) < m_settings.churn_percent;
+				if (pause == n.paused) continue;
+				if (pause) n.ses->pause_service();
+				else n.ses->resume_service();
+				n.paused = pause;
+				++m_churned;
+			}
+		}
+
+		int random_live_node(int const except = -1)
+		{
+			for (;;)
+			{
+				int const i = int(m_rng() % std::uint32_t(m_nodes.size()));
+				if (i != except && !m_nodes[std::size_t(i)].paused) return i;
+			}
+		}
+
+		int in_flight() const { return m_submitted - m_completed; }
+
+		bool getting() const
+		{
+			return m_settings.mode == workload::get && m_put_phase_done;
+		}
+
+		// the operations of the phase, a get for each blob put
+		int phase_ops() const
+		{
+			return getting() ? int(m_put_ops.size()) : m_settings.blobs;
+		}
+
+		void submit(time_point const now)
+		{
+			bool const get = getting();
+			while (in_flight() < m_settings.concurrency && m_submitted < phase_ops())
+			{
+				operation op;
+				op.start = now;
+				api::error_code ec = api::NO_ERROR;
+
+				if (get)
+				{
+					// get the blob put by another node
+					operation const& put = m_put_ops[std::size_t(m_submitted)];
+					op.node = random_live_node(put.node);
+					op.peer = m_nodes[std::size_t(put.node)].pk;
+					op.uri = put.uri;
+					ec = m_nodes[std::size_t(op.node)].ses->get_data_from_swarm(op.peer, op.uri);
+				}
+				else if (m_settings.mode == workload::relay)
+				{
+					op.node = random_live_node();
+					int const to = random_live_node(op.node);
+					op.peer = m_nodes[std::size_t(to)].pk;
+					ec = m_nodes[std::size_t(op.node)].ses->relay_message(op.peer, random_payload());
+				}
+				else
+				{
+					op.node = random_live_node();
+					for (auto& c : op.uri) c = char(m_rng());
+					ec = m_nodes[std::size_t(op.node)].ses->put_data_into_swarm(random_payload(), op.uri);
+				}
+
+				// a call rejected right away posts no alert, the operation
+				// is over and failed
+				if (ec != api::NO_ERROR)
+				{
+					op.done = true;
+					++m_completed;
+					++m_rejected[ec];
+				}
+
+				m_ops.push_back(op);
+				++m_submitted;
+			}
+		}
+
+		std::vector<char> random_payload()
+		{
+			std::vector<char> ret(std::size_t(m_settings.size));
+			for (auto& c : ret) c = char(m_rng());
+			return ret;
+		}
+
+		// completes the oldest operation of ``node`` matching ``match``
+		template <typename Match>
+		void complete(int const node, bool const ok, Match match)
+		{
+			for (auto& op : m_ops)
+			{
+				if (op.done || op.node != node || !match(op)) continue;
+				op.done = true;
+				++m_completed;
+				if (ok)
+				{
+					op.ok = true;
+					++m_succeeded;
+					m_latencies.push_back(clock_type::now() - op.start);
+				}
+				return;
+			}
+		}
+
+		int node_index(lt::session const& ses) const
+		{
+			for (std::size_t i = 0; i < m_nodes.size(); ++i)
+				if (m_nodes[i].ses.get() == &ses) return int(i);
+			return -1;
+		}
+
+		void handle_alerts(bench_node& n)
+		{
+			int const idx = node_index(*n.ses);
+			std::vector<alert*> alerts;
+			n.ses->pop_alerts(&alerts);
+			for (alert* a : alerts)
+			{
+				if (auto const* p = alert_cast<put_data_alert>(a))
+				{
+					complete(idx, p->error == api::NO_ERROR
+						, [&](operation const& op) { return op.uri == p->uri; });
+				}
+				else if (auto const* g = alert_cast<get_data_alert>(a))
+				{
+					complete(idx, g->error == api::NO_ERROR
+						, [&](operation const& op) { return op.uri == g->uri; });
+				}
+				else if (auto const* r = alert_cast<relay_message_alert>(a))
+				{
+					complete(idx, r->error == api::NO_ERROR
+						, [&](operation const& op) { return op.peer == r->receiver; });
+				}
+				else if (auto const* s = alert_cast<session_stats_alert>(a))
+				{
+					auto const c = s->counters();
+					for (std::size_t i = 0; i < m_counters.size(); ++i)
+						m_counters[i] += c[int(i)];
+				}
+			}
+		}
+
+		bool finished() const { return m_completed >= phase_ops(); }
+
+		// the puts were the setup, now measure the gets of the blobs that
+		// were put
+		void start_get_phase()
+		{
+			m_put_phase_done = true;
+			for (auto const& op : m_ops)
+				if (op.ok) m_put_ops.push_back(op);
+			m_ops.clear();
+			m_latencies.clear();
+			m_submitted = m_completed = m_succeeded = 0;
+			m_rejected.clear();
+			start_phase();
+		}
+
+		// the counter since the phase started
+		std::int64_t counter(char const* name) const
+		{
+			int const idx = find_metric_idx(name);
+			if (idx < 0) return 0;
+			return m_counters[std::size_t(idx)] - m_baseline[std::size_t(idx)];
+		}
+
+		void report(time_point const now)
+		{
+			collect_counters([this, now]
+			{
+				print(now);
+				for (auto& n : m_nodes) n.ses.reset();
+			});
+		}
+
+		void print(time_point const now) const
+		{
+			double const secs = double(total_milliseconds(now - m_start)) / 1000.;
+			int const blobs = std::max(m_succeeded, 1);
+
+			std::int64_t const rpcs = counter("transport.transport_get_completed")
+				+ counter("transport.transport_put_completed")
+				+ counter("transport.transport_send_completed");
+			std::int64_t const bytes = counter("dht.dht_bytes_out");
+			std::int64_t const retries = counter("assemble.assemble_put_retries")
+				+ counter("assemble.assemble_get_retries");
+
+			char const* mode = m_settings.mode == workload::put ? "put"
+				: m_settings.mode == workload::get ? "get" : "relay";
+
+			std::printf("workload: %s nodes: %d size: %d concurrency: %d "
+				"latency: %dms loss: %d%% churn: %d%% seed: %u\n"
+				, mode, m_settings.nodes, m_settings.size, m_settings.concurrency
+				, m_settings.latency_ms, m_settings.loss_percent
+				, m_settings.churn_percent, m_settings.seed);
+			std::printf("completed: %d succeeded: %d in %.1fs (simulated)\n"
+				, m_completed, m_succeeded, secs);
+			std::printf("blobs/sec: %.2f\n", secs > 0 ? m_succeeded / secs : 0.);
+			std::printf("latency p50: %" PRId64 "ms p99: %" PRId64 "ms\n"
+				, std::int64_t(total_milliseconds(percentile(m_latencies, 50)))
+				, std::int64_t(total_milliseconds(percentile(m_latencies, 99))));
+			std::printf("rpcs/blob: %.1f bytes/blob: %.0f segment retries: %" PRId64 "\n"
+				, double(rpcs) / blobs, double(bytes) / blobs, retries);
+			std::printf("churn events: %d\n", m_churned);
+			for (auto const& r : m_rejected)
+				std::printf("rejected: %d error: %d\n", r.second, int(r.first));
+		}
+
+	private:
+		sim::simulation& m_sim;
+		bench_settings const& m_settings;
+		std::mt19937 m_rng;
+		sim::asio::high_resolution_timer m_timer;
+
+		std::vector<bench_node> m_nodes;
+		std::vector<operation> m_ops;
+		std::vector<operation> m_put_ops;
+		std::vector<time_duration> m_latencies;
+		std::vector<std::int64_t> m_counters;
+
+		// the counters when the phase started
+		std::vector<std::int64_t> m_baseline;
+
+		time_point m_start;
+		time_point m_last_churn;
+		int m_submitted = 0;
+		int m_completed = 0;
+		int m_succeeded = 0;
+		int m_churned = 0;
+		bool m_put_phase_done = false;
+
+		// the calls rejected without an alert, by error
+		std::map<api::error_code, int> m_rejected;
+	};
+}
+
+int main(int argc, char const* argv[])
+{
+	bench_settings s;
+	if (!parse_args(argc, argv, s))
+	{
+		std::fprintf(stderr, "usage: bench_assemble [-m put|get|relay] [-n nodes] "
+			"[-b blobs] [-s size] [-c concurrency] [-l latency_ms] [-p loss_percent] "
+			"[-r churn_percent] [-S seed]\n");
+		return 1;
+	}
+
+	bench_network cfg(s);
+	sim::simulation sim{cfg};
+
+	bench b(sim, s);
+	b.start();
+	sim.run();
+
+	std::printf("packets dropped: %" PRId64 "\n", cfg.dropped());
+	return 0;
+}
@@ -0,0 +1,266 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+// runs a swarm of sessions over a network with a fixed latency and packet
+// loss, and checks that the DHT rpc timeouts follow the round trip times
+// measured, rather than the fixed defaults.
+//
+// The swarm is made of full sessions, rather than the nodes of dht_network
+// (setup_dht.hpp). Those speak the plain bencoded DHT, while the sessions
+// encrypt their packets, so neither understands the other.
+
+#include "test.hpp"
+
+#include "simulator/simulator.hpp"
+#include "simulator/queue.hpp"
+
+#include "ip2/session.hpp"
+#include "ip2/session_params.hpp"
+#include "ip2/settings_pack.hpp"
+#include "ip2/alert_types.hpp"
+#include "ip2/hex.hpp"
+#include "ip2/time.hpp"
+#include "ip2/kademlia/ed25519.hpp"
+#include "ip2/kademlia/rtt_estimator.hpp"
+
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace lt;
+
+#ifndef TORRENT_DISABLE_DHT
+namespace {
+
+	int const num_nodes = 30;
+	int const num_lookups = 20;
+
+	// drops packets at random, with a deterministic generator
+	struct lossy_link : sim::sink
+	{
+		explicit lossy_link(int const loss_percent)
+			: m_loss(loss_percent), m_rng(1) {}
+
+		void incoming_packet(sim::aux::packet p) override
+		{
+			if (m_loss > 0 && int(m_rng() % 100) < m_loss) return;
+			sim::forward_packet(std::move(p));
+		}
+
+		std::string label() const override { return "lossy link"; }
+
+	private:
+		int const m_loss;
+		std::mt19937 m_rng;
+	};
+
+	// every packet crosses the lossy link and a queue adding the latency,
+	// on top of the default per-host routes
+	struct rtt_network : sim::default_config
+	{
+		rtt_network(int const latency_ms, int const loss_percent)
+			: m_latency_ms(latency_ms)
+			, m_loss(std::make_shared<lossy_link>(loss_percent))
+		{}
+
+		void build(sim::simulation& sim) override
+		{
+			sim::default_config::build(sim);
+			m_latency = std::make_shared<sim::queue>(sim.get_io_context()
+				, 100 * 1000 * 1000
+				, sim::chrono::milliseconds(m_latency_ms)
+				, 1000 * 1000 * 1000, "latency");
+		}
+
+		sim::route channel_route(sim::asio::ip::address src
+			, sim::asio::ip::address dst) override
+		{
+			sim::route ret = sim::default_config::channel_route(src, dst);
+			ret.prepend(m_latency);
+			ret.prepend(m_loss);
+			return ret;
+		}
+
+	private:
+		int const m_latency_ms;
+		std::shared_ptr<lossy_link> m_loss;
+		std::shared_ptr<sim::queue> m_latency;
+	};
+
+	std::string seed_hex(int const node)
+	{
+		std::array<char, 32> s;
+		s.fill(char(node + 1));
+		return aux::to_hex(s);
+	}
+
+	std::array<char, 32> public_key_of(int const node)
+	{
+		std::array<char, 32> s;
+		s.fill(char(node + 1));
+		dht::public_key pk;
+		dht::secret_key sk;
+		std::tie(pk, sk) = dht::ed25519_create_keypair(s);
+		return pk.bytes;
+	}
+
+	// the stats a completed lookup reports are consistent
+	void check_stats(dht_lookup const& l)
+	{
+		TEST_CHECK(l.branch_factor >= 1);
+		TEST_CHECK(l.branch_factor <= default_settings().get_int(settings_pack::dht_max_search_branching));
+		TEST_CHECK(l.rounds > 0);
+		TEST_CHECK(l.rpcs >= l.responses + l.timeouts);
+		TEST_CHECK(l.rpcs >= l.rounds);
+		TEST_CHECK(l.duration >= l.first_response);
+	}
+
+	// runs the swarm over ``cfg``. Once it bootstrapped, the first session
+	// looks up num_lookups random targets, one every 10 seconds. Returns the
+	// get lookups it completed
+	std::vector<dht_lookup> run_lookups(rtt_network& cfg)
+	{
+		sim::simulation sim{cfg};
+
+		std::string bootstrap;
+		std::vector<address> addrs;
+		for (int i = 0; i < num_nodes; ++i)
+		{
+			addrs.push_back(make_address_v4("50.0.0." + std::to_string(i + 1)));
+
+			// the first few nodes are everyone's bootstrap nodes
+			if (i >= 8) continue;
+			if (!bootstrap.empty()) bootstrap += ",";
+			bootstrap += "tau://" + aux::to_hex(public_key_of(i)) + "@"
+				+ addrs.back().to_string() + ":6881";
+		}
+
+		std::vector<std::unique_ptr<sim::asio::io_context>> ios;
+		std::vector<std::shared_ptr<lt::session>> ses;
+		for (int i = 0; i < num_nodes; ++i)
+		{
+			settings_pack pack;
+			pack.set_str(settings_pack::listen_interfaces, addrs[std::size_t(i)].to_string() + ":6881");
+			pack.set_str(settings_pack::account_seed, seed_hex(i));
+			pack.set_str(settings_pack::dht_bootstrap_nodes, bootstrap);
+			pack.set_str(settings_pack::db_dir, "test_dht_rtt_db/" + std::to_string(i));
+			pack.set_bool(settings_pack::enable_dht, true);
+			pack.set_bool(settings_pack::dht_ignore_dark_internet, false);
+			pack.set_bool(settings_pack::dht_restrict_routing_ips, false);
+
+			ios.push_back(std::make_unique<sim::asio::io_context>(sim, addrs[std::size_t(i)]));
+			ses.push_back(std::make_shared<lt::session>(session_params(pack), *ios.back()));
+		}
+
+		std::vector<dht_lookup> ret;
+		std::mt19937 rng(1);
+		int lookups = 0;
+		bool stats_posted = false;
+		sim::asio::high_resolution_timer timer(sim.get_io_context());
+		std::function<void(error_code const&)> on_timer;
+		on_timer = [&](error_code const& ec)
+		{
+			if (ec) return;
+
+			if (lookups < num_lookups)
+			{
+				sha256_hash target;
+				for (auto& c : target) c = std::uint8_t(rng());
+				ses[0]->dht_get_item(target);
+				++lookups;
+				// the last lookup is given time to time out
+				timer.expires_after(lookups == num_lookups ? seconds(20) : seconds(10));
+				timer.async_wait(on_timer);
+				return;
+			}
+
+			if (!stats_posted)
+			{
+				ses[0]->post_dht_stats();
+				stats_posted = true;
+				timer.expires_after(seconds(1));
+				timer.async_wait(on_timer);
+				return;
+			}
+
+			std::vector<alert*> alerts;
+			ses[0]->pop_alerts(&alerts);
+			for (alert* a : alerts)
+			{
+				auto const* s = alert_cast<dht_stats_alert>(a);
+				if (s == nullptr) continue;
+				for (auto const& l : s->completed_requests)
+					if (!std::strcmp(l.type, "get")) ret.push_back(l);
+			}
+			for (auto& s : ses) s.reset();
+		};
+
+		// give the swarm time to bootstrap first
+		timer.expires_after(seconds(30));
+		timer.async_wait(on_timer);
+
+		sim.run();
+		return ret;
+	}
+}
+#endif // TORRENT_DISABLE_DHT
+
+TORRENT_TEST(dht_rtt_loss)
+{
+#ifndef TORRENT_DISABLE_DHT
+	// a fifth of the packets is lost. A request to a node whose round trip
+	// was sampled (100ms) times out after a second, not after the fixed
+	// default of 5
+	rtt_network cfg(50, 20);
+	std::vector<dht_lookup> const lookups = run_lookups(cfg);
+	TEST_EQUAL(int(lookups.size()), num_lookups);
+
+	// a timeout counted before a lookup was 5 seconds old didn't wait for
+	// the default
+	int const default_timeout = int(total_milliseconds(dht::rtt_estimator::default_timeout));
+	int timed_out = 0;
+	int timed_out_early = 0;
+	for (auto const& l : lookups)
+	{
+		check_stats(l);
+		TEST_CHECK(l.responses > 0);
+		if (l.timeouts == 0) continue;
+		++timed_out;
+		if (l.duration < default_timeout) ++timed_out_early;
+	}
+	std::printf("lookups: %d timed out: %d before %dms: %d\n"
+		, int(lookups.size()), timed_out, default_timeout, timed_out_early);
+	TEST_CHECK(timed_out > 0);
+	TEST_CHECK(timed_out_early > 0);
+#endif // TORRENT_DISABLE_DHT
+}
+
+TORRENT_TEST(dht_rtt_latency)
+{
+#ifndef TORRENT_DISABLE_DHT
+	// a round trip takes 1.2 seconds, longer than the short timeout of a node
+	// with no sample. The replies are waited for, none of the requests fails
+	rtt_network cfg(600, 0);
+	std::vector<dht_lookup> const lookups = run_lookups(cfg);
+	TEST_EQUAL(int(lookups.size()), num_lookups);
+
+	for (auto const& l : lookups)
+	{
+		check_stats(l);
+		TEST_CHECK(l.responses > 0);
+		TEST_EQUAL(l.timeouts, 0);
+		TEST_CHECK(l.first_response >= 1200);
+	}
+#endif // TORRENT_DISABLE_DHT
+}
@@ -32,6 +32,7 @@ see LICENSE file.
 #include "ip2/error_code.hpp"
 #include "ip2/performance_counters.hpp"
 #include "ip2/aux_/stack_allocator.hpp"
+#include "ip2/aux_/binary_log.hpp"
 #include "ip2/hex.hpp" // to_hex
 #include "ip2/session_stats.hpp"
 #include "ip2/socket_type.hpp"
@@ -851,9 +852,11 @@ namespace {
 	dht_stats_alert::dht_stats_alert(aux::stack_allocator&
 		, std::vector<dht_routing_bucket> table
 		, std::vector<dht_lookup> requests
+		, std::vector<dht_lookup> completed
 			, sha256_hash id, udp::endpoint ep)
 		: alert()
 		, active_requests(std::move(requests))
+		, completed_requests(std::move(completed))
 		, routing_table(std::move(table))
 		, nid(id)
 		, local_endpoint(ep)
@@ -865,9 +868,10 @@ namespace {
 		return {};
 #else
 		char buf[2048];
-		std::snprintf(buf, sizeof(buf), "DHT stats: (%s) reqs: %d buckets: %d"
+		std::snprintf(buf, sizeof(buf), "DHT stats: (%s) reqs: %d completed: %d buckets: %d"
 			, aux::to_hex(nid).c_str()
 			, int(active_requests.size())
+			, int(completed_requests.size())
 			, int(routing_table.size()));
 		return buf;
 #endif
@@ -899,7 +903,8 @@ namespace {
 			"traversal",
 			"incoming_table",
 			"items_db",
-			"bs_nodes_db"
+			"bs_nodes_db",
+			"relay_mailbox"
 		};
 
 		char ret[900];
@@ -1855,9 +1860,24 @@ namespace {
 			, m_str_idx(alloc.format_string(fmt, v))
 	{}
 
+	transport_log_alert::transport_log_alert(aux::stack_allocator& alloc, char const* fmt
+		, span<char const> record)
+			: m_alloc(alloc)
+			, m_str_idx(alloc.copy_buffer(record))
+			, m_fmt(fmt)
+			, m_record_size(int(record.size()))
+	{}
+
 	char const* transport_log_alert::log_message() const
 	{
-		return m_alloc.get().ptr(m_str_idx);
+		if (m_fmt == nullptr) return m_alloc.get().ptr(m_str_idx);
+
+		if (m_message.empty())
+		{
+			m_message = aux::format_log_record(m_fmt
+				, {m_alloc.get().ptr(m_str_idx), m_record_size});
+		}
+		return m_message.c_str();
 	}
 
 #if TORRENT_ABI_VERSION == 1
@@ -1886,9 +1906,24 @@ namespace {
 			, m_str_idx(alloc.format_string(fmt, v))
 	{}
 
+	assemble_log_alert::assemble_log_alert(aux::stack_allocator& alloc, char const* fmt
+		, span<char const> record)
+			: m_alloc(alloc)
+			, m_str_idx(alloc.copy_buffer(record))
+			, m_fmt(fmt)
+			, m_record_size(int(record.size()))
+	{}
+
 	char const* assemble_log_alert::log_message() const
 	{
-		return m_alloc.get().ptr(m_str_idx);
+		if (m_fmt == nullptr) return m_alloc.get().ptr(m_str_idx);
+
+		if (m_message.empty())
+		{
+			m_message = aux::format_log_record(m_fmt
+				, {m_alloc.get().ptr(m_str_idx), m_record_size});
+		}
+		return m_message.c_str();
 	}
 
 #if TORRENT_ABI_VERSION == 1
@@ -2004,20 +2039,22 @@ namespace {
 		, std::array<char, 32> const& from
 		, std::array<char, 20> const& data_uri
 		, std::int64_t ts
-		, std::vector<char> const& blob
+		, std::shared_ptr<assemble::blob_buffer const> b
 		, api::error_code const ec)
 		: sender(from)
 		, uri(data_uri)
 		, timestamp(ts)
-		, data(blob)
+		, blob(std::move(b))
 		, error(ec)
-	{}
+	{
+		if (blob) data = blob->data();
+	}
 
 	get_data_alert::get_data_alert(aux::stack_allocator& alloc
 		, char const* from
 		, char const* data_uri
 		, std::int64_t ts
-		, char const* blob
+		, char const* blob_data
 		, int blob_len
 		, api::error_code const ec)
 		: timestamp(ts)
@@ -2027,7 +2064,9 @@ namespace {
 		std::copy(data_uri, data_uri + 20, uri.begin());
 		if (blob_len > 0)
 		{
-			std::copy(blob, blob + blob_len, std::back_inserter(data));
+			blob = std::make_shared<assemble::blob_buffer>(
+				span<char const>(blob_data, blob_len));
+			data = blob->data();
 		}
 	}
 
@@ -2044,6 +2083,34 @@ namespace {
 #endif
 	}
 
+	get_data_segment_alert::get_data_segment_alert(aux::stack_allocator&
+		, std::array<char, 32> const& from
+		, std::array<char, 20> const& data_uri
+		, std::int64_t ts
+		, std::shared_ptr<assemble::blob_buffer const> b
+		, std::int64_t off
+		, span<char const> range)
+		: sender(from)
+		, uri(data_uri)
+		, timestamp(ts)
+		, blob(std::move(b))
+		, offset(off)
+		, data(range)
+	{}
+
+	std::string get_data_segment_alert::message() const
+	{
+#ifdef TORRENT_DISABLE_ALERT_MSG
+		return {};
+#else
+		char msg[200];
+		std::snprintf(msg, sizeof(msg), "Get data segment (sender=%s URI=%s ts=%" PRId64 " offset=%" PRId64 " size=%d)"
+			, aux::to_hex(sender).c_str(), aux::to_hex(uri).c_str()
+			, timestamp, offset, (int)data.size());
+		return msg;
+#endif
+	}
+
 	relay_message_alert::relay_message_alert(aux::stack_allocator&
 		, std::array<char, 32> const& msg_receiver
 		, api::error_code const ec)
@@ -2079,13 +2146,10 @@ namespace {
 
 	incoming_relay_message_alert::incoming_relay_message_alert(aux::stack_allocator& alloc
 		, char const* from
-		, std::string const& incoming_msg)
+		, span<char const> incoming_msg)
+		: msg(incoming_msg.begin(), incoming_msg.end())
 	{
 		std::copy(from, from + 32, sender.begin());
-		if (incoming_msg.size() > 0)
-		{
-			std::copy(incoming_msg.begin(), incoming_msg.end(), std::back_inserter(msg));
-		}
 	}
 
 	std::string incoming_relay_message_alert::message() const
@@ -14,54 +14,82 @@ see LICENSE file.
 #include "ip2/aux_/alert_manager.hpp"
 #include "ip2/alert_types.hpp"
 
+#include <thread> // for yield
+
 namespace ip2 {
 namespace aux {
 
 	alert_manager::alert_manager(int const queue_limit, alert_category_t const alert_mask)
 		: m_alert_mask(alert_mask)
-		, m_queue_size_limit(queue_limit)
-	{}
+	{
+		m_lane_limit[main_lane].store(queue_limit);
+		m_lane_limit[log_lane].store(0);
+		for (int gen = 0; gen < 2; ++gen)
+		{
+			m_writers[gen].store(0);
+			m_queued[gen].store(0);
+			m_first[gen].store(nullptr);
+		}
+	}
 
 	alert_manager::~alert_manager() = default;
 
+	alert_manager::producer_section::producer_section(alert_manager& m)
+		: mgr(m)
+	{
+		// get_all() may flip the generation between reading it and
+		// registering with it. It won't wait for us then, so we have to
+		// register with the new one
+		for (;;)
+		{
+			generation = mgr.m_generation.load();
+			mgr.m_writers[generation].fetch_add(1);
+			if (mgr.m_generation.load() == generation) break;
+			mgr.m_writers[generation].fetch_sub(1);
+		}
+	}
+
+	alert_manager::producer_section::~producer_section()
+	{
+		mgr.m_writers[generation].fetch_sub(1);
+	}
+
 	alert* alert_manager::wait_for_alert(time_duration max_wait)
 	{
 		std::unique_lock<std::recursive_mutex> lock(m_mutex);
 
-		if (!m_alerts[m_generation].empty())
-			return m_alerts[m_generation].front();
+		int const gen = m_generation.load();
+		if (m_queued[gen].load(std::memory_order_acquire) > 0)
+			return m_first[gen].load(std::memory_order_acquire);
 
 		// this call can be interrupted prematurely by other signals
 		m_condition.wait_for(lock, max_wait);
-		if (!m_alerts[m_generation].empty())
-			return m_alerts[m_generation].front();
+		if (m_queued[gen].load(std::memory_order_acquire) > 0)
+			return m_first[gen].load(std::memory_order_acquire);
 
 		return nullptr;
 	}
 
-	void alert_manager::maybe_notify(alert* a)
+	void alert_manager::maybe_notify()
 	{
-		if (m_alerts[m_generation].size() == 1)
-		{
-			// we just posted to an empty queue. If anyone is waiting for
-			// alerts, we need to notify them. Also (potentially) call the
-			// user supplied m_notify callback to let the client wake up its
-			// message loop to poll for alerts.
-			if (m_notify) m_notify();
+		std::lock_guard<std::recursive_mutex> lock(m_mutex);
 
-			// TODO: 2 keep a count of the number of threads waiting. Only if it's
-			// > 0 notify them
-			m_condition.notify_all();
-		}
+		// we just posted to an empty queue. If anyone is waiting for
+		// alerts, we need to notify them. Also (potentially) call the
+		// user supplied m_notify callback to let the client wake up its
+		// message loop to poll for alerts.
+		if (m_notify) m_notify();
 
-		TORRENT_UNUSED(a);
+		// TODO: 2 keep a count of the number of threads waiting. Only if it's
+		// > 0 notify them
+		m_condition.notify_all();
 	}
 
 	void alert_manager::set_notify_function(std::function<void()> const& fun)
 	{
 		std::unique_lock<std::recursive_mutex> lock(m_mutex);
 		m_notify = fun;
-		if (!m_alerts[m_generation].empty())
+		if (pending())
 		{
 			if (m_notify) m_notify();
 		}
@@ -71,38 +99,62 @@ namespace aux {
 	{
 		std::lock_guard<std::recursive_mutex> lock(m_mutex);
 
-		if (m_alerts[m_generation].empty())
+		int const gen = m_generation.load();
+		if (m_queued[gen].load(std::memory_order_acquire) == 0)
 		{
 			alerts.clear();
 			return;
 		}
 
-		if (m_dropped.any()) {
-			emplace_alert<alerts_dropped_alert>(m_dropped);
-			m_dropped.reset();
+		// the client is done with the alerts it got the last time, clear
+		// the buffers they're in for the producer to write to next
+		int const next = gen ^ 1;
+		TORRENT_ASSERT(m_writers[next].load() == 0);
+		for (int lane = 0; lane < num_lanes; ++lane)
+		{
+			m_alerts[lane][next].clear();
+			m_allocations[lane][next].reset();
 		}
+		m_dropped[next].reset();
+		m_queued[next].store(0);
+		m_first[next].store(nullptr);
 
-		m_alerts[m_generation].get_pointers(alerts);
+		// swap buffers, and wait for the producer to be done with the ones
+		// we take. It only holds them for the time it takes to post an alert
+		m_generation.store(next);
+		while (m_writers[gen].load() != 0) std::this_thread::yield();
+
+		if (m_dropped[gen].any())
+		{
+			try
+			{
+				m_alerts[main_lane][gen].emplace_back<alerts_dropped_alert>(
+					m_allocations[main_lane][gen], m_dropped[gen]);
+			}
+			catch (std::bad_alloc const&) {}
+		}
 
-		// swap buffers
-		m_generation = (m_generation + 1) & 1;
-		// clear the one we will start writing to now
-		m_alerts[m_generation].clear();
-		m_allocations[m_generation].reset();
+		m_alerts[main_lane][gen].get_pointers(alerts);
+		if (!m_alerts[log_lane][gen].empty())
+		{
+			m_alerts[log_lane][gen].get_pointers(m_log_pointers);
+			alerts.insert(alerts.end(), m_log_pointers.begin(), m_log_pointers.end());
+		}
 	}
 
 	bool alert_manager::pending() const
 	{
-		std::lock_guard<std::recursive_mutex> lock(m_mutex);
-		return !m_alerts[m_generation].empty();
+		return m_queued[m_generation.load()].load(std::memory_order_acquire) > 0;
 	}
 
 	int alert_manager::set_alert_queue_size_limit(int queue_size_limit_)
 	{
-		std::lock_guard<std::recursive_mutex> lock(m_mutex);
+		return m_lane_limit[main_lane].exchange(queue_size_limit_);
+	}
 
-		std::swap(m_queue_size_limit, queue_size_limit_);
-		return queue_size_limit_;
+	int alert_manager::set_log_queue_size_limit(int queue_size_limit_)
+	{
+		return m_lane_limit[log_lane].exchange(queue_size_limit_);
 	}
 }
 }
@@ -25,8 +25,10 @@ assembler::assembler(io_context& ios
 	, m_session(session)
 	, m_settings(settings)
 	, m_counters(cnt)
-	, m_getter(ios, session, settings, cnt, *this)
-	, m_putter(ios, session, settings, cnt, *this)
+	, m_direct(std::make_shared<direct_channel>(ios, session, settings, cnt, *this))
+	, m_cache(settings, *this)
+	, m_getter(ios, session, settings, cnt, *this, *m_direct, m_cache)
+	, m_putter(ios, session, settings, cnt, *this, *m_direct, m_cache)
 	, m_relayer(ios, session, settings, cnt, *this)
 	, m_relay_dispatcher(std::make_shared<relay_dispatcher>(m_getter, m_relayer, *this))
 {
@@ -40,6 +42,7 @@ assembler::assembler(io_context& ios
 assembler::~assembler()
 {
 	m_session.transporter()->unregister_relay_listener(m_relay_dispatcher);
+	m_direct->stop();
 }
 
 void assembler::update_node_id()
@@ -70,6 +73,16 @@ void assembler::log(aux::LOG_LEVEL log_level, char const* fmt, ...) noexcept try
 catch (std::exception const&)
 {}
 
+void assembler::log_record(aux::LOG_LEVEL, char const* fmt
+	, span<char const> record) noexcept try
+{
+#ifndef TORRENT_DISABLE_LOGGING
+	m_session.alerts().emplace_alert<assemble_log_alert>(fmt, record);
+#endif
+}
+catch (std::exception const&)
+{}
+
 void assembler::start()
 {
 	if (m_running) return;
@@ -85,6 +98,8 @@ void assembler::stop()
 
 	m_running = false;
 
+	m_direct->stop();
+
 	log(aux::LOG_NOTICE, "stopping assembler...");
 }
 
@@ -94,9 +109,9 @@ api::error_code assembler::put(span<char const> blob, aux::uri const& blob_uri)
 }
 
 api::error_code assembler::get(dht::public_key const& sender
-	, aux::uri data_uri, dht::timestamp ts)
+	, aux::uri data_uri, dht::timestamp ts, blob_handler handler)
 {
-	return m_getter.get_blob(sender, data_uri, ts);
+	return m_getter.get_blob(sender, data_uri, ts, std::move(handler));
 }
 
 api::error_code assembler::relay_message(dht::public_key const& receiver
@@ -111,5 +126,16 @@ api::error_code assembler::relay_uri(dht::public_key const& receiver
 	return m_relayer.relay_uri(receiver, data_uri, ts);
 }
 
+void assembler::on_incoming_direct(std::unique_ptr<aux::utp_stream> s)
+{
+	if (!m_running) return;
+	m_direct->incoming(std::move(s));
+}
+
+void assembler::open_segment_cache(std::string dir)
+{
+	m_cache.open(std::move(dir));
+}
+
 } // namespace assemble
 } // namespace ip2
@@ -0,0 +1,84 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "ip2/assemble/blob_buffer.hpp"
+#include "ip2/assert.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace ip2 {
+namespace assemble {
+
+blob_buffer::blob_buffer(int num_segments, int segment_size)
+	: m_buffer(std::size_t(num_segments) * std::size_t(segment_size))
+	, m_written(num_segments, false)
+	, m_num_segments(num_segments)
+	, m_segment_size(segment_size)
+{
+	TORRENT_ASSERT(num_segments > 0);
+	TORRENT_ASSERT(segment_size > 0);
+}
+
+blob_buffer::blob_buffer(span<char const> content)
+	: m_buffer(content.begin(), content.end())
+	, m_written(1, true)
+	, m_num_segments(1)
+	, m_segment_size(std::max(int(content.size()), 1))
+	, m_contiguous(1)
+	, m_last_segment_size(int(content.size()))
+{}
+
+bool blob_buffer::write_segment(int const index, span<char const> seg)
+{
+	if (index < 0 || index >= m_num_segments) return false;
+
+	bool const last = index == m_num_segments - 1;
+	int const len = int(seg.size());
+
+	// all segments but the last one are full
+	if (len <= 0 || len > m_segment_size) return false;
+	if (!last && len != m_segment_size) return false;
+
+	if (m_written.get_bit(index)) return true;
+
+	std::memcpy(m_buffer.data() + std::size_t(index) * std::size_t(m_segment_size)
+		, seg.data(), std::size_t(len));
+
+	if (last) m_last_segment_size.store(len, std::memory_order_relaxed);
+
+	m_written.set_bit(index);
+
+	// only the network thread writes, so a plain load is fine here. The
+	// store publishes the bytes copied above to readers of data()
+	int contiguous = m_contiguous.load(std::memory_order_relaxed);
+	while (contiguous < m_num_segments && m_written.get_bit(contiguous))
+		++contiguous;
+	m_contiguous.store(contiguous, std::memory_order_release);
+
+	return true;
+}
+
+span<char const> blob_buffer::data() const
+{
+	int const contiguous = m_contiguous.load(std::memory_order_acquire);
+	std::size_t len = std::size_t(contiguous) * std::size_t(m_segment_size);
+
+	if (contiguous == m_num_segments)
+	{
+		// ordered by the acquire above
+		int const last_size = m_last_segment_size.load(std::memory_order_relaxed);
+		len -= std::size_t(m_segment_size - last_size);
+	}
+
+	return {m_buffer.data(), std::ptrdiff_t(len)};
+}
+
+} // namespace assemble
+} // namespace ip2
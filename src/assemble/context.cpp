@@ -9,6 +9,8 @@ see LICENSE file.
 
 #include "ip2/assemble/context.hpp"
 
+#include "ip2/aux_/time.hpp"
+
 namespace ip2 {
 namespace assemble {
 
@@ -16,7 +18,16 @@ namespace {
 	static std::uint32_t s_context_id = 0;
 }
 
-context::context() : m_id(s_context_id++), m_error(api::NO_ERROR) {}
+context::context()
+	: m_id(s_context_id++)
+	, m_error(api::NO_ERROR)
+	, m_start_time(aux::time_now())
+{}
+
+time_duration context::elapsed() const
+{
+	return aux::time_now() - m_start_time;
+}
 
 void context::done() {}
 
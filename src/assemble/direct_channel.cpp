@@ -0,0 +1,450 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "ip2/assemble/direct_channel.hpp"
+#include "ip2/assemble/protocol.hpp"
+
+#include "ip2/aux_/session_interface.hpp"
+#include "ip2/aux_/session_settings.hpp"
+#include "ip2/aux_/utp_stream.hpp"
+#include "ip2/aux_/deadline_timer.hpp"
+#include "ip2/aux_/io.hpp"
+#include "ip2/aux_/socket_io.hpp" // for print_endpoint
+#include "ip2/assert.hpp"
+#include "ip2/error_code.hpp"
+#include "ip2/performance_counters.hpp"
+
+#include <cstring>
+
+namespace ip2 {
+
+namespace assemble {
+
+namespace {
+
+	char const request_magic[4] = {'I', 'P', '2', 'D'};
+	int const request_header_size = 6;
+
+	// a blob has far fewer segments than this
+	int const max_request_segments = 256;
+
+	// incoming streams served at the same time
+	int const max_served_connections = 32;
+}
+
+struct direct_channel::connection
+	: std::enable_shared_from_this<connection>
+{
+	connection(io_context& ios, std::unique_ptr<aux::utp_stream> s, bool out)
+		: stream(std::move(s)), timer(ios), outgoing(out)
+	{}
+
+	// read exactly ``size`` bytes into ``buffer``
+	void read(int const size, std::function<void(error_code const&)> h)
+	{
+		buffer.resize(std::size_t(size));
+		transferred = 0;
+		handler = std::move(h);
+		do_read();
+	}
+
+	// write all of ``buffer``
+	void write(std::function<void(error_code const&)> h)
+	{
+		transferred = 0;
+		handler = std::move(h);
+		do_write();
+	}
+
+	std::unique_ptr<aux::utp_stream> stream;
+	aux::deadline_timer timer;
+	bool const outgoing;
+	bool closed = false;
+	udp::endpoint remote;
+
+	std::vector<char> buffer;
+
+	// fetching only. The segments requested, the ones got, and the next one
+	// the response is expected for
+	std::vector<sha1_hash> hashes;
+	std::vector<bool> got;
+	std::size_t next = 0;
+	segment_handler on_segment;
+	done_handler on_done;
+
+private:
+
+	void do_read()
+	{
+		stream->async_read_some(boost::asio::buffer(buffer.data() + transferred
+			, buffer.size() - transferred)
+			, [self = shared_from_this()](error_code const& ec, std::size_t const n)
+			{ self->on_transferred(ec, n, false); });
+	}
+
+	void do_write()
+	{
+		stream->async_write_some(boost::asio::buffer(buffer.data() + transferred
+			, buffer.size() - transferred)
+			, [self = shared_from_this()](error_code const& ec, std::size_t const n)
+			{ self->on_transferred(ec, n, true); });
+	}
+
+	void on_transferred(error_code const& ec, std::size_t const n, bool const writing)
+	{
+		transferred += n;
+		if (!ec && transferred < buffer.size())
+		{
+			if (writing) do_write();
+			else do_read();
+			return;
+		}
+
+		auto h = std::move(handler);
+		handler = nullptr;
+		if (h) h(ec);
+	}
+
+	std::size_t transferred = 0;
+	std::function<void(error_code const&)> handler;
+};
+
+direct_channel::direct_channel(io_context& ios
+	, aux::session_interface& session
+	, aux::session_settings const& settings
+	, counters& cnt
+	, assemble_logger& logger)
+	: m_ios(ios)
+	, m_session(session)
+	, m_settings(settings)
+	, m_counters(cnt)
+	, m_logger(logger)
+{}
+
+direct_channel::~direct_channel()
+{
+	stop();
+}
+
+void direct_channel::serve(span<char const> blob, span<sha1_hash const> hashes)
+{
+	int const cache_size = m_settings.get_int(settings_pack::direct_transfer_cache_size);
+	if (!m_settings.get_bool(settings_pack::enable_direct_transfer)
+		|| blob.empty() || blob.size() > cache_size)
+	{
+		return;
+	}
+
+	TORRENT_ASSERT(hashes.size()
+		== (blob.size() + protocol::blob_seg_mtu - 1) / protocol::blob_seg_mtu);
+
+	auto b = std::make_shared<cached_blob>();
+	b->data.assign(blob.begin(), blob.end());
+	b->hashes.assign(hashes.begin(), hashes.end());
+
+	int offset = 0;
+	for (auto const& h : b->hashes)
+	{
+		int const size = std::min(protocol::blob_seg_mtu, int(b->data.size()) - offset);
+		m_segments[h] = segment_ref{b.get(), offset, size};
+		offset += size;
+	}
+
+	m_cache_size += std::int64_t(b->data.size());
+	m_blobs.push_back(std::move(b));
+
+	// drop the oldest blobs. A segment shared with a newer blob points to
+	// the newer one, and is kept
+	while (m_cache_size > cache_size && !m_blobs.empty())
+	{
+		cached_blob const& front = *m_blobs.front();
+		for (auto const& h : front.hashes)
+		{
+			auto const it = m_segments.find(h);
+			if (it != m_segments.end() && it->second.blob == &front)
+				m_segments.erase(it);
+		}
+		m_cache_size -= std::int64_t(front.data.size());
+		m_blobs.pop_front();
+	}
+}
+
+span<char const> direct_channel::find_segment(sha1_hash const& h) const
+{
+	auto const it = m_segments.find(h);
+	if (it == m_segments.end()) return {};
+
+	segment_ref const& s = it->second;
+	return {s.blob->data.data() + s.offset, s.size};
+}
+
+void direct_channel::incoming(std::unique_ptr<aux::utp_stream> s)
+{
+	if (!m_settings.get_bool(settings_pack::enable_direct_transfer)
+		|| int(m_connections.size()) >= max_served_connections)
+	{
+		return;
+	}
+
+	auto c = std::make_shared<connection>(m_ios, std::move(s), false);
+	error_code ec;
+	tcp::endpoint const ep = c->stream->remote_endpoint(ec);
+	c->remote = udp::endpoint(ep.address(), ep.port());
+	m_connections.insert(c);
+
+#ifndef TORRENT_DISABLE_LOGGING
+	m_logger.log_lazy(aux::LOG_INFO, "direct stream from %s"
+		, aux::print_endpoint(c->remote).c_str());
+#endif
+
+	std::weak_ptr<direct_channel> self = shared_from_this();
+	c->timer.expires_after(seconds(m_settings.get_int(settings_pack::direct_transfer_timeout)));
+	c->timer.async_wait([self, c](error_code const& e)
+	{
+		auto ch = self.lock();
+		if (e || !ch) return;
+		ch->close(c, errors::timed_out);
+	});
+
+	c->read(request_header_size, [self, c](error_code const& e)
+	{
+		auto ch = self.lock();
+		if (!ch) return;
+		if (e) { ch->close(c, e); return; }
+
+		span<char const> header = c->buffer;
+		if (std::memcmp(header.data(), request_magic, sizeof(request_magic)) != 0)
+		{
+			ch->close(c, errors::invalid_request);
+			return;
+		}
+		header = header.subspan(sizeof(request_magic));
+		int const count = aux::read_uint16(header);
+		if (count == 0 || count > max_request_segments)
+		{
+			ch->close(c, errors::invalid_request);
+			return;
+		}
+
+		c->read(count * 20, [self, c](error_code const& e2)
+		{
+			auto ch2 = self.lock();
+			if (!ch2) return;
+			if (e2) { ch2->close(c, e2); return; }
+			ch2->serve_request(c);
+		});
+	});
+}
+
+void direct_channel::serve_request(std::shared_ptr<connection> c)
+{
+	int const count = int(c->buffer.size() / 20);
+	std::vector<sha1_hash> hashes;
+	hashes.reserve(std::size_t(count));
+	for (int i = 0; i < count; ++i)
+		hashes.emplace_back(c->buffer.data() + i * 20);
+
+	int served = 0;
+	std::vector<char>& out = c->buffer;
+	out.clear();
+	for (auto const& h : hashes)
+	{
+		span<char const> const seg = find_segment(h);
+		out.push_back(char((seg.size() >> 8) & 0xff));
+		out.push_back(char(seg.size() & 0xff));
+		out.insert(out.end(), seg.begin(), seg.end());
+		if (!seg.empty()) ++served;
+	}
+
+	m_counters.inc_stats_counter(counters::assemble_direct_served, served);
+
+#ifndef TORRENT_DISABLE_LOGGING
+	m_logger.log_lazy(aux::LOG_INFO, "serving %d of %d segments directly to %s"
+		, served, count, aux::print_endpoint(c->remote).c_str());
+#endif
+
+	std::weak_ptr<direct_channel> self = shared_from_this();
+	c->write([self, c](error_code const& e)
+	{
+		auto ch = self.lock();
+		if (!ch) return;
+		if (e) { ch->close(c, e); return; }
+
+		// the getter closes the stream once it has read the response
+		c->read(1, [self, c](error_code const& e2)
+		{
+			auto ch2 = self.lock();
+			if (!ch2) return;
+			ch2->close(c, e2);
+		});
+	});
+}
+
+bool direct_channel::fetch(udp::endpoint const& ep, std::vector<sha1_hash> hashes
+	, segment_handler on_segment, done_handler on_done)
+{
+	if (!m_settings.get_bool(settings_pack::enable_direct_transfer)
+		|| hashes.empty() || int(hashes.size()) > max_request_segments)
+	{
+		return false;
+	}
+
+	std::unique_ptr<aux::utp_stream> s = m_session.open_direct_stream(ep);
+	if (!s) return false;
+
+	auto c = std::make_shared<connection>(m_ios, std::move(s), true);
+	c->remote = ep;
+	c->got.resize(hashes.size(), false);
+	c->hashes = std::move(hashes);
+	c->on_segment = std::move(on_segment);
+	c->on_done = std::move(on_done);
+	m_connections.insert(c);
+
+	m_counters.inc_stats_counter(counters::assemble_direct_gets);
+
+#ifndef TORRENT_DISABLE_LOGGING
+	m_logger.log_lazy(aux::LOG_INFO, "fetching %d segments directly from %s"
+		, int(c->hashes.size()), aux::print_endpoint(ep).c_str());
+#endif
+
+	std::weak_ptr<direct_channel> self = shared_from_this();
+	c->timer.expires_after(seconds(m_settings.get_int(settings_pack::direct_transfer_timeout)));
+	c->timer.async_wait([self, c](error_code const& e)
+	{
+		auto ch = self.lock();
+		if (e || !ch) return;
+		ch->close(c, errors::timed_out);
+	});
+
+	c->stream->async_connect(tcp::endpoint(ep.address(), ep.port())
+		, [self, c](error_code const& e)
+	{
+		auto ch = self.lock();
+		if (!ch) return;
+		if (e) { ch->close(c, e); return; }
+
+		std::vector<char>& req = c->buffer;
+		req.resize(std::size_t(request_header_size) + c->hashes.size() * 20);
+		std::memcpy(req.data(), request_magic, sizeof(request_magic));
+		span<char> count(req.data() + sizeof(request_magic), 2);
+		aux::write_uint16(c->hashes.size(), count);
+		char* ptr = req.data() + request_header_size;
+		for (auto const& h : c->hashes)
+		{
+			std::memcpy(ptr, h.data(), 20);
+			ptr += 20;
+		}
+
+		c->write([self, c](error_code const& e2)
+		{
+			auto ch2 = self.lock();
+			if (!ch2) return;
+			if (e2) { ch2->close(c, e2); return; }
+			ch2->read_response(c);
+		});
+	});
+
+	return true;
+}
+
+void direct_channel::read_response(std::shared_ptr<connection> c)
+{
+	if (c->next == c->hashes.size())
+	{
+		close(c, error_code());
+		return;
+	}
+
+	std::weak_ptr<direct_channel> self = shared_from_this();
+	c->read(2, [self, c](error_code const& e)
+	{
+		auto ch = self.lock();
+		if (!ch) return;
+		if (e) { ch->close(c, e); return; }
+
+		span<char const> len_buf = c->buffer;
+		int const len = aux::read_uint16(len_buf);
+		if (len == 0)
+		{
+			// the sender doesn't have this segment
+			++c->next;
+			ch->read_response(c);
+			return;
+		}
+
+		if (len > protocol::blob_seg_mtu)
+		{
+			ch->close(c, errors::invalid_piece_size);
+			return;
+		}
+
+		c->read(len, [self, c](error_code const& e2)
+		{
+			auto ch2 = self.lock();
+			if (!ch2) return;
+			if (e2) { ch2->close(c, e2); return; }
+
+			std::size_t const i = c->next++;
+			if (!c->on_segment(c->hashes[i], c->buffer))
+			{
+				ch2->close(c, errors::invalid_piece);
+				return;
+			}
+			c->got[i] = true;
+			ch2->m_counters.inc_stats_counter(counters::assemble_direct_segments);
+			ch2->read_response(c);
+		});
+	});
+}
+
+void direct_channel::close(std::shared_ptr<connection> c, error_code const& ec)
+{
+	if (c->closed) return;
+	c->closed = true;
+
+	c->timer.cancel();
+	c->stream->close();
+	m_connections.erase(c);
+
+#ifndef TORRENT_DISABLE_LOGGING
+	m_logger.log_lazy(aux::LOG_INFO, "direct stream %s %s closed: %s"
+		, c->outgoing ? "to" : "from", aux::print_endpoint(c->remote).c_str()
+		, ec ? ec.message().c_str() : "done");
+#else
+	TORRENT_UNUSED(ec);
+#endif
+
+	if (!c->outgoing || !c->on_done) return;
+
+	std::vector<sha1_hash> missing;
+	for (std::size_t i = 0; i < c->hashes.size(); ++i)
+	{
+		if (!c->got[i]) missing.push_back(c->hashes[i]);
+	}
+
+	auto on_done = std::move(c->on_done);
+	c->on_done = nullptr;
+	on_done(std::move(missing));
+}
+
+void direct_channel::stop()
+{
+	// the owners of fetches are being stopped too, their handlers are not
+	// called
+	for (auto const& c : m_connections)
+	{
+		c->closed = true;
+		c->timer.cancel();
+		c->stream->close();
+	}
+	m_connections.clear();
+}
+
+} // namespace assemble
+} // namespace ip2
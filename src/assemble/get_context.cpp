@@ -10,11 +10,7 @@ see LICENSE file.
 #include "ip2/assemble/get_context.hpp"
 #include "ip2/assemble/protocol.hpp"
 
-#ifndef TORRENT_DISABLE_LOGGING
-#include <ip2/hex.hpp> // to_hex
-#endif
-
-using namespace ip2::assemble::protocol;
+#include <ip2/hasher.hpp>
 
 namespace ip2 {
 namespace assemble {
@@ -30,11 +26,6 @@ get_context::get_context(assemble_logger& logger, dht::public_key const& sender
 
 void get_context::start_getting_hash(sha1_hash const& h, bool is_seg)
 {
-#ifndef TORRENT_DISABLE_LOGGING
-	char hex_hash[41];
-	aux::to_hex(h, hex_hash);
-#endif
-
 	m_flying_segments.insert(h);
 
 	auto it = m_invoked_hashes.find(h);
@@ -46,15 +37,15 @@ void get_context::start_getting_hash(sha1_hash const& h, bool is_seg)
 		if (is_seg)
 		{
 #ifndef TORRENT_DISABLE_LOGGING
-			m_logger.log(aux::LOG_INFO, "[%u] get segment:%s, times:%d"
-				, id(), hex_hash, 1);
+			m_logger.log_lazy(aux::LOG_INFO, "[%u] get segment:%s, times:%d"
+				, id(), aux::hex_arg(h), 1);
 #endif
 		}
 		else
 		{
 #ifndef TORRENT_DISABLE_LOGGING
-			m_logger.log(aux::LOG_INFO, "[%u] get index:%s, times:%d"
-				, id(), hex_hash, 1);
+			m_logger.log_lazy(aux::LOG_INFO, "[%u] get index:%s, times:%d"
+				, id(), aux::hex_arg(h), 1);
 #endif
 		}
 
@@ -66,26 +57,21 @@ void get_context::start_getting_hash(sha1_hash const& h, bool is_seg)
 	if (is_seg)
 	{
 #ifndef TORRENT_DISABLE_LOGGING
-		m_logger.log(aux::LOG_INFO, "[%u] get segment:%s, times:%d"
-			, id(), hex_hash, it->second);
+		m_logger.log_lazy(aux::LOG_INFO, "[%u] get segment:%s, times:%d"
+			, id(), aux::hex_arg(h), it->second);
 #endif
 	}
 	else
 	{
 #ifndef TORRENT_DISABLE_LOGGING
-		m_logger.log(aux::LOG_INFO, "[%u] get index:%s, times:%d"
-			, id(), hex_hash, it->second);
+		m_logger.log_lazy(aux::LOG_INFO, "[%u] get index:%s, times:%d"
+			, id(), aux::hex_arg(h), it->second);
 #endif
 	}
 }
 
 bool get_context::is_getting_allowed(sha1_hash const& h)
 {
-#ifndef TORRENT_DISABLE_LOGGING
-	char hex_hash[41];
-	aux::to_hex(h, hex_hash);
-#endif
-
 	auto it = m_invoked_hashes.find(h);
 
 	if (it == m_invoked_hashes.end())
@@ -96,8 +82,8 @@ bool get_context::is_getting_allowed(sha1_hash const& h)
     int times = it->second;
 
 #ifndef TORRENT_DISABLE_LOGGING 
-	m_logger.log(aux::LOG_INFO, "[%u] allowed getting:%s, times:%d"
-		, id(), hex_hash, times);
+	m_logger.log_lazy(aux::LOG_INFO, "[%u] allowed getting:%s, times:%d"
+		, id(), aux::hex_arg(h), times);
 #endif
 
 	return times < reget_times_limit;
@@ -105,104 +91,120 @@ bool get_context::is_getting_allowed(sha1_hash const& h)
 
 api::error_code get_context::on_root_index_got(dht::item const& it)
 {
-#ifndef TORRENT_DISABLE_LOGGING
-	char hex_uri[41];
-	aux::to_hex(m_uri_hash, hex_uri);
-#endif
-
-	entry const& proto = it.value();
-	std::shared_ptr<protocol::basic_protocol> bp;
-	api::error_code err;
-	std::tie(bp, err) = protocol::construct_protocol(proto, m_logger);
+	protocol::blob_index_schema::view index;
+	api::error_code const err
+		= protocol::decode<protocol::blob_index_schema>(it.value(), index);
 	if (err != api::NO_ERROR)
 	{
 #ifndef TORRENT_DISABLE_LOGGING
-		m_logger.log(aux::LOG_ERR, "[%u] parse index[%s] error: %d"
-			, id(), hex_uri, err);
+		m_logger.log_lazy(aux::LOG_ERR, "[%u] parse index[%s] error: %d"
+			, id(), aux::hex_arg(m_uri_hash), err);
 #endif
 
 		return err;
 	}
 
-	if (bp->get_name() != protocol::blob_index_protocol::name)
+	m_root_index.clear();
+	m_root_index.reserve(std::size_t(index.count()));
+	for (int i = 0; i < index.count(); ++i)
 	{
-#ifndef TORRENT_DISABLE_LOGGING
-		m_logger.log(aux::LOG_ERR, "[%u] parse index error:%s, name:%s"
-			, id(), hex_uri, bp->get_name().c_str());
-#endif
-
-		return api::ASSEMBLE_NAME_ERROR;
+		m_root_index.push_back(index.hash(i));
 	}
 
-	std::shared_ptr<protocol::blob_index_protocol> index_proto
-		= std::dynamic_pointer_cast<protocol::blob_index_protocol>(bp);
-	index_proto->seg_hashes(m_root_index);
+	if (m_root_index.empty()) return api::NO_ERROR;
+
+	m_blob = std::make_shared<blob_buffer>(int(m_root_index.size())
+		, protocol::blob_seg_mtu);
+	m_segment_positions.clear();
+	for (int i = 0; i < int(m_root_index.size()); ++i)
+	{
+		m_segment_positions[m_root_index[std::size_t(i)]].push_back(i);
+	}
 
 	return api::NO_ERROR;
 }
 
 api::error_code get_context::on_segment_got(dht::item const& it
-	, sha1_hash const& seg_hash)
+	, sha1_hash const& seg_hash, span<char const>& value)
 {
-#ifndef TORRENT_DISABLE_LOGGING
-	char hex_hash[41];
-	aux::to_hex(seg_hash, hex_hash);
-#endif
-
-	entry const& proto = it.value();
-	std::shared_ptr<protocol::basic_protocol> bp;
-	api::error_code err;
-	std::tie(bp, err) = protocol::construct_protocol(proto, m_logger);
+	protocol::blob_seg_schema::view seg;
+	api::error_code const err
+		= protocol::decode<protocol::blob_seg_schema>(it.value(), seg);
 	if (err != api::NO_ERROR)
 	{
 #ifndef TORRENT_DISABLE_LOGGING 
-		m_logger.log(aux::LOG_ERR, "[%u] parse segment[%s] error:%d"
-			, id(), hex_hash, err);
+		m_logger.log_lazy(aux::LOG_ERR, "[%u] parse segment[%s] error:%d"
+			, id(), aux::hex_arg(seg_hash), err);
 #endif
 
 		return err;
 	}
 
-	if (bp->get_name() != protocol::blob_seg_protocol::name)
+	value = seg.value;
+
+#ifndef TORRENT_DISABLE_LOGGING
+	m_logger.log_lazy(aux::LOG_INFO, "[%u] blob seg[%s] got with the size:%d"
+		, id(), aux::hex_arg(seg_hash), (int)value.size());
+#endif
+
+	return on_segment_value(value, seg_hash);
+}
+
+api::error_code get_context::on_segment_value(span<char const> value
+	, sha1_hash const& seg_hash)
+{
+	// the segment is addressed by the hash of its content, make sure
+	// it's not corrupt before it's exposed to the client.
+	if (hasher(value).final() != seg_hash)
 	{
-#ifndef TORRENT_DISABLE_LOGGING 
-		m_logger.log(aux::LOG_ERR, "[%u] parse segment error:%s, name:%s"
-			, id(), hex_hash, bp->get_name().c_str());
+#ifndef TORRENT_DISABLE_LOGGING
+		m_logger.log_lazy(aux::LOG_ERR, "[%u] segment[%s] hash mismatch"
+			, id(), aux::hex_arg(seg_hash));
 #endif
 
-		return api::ASSEMBLE_NAME_ERROR;
+		return api::ASSEMBLE_PROTOCOL_FORMAT_ERROR;
 	}
 
-	std::shared_ptr<protocol::blob_seg_protocol> seg_proto
-		= std::dynamic_pointer_cast<protocol::blob_seg_protocol>(bp);
-	std::string value = seg_proto->seg_value();
+	auto const pos = m_segment_positions.find(seg_hash);
+	if (!m_blob || pos == m_segment_positions.end())
+	{
+		return api::ASSEMBLE_PROTOCOL_FORMAT_ERROR;
+	}
 
+	for (int const i : pos->second)
+	{
+		if (!m_blob->write_segment(i, value))
+		{
 #ifndef TORRENT_DISABLE_LOGGING
-	m_logger.log(aux::LOG_INFO, "[%u] blob seg[%s] got with the size:%d"
-		, id(), hex_hash, (int)value.size());
+			m_logger.log_lazy(aux::LOG_ERR, "[%u] segment[%s] invalid size:%d at:%d"
+				, id(), aux::hex_arg(seg_hash), (int)value.size(), i);
 #endif
-	m_segments_total_size += value.size();
 
-	m_segments.insert(std::pair<sha1_hash, std::string>(seg_hash, std::move(value)));
+			return api::ASSEMBLE_PROTOCOL_FORMAT_ERROR;
+		}
+	}
 
 	return api::NO_ERROR;
 }
 
-bool get_context::get_segments_blob(std::vector<char>& value)
+std::shared_ptr<blob_buffer const> get_context::get_blob() const
 {
 	// ignore broken blob
-	if (m_root_index.size() != m_segments.size()) return false;
+	if (!m_blob || !m_blob->is_complete()) return {};
 
-	//value.reserve(m_segments_total_size);
+	return m_blob;
+}
 
-	for (auto& i : m_root_index)
-	{
-		auto it = m_segments.find(i);
-		if (it == m_segments.end()) return false;
+bool get_context::next_stream_range(std::int64_t& offset, span<char const>& range)
+{
+	if (!m_blob) return false;
 
-		//value.append(it->second, it->second.size());
-		std::copy(it->second.begin(), it->second.end(), std::back_inserter(value));
-	}
+	int const contiguous = m_blob->contiguous_segments();
+	if (contiguous <= m_streamed_segments) return false;
+
+	offset = std::int64_t(m_streamed_segments) * m_blob->segment_size();
+	range = m_blob->data().subspan(std::ptrdiff_t(offset));
+	m_streamed_segments = contiguous;
 
 	return true;
 }
@@ -210,17 +212,12 @@ bool get_context::get_segments_blob(std::vector<char>& value)
 void get_context::done()
 {
 #ifndef TORRENT_DISABLE_LOGGING
-	char hex_sender[65];
-	char hex_uri[41];
-	aux::to_hex(m_sender.bytes, hex_sender);
-	aux::to_hex(m_uri.bytes, hex_uri);
-
-	m_logger.log(aux::LOG_INFO
+	m_logger.log_lazy(aux::LOG_INFO
 		, "[%u] get DONE: sender: %s, uri:%s, err:%d, invoked:%d, index:%d, value size:%d"
-		, id(), hex_sender, hex_uri, get_error()
+		, id(), aux::hex_arg(m_sender.bytes), aux::hex_arg(m_uri.bytes), get_error()
 		, (int)m_invoked_hashes.size()
 		, (int)m_root_index.size()
-		, (int)m_segments.size());
+		, m_blob ? m_blob->size() : 0);
 #endif
 }
 
@@ -11,33 +11,48 @@ see LICENSE file.
 
 #include "ip2/aux_/session_interface.hpp"
 #include "ip2/aux_/alert_manager.hpp" // for alert_manager
+#include "ip2/aux_/latency_histogram.hpp"
 
 #include "ip2/kademlia/node_id.hpp"
 
-#ifndef TORRENT_DISABLE_LOGGING
-#include "ip2/hex.hpp" // to_hex
-#endif
+#include "ip2/performance_counters.hpp"
+#include "ip2/aux_/socket_io.hpp" // for print_endpoint
 
 #include <ip2/time.hpp>
 #include <ip2/aux_/time.hpp>
 #include <ip2/api/dht_rpc_params.hpp>
 
+#include <algorithm>
+
 using namespace std::placeholders;
 
 namespace ip2 {
 
 namespace assemble {
 
+namespace {
+
+	// the senders whose direct endpoints are remembered
+	constexpr std::size_t max_direct_hints = 1000;
+
+	// how long a direct endpoint is used after the sender told it
+	constexpr auto direct_hint_lifetime = minutes(10);
+}
+
 getter::getter(io_context& ios
 	, aux::session_interface& session
 	, aux::session_settings const& settings
 	, counters& cnt
-	, assemble_logger& logger)
+	, assemble_logger& logger
+	, direct_channel& direct
+	, segment_cache& cache)
 	: m_ios(ios)
 	, m_session(session)
 	, m_settings(settings)
 	, m_counters(cnt)
 	, m_logger(logger)
+	, m_direct(direct)
+	, m_cache(cache)
 {
 	update_node_id();
 }
@@ -49,21 +64,15 @@ void getter::update_node_id()
 }
 
 api::error_code getter::get_blob(dht::public_key const& sender
-	, aux::uri blob_uri, dht::timestamp ts)
+	, aux::uri blob_uri, dht::timestamp ts, blob_handler handler)
 {
-#ifndef TORRENT_DISABLE_LOGGING
-	char hex_sender[65];
-	char hex_uri[41];
-	aux::to_hex(sender.bytes, hex_sender);
-	aux::to_hex(blob_uri.bytes, hex_uri);
-#endif
-
 	// check network, if dht live nodes is 0, return error.
 	if (m_session.dht_nodes() == 0)
 	{
 #ifndef TORRENT_DISABLE_LOGGING
-		m_logger.log(aux::LOG_ERR
-			, "drop get req:%s/%s, error: dht nodes 0", hex_sender, hex_uri);
+		m_logger.log_lazy(aux::LOG_ERR
+			, "drop get req:%s/%s, error: dht nodes 0"
+			, aux::hex_arg(sender.bytes), aux::hex_arg(blob_uri.bytes));
 #endif
 
 		return api::DHT_LIVE_NODES_ZERO;
@@ -71,11 +80,12 @@ api::error_code getter::get_blob(dht::public_key const& sender
 
 	// check transport queue cache size.
 	// if transport queue doesn't have enough queue, return error.
-	if (!m_session.transporter()->has_enough_buffer(1))
+	if (!m_session.transporter()->has_enough_buffer(1, transport::BLOB_GET_CLASS))
 	{
 #ifndef TORRENT_DISABLE_LOGGING
-		m_logger.log(aux::LOG_ERR
-			, "drop get req:%s/%s, error: buffer is full", hex_sender, hex_uri);
+		m_logger.log_lazy(aux::LOG_ERR
+			, "drop get req:%s/%s, error: buffer is full"
+			, aux::hex_arg(sender.bytes), aux::hex_arg(blob_uri.bytes));
 #endif
 
 		return api::TRANSPORT_BUFFER_FULL;
@@ -83,6 +93,16 @@ api::error_code getter::get_blob(dht::public_key const& sender
 
 	std::shared_ptr<get_context> ctx = std::make_shared<get_context>(
 		m_logger, sender, blob_uri, ts);
+	ctx->set_handler(std::move(handler));
+
+	auto const hint = m_direct_hints.find(sender);
+	if (hint != m_direct_hints.end())
+	{
+		if (hint->second.expires > aux::time_now())
+			ctx->set_direct_endpoint(hint->second.ep);
+		else
+			m_direct_hints.erase(hint);
+	}
 	api::dht_rpc_params config = get_rpc_parmas(api::GET);
 	std::string salt(blob_uri.bytes.data(), 20);
 	sha1_hash index_hash(blob_uri.bytes.data());
@@ -90,7 +110,8 @@ api::error_code getter::get_blob(dht::public_key const& sender
 	api::error_code result = m_session.transporter()->get(sender
 		, salt, ts.value
 		, std::bind(&getter::get_callback, this, _1, _2, ctx, index_hash, false)
-		, config.invoke_branch, config.invoke_window, config.invoke_limit);
+		, config.invoke_branch, config.invoke_window, config.invoke_limit
+		, transport::BLOB_GET_CLASS);
 
 	if (result == api::NO_ERROR)
 	{
@@ -107,20 +128,31 @@ api::error_code getter::get_blob(dht::public_key const& sender
 }
 
 void getter::on_incoming_relay_uri(dht::public_key const& sender
-	, aux::uri blob_uri, dht::timestamp ts)
+	, aux::uri blob_uri, dht::timestamp ts, udp::endpoint const& ep)
 {
 #ifndef TORRENT_DISABLE_LOGGING
-	char hex_sender[65];
-	char hex_uri[41];
-	aux::to_hex(sender.bytes, hex_sender);
-	aux::to_hex(blob_uri.bytes, hex_uri);
+	m_logger.log_lazy(aux::LOG_INFO
+		, "incoming relay uri: sender: %s, uri:%s, endpoint:%s"
+		, aux::hex_arg(sender.bytes), aux::hex_arg(blob_uri.bytes)
+		, aux::print_endpoint(ep).c_str());
 #endif
 
-#ifndef TORRENT_DISABLE_LOGGING
-	m_logger.log(aux::LOG_INFO
-		, "incoming relay uri: sender: %s, uri:%s"
-		, hex_sender, hex_uri);
-#endif
+	if (ep.port() != 0)
+	{
+		time_point const now = aux::time_now();
+		if (m_direct_hints.size() >= max_direct_hints
+			&& m_direct_hints.find(sender) == m_direct_hints.end())
+		{
+			for (auto it = m_direct_hints.begin(); it != m_direct_hints.end();)
+			{
+				if (it->second.expires <= now) it = m_direct_hints.erase(it);
+				else ++it;
+			}
+			if (m_direct_hints.size() >= max_direct_hints)
+				m_direct_hints.erase(m_direct_hints.begin());
+		}
+		m_direct_hints[sender] = direct_hint{ep, now + direct_hint_lifetime};
+	}
 
 	// post "incoming_relay_data_uri_alert"
 	m_session.alerts().emplace_alert<incoming_relay_data_uri_alert>(sender.bytes.data()
@@ -132,11 +164,6 @@ void getter::get_callback(dht::item const& it, bool auth
 {
 	if (!auth) return;
 
-#ifndef TORRENT_DISABLE_LOGGING
-	char hex_hash[41];
-	aux::to_hex(h, hex_hash);
-#endif
-
 	ctx->on_arrived(h);
 
 	if (!is_seg && ctx->is_root_index(h))
@@ -148,17 +175,20 @@ void getter::get_callback(dht::item const& it, bool auth
 			if (ctx->is_getting_allowed(h))
 			{
 #ifndef TORRENT_DISABLE_LOGGING
-				m_logger.log(aux::LOG_WARNING, "[%u] re-get root index again: %s"
-					, ctx->id(), hex_hash);
+				m_logger.log_lazy(aux::LOG_WARNING, "[%u] re-get root index again: %s"
+					, ctx->id(), aux::hex_arg(h));
 #endif
 
+				m_counters.inc_stats_counter(counters::assemble_get_retries);
+
 				std::string salt(h.data(), 20);
 				api::dht_rpc_params config = get_rpc_parmas(api::GET);
 
 				api::error_code ok = m_session.transporter()->get(ctx->get_sender()
 					, salt, ctx->get_timestamp()
 					, std::bind(&getter::get_callback, this, _1, _2, ctx, h, false)
-					, config.invoke_branch, config.invoke_window, config.invoke_limit);
+					, config.invoke_branch, config.invoke_window, config.invoke_limit
+					, transport::BLOB_GET_CLASS);
 
 				if (ok == api::NO_ERROR)
 				{
@@ -178,8 +208,8 @@ void getter::get_callback(dht::item const& it, bool auth
 			else
 			{
 #ifndef TORRENT_DISABLE_LOGGING
-				m_logger.log(aux::LOG_ERR, "[%u] getting index failed too many times:%s"
-					, ctx->id(), hex_hash);
+				m_logger.log_lazy(aux::LOG_ERR, "[%u] getting index failed too many times:%s"
+					, ctx->id(), aux::hex_arg(h));
 #endif
 				ctx->set_error(err);
 				ctx->done();
@@ -198,8 +228,8 @@ void getter::get_callback(dht::item const& it, bool auth
 			if (seg_hashes.size() == 0)
 			{
 #ifndef TORRENT_DISABLE_LOGGING
-				m_logger.log(aux::LOG_ERR, "[%u] empty segment index:%s"
-					, ctx->id(), hex_hash);
+				m_logger.log_lazy(aux::LOG_ERR, "[%u] empty segment index:%s"
+					, ctx->id(), aux::hex_arg(h));
 #endif
                 ctx->set_error(api::EMPTY_BLOB_INDEX);
                 ctx->done();
@@ -210,64 +240,23 @@ void getter::get_callback(dht::item const& it, bool auth
 			}
 			else
 			{
-				// get all blob segments
-				// check network, if dht live nodes is 0, return error.
-				if (m_session.dht_nodes() == 0)
+				std::vector<sha1_hash> unique_hashes = seg_hashes;
+				std::sort(unique_hashes.begin(), unique_hashes.end());
+				unique_hashes.erase(std::unique(unique_hashes.begin(), unique_hashes.end())
+					, unique_hashes.end());
+
+				// the segments cached aren't got again
+				unique_hashes.erase(std::remove_if(unique_hashes.begin(), unique_hashes.end()
+					, [this, &ctx](sha1_hash const& s) { return get_cached_segment(ctx, s); })
+					, unique_hashes.end());
+
+				// get the others straight from the sender if it's
+				// reachable, otherwise from the DHT
+				if (!unique_hashes.empty()
+					&& (ctx->direct_endpoint().port() == 0
+					|| !get_segments_direct(ctx, unique_hashes)))
 				{
-#ifndef TORRENT_DISABLE_LOGGING
-					m_logger.log(aux::LOG_ERR
-						, "[%u] drop get seg:%s, dht live nodes is 0"
-						, ctx->id(), hex_hash);
-#endif
-					ctx->set_error(api::DHT_LIVE_NODES_ZERO);
-					ctx->done();
-					// post get alert
-					post_alert(ctx);
-					m_running_tasks.erase(ctx);
-					return;
-				}
-
-				// check transport queue cache size.
-				// if transport queue doesn't have enough queue, return error.
-				if (!m_session.transporter()->has_enough_buffer(seg_hashes.size()))
-				{
-#ifndef TORRENT_DISABLE_LOGGING
-					m_logger.log(aux::LOG_ERR
-						, "[%u] drop get seg:%s, buffer is full:%d"
-						, ctx->id(), hex_hash, seg_hashes.size());
-#endif
-					ctx->set_error(api::TRANSPORT_BUFFER_FULL);
-					ctx->done();
-					// post get alert
-					post_alert(ctx);
-					m_running_tasks.erase(ctx);
-					return;
-				}
-
-				api::dht_rpc_params config = get_rpc_parmas(api::GET);
-
-				for (auto& s : seg_hashes)
-				{
-					std::string seg_salt(s.data(), 20);
-
-					api::error_code ok = m_session.transporter()->get(ctx->get_sender()
-						, seg_salt, ctx->get_timestamp()
-						, std::bind(&getter::get_callback, this, _1, _2, ctx, s, true)
-						, config.invoke_branch, config.invoke_window
-						, config.invoke_limit);
-
-					if (ok == api::NO_ERROR)
-					{
-						ctx->start_getting_hash(s, true);
-					}
-					else
-					{
-						ctx->set_error(ok);
-						// how to handle this error?
-						// if no flying request, done this get task.
-						// else wait for reponse.
-						break;
-					}
+					if (!get_segments(ctx, h, unique_hashes)) return;
 				}
 			}
 		}
@@ -275,24 +264,33 @@ void getter::get_callback(dht::item const& it, bool auth
 	else
 	{
 		// this item is blob segment
-		api::error_code err = ctx->on_segment_got(it, h);
+		span<char const> value;
+		api::error_code err = ctx->on_segment_got(it, h, value);
 
-		if (err != api::NO_ERROR)
+		if (err == api::NO_ERROR)
+		{
+			m_cache.put(h, value);
+			post_segment_alert(ctx);
+		}
+		else
 		{
 			if (ctx->is_getting_allowed(h))
 			{
 #ifndef TORRENT_DISABLE_LOGGING
-				m_logger.log(aux::LOG_WARNING, "[%u] re-get segment again:%s"
-					, ctx->id(), hex_hash);
+				m_logger.log_lazy(aux::LOG_WARNING, "[%u] re-get segment again:%s"
+					, ctx->id(), aux::hex_arg(h));
 #endif
 
+				m_counters.inc_stats_counter(counters::assemble_get_retries);
+
 				std::string salt(h.data(), 20);
 				api::dht_rpc_params config = get_rpc_parmas(api::GET);
 
 				api::error_code ok = m_session.transporter()->get(ctx->get_sender()
 					, salt, ctx->get_timestamp()
 					, std::bind(&getter::get_callback, this, _1, _2, ctx, h, true)
-					, config.invoke_branch, config.invoke_window, config.invoke_limit);
+					, config.invoke_branch, config.invoke_window, config.invoke_limit
+					, transport::BLOB_GET_CLASS);
 
 				if (ok == api::NO_ERROR)
 				{
@@ -306,8 +304,8 @@ void getter::get_callback(dht::item const& it, bool auth
 			else
 			{
 #ifndef TORRENT_DISABLE_LOGGING
-				m_logger.log(aux::LOG_ERR, "[%u] getting segment failed too many times:%s"
-					, ctx->id(), hex_hash);
+				m_logger.log_lazy(aux::LOG_ERR, "[%u] getting segment failed too many times:%s"
+					, ctx->id(), aux::hex_arg(h));
 #endif
 				ctx->set_error(err);
 			}
@@ -322,8 +320,160 @@ void getter::get_callback(dht::item const& it, bool auth
 	}
 }
 
+bool getter::get_segments(std::shared_ptr<get_context> ctx, sha1_hash const& h
+	, std::vector<sha1_hash> const& seg_hashes)
+{
+	// check network, if dht live nodes is 0, return error.
+	if (m_session.dht_nodes() == 0)
+	{
+#ifndef TORRENT_DISABLE_LOGGING
+		m_logger.log_lazy(aux::LOG_ERR
+			, "[%u] drop get seg:%s, dht live nodes is 0"
+			, ctx->id(), aux::hex_arg(h));
+#endif
+		ctx->set_error(api::DHT_LIVE_NODES_ZERO);
+		ctx->done();
+		// post get alert
+		post_alert(ctx);
+		m_running_tasks.erase(ctx);
+		return false;
+	}
+
+	// check transport queue cache size.
+	// if transport queue doesn't have enough queue, return error.
+	if (!m_session.transporter()->has_enough_buffer(int(seg_hashes.size())
+		, transport::BLOB_GET_CLASS))
+	{
+#ifndef TORRENT_DISABLE_LOGGING
+		m_logger.log_lazy(aux::LOG_ERR
+			, "[%u] drop get seg:%s, buffer is full:%d"
+			, ctx->id(), aux::hex_arg(h), seg_hashes.size());
+#endif
+		ctx->set_error(api::TRANSPORT_BUFFER_FULL);
+		ctx->done();
+		// post get alert
+		post_alert(ctx);
+		m_running_tasks.erase(ctx);
+		return false;
+	}
+
+	api::dht_rpc_params config = get_rpc_parmas(api::GET);
+
+	for (auto& s : seg_hashes)
+	{
+		std::string seg_salt(s.data(), 20);
+
+		api::error_code ok = m_session.transporter()->get(ctx->get_sender()
+			, seg_salt, ctx->get_timestamp()
+			, std::bind(&getter::get_callback, this, _1, _2, ctx, s, true)
+			, config.invoke_branch, config.invoke_window
+			, config.invoke_limit, transport::BLOB_GET_CLASS);
+
+		if (ok == api::NO_ERROR)
+		{
+			ctx->start_getting_hash(s, true);
+		}
+		else
+		{
+			ctx->set_error(ok);
+			// how to handle this error?
+			// if no flying request, done this get task.
+			// else wait for reponse.
+			break;
+		}
+	}
+
+	return true;
+}
+
+bool getter::get_cached_segment(std::shared_ptr<get_context> ctx, sha1_hash const& h)
+{
+	span<char const> const value = m_cache.get(h);
+	if (value.empty())
+	{
+		m_counters.inc_stats_counter(counters::assemble_cache_misses);
+		return false;
+	}
+
+	// the cache is checked like the network, a corrupt file isn't used
+	if (ctx->on_segment_value(value, h) != api::NO_ERROR)
+	{
+		m_cache.remove(h);
+		m_counters.inc_stats_counter(counters::assemble_cache_misses);
+		return false;
+	}
+
+	m_counters.inc_stats_counter(counters::assemble_cache_hits);
+	m_counters.inc_stats_counter(counters::assemble_cache_bytes_saved
+		, std::int64_t(value.size()));
+	post_segment_alert(ctx);
+	return true;
+}
+
+bool getter::get_segments_direct(std::shared_ptr<get_context> ctx
+	, std::vector<sha1_hash> const& hashes)
+{
+	bool const started = m_direct.fetch(ctx->direct_endpoint(), hashes
+		, [this, ctx](sha1_hash const& h, span<char const> value)
+		{
+			ctx->on_arrived(h);
+			if (ctx->on_segment_value(value, h) != api::NO_ERROR) return false;
+			m_cache.put(h, value);
+			post_segment_alert(ctx);
+			return true;
+		}
+		, [this, ctx](std::vector<sha1_hash> missing)
+		{ on_direct_done(ctx, missing); });
+
+	if (!started) return false;
+
+#ifndef TORRENT_DISABLE_LOGGING
+	m_logger.log_lazy(aux::LOG_INFO, "[%u] get %d segments directly from %s"
+		, ctx->id(), int(hashes.size()), aux::print_endpoint(ctx->direct_endpoint()).c_str());
+#endif
+
+	for (auto const& s : hashes) ctx->start_getting_hash(s, true);
+	return true;
+}
+
+void getter::on_direct_done(std::shared_ptr<get_context> ctx
+	, std::vector<sha1_hash> const& missing)
+{
+	if (!missing.empty())
+	{
+#ifndef TORRENT_DISABLE_LOGGING
+		m_logger.log_lazy(aux::LOG_WARNING, "[%u] %d segments not got directly, getting them from dht"
+			, ctx->id(), int(missing.size()));
+#endif
+
+		m_counters.inc_stats_counter(counters::assemble_direct_fallbacks
+			, std::int64_t(missing.size()));
+
+		// they are flying again once they're asked from the DHT
+		for (auto const& s : missing) ctx->on_arrived(s);
+
+		sha1_hash const index_hash(ctx->get_uri().bytes.data());
+		if (!get_segments(ctx, index_hash, missing)) return;
+	}
+
+	if (ctx->is_done())
+	{
+		post_alert(ctx);
+		ctx->done();
+		m_running_tasks.erase(ctx);
+	}
+}
+
 void getter::post_alert(std::shared_ptr<get_context> ctx)
 {
+	if (ctx->handler())
+	{
+		aux::record_latency(m_counters, counters::assemble_get_latency0
+			, ctx->elapsed());
+		ctx->handler()(ctx->get_blob(), ctx->get_error());
+		return;
+	}
+
 	dht::public_key sender = ctx->get_sender();
 	aux::uri data_uri = ctx->get_uri();
 	std::array<char, 32> from;
@@ -331,16 +481,38 @@ void getter::post_alert(std::shared_ptr<get_context> ctx)
 	std::copy(sender.bytes.begin(), sender.bytes.end(), from.begin());
 	std::copy(data_uri.bytes.begin(), data_uri.bytes.end(), uri.begin());
 
-	std::vector<char> data;
-	bool got = ctx->get_segments_blob(data);
+	aux::record_latency(m_counters, counters::assemble_get_latency0
+		, ctx->elapsed());
+
+	std::shared_ptr<blob_buffer const> blob = ctx->get_blob();
 
 #ifndef TORRENT_DISABLE_LOGGING
-	m_logger.log(aux::LOG_ERR, "[%u] post get alert, result:%s, err:%d, data size:%d"
-		, ctx->id(), got ? "true" : "false", ctx->get_error(), (int)data.size());
+	m_logger.log_lazy(aux::LOG_ERR, "[%u] post get alert, result:%s, err:%d, data size:%d"
+		, ctx->id(), blob ? "true" : "false", ctx->get_error()
+		, blob ? blob->size() : 0);
 #endif
 
 	m_session.alerts().emplace_alert<get_data_alert>(from, uri, ctx->get_timestamp()
-		, data, ctx->get_error());
+		, std::move(blob), ctx->get_error());
+}
+
+void getter::post_segment_alert(std::shared_ptr<get_context> ctx)
+{
+	if (!m_session.alerts().should_post<get_data_segment_alert>()) return;
+
+	std::int64_t offset;
+	span<char const> range;
+	if (!ctx->next_stream_range(offset, range)) return;
+
+	dht::public_key sender = ctx->get_sender();
+	aux::uri data_uri = ctx->get_uri();
+	std::array<char, 32> from;
+	std::array<char, 20> uri;
+	std::copy(sender.bytes.begin(), sender.bytes.end(), from.begin());
+	std::copy(data_uri.bytes.begin(), data_uri.bytes.end(), uri.begin());
+
+	m_session.alerts().emplace_alert<get_data_segment_alert>(from, uri
+		, ctx->get_timestamp(), ctx->get_partial_blob(), offset, range);
 }
 
 } // namespace assemble
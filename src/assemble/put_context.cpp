@@ -9,10 +9,6 @@ see LICENSE file.
 
 #include "ip2/assemble/put_context.hpp"
 
-#ifndef TORRENT_DISABLE_LOGGING
-#include <ip2/hex.hpp> // to_hex
-#endif
-
 namespace ip2 {
 namespace assemble {
 
@@ -30,20 +26,12 @@ void put_context::add_root_index(sha1_hash const& h)
 	m_root_index.push_back(h);
 
 #ifndef TORRENT_DISABLE_LOGGING
-	char hex_hash[41];
-	aux::to_hex(h, hex_hash);
-
-	m_logger.log(aux::LOG_INFO, "[%u] add root index:%s", id(), hex_hash);
+	m_logger.log_lazy(aux::LOG_INFO, "[%u] add root index:%s", id(), aux::hex_arg(h));
 #endif
 }
 
 void put_context::add_invoked_hash(sha1_hash const& h, bool seg)
 {
-#ifndef TORRENT_DISABLE_LOGGING
-	char hex_hash[41];
-	aux::to_hex(h, hex_hash);
-#endif
-
 	m_flying_segments.insert(h);
 
 	auto it = m_invoked_hashes.find(h);
@@ -53,15 +41,15 @@ void put_context::add_invoked_hash(sha1_hash const& h, bool seg)
 		if (seg)
 		{
 #ifndef TORRENT_DISABLE_LOGGING
-			m_logger.log(aux::LOG_INFO, "[%u] put segment:%s, times:%d"
-				, id(), hex_hash, 1);
+			m_logger.log_lazy(aux::LOG_INFO, "[%u] put segment:%s, times:%d"
+				, id(), aux::hex_arg(h), 1);
 #endif
 		}
 		else
 		{
 #ifndef TORRENT_DISABLE_LOGGING
-			m_logger.log(aux::LOG_INFO, "[%u] put index:%s, times:%d"
-				, id(), hex_hash, 1);
+			m_logger.log_lazy(aux::LOG_INFO, "[%u] put index:%s, times:%d"
+				, id(), aux::hex_arg(h), 1);
 #endif
 		}
 
@@ -73,26 +61,21 @@ void put_context::add_invoked_hash(sha1_hash const& h, bool seg)
 	if (seg)
 	{
 #ifndef TORRENT_DISABLE_LOGGING
-		m_logger.log(aux::LOG_INFO, "[%u] put segment:%s, times:%d"
-			, id(), hex_hash, it->second);
+		m_logger.log_lazy(aux::LOG_INFO, "[%u] put segment:%s, times:%d"
+			, id(), aux::hex_arg(h), it->second);
 #endif
 	}
 	else
 	{
 #ifndef TORRENT_DISABLE_LOGGING
-		m_logger.log(aux::LOG_INFO, "[%u] put index:%s, times:%d"
-			, id(), hex_hash, it->second);
+		m_logger.log_lazy(aux::LOG_INFO, "[%u] put index:%s, times:%d"
+			, id(), aux::hex_arg(h), it->second);
 #endif
 	}
 }
 
 void put_context::add_callbacked_hash(sha1_hash const& h, int response, bool seg)
 {
-#ifndef TORRENT_DISABLE_LOGGING
-	char hex_hash[41];
-	aux::to_hex(h, hex_hash);
-#endif
-
 	m_flying_segments.erase(h);
 
 	auto it = m_invoked_hashes.find(h);
@@ -102,15 +85,15 @@ void put_context::add_callbacked_hash(sha1_hash const& h, int response, bool seg
 		if (seg)
 		{
 #ifndef TORRENT_DISABLE_LOGGING
-			m_logger.log(aux::LOG_INFO, "[%u] put segment callback:%s, responses:%d"
-				, id(), hex_hash, response);
+			m_logger.log_lazy(aux::LOG_INFO, "[%u] put segment callback:%s, responses:%d"
+				, id(), aux::hex_arg(h), response);
 #endif
 		}
 		else
 		{
 #ifndef TORRENT_DISABLE_LOGGING
-			m_logger.log(aux::LOG_INFO, "[%u] put index callback:%s, responses:%d"
-				, id(), hex_hash, response);
+			m_logger.log_lazy(aux::LOG_INFO, "[%u] put index callback:%s, responses:%d"
+				, id(), aux::hex_arg(h), response);
 #endif
 		}
 
@@ -122,26 +105,21 @@ void put_context::add_callbacked_hash(sha1_hash const& h, int response, bool seg
 	if (seg)
 	{
 #ifndef TORRENT_DISABLE_LOGGING
-		m_logger.log(aux::LOG_INFO, "[%u] put segment callback:%s, responses:%d"
-			, id(), hex_hash, it->second);
+		m_logger.log_lazy(aux::LOG_INFO, "[%u] put segment callback:%s, responses:%d"
+			, id(), aux::hex_arg(h), it->second);
 #endif
 	}
 	else
 	{
 #ifndef TORRENT_DISABLE_LOGGING
-		m_logger.log(aux::LOG_INFO, "[%u] put index callback:%s, responses:%d"
-			, id(), hex_hash, it->second);
+		m_logger.log_lazy(aux::LOG_INFO, "[%u] put index callback:%s, responses:%d"
+			, id(), aux::hex_arg(h), it->second);
 #endif
 	}
 }
 
 bool put_context::is_reput_allowed(sha1_hash const& h)
 {
-#ifndef TORRENT_DISABLE_LOGGING
-	char hex_hash[41];
-	aux::to_hex(h, hex_hash);
-#endif
-
 	auto it = m_invoked_hashes.find(h);
 
 	if (it == m_invoked_hashes.end())
@@ -151,8 +129,8 @@ bool put_context::is_reput_allowed(sha1_hash const& h)
 
 	int times = it->second;
 #ifndef TORRENT_DISABLE_LOGGING
-	m_logger.log(aux::LOG_INFO, "[%u] allowed reput hash:%s, times:%d"
-		, id(), hex_hash, times);
+	m_logger.log_lazy(aux::LOG_INFO, "[%u] allowed reput hash:%s, times:%d"
+		, id(), aux::hex_arg(h), times);
 #endif
 
 	return times < reput_times_limit;
@@ -161,12 +139,9 @@ bool put_context::is_reput_allowed(sha1_hash const& h)
 void put_context::done()
 {
 #ifndef TORRENT_DISABLE_LOGGING
-	char hex_uri[41];
-	aux::to_hex(m_uri.bytes, hex_uri);
-
-	m_logger.log(aux::LOG_INFO
+	m_logger.log_lazy(aux::LOG_INFO
 		, "[%u] put DONE: uri:%s, err:%d, seg_count:%u, invoked:%d, cb:%d"
-		, id(), hex_uri, get_error(), m_seg_count
+		, id(), aux::hex_arg(m_uri.bytes), get_error(), m_seg_count
 		, (int)m_invoked_hashes.size(), (int)m_callbacked_hashes.size());
 #endif
 }
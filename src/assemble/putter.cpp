@@ -12,17 +12,14 @@ see LICENSE file.
 
 #include "ip2/aux_/session_interface.hpp"
 #include "ip2/aux_/alert_manager.hpp" // for alert_manager
+#include "ip2/aux_/latency_histogram.hpp"
+#include "ip2/hasher.hpp"
 
 #include "ip2/kademlia/node_id.hpp"
 
-#ifndef TORRENT_DISABLE_LOGGING
-#include "ip2/hex.hpp" // to_hex
-#endif
-
 #include <algorithm>
 
 using namespace std::placeholders;
-using namespace ip2::assemble::protocol;
 
 namespace ip2 {
 
@@ -32,12 +29,16 @@ putter::putter(io_context& ios
 	, aux::session_interface& session
 	, aux::session_settings const& settings
 	, counters& cnt
-	, assemble_logger& logger)
+	, assemble_logger& logger
+	, direct_channel& direct
+	, segment_cache& cache)
 	: m_ios(ios)
 	, m_session(session)
 	, m_settings(settings)
 	, m_counters(cnt)
 	, m_logger(logger)
+	, m_direct(direct)
+	, m_cache(cache)
 {
 	update_node_id();
 }
@@ -50,17 +51,12 @@ api::error_code putter::put_blob(span<char const> blob, aux::uri const& blob_uri
 		return api::BLOB_TOO_LARGE;
 	}
 
-#ifndef TORRENT_DISABLE_LOGGING
-	char hex_uri[41];
-	aux::to_hex(blob_uri.bytes, hex_uri);
-#endif
-
 	// check network, if dht live nodes is 0, return error.
 	if (m_session.dht_nodes() == 0)
 	{
 #ifndef TORRENT_DISABLE_LOGGING
-		m_logger.log(aux::LOG_INFO
-			, "drop put req:%s, error: dht nodes 0", hex_uri);
+		m_logger.log_lazy(aux::LOG_INFO
+			, "drop put req:%s, error: dht nodes 0", aux::hex_arg(blob_uri.bytes));
 #endif
 
 		return api::DHT_LIVE_NODES_ZERO;
@@ -74,47 +70,61 @@ api::error_code putter::put_blob(span<char const> blob, aux::uri const& blob_uri
 
 	// check transport queue cache size.
 	// if transport queue doesn't have enough queue, return error.
-	if (!m_session.transporter()->has_enough_buffer(buffer_slot))
+	if (!m_session.transporter()->has_enough_buffer(buffer_slot, transport::BLOB_PUT_CLASS))
 	{
 #ifndef TORRENT_DISABLE_LOGGING
-		m_logger.log(aux::LOG_INFO
-			, "drop put req:%s, error: buffer is full", hex_uri);
+		m_logger.log_lazy(aux::LOG_INFO
+			, "drop put req:%s, error: buffer is full", aux::hex_arg(blob_uri.bytes));
 #endif
 
 		return api::TRANSPORT_BUFFER_FULL;
 	}
 
+	// hash all the segments before any of them is put
+	std::vector<span<char const>> segs(seg_count);
+	for (std::uint32_t i = 0; i < seg_count; ++i)
+	{
+		std::uint32_t const off = i * protocol::blob_seg_mtu;
+		segs[i] = blob.subspan(off, std::min<std::uint32_t>(protocol::blob_seg_mtu
+			, static_cast<std::uint32_t>(blob.size()) - off));
+	}
+	std::vector<sha1_hash> seg_hashes(seg_count);
+	hash_batch(segs, seg_hashes);
+
 	std::shared_ptr<put_context> ctx = std::make_shared<put_context>(m_logger
 		, m_self_pubkey, blob_uri, seg_count);
 	std::vector<sha1_hash> blob_seg_hashes;
 
 	// start putting the last blob segment
-	std::uint32_t begin = (seg_count - 1) * blob_seg_mtu;
+	std::uint32_t begin = (seg_count - 1) * protocol::blob_seg_mtu;
 	std::uint32_t end = static_cast<std::uint32_t>(blob.size() - 1);
 
-	std::string last_seg;
-	last_seg.append(blob.data() + begin, end - begin + 1);
-	sha1_hash last_seg_hash = hash(last_seg, end - begin + 1);
+	span<char const> last_seg = blob.subspan(begin, end - begin + 1);
+	sha1_hash last_seg_hash = seg_hashes[seg_count - 1];
 
-	protocol::blob_seg_protocol p(last_seg);
-	entry pl = p.to_entry();
+	entry pl = protocol::encode<protocol::blob_seg_schema>(last_seg);
 	api::dht_rpc_params config = get_rpc_parmas(api::PUT);
 
 #ifndef TORRENT_DISABLE_LOGGING
-	m_logger.log(aux::LOG_INFO, "[%u] start putting blob with uri %s"
-		, ctx->id(), hex_uri);
+	m_logger.log_lazy(aux::LOG_INFO, "[%u] start putting blob with uri %s"
+		, ctx->id(), aux::hex_arg(blob_uri.bytes));
 #endif
 
 	api::error_code ok = m_session.transporter()->put(pl
 		, std::string(last_seg_hash.data(), 20)
 		, std::bind(&putter::put_callback, this, _1, _2, ctx, last_seg_hash, true)
-		, config.invoke_branch, config.invoke_window, config.invoke_limit);
+		, config.invoke_branch, config.invoke_window, config.invoke_limit
+		, transport::BLOB_PUT_CLASS);
 
 	if (ok == api::NO_ERROR)
 	{
 		blob_seg_hashes.push_back(last_seg_hash);
 		ctx->add_invoked_hash(last_seg_hash, true);
 		m_running_tasks.insert(ctx);
+		m_cache.put(last_seg_hash, last_seg);
+
+		// getters that can reach this node get the segments from it
+		m_direct.serve(blob, seg_hashes);
 	}
 	else
 	{
@@ -129,25 +139,25 @@ api::error_code putter::put_blob(span<char const> blob, aux::uri const& blob_uri
 	// put left segments
 	while (seg_count > 0)
 	{
-		begin = (seg_count - 1) * blob_seg_mtu;
-		end = seg_count * blob_seg_mtu;
+		begin = (seg_count - 1) * protocol::blob_seg_mtu;
+		end = seg_count * protocol::blob_seg_mtu;
 
-		std::string seg;
-		seg.append(blob.data() + begin, blob_seg_mtu);
-		sha1_hash seg_hash = hash(seg, blob_seg_mtu);
+		span<char const> seg = blob.subspan(begin, protocol::blob_seg_mtu);
+		sha1_hash seg_hash = seg_hashes[seg_count - 1];
 
-		protocol::blob_seg_protocol proto(seg);
-		entry e = proto.to_entry();
+		entry e = protocol::encode<protocol::blob_seg_schema>(seg);
 
 		api::error_code err = m_session.transporter()->put(e
 			, std::string(seg_hash.data(), 20) 
 			, std::bind(&putter::put_callback, this, _1, _2, ctx, seg_hash, true)
-			, config.invoke_branch, config.invoke_window, config.invoke_limit);
+			, config.invoke_branch, config.invoke_window, config.invoke_limit
+			, transport::BLOB_PUT_CLASS);
 
 		if (err == api::NO_ERROR)
 		{
 			blob_seg_hashes.push_back(seg_hash);
 			ctx->add_invoked_hash(seg_hash, true);
+			m_cache.put(seg_hash, seg);
 		}
 		else
 		{
@@ -161,7 +171,7 @@ api::error_code putter::put_blob(span<char const> blob, aux::uri const& blob_uri
 	// if no error, put root index
 	if (seg_count == 0 && ctx->get_error() == api::NO_ERROR)
 	{
-		m_logger.log(aux::LOG_INFO, "hash vector size:%d", (int)blob_seg_hashes.size());
+		m_logger.log_lazy(aux::LOG_INFO, "hash vector size:%d", (int)blob_seg_hashes.size());
 		for (auto i = blob_seg_hashes.rbegin(); i != blob_seg_hashes.rend(); i++)
 		{
 			ctx->add_root_index(*i);
@@ -169,14 +179,14 @@ api::error_code putter::put_blob(span<char const> blob, aux::uri const& blob_uri
 
 		std::vector<sha1_hash> root_hashes;
 		ctx->get_root_index(root_hashes);
-		protocol::blob_index_protocol rip(root_hashes);
-		entry ripe = rip.to_entry();
+		entry ripe = protocol::encode<protocol::blob_index_schema>(root_hashes);
 		sha1_hash uri_hash(blob_uri.bytes.data());
 
 		api::error_code err = m_session.transporter()->put(ripe
 			, std::string(uri_hash.data(), 20)
 			, std::bind(&putter::put_callback, this, _1, _2, ctx, uri_hash, false)
-			, config.invoke_branch, config.invoke_window, config.invoke_limit);
+			, config.invoke_branch, config.invoke_window, config.invoke_limit
+			, transport::BLOB_PUT_CLASS);
 
 		if (err == api::NO_ERROR)
 		{
@@ -215,12 +225,15 @@ void putter::put_callback(dht::item const& it, int responses
 	{
 		if (ctx->is_reput_allowed(h))
 		{
+			m_counters.inc_stats_counter(counters::assemble_put_retries);
+
 			api::dht_rpc_params config = get_rpc_parmas(api::PUT);
 
 			api::error_code err = m_session.transporter()->put(it.value()
 				, std::string(h.data(), 20)
 				, std::bind(&putter::put_callback, this, _1, _2, ctx, h, is_seg)
-				, config.invoke_branch, config.invoke_window, config.invoke_limit);
+				, config.invoke_branch, config.invoke_window, config.invoke_limit
+				, transport::BLOB_PUT_CLASS);
 
 			if (err == api::NO_ERROR)
 			{
@@ -240,6 +253,9 @@ void putter::put_callback(dht::item const& it, int responses
 	if (ctx->is_done())
 	{
 		ctx->done();
+		aux::record_latency(m_counters, counters::assemble_put_latency0
+			, ctx->elapsed());
+
 		// post alert with error code
 		aux::uri data_uri = ctx->get_uri();
 		m_session.alerts().emplace_alert<put_data_alert>(data_uri.bytes.data()
@@ -248,12 +264,6 @@ void putter::put_callback(dht::item const& it, int responses
 	}
 }
 
-sha1_hash putter::hash(std::string const& value, std::size_t value_size)
-{
-	hasher h(value.data(), value_size);
-	return h.final();
-}
-
 sha1_hash putter::hash(std::vector<sha1_hash> const& hl)
 {
 	hasher h;
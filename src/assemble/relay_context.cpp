@@ -9,10 +9,6 @@ see LICENSE file.
 
 #include "ip2/assemble/relay_context.hpp"
 
-#ifndef TORRENT_DISABLE_LOGGING
-#include <ip2/hex.hpp> // to_hex
-#endif
-
 namespace ip2 {
 namespace assemble {
 
@@ -36,25 +32,19 @@ relay_context::relay_context(assemble_logger& logger
 
 void relay_context::start_relay()
 {
-#ifndef TORRENT_DISABLE_LOGGING
-	char hex_receiver[65];
-	aux::to_hex(m_receiver.bytes, hex_receiver);
-#endif
-
 	if (m_type == relay_type::MESSAGE)
 	{
 #ifndef TORRENT_DISABLE_LOGGING
-		m_logger.log(aux::LOG_INFO
-			, "[%u] start relay message to %s", id(), hex_receiver);
+		m_logger.log_lazy(aux::LOG_INFO
+			, "[%u] start relay message to %s", id(), aux::hex_arg(m_receiver.bytes));
 #endif
 	}
 	else
 	{
 #ifndef TORRENT_DISABLE_LOGGING
-		char hex_uri[41];
-		aux::to_hex(m_uri.bytes, hex_uri);
-		m_logger.log(aux::LOG_INFO
-			, "[%u] start relay uri %s to %s", id(), hex_uri, hex_receiver);
+		m_logger.log_lazy(aux::LOG_INFO
+			, "[%u] start relay uri %s to %s"
+			, id(), aux::hex_arg(m_uri.bytes), aux::hex_arg(m_receiver.bytes));
 #endif
 	}
 }
@@ -62,11 +52,9 @@ void relay_context::start_relay()
 void relay_context::done()
 {
 #ifndef TORRENT_DISABLE_LOGGING
-	char hex_receiver[65];
-	aux::to_hex(m_receiver.bytes, hex_receiver);
-
-	m_logger.log(aux::LOG_INFO
-		, "[%u] relay DONE: receiver: %s, err: %d", id(), hex_receiver, get_error());
+	m_logger.log_lazy(aux::LOG_INFO
+		, "[%u] relay DONE: receiver: %s, err: %d"
+		, id(), aux::hex_arg(m_receiver.bytes), get_error());
 #endif
 }
 
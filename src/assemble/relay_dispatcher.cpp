@@ -10,8 +10,6 @@ see LICENSE file.
 #include "ip2/assemble/relay_dispatcher.hpp"
 #include "ip2/assemble/protocol.hpp"
 
-using namespace ip2::assemble::protocol;
-
 namespace ip2 {
 namespace assemble {
 
@@ -23,41 +21,42 @@ relay_dispatcher::relay_dispatcher(getter& g, relayer& r, assemble_logger& logge
 
 void relay_dispatcher::on_dht_relay(dht::public_key const& from, entry const& payload)
 {
-	std::shared_ptr<protocol::basic_protocol> bp;
-	api::error_code err;
-	std::tie(bp, err) = protocol::construct_protocol(payload, m_logger);
-	if (err != api::NO_ERROR)
-	{
-#ifndef TORRENT_DISABLE_LOGGING 
-		m_logger.log(aux::LOG_ERR, "parse protocol error:%d", err);
-#endif
-
-		return;
-    }
+	char const name = protocol::message_name(payload);
+	api::error_code err = api::NO_ERROR;
 
-	if (strncmp(bp->get_name().c_str(), protocol::relay_uri_protocol::name.c_str()
-			, 1) == 0)
+	if (name == protocol::relay_uri_schema::name)
 	{
-		std::shared_ptr<protocol::relay_uri_protocol> rup
-			= std::dynamic_pointer_cast<protocol::relay_uri_protocol>(bp);
-
-		m_getter.on_incoming_relay_uri(rup->pk()
-			, rup->blob_uri(), rup->ts());
+		protocol::relay_uri_schema::view uri;
+		err = protocol::decode<protocol::relay_uri_schema>(payload, uri);
+		if (err == api::NO_ERROR)
+		{
+			// only the sender of the blob may say where it's served
+			udp::endpoint const ep = from == uri.pk ? uri.ep : udp::endpoint();
+			m_getter.on_incoming_relay_uri(uri.pk, uri.blob_uri, uri.ts, ep);
+			return;
+		}
 	}
-	else if (strncmp(bp->get_name().c_str(), protocol::relay_msg_protocol::name.c_str()
-			, 1) == 0)
+	else if (name == protocol::relay_msg_schema::name)
 	{
-		std::shared_ptr<protocol::relay_msg_protocol> rmp
-			= std::dynamic_pointer_cast<protocol::relay_msg_protocol>(bp);
-
-		m_relayer.on_incoming_relay_message(from, rmp->msg());
+		protocol::relay_msg_schema::view msg;
+		err = protocol::decode<protocol::relay_msg_schema>(payload, msg);
+		if (err == api::NO_ERROR)
+		{
+			m_relayer.on_incoming_relay_message(from, msg.msg);
+			return;
+		}
 	}
 	else
 	{
 #ifndef TORRENT_DISABLE_LOGGING
-		m_logger.log(aux::LOG_ERR, "parse protocol unkown name: %s", bp->get_name().c_str());
+		m_logger.log(aux::LOG_ERR, "parse protocol unkown name: %c", name ? name : '?');
 #endif
+		return;
 	}
+
+#ifndef TORRENT_DISABLE_LOGGING 
+	m_logger.log(aux::LOG_ERR, "parse protocol error:%d", err);
+#endif
 }
 
 } // namespace assemble
@@ -12,17 +12,13 @@ see LICENSE file.
 
 #include "ip2/aux_/session_interface.hpp"
 #include "ip2/aux_/alert_manager.hpp"
+#include "ip2/aux_/latency_histogram.hpp"
 
 #include "ip2/kademlia/node_id.hpp"
 
-#ifndef TORRENT_DISABLE_LOGGING
-#include "ip2/hex.hpp" // to_hex
-#endif
-
 #include "ip2/hasher.hpp"
 
 using namespace std::placeholders;
-using namespace ip2::assemble::protocol;
 
 namespace ip2 {
 
@@ -51,17 +47,12 @@ void relayer::update_node_id()
 api::error_code relayer::relay_message(dht::public_key const& receiver
 	, span<char const> message)
 {
-#ifndef TORRENT_DISABLE_LOGGING
-	char hex_key[65];
-	aux::to_hex(receiver.bytes, hex_key);
-#endif
-
 	// check network, if dht live nodes is 0, return error.
 	if (m_session.dht_nodes() == 0)
 	{
 #ifndef TORRENT_DISABLE_LOGGING
-		m_logger.log(aux::LOG_ERR
-			, "drop relay message:%s, error: dht nodes 0", hex_key);
+		m_logger.log_lazy(aux::LOG_ERR
+			, "drop relay message:%s, error: dht nodes 0", aux::hex_arg(receiver.bytes));
 #endif
 
 		return api::DHT_LIVE_NODES_ZERO;
@@ -69,11 +60,11 @@ api::error_code relayer::relay_message(dht::public_key const& receiver
 
 	// check transport queue cache size.
 	// if transport queue doesn't have enough queue, return error.
-	if (!m_session.transporter()->has_enough_buffer(1))
+	if (!m_session.transporter()->has_enough_buffer(1, transport::RELAY_CLASS))
 	{
 #ifndef TORRENT_DISABLE_LOGGING
-		m_logger.log(aux::LOG_ERR
-			, "drop relay message:%s, error: buffer is full", hex_key);
+		m_logger.log_lazy(aux::LOG_ERR
+			, "drop relay message:%s, error: buffer is full", aux::hex_arg(receiver.bytes));
 #endif
 
 		return api::TRANSPORT_BUFFER_FULL;
@@ -83,8 +74,9 @@ api::error_code relayer::relay_message(dht::public_key const& receiver
 	if ((int)message.size() > protocol::relay_msg_mtu)
 	{
 #ifndef TORRENT_DISABLE_LOGGING
-		m_logger.log(aux::LOG_ERR
-			, "drop relay message:%s, too large:%d", hex_key, (int)message.size());
+		m_logger.log_lazy(aux::LOG_ERR
+			, "drop relay message:%s, too large:%d"
+			, aux::hex_arg(receiver.bytes), (int)message.size());
 #endif
 
 		return api::BLOB_TOO_LARGE;
@@ -92,14 +84,13 @@ api::error_code relayer::relay_message(dht::public_key const& receiver
 
 	std::shared_ptr<relay_context> ctx = std::make_shared<relay_context>(m_logger, receiver);
 
-	protocol::relay_msg_protocol p(std::string(message.data(), message.size()));
-	entry pl = p.to_entry();
+	entry pl = protocol::encode<protocol::relay_msg_schema>(message);
 	api::dht_rpc_params config = get_rpc_parmas(api::RELAY);
 
 	api::error_code ok = m_session.transporter()->send(receiver, pl
 		, std::bind(&relayer::send_message_callback, this, _1, _2, ctx)
 		, config.invoke_branch, config.invoke_window
-		, config.invoke_limit, config.hit_limit);
+		, config.invoke_limit, config.hit_limit, transport::RELAY_CLASS);
 
 	if (ok == api::NO_ERROR)
 	{
@@ -120,19 +111,13 @@ api::error_code relayer::relay_message(dht::public_key const& receiver
 api::error_code relayer::relay_uri(dht::public_key const& receiver
 	, aux::uri const& data_uri, dht::timestamp ts)
 {
-#ifndef TORRENT_DISABLE_LOGGING
-	char hex_uri[41];
-    char hex_key[65];
-	aux::to_hex(data_uri.bytes, hex_uri);
-    aux::to_hex(receiver.bytes, hex_key);
-#endif
-
 	// check network, if dht live nodes is 0, return error.
 	if (m_session.dht_nodes() == 0)
 	{
 #ifndef TORRENT_DISABLE_LOGGING
-		m_logger.log(aux::LOG_ERR
-		, "drop relay uri:%s/%s, error: dht nodes 0", hex_key, hex_uri);
+		m_logger.log_lazy(aux::LOG_ERR
+		, "drop relay uri:%s/%s, error: dht nodes 0"
+		, aux::hex_arg(receiver.bytes), aux::hex_arg(data_uri.bytes));
 #endif
 
 		return api::DHT_LIVE_NODES_ZERO;
@@ -140,11 +125,12 @@ api::error_code relayer::relay_uri(dht::public_key const& receiver
 
 	// check transport queue cache size.
 	// if transport queue doesn't have enough queue, return error.
-	if (!m_session.transporter()->has_enough_buffer(1))
+	if (!m_session.transporter()->has_enough_buffer(1, transport::RELAY_CLASS))
 	{
 #ifndef TORRENT_DISABLE_LOGGING
-		m_logger.log(aux::LOG_ERR
-			, "drop relay uri:%s/%s, error: buffer is full", hex_key, hex_uri);
+		m_logger.log_lazy(aux::LOG_ERR
+			, "drop relay uri:%s/%s, error: buffer is full"
+			, aux::hex_arg(receiver.bytes), aux::hex_arg(data_uri.bytes));
 #endif
 
 		return api::TRANSPORT_BUFFER_FULL;
@@ -153,15 +139,17 @@ api::error_code relayer::relay_uri(dht::public_key const& receiver
 	std::shared_ptr<relay_context> ctx = std::make_shared<relay_context>(m_logger
 		, receiver, data_uri, ts);
 
-	protocol::relay_uri_protocol p(m_self_pubkey, data_uri, ts);
-	entry pl = p.to_entry();
+	// the receiver may get the blob straight from this node, if it's
+	// reachable
+	entry pl = protocol::encode<protocol::relay_uri_schema>(m_self_pubkey
+		, data_uri, ts, m_session.direct_endpoint());
 	api::dht_rpc_params config = get_rpc_parmas(api::RELAY);
 
 	api::error_code ok = m_session.transporter()->send(receiver, pl
 		, std::bind(&relayer::send_uri_callback, this, _1, _2
 			, ctx, receiver, data_uri, ts)
 		, config.invoke_branch, config.invoke_window
-		, config.invoke_limit, config.hit_limit);
+		, config.invoke_limit, config.hit_limit, transport::RELAY_CLASS);
 
 	if (ok == api::NO_ERROR)
 	{
@@ -179,7 +167,7 @@ api::error_code relayer::relay_uri(dht::public_key const& receiver
 	}
 }
 
-void relayer::on_incoming_relay_message(dht::public_key const& pk, std::string const& msg)
+void relayer::on_incoming_relay_message(dht::public_key const& pk, span<char const> msg)
 {
 	// post 'incoming_relay_alert'
 	m_session.alerts().emplace_alert<incoming_relay_message_alert>(pk.bytes.data(), msg);
@@ -195,6 +183,8 @@ void relayer::send_message_callback(entry const& payload
 	}
 
 	ctx->done();
+	aux::record_latency(m_counters, counters::assemble_relay_latency0
+		, ctx->elapsed());
 
 	if (ctx->get_relay_type() == MESSAGE)
 	{
@@ -218,6 +208,8 @@ void relayer::send_uri_callback(entry const& payload
 	}
 
 	ctx->done();
+	aux::record_latency(m_counters, counters::assemble_relay_latency0
+		, ctx->elapsed());
 
     if (ctx->get_relay_type() == URI)
 	{
@@ -0,0 +1,242 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "ip2/assemble/segment_cache.hpp"
+
+#include "ip2/aux_/session_settings.hpp"
+#include "ip2/hex.hpp" // from_hex, to_hex
+
+#include <algorithm>
+#include <cstring> // for strlen
+#include <filesystem>
+#include <fstream>
+#include <tuple>
+
+namespace ip2 {
+
+namespace assemble {
+
+namespace {
+
+	// a file is named by the hex encoded hash of its segment
+	constexpr char const* file_extension = ".seg";
+}
+
+segment_cache::segment_cache(aux::session_settings const& settings
+	, assemble_logger& logger)
+	: m_settings(settings)
+	, m_logger(logger)
+{}
+
+void segment_cache::open(std::string dir)
+{
+	m_dir = std::move(dir);
+
+	std::error_code ec;
+	std::filesystem::create_directories(m_dir, ec);
+	if (ec)
+	{
+#ifndef TORRENT_DISABLE_LOGGING
+		m_logger.log_lazy(aux::LOG_ERR, "segment cache: failed to create %s: %s"
+			, m_dir, ec.message());
+#endif
+		m_dir.clear();
+		return;
+	}
+
+	// the files of an earlier run, most recently written first
+	std::vector<std::tuple<std::filesystem::file_time_type, sha1_hash, int>> files;
+	for (auto const& e : std::filesystem::directory_iterator(m_dir, ec))
+	{
+		std::string const name = e.path().filename().string();
+		sha1_hash h;
+		if (name.size() != 40 + std::strlen(file_extension)
+			|| e.path().extension() != file_extension
+			|| !aux::from_hex({name.data(), 40}, h.data()))
+		{
+			continue;
+		}
+
+		std::error_code fec;
+		auto const size = e.file_size(fec);
+		auto const time = e.last_write_time(fec);
+		if (fec) continue;
+		files.emplace_back(time, h, int(size));
+	}
+	std::sort(files.begin(), files.end()
+		, [](auto const& lhs, auto const& rhs)
+		{ return std::get<0>(lhs) > std::get<0>(rhs); });
+
+	for (auto const& f : files)
+	{
+		sha1_hash const& h = std::get<1>(f);
+		if (m_disk.count(h)) continue;
+		m_disk_lru.push_back(h);
+		m_disk[h] = disk_entry{std::get<2>(f), std::prev(m_disk_lru.end())};
+		m_disk_size += std::get<2>(f);
+	}
+
+	trim_disk();
+
+#ifndef TORRENT_DISABLE_LOGGING
+	m_logger.log_lazy(aux::LOG_INFO, "segment cache: %d segments, %d bytes on disk in %s"
+		, int(m_disk.size()), m_disk_size, m_dir);
+#endif
+}
+
+void segment_cache::put(sha1_hash const& h, span<char const> seg)
+{
+	if (seg.empty()) return;
+
+	auto const it = m_memory.find(h);
+	if (it != m_memory.end())
+	{
+		m_memory_lru.splice(m_memory_lru.begin(), m_memory_lru, it->second.lru);
+		return;
+	}
+
+	m_memory_lru.push_front(h);
+	m_memory[h] = memory_entry{{seg.begin(), seg.end()}, m_memory_lru.begin()};
+	m_memory_size += seg.size();
+
+	trim_memory();
+}
+
+span<char const> segment_cache::get(sha1_hash const& h)
+{
+	auto const it = m_memory.find(h);
+	if (it != m_memory.end())
+	{
+		m_memory_lru.splice(m_memory_lru.begin(), m_memory_lru, it->second.lru);
+		return it->second.data;
+	}
+
+	auto const d = m_disk.find(h);
+	if (d == m_disk.end()) return {};
+
+	std::vector<char> seg;
+	if (!read_file(h, d->second.size, seg))
+	{
+		remove(h);
+		return {};
+	}
+	m_disk_lru.splice(m_disk_lru.begin(), m_disk_lru, d->second.lru);
+
+	// it's kept on disk too, so it isn't written again once it's dropped
+	// from memory
+	m_memory_lru.push_front(h);
+	memory_entry& e = m_memory[h];
+	e.data = std::move(seg);
+	e.lru = m_memory_lru.begin();
+	m_memory_size += std::int64_t(e.data.size());
+
+	trim_memory();
+	return e.data;
+}
+
+void segment_cache::remove(sha1_hash const& h)
+{
+	auto const it = m_memory.find(h);
+	if (it != m_memory.end())
+	{
+		m_memory_size -= std::int64_t(it->second.data.size());
+		m_memory_lru.erase(it->second.lru);
+		m_memory.erase(it);
+	}
+
+	auto const d = m_disk.find(h);
+	if (d != m_disk.end())
+	{
+		m_disk_size -= d->second.size;
+		m_disk_lru.erase(d->second.lru);
+		m_disk.erase(d);
+		remove_file(h);
+	}
+}
+
+void segment_cache::trim_memory()
+{
+	std::int64_t const limit = m_settings.get_int(settings_pack::assemble_segment_cache_size);
+	bool const spill = !m_dir.empty()
+		&& m_settings.get_int(settings_pack::assemble_segment_cache_disk_size) > 0;
+
+	// the segment used last is always kept, so it can be returned
+	while (m_memory_size > limit && m_memory_lru.size() > 1)
+	{
+		sha1_hash const h = m_memory_lru.back();
+		auto const it = m_memory.find(h);
+		TORRENT_ASSERT(it != m_memory.end());
+
+		if (spill && m_disk.count(h) == 0 && write_file(h, it->second.data))
+		{
+			m_disk_lru.push_front(h);
+			m_disk[h] = disk_entry{int(it->second.data.size()), m_disk_lru.begin()};
+			m_disk_size += std::int64_t(it->second.data.size());
+		}
+
+		m_memory_size -= std::int64_t(it->second.data.size());
+		m_memory_lru.pop_back();
+		m_memory.erase(it);
+	}
+
+	if (spill) trim_disk();
+}
+
+void segment_cache::trim_disk()
+{
+	std::int64_t const limit = m_settings.get_int(settings_pack::assemble_segment_cache_disk_size);
+	while (m_disk_size > limit && !m_disk_lru.empty())
+	{
+		sha1_hash const h = m_disk_lru.back();
+		auto const d = m_disk.find(h);
+		TORRENT_ASSERT(d != m_disk.end());
+		m_disk_size -= d->second.size;
+		m_disk_lru.pop_back();
+		m_disk.erase(d);
+		remove_file(h);
+	}
+}
+
+bool segment_cache::write_file(sha1_hash const& h, span<char const> seg)
+{
+	std::ofstream f(file_path(h), std::ios::binary | std::ios::trunc);
+	f.write(seg.data(), seg.size());
+	if (f.good()) return true;
+
+#ifndef TORRENT_DISABLE_LOGGING
+	m_logger.log_lazy(aux::LOG_WARNING, "segment cache: failed to write %s"
+		, aux::hex_arg(h));
+#endif
+	f.close();
+	remove_file(h);
+	return false;
+}
+
+bool segment_cache::read_file(sha1_hash const& h, int const size
+	, std::vector<char>& seg) const
+{
+	std::ifstream f(file_path(h), std::ios::binary);
+	seg.resize(std::size_t(size));
+	f.read(seg.data(), size);
+	return f.good() && f.gcount() == size;
+}
+
+void segment_cache::remove_file(sha1_hash const& h) const
+{
+	std::error_code ec;
+	std::filesystem::remove(file_path(h), ec);
+}
+
+std::string segment_cache::file_path(sha1_hash const& h) const
+{
+	return m_dir + "/" + aux::to_hex(h) + file_extension;
+}
+
+} // namespace assemble
+} // namespace ip2
@@ -0,0 +1,174 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "ip2/aux_/binary_log.hpp"
+#include "ip2/hex.hpp" // to_hex
+
+#include <cstdio> // for snprintf
+
+namespace ip2::aux {
+
+namespace {
+
+	using namespace log_detail;
+
+	// reads the arguments of a record back, in order
+	struct record_reader
+	{
+		explicit record_reader(span<char const> r) : m_record(r) {}
+
+		bool next(char& tag, std::uint64_t& value, span<char const>& bytes)
+		{
+			if (m_record.empty()) return false;
+			tag = m_record[0];
+			m_record = m_record.subspan(1);
+
+			if (tag == string_tag || tag == hex_tag)
+			{
+				std::uint32_t len;
+				if (m_record.size() < std::ptrdiff_t(sizeof(len))) return false;
+				std::memcpy(&len, m_record.data(), sizeof(len));
+				m_record = m_record.subspan(sizeof(len));
+				if (m_record.size() < std::ptrdiff_t(len)) return false;
+				bytes = m_record.first(len);
+				m_record = m_record.subspan(len);
+			}
+			else
+			{
+				if (m_record.size() < std::ptrdiff_t(sizeof(value))) return false;
+				std::memcpy(&value, m_record.data(), sizeof(value));
+				m_record = m_record.subspan(sizeof(value));
+			}
+			return true;
+		}
+
+	private:
+		span<char const> m_record;
+	};
+
+	template <typename T>
+	void append_format(std::string& out, std::string const& spec, T const v)
+	{
+		int const n = std::snprintf(nullptr, 0, spec.c_str(), v);
+		if (n <= 0) return;
+		std::size_t const pos = out.size();
+		out.resize(pos + std::size_t(n) + 1);
+		std::snprintf(&out[pos], std::size_t(n) + 1, spec.c_str(), v);
+		out.resize(pos + std::size_t(n));
+	}
+
+	bool is_float_conversion(char const c)
+	{
+		return std::strchr("eEfFgGaA", c) != nullptr;
+	}
+
+	bool is_unsigned_conversion(char const c)
+	{
+		return std::strchr("ouxX", c) != nullptr;
+	}
+}
+
+	std::vector<char>& log_record_buffer()
+	{
+		thread_local std::vector<char> buf;
+		buf.clear();
+		return buf;
+	}
+
+	std::string format_log_record(char const* fmt, span<char const> record)
+	{
+		std::string ret;
+		record_reader args(record);
+
+		char const* p = fmt;
+		while (*p != '\0')
+		{
+			if (*p != '%')
+			{
+				char const* end = std::strchr(p, '%');
+				if (end == nullptr) end = p + std::strlen(p);
+				ret.append(p, end);
+				p = end;
+				continue;
+			}
+
+			if (p[1] == '%')
+			{
+				ret += '%';
+				p += 2;
+				continue;
+			}
+
+			// keep the flags, width and precision of the conversion and drop
+			// its length modifier, which is picked from the recorded type
+			std::string spec = "%";
+			++p;
+			while (*p != '\0' && std::strchr("-+ #0123456789.", *p)) spec += *p++;
+			while (*p != '\0' && std::strchr("hlLqjzt", *p)) ++p;
+			char const conv = *p;
+			if (conv == '\0') break;
+			++p;
+
+			char tag;
+			std::uint64_t value = 0;
+			span<char const> bytes;
+			if (!args.next(tag, value, bytes))
+			{
+				ret += "<missing>";
+				continue;
+			}
+
+			switch (tag)
+			{
+				case signed_tag:
+				case unsigned_tag:
+				{
+					if (conv == 'c')
+						append_format(ret, spec + 'c', int(value));
+					else if (is_float_conversion(conv))
+						append_format(ret, spec + conv, tag == signed_tag
+							? double(std::int64_t(value)) : double(value));
+					else if (is_unsigned_conversion(conv))
+						append_format(ret, spec + "ll" + conv, static_cast<unsigned long long>(value));
+					else if (tag == signed_tag)
+						append_format(ret, spec + "lld", static_cast<long long>(std::int64_t(value)));
+					else
+						append_format(ret, spec + "llu", static_cast<unsigned long long>(value));
+					break;
+				}
+				case double_tag:
+				{
+					double d;
+					std::memcpy(&d, &value, sizeof(d));
+					append_format(ret, spec + (is_float_conversion(conv) ? conv : 'g'), d);
+					break;
+				}
+				case pointer_tag:
+					append_format(ret, spec + 'p'
+						, reinterpret_cast<void const*>(std::uintptr_t(value)));
+					break;
+				case string_tag:
+				case hex_tag:
+				{
+					std::string const s = tag == hex_tag
+						? aux::to_hex(bytes)
+						: std::string(bytes.data(), std::size_t(bytes.size()));
+					if (spec.size() == 1) ret += s;
+					else append_format(ret, spec + 's', s.c_str());
+					break;
+				}
+				default:
+					ret += "<invalid>";
+					return ret;
+			}
+		}
+
+		return ret;
+	}
+}
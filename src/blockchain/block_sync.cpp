@@ -0,0 +1,126 @@
+/*
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "ip2/blockchain/block_sync.hpp"
+#include "ip2/assert.hpp"
+
+namespace ip2::blockchain {
+
+    block_sync::block_sync(int const max_in_flight, int const max_blocks)
+        : m_max_in_flight(max_in_flight)
+        , m_max_blocks(max_blocks) {
+        TORRENT_ASSERT(max_in_flight > 0);
+    }
+
+    void block_sync::missing(dht::public_key const& peer, sha1_hash const& child, sha1_hash const& hash) {
+        if (idle()) m_peer = peer;
+
+        queue_list(child);
+
+        if (int(m_seen_blocks.size()) < m_max_blocks && m_seen_blocks.insert(hash).second) {
+            // the nearest block first, it's the one the branch waits on
+            m_blocks.push_front(hash);
+        }
+    }
+
+    void block_sync::ancestors_received(sha1_hash const& key, std::vector<sha1_hash> const& hashes
+            , std::function<bool(sha1_hash const&)> const& have) {
+        if (m_lists_in_flight.erase(key) == 0) return;
+
+        bool reached_known = false;
+        for (auto const& h: hashes) {
+            if (have(h)) {
+                reached_known = true;
+                break;
+            }
+            if (int(m_seen_blocks.size()) >= m_max_blocks) {
+                reached_known = true;
+                break;
+            }
+            if (m_seen_blocks.insert(h).second) m_blocks.push_back(h);
+        }
+
+        // the last block of the list is the checkpoint before ``key``, its
+        // list goes on from there
+        if (!reached_known && !hashes.empty()) queue_list(hashes.back());
+
+        maybe_reset();
+    }
+
+    void block_sync::ancestors_failed(sha1_hash const& key) {
+        m_lists_in_flight.erase(key);
+        maybe_reset();
+    }
+
+    void block_sync::block_done(sha1_hash const& hash) {
+        if (m_blocks_in_flight.erase(hash) == 0) return;
+        maybe_reset();
+    }
+
+    std::vector<block_sync::request> block_sync::pop_requests() {
+        std::vector<request> ret;
+
+        for (auto const& key: m_lists) {
+            m_lists_in_flight.insert(key);
+            ret.push_back({request::ancestors, key});
+        }
+        m_lists.clear();
+
+        while (!m_blocks.empty() && int(m_blocks_in_flight.size()) < m_max_in_flight) {
+            m_blocks_in_flight.insert(m_blocks.front());
+            ret.push_back({request::block, m_blocks.front()});
+            m_blocks.pop_front();
+        }
+
+        return ret;
+    }
+
+    bool block_sync::idle() const {
+        return m_blocks.empty() && m_blocks_in_flight.empty()
+            && m_lists.empty() && m_lists_in_flight.empty();
+    }
+
+    entry block_sync::ancestors_entry(std::vector<sha1_hash> const& hashes) {
+        entry::list_type e;
+        for (auto const& hash: hashes) {
+            e.push_back(hash.to_string());
+        }
+
+        return e;
+    }
+
+    bool block_sync::parse_ancestors(entry const& e, std::vector<sha1_hash>& hashes) {
+        hashes.clear();
+        if (e.type() != entry::list_t) return false;
+
+        // nothing sends more than that
+        auto const& lst = e.list();
+        if (int(lst.size()) > blockchain_checkpoint_interval) return false;
+
+        for (auto const& hash: lst) {
+            if (hash.type() != entry::string_t || hash.string().size() != std::size_t(sha1_hash::size())) {
+                hashes.clear();
+                return false;
+            }
+            hashes.emplace_back(hash.string().data());
+        }
+
+        return true;
+    }
+
+    void block_sync::maybe_reset() {
+        if (!idle()) return;
+
+        m_seen_blocks.clear();
+        m_seen_lists.clear();
+    }
+
+    void block_sync::queue_list(sha1_hash const& key) {
+        if (m_seen_lists.insert(key).second) m_lists.push_back(key);
+    }
+}
@@ -11,6 +11,8 @@ see LICENSE file.
 
 #include "ip2/blockchain/blockchain.hpp"
 #include "ip2/blockchain/consensus.hpp"
+#include "ip2/assemble/assembler.hpp"
+#include "ip2/aux_/session_settings.hpp"
 #include "ip2/common/entry_type.hpp"
 #include "ip2/kademlia/dht_tracker.hpp"
 #include "ip2/kademlia/ed25519.hpp"
@@ -21,6 +23,24 @@ using namespace std::placeholders;
 namespace ip2::blockchain {
     using namespace aux;
 
+namespace {
+
+    // the stateless checks of an item got from the DHT, done on the worker
+    // of its chain
+    verified_item verify_item(entry const& value, GET_ITEM_TYPE const type) {
+        switch (type) {
+            case GET_ITEM_TYPE::HEAD_BLOCK:
+            case GET_ITEM_TYPE::BLOCK:
+                return verify_block_item(value);
+            case GET_ITEM_TYPE::NOTE_TX:
+            case GET_ITEM_TYPE::TRANSFER_TX:
+                return verify_transaction_item(value);
+            default:
+                return verified_item();
+        }
+    }
+}
+
     bool blockchain::init() {
         try {
             // db init
@@ -33,6 +53,7 @@ namespace ip2::blockchain {
             m_chains = m_repository->get_all_chains();
             for (auto const& chain_id: m_chains) {
                 m_chain_connected[chain_id] = false;
+                add_short_chain_id(chain_id);
             }
         } catch (std::exception &e) {
             log(LOG_ERR, "Exception init [CHAIN] %s in file[%s], func[%s], line[%d]", e.what(), __FILE__, __FUNCTION__ , __LINE__);
@@ -45,23 +66,18 @@ namespace ip2::blockchain {
     bool blockchain::start()
     {
         log(LOG_INFO, "INFO: Start BlockChain...");
+
+        m_workers = std::make_unique<chain_workers>(m_ioc
+                , m_ses.settings().get_int(settings_pack::blockchain_verify_threads));
+
         if (!init()) {
             log(LOG_ERR, "ERROR: Init fail.");
             return false;
         }
 
-        for (auto const& chain_id: m_chains) {
-            try {
-                if (!init_chain(chain_id)) {
-                    log(LOG_ERR, "INFO: Init chain[%s] fail", aux::toHex(chain_id).c_str());
-                    m_chain_connected[chain_id] = true;
-                    return false;
-                }
-            } catch(std::exception &e) {
-                log(LOG_ERR, "Exception init chain %s in file[%s], func[%s], line[%d]", e.what(), __FILE__, __FUNCTION__ , __LINE__);
-                continue;
-            }
-        }
+        // the chains are loaded as they're connected, in the background
+        // or when they're used first, so the start doesn't grow with the
+        // number of the chains followed
 
         m_stop = false;
 
@@ -78,15 +94,16 @@ namespace ip2::blockchain {
     {
         m_stop = true;
 
+        if (m_workers) m_workers->stop();
+
         m_refresh_timer.cancel();
 
-        for (auto& timer: m_chain_timers) {
-            timer.second.cancel();
-        }
+        m_mining_timer.cancel();
 
         m_dht_tasks_timer.cancel();
 
-        for (auto const& chain_id: m_chains) {
+        // the acl of the chains not loaded is in the db already
+        for (auto const& chain_id: m_scheduler.loaded_chains()) {
             m_repository->clear_acl_db(chain_id);
             auto const &acl = m_access_list[chain_id];
             for (auto const& item: acl) {
@@ -122,8 +139,9 @@ namespace ip2::blockchain {
 
 //        m_refresh_timer.cancel();
 
-        for (auto& timer: m_chain_timers) {
-            timer.second.cancel();
+        // mine all the connected chains now
+        for (auto const& chain_id: m_scheduler.scheduled_chains()) {
+            schedule_mining(chain_id, 0);
         }
     }
 
@@ -181,15 +199,12 @@ namespace ip2::blockchain {
             }
             m_chains.insert(chain_id);
 
-            if (!init_chain(chain_id)) {
-                log(LOG_ERR, "INFO: Init chain[%s] fail", aux::toHex(chain_id).c_str());
-                return false;
-            }
-
             m_chain_connected[chain_id] = false;
 
             // connect chain
-            connect_chain(chain_id);
+            if (!activate_chain(chain_id)) {
+                return false;
+            }
 
             return true;
         } else {
@@ -203,7 +218,7 @@ namespace ip2::blockchain {
             return false;
         }
 
-        if (!m_chain_connected[chain_id]) {
+        if (!activate_chain(chain_id)) {
             log(LOG_ERR, "INFO: Unconnected chain[%s]", aux::toHex(chain_id).c_str());
             return false;
         }
@@ -255,11 +270,7 @@ namespace ip2::blockchain {
                 return false;
             }
 
-            // cancel
-            auto it_chain_timer = m_chain_timers.find(chain_id);
-            if (it_chain_timer != m_chain_timers.end()) {
-                it_chain_timer->second.cancel();
-            }
+            // remove chain cache, with its mining
 //            auto it_chain_status_timer = m_chain_status_timers.find(chain_id);
 //            if (it_chain_status_timer != m_chain_status_timers.end()) {
 //                it_chain_status_timer->second.cancel();
@@ -326,7 +337,7 @@ namespace ip2::blockchain {
         }
     }
 
-    bool blockchain::init_chain(const bytes &chain_id) {
+    void blockchain::add_short_chain_id(const bytes &chain_id) {
         aux::bytes short_chain_id;
         if (chain_id.size() > short_chain_id_length) {
             short_chain_id.insert(short_chain_id.end(), chain_id.begin(), chain_id.begin() + short_chain_id_length);
@@ -334,6 +345,10 @@ namespace ip2::blockchain {
             short_chain_id = chain_id;
         }
         m_short_chain_id_table[short_chain_id] = chain_id;
+    }
+
+    bool blockchain::init_chain(const bytes &chain_id) {
+        add_short_chain_id(chain_id);
 
         m_chain_getting_times[chain_id] = 0;
 
@@ -357,9 +372,59 @@ namespace ip2::blockchain {
         return true;
     }
 
+    bool blockchain::load_chain(const bytes &chain_id) {
+        if (m_scheduler.is_loaded(chain_id)) return true;
+
+        try {
+            if (!init_chain(chain_id)) {
+                log(LOG_ERR, "INFO: Init chain[%s] fail", aux::toHex(chain_id).c_str());
+                return false;
+            }
+        } catch (std::exception &e) {
+            log(LOG_ERR, "Exception init chain %s in file[%s], func[%s], line[%d]", e.what(), __FILE__, __FUNCTION__ , __LINE__);
+            return false;
+        }
+
+        m_scheduler.loaded(chain_id, get_total_milliseconds());
+        log(LOG_INFO, "INFO: Load chain[%s], loaded chains[%zu]", aux::toHex(chain_id).c_str(), m_scheduler.loaded_chains().size());
+
+        return true;
+    }
+
+    bool blockchain::activate_chain(const bytes &chain_id) {
+        if (m_chains.find(chain_id) == m_chains.end()) return false;
+
+        if (m_scheduler.activate(chain_id, get_total_milliseconds()) || !m_chain_connected[chain_id]) {
+            return connect_chain(chain_id);
+        }
+
+        return true;
+    }
+
+    void blockchain::park_chain(const bytes &chain_id) {
+        log(LOG_INFO, "INFO: Park idle chain[%s]", aux::toHex(chain_id).c_str());
+
+        // the chain is loaded from the db again when it's connected
+        m_repository->clear_acl_db(chain_id);
+        auto const &acl = m_access_list[chain_id];
+        for (auto const& item: acl) {
+            m_repository->add_peer_in_acl_db(chain_id, item.first);
+        }
+
+        clear_chain_cache(chain_id);
+
+        m_scheduler.park(chain_id);
+    }
+
     bool blockchain::connect_chain(const aux::bytes &chain_id) {
         log(LOG_INFO, "INFO: connect chain[%s]", aux::toHex(chain_id).c_str());
 
+        if (!load_chain(chain_id)) {
+            // not tried again in the background, only when it's used
+            m_scheduler.park(chain_id);
+            return false;
+        }
+
         if (!m_chain_connected[chain_id]) {
             peer_preparation(chain_id);
 
@@ -375,14 +440,8 @@ namespace ip2::blockchain {
 //            i->second.async_wait(std::bind(&blockchain::refresh_chain_status, self(), _1, chain_id));
 //        }
 
-            // create chain timer
-            m_chain_timers.emplace(chain_id, aux::deadline_timer(m_ioc));
             // start mining
-            auto it = m_chain_timers.find(chain_id);
-            if (it != m_chain_timers.end()) {
-                it->second.expires_after(milliseconds(150));
-                it->second.async_wait(std::bind(&blockchain::refresh_mining_timeout, self(), _1, chain_id));
-            }
+            schedule_mining(chain_id, 150);
 
             m_chain_connected[chain_id] = true;
         }
@@ -535,8 +594,10 @@ namespace ip2::blockchain {
         m_chains.clear();
         m_tx_pools.clear();
 //        m_chain_status.clear();
-        m_chain_timers.clear();
+        m_scheduler.clear();
 //        m_chain_status_timers.clear();
+        m_block_syncs.clear();
+        m_state_snapshots.clear();
         m_access_list.clear();
 //        m_blocks.clear();
         m_head_blocks.clear();
@@ -548,8 +609,10 @@ namespace ip2::blockchain {
         m_tx_pools[chain_id].clear();
         m_chain_connected.erase(chain_id);
 //        m_chain_status.erase(chain_id);
-        m_chain_timers.erase(chain_id);
+        m_scheduler.remove(chain_id);
 //        m_chain_status_timers.erase(chain_id);
+        m_block_syncs.erase(chain_id);
+        m_state_snapshots.erase(chain_id);
         m_access_list.erase(chain_id);
 //        m_blocks[chain_id].clear();
         m_head_blocks.erase(chain_id);
@@ -572,7 +635,25 @@ namespace ip2::blockchain {
             bool found = false;
             // 随机挑选一条
             for (auto const &chain_id: m_chains) {
-                if (!m_chain_connected[chain_id]) {
+                // the parked chains wait to be used
+                if (!m_chain_connected[chain_id] && !m_scheduler.is_parked(chain_id)) {
+                    // only the chains we mine, or with a recent head block, are worth
+                    // loading before they're used
+                    auto const head_block = m_repository->get_head_block(chain_id);
+                    if (!head_block.empty()) {
+                        m_scheduler.record_activity(chain_id, head_block.timestamp() * 1000);
+                    }
+                    if (m_repository->get_account(chain_id, *m_ses.pubkey()).power() > 0) {
+                        m_scheduler.set_miner(chain_id);
+                    }
+
+                    if (!m_scheduler.wants_connect(chain_id, get_total_milliseconds())) {
+                        // left unloaded until activate_chain()
+                        log(LOG_INFO, "INFO: Park inactive chain:%s", aux::toHex(chain_id).c_str());
+                        m_scheduler.park(chain_id);
+                        continue;
+                    }
+
                     log(LOG_INFO, "INFO: Select chain:%s", aux::toHex(chain_id).c_str());
                     connect_chain(chain_id);
 
@@ -602,51 +683,67 @@ namespace ip2::blockchain {
                 if (now >= m_last_dht_time + blockchain_min_refresh_time) {
                     auto const &dhtItem = m_tasks.front();
 //                log(LOG_INFO, "INFO: DHT item[%s]", dhtItem.to_string().c_str());
+                    // chain sync goes through the transporter like every other module, so
+                    // a resync can't take the dht budget from user facing relays
+                    auto *transporter = m_ses.transporter();
+                    api::error_code ok = api::TRANSPORT_STOPPED;
                     switch (dhtItem.m_type) {
                         case dht_item_type::DHT_GET: {
-
-                            m_ses.dht()->get_item(dhtItem.m_peer,
+                            if (!transporter) break;
+                            ok = transporter->get(dhtItem.m_peer, dhtItem.m_salt, dhtItem.m_timestamp,
                                                   std::bind(&blockchain::get_mutable_callback, self(),
                                                             dhtItem.m_chain_id, _1, _2, dhtItem.m_get_item_type,
                                                             dhtItem.m_timestamp, dhtItem.m_times),
-                                                  1, 8, 16, dhtItem.m_salt, dhtItem.m_timestamp);
+                                                  1, 8, 16, transport::CHAIN_SYNC_CLASS);
 
                             break;
                         }
                         case dht_item_type::DHT_PUT: {
-                            m_ses.dht()->put_item(dhtItem.m_data,
+                            if (!transporter) break;
+                            ok = transporter->put(dhtItem.m_data, dhtItem.m_salt,
                                                   std::bind(&blockchain::on_dht_put_mutable_item, self(), _1, _2),
-                                                  1, 8, 16, dhtItem.m_salt);
+                                                  1, 8, 16, transport::CHAIN_SYNC_CLASS);
 
                             break;
                         }
                         case dht_item_type::DHT_PUT_TX: {
-                            m_ses.dht()->put_item(dhtItem.m_data,
+                            if (!transporter) break;
+                            ok = transporter->put(dhtItem.m_data, dhtItem.m_salt,
                                                   std::bind(&blockchain::on_dht_put_transaction, self(),
                                                             dhtItem.m_chain_id, dhtItem.m_hash, _1, _2),
-                                                  1, 8, 16, dhtItem.m_salt);
+                                                  1, 8, 16, transport::CHAIN_SYNC_CLASS);
 
                             break;
                         }
                         case dht_item_type::DHT_SEND: {
-                            m_ses.dht()->send(dhtItem.m_peer, dhtItem.m_data, 1, 8, 16, 1,
-                                              std::bind(&blockchain::on_dht_relay_mutable_item, self(), _1, _2,
-                                                        dhtItem.m_peer));
+                            if (!transporter) break;
+                            ok = transporter->send(dhtItem.m_peer, dhtItem.m_data,
+                                                   std::bind(&blockchain::on_dht_relay_mutable_item, self(), _1, _2,
+                                                             dhtItem.m_peer),
+                                                   1, 8, 16, 1, transport::CHAIN_SYNC_CLASS);
 
                             break;
                         }
                         default: {
                             log(LOG_ERR, "INFO: Unknown type[%d]", dhtItem.m_type);
+                            ok = api::NO_ERROR;
                         }
                     }
 
+                    if (ok == api::NO_ERROR) {
 //                m_tasks_set.erase(dhtItem);
-                    m_tasks.pop();
+                        m_tasks.pop();
 //                if (m_tasks_set.size() != m_tasks.size()) {
 //                    log(LOG_ERR, "================:%s", dhtItem.to_string().c_str());
 //                }
 
-                    interval = blockchain_min_refresh_time;
+                        interval = blockchain_min_refresh_time;
+                    } else {
+                        // the chain sync queue of the transporter is full, keep the task
+                        // and try again once it has drained a bit
+                        log(LOG_INFO, "INFO: DHT task deferred, error[%d]", ok);
+                        interval = blockchain_max_refresh_time;
+                    }
                     m_last_dht_time = now;
                 } else {
                     interval = m_last_dht_time + blockchain_min_refresh_time - now;
@@ -682,13 +779,58 @@ namespace ip2::blockchain {
 //        }
 //    }
 
-    void blockchain::refresh_mining_timeout(const error_code &e, const aux::bytes &chain_id) {
-        if ((e.value() != 0 && e.value() != boost::asio::error::operation_aborted) || m_stop) {
-            log(LOG_ERR, "ERROR: refresh_mining_timeout:%d", e.value());
+    void blockchain::schedule_mining(const aux::bytes &chain_id, std::int64_t interval) {
+        time_point const deadline = clock_type::now() + milliseconds(interval);
+        m_scheduler.schedule(chain_id, deadline);
+
+        if (deadline < m_mining_timer_expiry) {
+            arm_mining_timer();
+        }
+    }
+
+    void blockchain::unschedule_mining(const aux::bytes &chain_id) {
+        m_scheduler.unschedule(chain_id);
+    }
+
+    void blockchain::arm_mining_timer() {
+        m_mining_timer_expiry = m_scheduler.next_expiry();
+        if (m_mining_timer_expiry == max_time()) {
+            m_mining_timer.cancel();
             return;
         }
 
+        auto const now = clock_type::now();
+        m_mining_timer.expires_after(m_mining_timer_expiry > now ? m_mining_timer_expiry - now : time_duration(0));
+        m_mining_timer.async_wait(std::bind(&blockchain::on_mining_timer, self(), _1));
+    }
+
+    void blockchain::on_mining_timer(const error_code &e) {
+        // aborted when it's armed again to an earlier chain
+        if (e.value() != 0 || m_stop) return;
+
+        m_mining_timer_expiry = max_time();
+
+        // all the chains due are off the wheel before any is mined
+        for (auto const& chain_id: m_scheduler.advance(clock_type::now())) {
+            refresh_mining_timeout(chain_id);
+        }
+
+        // no chain mined was scheduled again before the others
+        if (m_mining_timer_expiry == max_time()) {
+            arm_mining_timer();
+        }
+    }
+
+    void blockchain::refresh_mining_timeout(const aux::bytes &chain_id) {
+        if (m_stop) return;
+
         try {
+            if (!is_empty_chain(chain_id)
+                && m_scheduler.is_idle(chain_id, get_total_milliseconds())) {
+                park_chain(chain_id);
+                return;
+            }
+
 //            log(LOG_INFO, "INFO: 1. Chain[%s] status[%d]", aux::toHex(chain_id).c_str(), m_chain_status[chain_id]);
 
             long refresh_time = DEFAULT_BLOCK_TIME * 1000;
@@ -817,11 +959,7 @@ namespace ip2::blockchain {
             }
 
             log(LOG_INFO, "refresh time:%ld ", refresh_time);
-            auto it = m_chain_timers.find(chain_id);
-            if (it != m_chain_timers.end()) {
-                it->second.expires_after(milliseconds(refresh_time));
-                it->second.async_wait(std::bind(&blockchain::refresh_mining_timeout, self(), _1, chain_id));
-            }
+            schedule_mining(chain_id, refresh_time);
         } catch (std::exception &e) {
             log(LOG_ERR, "Exception init [CHAIN] %s in file[%s], func[%s], line[%d]", e.what(), __FILE__, __FUNCTION__ , __LINE__);
         }
@@ -1262,9 +1400,8 @@ namespace ip2::blockchain {
 //                try_to_rebranch_to_best_vote(chain_id);
 
                 // 6. try to mine block
-                auto it_timer = m_chain_timers.find(chain_id);
-                if (it_timer != m_chain_timers.end()) {
-                    it_timer->second.cancel();
+                if (m_scheduler.is_scheduled(chain_id)) {
+                    schedule_mining(chain_id, 0);
                 }
             } else {
                 if (blk.block_number() % CHAIN_EPOCH_BLOCK_SIZE == 0) {
@@ -1517,7 +1654,7 @@ namespace ip2::blockchain {
             if (reference_block.empty()) {
                 log(LOG_INFO, "INFO chain[%s] 4. Cannot find block[%s]",
                     aux::toHex(chain_id).c_str(), aux::toHex(previous_hash.to_string()).c_str());
-                get_block(chain_id, peer, previous_hash);
+                sync_missing_block(chain_id, peer, connect_blocks.back().sha1(), previous_hash);
                 return MISSING;
             }
         }
@@ -1563,7 +1700,7 @@ namespace ip2::blockchain {
             if (reference_block.empty()) {
                 log(LOG_INFO, "INFO chain[%s] 5.2 Cannot find block[%s]",
                     aux::toHex(chain_id).c_str(), aux::toHex(previous_hash.to_string()).c_str());
-                get_block(chain_id, peer, previous_hash);
+                sync_missing_block(chain_id, peer, connect_blocks.back().sha1(), previous_hash);
                 return MISSING;
             }
         }
@@ -2202,33 +2339,10 @@ namespace ip2::blockchain {
     void blockchain::get_genesis_state(const bytes &chain_id, sha1_hash &stateRoot, std::vector<state_array> &arrays) {
         auto all_state = m_repository->get_all_effective_state(chain_id);
         if (!all_state.empty()) {
-            std::vector<account> states;
-            for (auto const &state: all_state) {
-                states.push_back(state);
-                if (states.size() == MAX_STATE_ARRAY_SIZE) {
-                    state_array stateArray(states);
-                    arrays.push_back(stateArray);
-
-                    states.clear();
-                }
-            }
-
-            // the last one
-            if (!states.empty()) {
-                state_array stateArray(states);
-                arrays.push_back(stateArray);
-
-                states.clear();
-            }
-
-            if (!arrays.empty()) {
-                std::vector<sha1_hash> hashArray;
-                for (auto const &array: arrays) {
-                    hashArray.push_back(array.sha1());
-                }
-                state_hash_array stateHashArray(hashArray);
-                stateRoot = stateHashArray.sha1();
-            }
+            // cut the same way as the snapshot put of it
+            state_snapshot snapshot(all_state);
+            arrays.insert(arrays.end(), snapshot.arrays().begin(), snapshot.arrays().end());
+            stateRoot = snapshot.root();
         }
     }
 
@@ -2410,7 +2524,7 @@ namespace ip2::blockchain {
             log(LOG_INFO, "INFO: Unfollowed chain[%s]", aux::toHex(chain_id).c_str());
         }
 
-        if (!m_chain_connected[chain_id]) {
+        if (!activate_chain(chain_id)) {
             log(LOG_ERR, "INFO: Unconnected chain[%s]", aux::toHex(chain_id).c_str());
         }
 
@@ -2433,6 +2547,7 @@ namespace ip2::blockchain {
             std::vector<state_array> stateArrays;
             get_genesis_state(chain_id, stateRoot, stateArrays);
             put_block_with_all_state(chain_id, blk, stateArrays);
+            put_state_snapshot(chain_id, stateArrays);
             put_head_block_hash(chain_id, m_head_blocks[chain_id].sha1());
         }
     }
@@ -2442,7 +2557,7 @@ namespace ip2::blockchain {
             log(LOG_INFO, "INFO: Unfollowed chain[%s]", aux::toHex(chain_id).c_str());
         }
 
-        if (!m_chain_connected[chain_id]) {
+        if (!activate_chain(chain_id)) {
             log(LOG_ERR, "INFO: Unconnected chain[%s]", aux::toHex(chain_id).c_str());
         }
 
@@ -2461,6 +2576,7 @@ namespace ip2::blockchain {
             std::vector<state_array> stateArrays;
             get_genesis_state(chain_id, stateRoot, stateArrays);
             put_block_with_all_state(chain_id, blk, stateArrays);
+            put_state_snapshot(chain_id, stateArrays);
         }
     }
 
@@ -2469,7 +2585,7 @@ namespace ip2::blockchain {
             log(LOG_INFO, "INFO: Unfollowed chain[%s]", aux::toHex(chain_id).c_str());
         }
 
-        if (!m_chain_connected[chain_id]) {
+        if (!activate_chain(chain_id)) {
             log(LOG_ERR, "INFO: Unconnected chain[%s]", aux::toHex(chain_id).c_str());
         }
 
@@ -2484,11 +2600,16 @@ namespace ip2::blockchain {
 
         if (!is_empty_chain(chain_id)) {
             auto blk = m_head_blocks[chain_id];
+            put_block_ancestors(chain_id, blk);
             while (blk.block_number() % CHAIN_EPOCH_BLOCK_SIZE != 0) {
                 put_block(chain_id, blk);
+                if (blk.block_number() % blockchain_checkpoint_interval == 0) {
+                    put_block_ancestors(chain_id, blk);
+                }
                 blk = m_repository->get_block_by_hash(chain_id, blk.previous_block_hash());
             }
             put_block(chain_id, blk);
+            put_block_ancestors(chain_id, blk);
 
             put_head_block_hash(chain_id, m_head_blocks[chain_id].sha1());
         }
@@ -2584,6 +2705,7 @@ namespace ip2::blockchain {
     void blockchain::put_head_block(const bytes &chain_id, const block &blk) {
         if (!blk.empty()) {
             put_block(chain_id, blk);
+            put_block_ancestors(chain_id, blk);
             put_head_block_hash(chain_id, blk.sha1());
 
             send_new_head_block_signal(chain_id, blk.sha1());
@@ -2599,6 +2721,7 @@ namespace ip2::blockchain {
 
         if (!blk.empty() && !arrays.empty()) {
             put_block_with_all_state(chain_id, blk, arrays);
+            put_state_snapshot(chain_id, arrays);
 
             put_head_block_hash(chain_id, blk.sha1());
 
@@ -2654,7 +2777,111 @@ namespace ip2::blockchain {
     }
 
     void blockchain::get_all_state_from_peer(const bytes &chain_id, const dht::public_key &peer, const sha1_hash &hash) {
-        get_state_hash_array(chain_id, peer, hash);
+        if (m_ses.settings().get_bool(settings_pack::blockchain_fast_join) && m_ses.assembler()) {
+            get_state_snapshot(chain_id, peer, hash);
+        } else {
+            get_state_hash_array(chain_id, peer, hash);
+        }
+    }
+
+    void blockchain::put_state_snapshot(const bytes &chain_id, const std::vector<state_array> &arrays) {
+        if (!m_ses.assembler() || arrays.empty()) return;
+
+        state_snapshot snapshot(arrays);
+        for (int i = 0; i < snapshot.num_parts(); ++i) {
+            auto const part = snapshot.part(i);
+            auto const ec = m_ses.assembler()->put(span<char const>(part), state_snapshot::part_uri(snapshot.root(), i));
+            log(LOG_INFO, "INFO: Chain id[%s] Put state snapshot[%s] part[%d], size[%d], result[%d]",
+                aux::toHex(chain_id).c_str(), aux::toHex(snapshot.root()).c_str(), i, int(part.size()), ec);
+        }
+    }
+
+    void blockchain::get_state_snapshot(const bytes &chain_id, const dht::public_key &peer, const sha1_hash &hash) {
+        auto it = m_state_snapshots.find(chain_id);
+        if (it != m_state_snapshots.end() && it->second.root() == hash) {
+            log(LOG_INFO, "INFO: Chain[%s] state snapshot[%s] is being got", aux::toHex(chain_id).c_str(),
+                aux::toHex(hash).c_str());
+            return;
+        }
+
+        m_state_snapshots[chain_id] = state_snapshot(hash);
+        get_state_snapshot_part(chain_id, peer, hash, 0);
+    }
+
+    void blockchain::get_state_snapshot_part(const bytes &chain_id, const dht::public_key &peer, const sha1_hash &hash, int index) {
+        log(LOG_INFO, "INFO: Get state snapshot[%s] part[%d] from chain[%s] peer[%s]", aux::toHex(hash).c_str(),
+            index, aux::toHex(chain_id).c_str(), aux::toHex(peer.bytes).c_str());
+
+        auto const ec = m_ses.assembler()->get(peer, state_snapshot::part_uri(hash, index), dht::timestamp(0)
+                , std::bind(&blockchain::on_state_snapshot_part, self(), chain_id, peer, hash, index, _1, _2));
+        if (ec != api::NO_ERROR) {
+            on_state_snapshot_part(chain_id, peer, hash, index, nullptr, ec);
+        }
+    }
+
+    void blockchain::on_state_snapshot_part(aux::bytes const& chain_id, dht::public_key const& peer, sha1_hash const& hash
+            , int index, std::shared_ptr<assemble::blob_buffer const> const& blob, api::error_code ec) {
+        if (m_stop || m_chains.find(chain_id) == m_chains.end())
+            return;
+
+        auto it = m_state_snapshots.find(chain_id);
+        if (it == m_state_snapshots.end() || it->second.root() != hash)
+            return;
+
+        auto &snapshot = it->second;
+        bool const first = snapshot.num_parts() == 0;
+
+        try {
+            if (!blob || ec != api::NO_ERROR || !snapshot.add_part(index, blob->data())) {
+                // the peer put no snapshot, or a bad one
+                log(LOG_ERR, "INFO: Chain[%s] fail to get state snapshot[%s] part[%d], error[%d], get state arrays",
+                    aux::toHex(chain_id).c_str(), aux::toHex(hash).c_str(), index, ec);
+                m_state_snapshots.erase(it);
+                get_state_hash_array(chain_id, peer, hash);
+                return;
+            }
+        } catch (std::exception &e) {
+            log(LOG_ERR, "ERROR: Exception in state snapshot [CHAIN] %s in file[%s], func[%s], line[%d]",
+                e.what(), __FILE__, __FUNCTION__ , __LINE__);
+            m_state_snapshots.erase(it);
+            get_state_hash_array(chain_id, peer, hash);
+            return;
+        }
+
+        // the first part tells how many there are, the rest are got at once
+        if (first) {
+            int const num_parts = snapshot.num_parts();
+            for (int i = 0; i < num_parts; ++i) {
+                if (i != index) get_state_snapshot_part(chain_id, peer, hash, i);
+            }
+        }
+
+        // a failed get above may have dropped it
+        it = m_state_snapshots.find(chain_id);
+        if (it == m_state_snapshots.end() || it->second.root() != hash || !it->second.complete())
+            return;
+
+        log(LOG_INFO, "INFO: Chain[%s] got state snapshot[%s]", aux::toHex(chain_id).c_str(), aux::toHex(hash).c_str());
+
+        // the state arrays are checked, they're imported the way the ones got
+        // one by one are
+        for (auto const& stateArray: it->second.arrays()) {
+            m_ses.alerts().emplace_alert<blockchain_state_array_alert>(chain_id, stateArray.StateArray());
+            if (!m_repository->save_state_array(chain_id, stateArray)) {
+                log(LOG_ERR, "INFO: chain:%s, save state array[%s] fail.",
+                    aux::toHex(chain_id).c_str(), stateArray.to_string().c_str());
+            }
+        }
+
+        auto& acl = m_access_list[chain_id];
+        auto it_peer = acl.find(peer);
+        if (it_peer != acl.end()) {
+            it_peer->second.m_state_hash_array = it->second.hash_array();
+        }
+
+        m_state_snapshots.erase(it);
+
+        state_reception_event(chain_id, peer);
     }
 
 //    void blockchain::put_all_state(const bytes &chain_id) {
@@ -2791,6 +3018,71 @@ namespace ip2::blockchain {
         }
     }
 
+    void blockchain::get_block_ancestors(const bytes &chain_id, const dht::public_key &peer, const sha1_hash &hash) {
+        // salt is the block hash followed by the suffix, the hash is taken back from it
+        auto salt = make_salt(hash) + key_suffix_block_ancestors;
+
+        log(LOG_INFO, "INFO: Get block ancestors from chain[%s] peer[%s], salt:[%s]", aux::toHex(chain_id).c_str(),
+            aux::toHex(peer.bytes).c_str(), aux::toHex(salt).c_str());
+        subscribe(chain_id, peer, salt, GET_ITEM_TYPE::BLOCK_ANCESTORS);
+    }
+
+    void blockchain::put_block_ancestors(const bytes &chain_id, const block &blk) {
+        if (blk.empty()) return;
+
+        std::vector<sha1_hash> hashes;
+        auto b = blk;
+        while (b.block_number() > 0 && int(hashes.size()) < blockchain_checkpoint_interval) {
+            hashes.push_back(b.previous_block_hash());
+            // stop at the checkpoint, its own list goes on from there
+            if ((b.block_number() - 1) % blockchain_checkpoint_interval == 0) break;
+
+            b = m_repository->get_block_by_hash(chain_id, b.previous_block_hash());
+            if (b.empty()) break;
+        }
+
+        if (!hashes.empty()) {
+            auto salt = make_salt(blk.sha1()) + key_suffix_block_ancestors;
+
+            log(LOG_INFO, "INFO: Chain id[%s] Put block ancestors salt[%s]", aux::toHex(chain_id).c_str(), aux::toHex(salt).c_str());
+            publish(salt, block_sync::ancestors_entry(hashes));
+        }
+    }
+
+    void blockchain::sync_missing_block(const bytes &chain_id, const dht::public_key &peer, const sha1_hash &child, const sha1_hash &hash) {
+        auto it = m_block_syncs.find(chain_id);
+        if (it == m_block_syncs.end()) {
+            it = m_block_syncs.emplace(chain_id, block_sync(blockchain_max_sync_in_flight, blockchain_max_sync_blocks)).first;
+        }
+
+        it->second.missing(peer, child, hash);
+        sync_blocks(chain_id);
+    }
+
+    bool blockchain::sync_block_done(const bytes &chain_id, const sha1_hash &hash) {
+        auto it = m_block_syncs.find(chain_id);
+        if (it == m_block_syncs.end()) return false;
+
+        it->second.block_done(hash);
+        sync_blocks(chain_id);
+
+        return it->second.idle();
+    }
+
+    void blockchain::sync_blocks(const bytes &chain_id) {
+        auto it = m_block_syncs.find(chain_id);
+        if (it == m_block_syncs.end()) return;
+
+        auto &sync = it->second;
+        for (auto const& req: sync.pop_requests()) {
+            if (req.kind == block_sync::request::ancestors) {
+                get_block_ancestors(chain_id, sync.peer(), req.hash);
+            } else {
+                get_block(chain_id, sync.peer(), req.hash);
+            }
+        }
+    }
+
 //    void blockchain::get_transaction_wrapper(const bytes &chain_id, const dht::public_key &peer, const sha1_hash &hash, int times) {
 //        // salt is x pubkey when request signal
 //        auto salt = make_salt(hash);
@@ -2951,6 +3243,10 @@ namespace ip2::blockchain {
         if(!authoritative)
             return; 
 
+        // the chain was parked or unfollowed while it was got
+        if (!m_scheduler.is_loaded(chain_id))
+            return;
+
         // construct mutable data wrapper from entry
         try {
             const auto& peer = i.pk();
@@ -2980,80 +3276,20 @@ namespace ip2::blockchain {
 
                         break;
                     }
-                    case GET_ITEM_TYPE::HEAD_BLOCK: {
-                        block blk(i.value());
-
-                        if (!blk.empty()) {
-                            log(LOG_INFO, "INFO: Got head block[%s], time:%" PRId64,
-                                blk.to_string().c_str(), get_total_milliseconds());
-
-                            auto &acl = m_access_list[chain_id];
-                            auto it = acl.find(peer);
-                            if (it != acl.end()) {
-                                // only peer in acl is allowed
-                                it->second.m_head_block = blk;
-                                if (blk.block_number() % CHAIN_EPOCH_BLOCK_SIZE == 0) {
-                                    it->second.m_genesis_block = blk;
-                                }
-                            }
-
-                            if (blk.block_number() % CHAIN_EPOCH_BLOCK_SIZE == 0) {
-                                get_all_state_from_peer(chain_id, peer, blk.state_root());
-                            }
-
-                            if (!m_repository->save_block_if_not_exist(blk)) {
-                                log(LOG_ERR, "INFO: chain:%s, save remote head block[%s] fail.",
-                                    aux::toHex(chain_id).c_str(), blk.to_string().c_str());
-                            }
-
-                            // notify ui tx from block
-                            if (!blk.tx().empty()) {
-                                m_ses.alerts().emplace_alert<blockchain_new_transaction_alert>(blk.tx());
-                            }
-
-                            if (blk.cumulative_difficulty() > m_head_blocks[chain_id].cumulative_difficulty()) {
-                                m_ses.alerts().emplace_alert<blockchain_syncing_head_block_alert>(peer, blk);
-                            }
-
-                            block_reception_event(chain_id, peer, blk);
+                    case GET_ITEM_TYPE::HEAD_BLOCK:
+                    case GET_ITEM_TYPE::BLOCK:
+                    case GET_ITEM_TYPE::NOTE_TX:
+                    case GET_ITEM_TYPE::TRANSFER_TX: {
+                        // the next blocks of the sync are fetched while this
+                        // one is checked. The worker keeps the order of the chain
+                        if (type == GET_ITEM_TYPE::BLOCK) {
+                            sync_block_done(chain_id, sha1_hash(salt.data()));
                         }
 
-                        break;
-                    }
-                    case GET_ITEM_TYPE::BLOCK: {
-                        block blk(i.value());
-
-                        if (!blk.empty()) {
-                            log(LOG_INFO, "INFO: Got block[%s], time:%" PRId64,
-                                blk.to_string().c_str(), get_total_milliseconds());
-
-                            auto &acl = m_access_list[chain_id];
-                            auto it = acl.find(peer);
-                            if (it != acl.end()) {
-                                // only peer in acl is allowed
-                                if (blk.block_number() % CHAIN_EPOCH_BLOCK_SIZE == 0) {
-                                    it->second.m_genesis_block = blk;
-                                }
-                            }
-
-                            if (blk.block_number() % CHAIN_EPOCH_BLOCK_SIZE == 0) {
-                                get_all_state_from_peer(chain_id, peer, blk.state_root());
-                            }
-
-                            if (!m_repository->save_block_if_not_exist(blk)) {
-                                log(LOG_ERR, "INFO: chain:%s, save block[%s] fail.",
-                                    aux::toHex(chain_id).c_str(), blk.to_string().c_str());
-                            }
-
-                            // notify ui tx from block
-                            if (!blk.tx().empty()) {
-                                m_ses.alerts().emplace_alert<blockchain_new_transaction_alert>(blk.tx());
-                            }
-
-                            m_ses.alerts().emplace_alert<blockchain_syncing_block_alert>(peer, blk);
-
-                            block_reception_event(chain_id, peer, blk);
-                        }
+                        // decoded and checked on the worker of the chain, the
+                        // rest is done back on this thread
+                        m_workers->post(chain_id, [value = i.value(), type] { return verify_item(value, type); }
+                                , std::bind(&blockchain::on_item_verified, self(), chain_id, peer, type, _1));
 
                         break;
                     }
@@ -3111,48 +3347,6 @@ namespace ip2::blockchain {
 
                         break;
                     }
-                    case GET_ITEM_TYPE::NOTE_TX: {
-                        transaction tx(i.value());
-
-                        log(LOG_INFO, "INFO: Got note transaction [%s].", tx.to_string().c_str());
-
-                        if (!tx.empty() && tx.verify_signature() && tx.type() == tx_type::type_note) {
-
-                            log(LOG_INFO, "INFO: Got note transaction[%s].", tx.to_string().c_str());
-
-                            m_ses.alerts().emplace_alert<blockchain_new_transaction_alert>(tx);
-
-                            auto &pool = m_tx_pools[chain_id];
-
-                            if (pool.add_tx_to_time_pool(tx)) {
-                                put_note_transaction(chain_id, tx);
-                            }
-                        }
-
-                        break;
-                    }
-                    case GET_ITEM_TYPE::TRANSFER_TX: {
-                        transaction tx(i.value());
-
-                        if (!tx.empty() && tx.verify_signature() && tx.type() == tx_type::type_transfer) {
-
-                            log(LOG_INFO, "INFO: Got transfer transaction[%s].", tx.to_string().c_str());
-
-                            m_ses.alerts().emplace_alert<blockchain_new_transaction_alert>(tx);
-
-                            auto &pool = m_tx_pools[chain_id];
-                            if (pool.add_tx_to_fee_pool(tx)) {
-                                auto self_tx = pool.get_transaction_by_account(*m_ses.pubkey());
-                                auto best_tx = pool.get_best_fee_transaction();
-                                if (self_tx.empty() && best_tx == tx) {
-                                    // transfer tx only when self tx is not in pool and this tx is not the best
-                                    put_transfer_transaction(chain_id, tx);
-                                }
-                            }
-                        }
-
-                        break;
-                    }
                     case GET_ITEM_TYPE::NOTE_POOL_ROOT: {
                         sha1_hash note_pool_root(i.value().string().c_str());
                         log(LOG_INFO, "INFO: Got note pool root[%s]", aux::toHex(note_pool_root).c_str());
@@ -3184,6 +3378,32 @@ namespace ip2::blockchain {
 
                         break;
                     }
+                    case GET_ITEM_TYPE::BLOCK_ANCESTORS: {
+                        auto it = m_block_syncs.find(chain_id);
+                        if (it == m_block_syncs.end()) break;
+
+                        sha1_hash key(salt.data());
+                        std::vector<sha1_hash> hashes;
+                        if (!block_sync::parse_ancestors(i.value(), hashes)) {
+                            log(LOG_ERR, "INFO: Got bad block ancestors[%s].", i.value().to_string(true).c_str());
+                            it->second.ancestors_failed(key);
+                        } else {
+                            log(LOG_INFO, "INFO: Got %d block ancestors of block[%s].",
+                                int(hashes.size()), aux::toHex(key).c_str());
+                            it->second.ancestors_received(key, hashes, [&](sha1_hash const& h) {
+                                return !m_repository->get_block_by_hash(chain_id, h).empty();
+                            });
+                        }
+
+                        sync_blocks(chain_id);
+
+                        // all the blocks were there
+                        if (it->second.idle()) {
+                            try_to_rebranch_to_most_difficult_chain(chain_id, peer);
+                        }
+
+                        break;
+                    }
                     case GET_ITEM_TYPE::STATE_ARRAY: {
                         state_array stateArray(i.value());
                         log(LOG_INFO, "INFO: Got state array[%s].", stateArray.to_string().c_str());
@@ -3220,9 +3440,24 @@ namespace ip2::blockchain {
                         break;
                     }
                     case GET_ITEM_TYPE::BLOCK: {
+                        if (sync_block_done(chain_id, sha1_hash(salt.data()))) {
+                            try_to_rebranch_to_most_difficult_chain(chain_id, peer);
+                        }
                         request_all_blocks(chain_id, peer);
                         break;
                     }
+                    case GET_ITEM_TYPE::BLOCK_ANCESTORS: {
+                        // the peer didn't publish it, the blocks come a round trip each
+                        auto it = m_block_syncs.find(chain_id);
+                        if (it != m_block_syncs.end()) {
+                            it->second.ancestors_failed(sha1_hash(salt.data()));
+                            sync_blocks(chain_id);
+                            if (it->second.idle()) {
+                                try_to_rebranch_to_most_difficult_chain(chain_id, peer);
+                            }
+                        }
+                        break;
+                    }
                     case GET_ITEM_TYPE::NOTE_TX: {
                         if (times == 1) {
                             get_transaction(chain_id, peer, sha1_hash(salt.data()), times + 1);
@@ -3269,6 +3504,153 @@ namespace ip2::blockchain {
         }
     }
 
+    void blockchain::on_item_verified(aux::bytes const& chain_id, dht::public_key const& peer
+            , GET_ITEM_TYPE type, verified_item const& item)
+    {
+        if (m_stop || !m_scheduler.is_loaded(chain_id))
+            return;
+
+        if (!item.valid) {
+            log(LOG_ERR, "INFO: chain[%s] drop item of type[%d] from peer[%s], bad signature or encoding",
+                aux::toHex(chain_id).c_str(), type, aux::toHex(peer.bytes).c_str());
+            return;
+        }
+
+        try {
+            switch (type) {
+                case GET_ITEM_TYPE::HEAD_BLOCK: {
+                    auto const& blk = item.blk;
+
+                    if (!blk.empty()) {
+                        log(LOG_INFO, "INFO: Got head block[%s], time:%" PRId64,
+                            blk.to_string().c_str(), get_total_milliseconds());
+
+                        auto &acl = m_access_list[chain_id];
+                        auto it = acl.find(peer);
+                        if (it != acl.end()) {
+                            // only peer in acl is allowed
+                            it->second.m_head_block = blk;
+                            if (blk.block_number() % CHAIN_EPOCH_BLOCK_SIZE == 0) {
+                                it->second.m_genesis_block = blk;
+                            }
+                        }
+
+                        if (blk.block_number() % CHAIN_EPOCH_BLOCK_SIZE == 0) {
+                            get_all_state_from_peer(chain_id, peer, blk.state_root());
+                        }
+
+                        if (!m_repository->save_block_if_not_exist(blk)) {
+                            log(LOG_ERR, "INFO: chain:%s, save remote head block[%s] fail.",
+                                aux::toHex(chain_id).c_str(), blk.to_string().c_str());
+                        }
+
+                        // notify ui tx from block
+                        if (!blk.tx().empty()) {
+                            m_ses.alerts().emplace_alert<blockchain_new_transaction_alert>(blk.tx());
+                        }
+
+                        if (blk.cumulative_difficulty() > m_head_blocks[chain_id].cumulative_difficulty()) {
+                            m_ses.alerts().emplace_alert<blockchain_syncing_head_block_alert>(peer, blk);
+                        }
+
+                        block_reception_event(chain_id, peer, blk);
+                    }
+
+                    break;
+                }
+                case GET_ITEM_TYPE::BLOCK: {
+                    auto const& blk = item.blk;
+
+                    if (!blk.empty()) {
+                        log(LOG_INFO, "INFO: Got block[%s], time:%" PRId64,
+                            blk.to_string().c_str(), get_total_milliseconds());
+
+                        auto &acl = m_access_list[chain_id];
+                        auto it = acl.find(peer);
+                        if (it != acl.end()) {
+                            // only peer in acl is allowed
+                            if (blk.block_number() % CHAIN_EPOCH_BLOCK_SIZE == 0) {
+                                it->second.m_genesis_block = blk;
+                            }
+                        }
+
+                        if (blk.block_number() % CHAIN_EPOCH_BLOCK_SIZE == 0) {
+                            get_all_state_from_peer(chain_id, peer, blk.state_root());
+                        }
+
+                        if (!m_repository->save_block_if_not_exist(blk)) {
+                            log(LOG_ERR, "INFO: chain:%s, save block[%s] fail.",
+                                aux::toHex(chain_id).c_str(), blk.to_string().c_str());
+                        }
+
+                        // notify ui tx from block
+                        if (!blk.tx().empty()) {
+                            m_ses.alerts().emplace_alert<blockchain_new_transaction_alert>(blk.tx());
+                        }
+
+                        m_ses.alerts().emplace_alert<blockchain_syncing_block_alert>(peer, blk);
+
+                        // a branch being synced is walked once all its blocks are in
+                        auto it_sync = m_block_syncs.find(chain_id);
+                        if (it_sync == m_block_syncs.end() || it_sync->second.idle()) {
+                            block_reception_event(chain_id, peer, blk);
+                        }
+                    }
+
+                    break;
+                }
+                case GET_ITEM_TYPE::NOTE_TX: {
+                    auto const& tx = item.tx;
+
+                    log(LOG_INFO, "INFO: Got note transaction [%s].", tx.to_string().c_str());
+
+                    if (tx.type() == tx_type::type_note) {
+
+                        log(LOG_INFO, "INFO: Got note transaction[%s].", tx.to_string().c_str());
+
+                        m_ses.alerts().emplace_alert<blockchain_new_transaction_alert>(tx);
+
+                        auto &pool = m_tx_pools[chain_id];
+
+                        if (pool.add_tx_to_time_pool(tx)) {
+                            put_note_transaction(chain_id, tx);
+                        }
+                    }
+
+                    break;
+                }
+                case GET_ITEM_TYPE::TRANSFER_TX: {
+                    auto const& tx = item.tx;
+
+                    if (tx.type() == tx_type::type_transfer) {
+
+                        log(LOG_INFO, "INFO: Got transfer transaction[%s].", tx.to_string().c_str());
+
+                        m_ses.alerts().emplace_alert<blockchain_new_transaction_alert>(tx);
+
+                        auto &pool = m_tx_pools[chain_id];
+                        if (pool.add_tx_to_fee_pool(tx)) {
+                            auto self_tx = pool.get_transaction_by_account(*m_ses.pubkey());
+                            auto best_tx = pool.get_best_fee_transaction();
+                            if (self_tx.empty() && best_tx == tx) {
+                                // transfer tx only when self tx is not in pool and this tx is not the best
+                                put_transfer_transaction(chain_id, tx);
+                            }
+                        }
+                    }
+
+                    break;
+                }
+                default: {
+                    log(LOG_ERR, "INFO: Unknown type.");
+                }
+            }
+        } catch (std::exception &e) {
+            log(LOG_ERR, "ERROR: Exception in item verified [CHAIN] %s in file[%s], func[%s], line[%d]",
+                e.what(), __FILE__, __FUNCTION__ , __LINE__);
+        }
+    }
+
     // key is a 32-byte binary string, the public key to look up.
     // the salt is optional
 //    void blockchain::dht_get_mutable_item(aux::bytes const& chain_id, std::array<char, 32> key, std::string salt)
@@ -3472,7 +3854,7 @@ namespace ip2::blockchain {
                     return false;
                 }
 
-                if (!m_chain_connected[chain_id]) {
+                if (!activate_chain(chain_id)) {
                     log(LOG_ERR, "INFO: Unconnected chain[%s]", aux::toHex(chain_id).c_str());
                     return false;
                 }
@@ -3501,7 +3883,7 @@ namespace ip2::blockchain {
             return false;
         }
 
-        if (!m_chain_connected[chain_id]) {
+        if (!activate_chain(chain_id)) {
             log(LOG_ERR, "INFO: Unconnected chain[%s]", aux::toHex(chain_id).c_str());
             return false;
         }
@@ -3527,7 +3909,7 @@ namespace ip2::blockchain {
             return std::vector<block>();
         }
 
-        if (!m_chain_connected[chain_id]) {
+        if (!activate_chain(chain_id)) {
             log(LOG_ERR, "INFO: Unconnected chain[%s]", aux::toHex(chain_id).c_str());
             return std::vector<block>();
         }
@@ -3558,7 +3940,7 @@ namespace ip2::blockchain {
             return 0;
         }
 
-        if (!m_chain_connected[chain_id]) {
+        if (!activate_chain(chain_id)) {
             log(LOG_ERR, "INFO: Unconnected chain[%s]", aux::toHex(chain_id).c_str());
             return 0;
         }
@@ -3578,7 +3960,7 @@ namespace ip2::blockchain {
             return -1;
         }
 
-        if (!m_chain_connected[chain_id]) {
+        if (!activate_chain(chain_id)) {
             log(LOG_ERR, "INFO: Unconnected chain[%s]", aux::toHex(chain_id).c_str());
             return -1;
         }
@@ -3628,7 +4010,7 @@ namespace ip2::blockchain {
             return std::set<dht::public_key>();
         }
 
-        if (!m_chain_connected[chain_id]) {
+        if (!activate_chain(chain_id)) {
             log(LOG_ERR, "INFO: Unconnected chain[%s]", aux::toHex(chain_id).c_str());
             return std::set<dht::public_key>();
         }
@@ -3648,7 +4030,7 @@ namespace ip2::blockchain {
             return std::set<dht::public_key>();
         }
 
-        if (!m_chain_connected[chain_id]) {
+        if (!activate_chain(chain_id)) {
             log(LOG_ERR, "INFO: Unconnected chain[%s]", aux::toHex(chain_id).c_str());
             return std::set<dht::public_key>();
         }
@@ -3887,7 +4269,7 @@ namespace ip2::blockchain {
                 return;
             }
 
-            if (!m_chain_connected[chain_id]) {
+            if (!activate_chain(chain_id)) {
                 log(LOG_ERR, "INFO: Unconnected chain[%s]", aux::toHex(chain_id).c_str());
                 return;
             }
@@ -0,0 +1,131 @@
+/*
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "ip2/blockchain/chain_scheduler.hpp"
+
+#include <algorithm>
+
+namespace ip2::blockchain {
+
+    chain_scheduler::chain_scheduler(time_duration const resolution, time_point const now)
+        : m_wheel(resolution, now) {}
+
+    bool chain_scheduler::is_loaded(aux::bytes const& chain_id) const {
+        return m_loaded.find(chain_id) != m_loaded.end();
+    }
+
+    bool chain_scheduler::is_parked(aux::bytes const& chain_id) const {
+        return m_parked.find(chain_id) != m_parked.end();
+    }
+
+    bool chain_scheduler::wants_connect(aux::bytes const& chain_id, std::int64_t const now) const {
+        if (is_loaded(chain_id) || is_parked(chain_id)) return false;
+        if (is_miner(chain_id)) return true;
+
+        // a chain with no activity at all isn't idle, it isn't active either
+        return m_last_active.find(chain_id) != m_last_active.end() && !is_idle(chain_id, now);
+    }
+
+    void chain_scheduler::record_activity(aux::bytes const& chain_id, std::int64_t const when) {
+        auto& last = m_last_active[chain_id];
+        last = std::max(last, when);
+    }
+
+    void chain_scheduler::set_miner(aux::bytes const& chain_id) {
+        m_miners.insert(chain_id);
+    }
+
+    bool chain_scheduler::is_miner(aux::bytes const& chain_id) const {
+        return m_miners.find(chain_id) != m_miners.end();
+    }
+
+    bool chain_scheduler::activate(aux::bytes const& chain_id, std::int64_t const now) {
+        m_last_active[chain_id] = now;
+        return !is_loaded(chain_id);
+    }
+
+    void chain_scheduler::loaded(aux::bytes const& chain_id, std::int64_t const now) {
+        m_loaded.insert(chain_id);
+        m_parked.erase(chain_id);
+        // a chain connected in the background counts as used from then
+        record_activity(chain_id, now);
+    }
+
+    bool chain_scheduler::is_idle(aux::bytes const& chain_id, std::int64_t const now) const {
+        auto const it = m_last_active.find(chain_id);
+        return it != m_last_active.end() && now - it->second > blockchain_chain_idle_time;
+    }
+
+    void chain_scheduler::park(aux::bytes const& chain_id) {
+        remove(chain_id);
+        m_parked.insert(chain_id);
+    }
+
+    void chain_scheduler::remove(aux::bytes const& chain_id) {
+        unschedule(chain_id);
+        m_loaded.erase(chain_id);
+        m_parked.erase(chain_id);
+        m_last_active.erase(chain_id);
+        m_miners.erase(chain_id);
+    }
+
+    void chain_scheduler::clear() {
+        for (auto const& item: m_timers) {
+            m_wheel.remove(item.second);
+        }
+        m_timers.clear();
+        m_loaded.clear();
+        m_parked.clear();
+        m_last_active.clear();
+        m_miners.clear();
+    }
+
+    void chain_scheduler::schedule(aux::bytes const& chain_id, time_point const deadline) {
+        unschedule(chain_id);
+        m_timers[chain_id] = m_wheel.add(deadline, chain_id);
+    }
+
+    void chain_scheduler::unschedule(aux::bytes const& chain_id) {
+        auto it = m_timers.find(chain_id);
+        if (it != m_timers.end()) {
+            m_wheel.remove(it->second);
+            m_timers.erase(it);
+        }
+    }
+
+    bool chain_scheduler::is_scheduled(aux::bytes const& chain_id) const {
+        return m_timers.find(chain_id) != m_timers.end();
+    }
+
+    std::vector<aux::bytes> chain_scheduler::scheduled_chains() const {
+        std::vector<aux::bytes> ret;
+        ret.reserve(m_timers.size());
+        for (auto const& item: m_timers) {
+            ret.push_back(item.first);
+        }
+        return ret;
+    }
+
+    time_point chain_scheduler::next_expiry() const {
+        return m_wheel.next_expiry();
+    }
+
+    std::vector<aux::bytes> chain_scheduler::advance(time_point const now) {
+        std::vector<aux::bytes> chains;
+        m_wheel.advance(now, chains);
+
+        // the handles of the expired timers are gone with them. They're all
+        // dropped before any chain is mined, or unscheduling one mined later
+        // would remove it from the wheel a second time
+        for (auto const& chain_id: chains) {
+            m_timers.erase(chain_id);
+        }
+
+        return chains;
+    }
+}
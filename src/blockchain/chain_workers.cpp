@@ -0,0 +1,92 @@
+/*
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include <string_view>
+#include <thread>
+
+#include "ip2/blockchain/chain_workers.hpp"
+#include "ip2/assert.hpp"
+
+namespace ip2::blockchain {
+
+    struct chain_workers::shard {
+        shard() : work(make_work_guard(ioc)) {}
+
+        io_context ioc;
+        executor_work_guard<io_context::executor_type> work;
+        std::thread thread;
+    };
+
+    chain_workers::chain_workers(io_context& ioc, int const num_threads)
+        : m_ioc(ioc) {
+        TORRENT_ASSERT(num_threads >= 0);
+
+        for (int i = 0; i < num_threads; ++i) {
+            m_shards.emplace_back(new shard);
+            shard& s = *m_shards.back();
+            s.thread = std::thread([&s] { s.ioc.run(); });
+        }
+    }
+
+    chain_workers::~chain_workers() {
+        stop();
+    }
+
+    void chain_workers::stop() {
+        m_stopped = true;
+
+        for (auto& s : m_shards) {
+            s->work.reset();
+            s->ioc.stop();
+        }
+
+        for (auto& s : m_shards) {
+            if (s->thread.joinable()) s->thread.join();
+        }
+
+        m_shards.clear();
+    }
+
+    verified_item verify_block_item(entry const& value) {
+        verified_item ret;
+        try {
+            ret.blk = block(value);
+            auto const& tx = ret.blk.tx();
+            ret.valid = !ret.blk.empty() && ret.blk.verify_signature()
+                    && (tx.empty() || (tx.chain_id() == ret.blk.chain_id() && tx.verify_signature()));
+        } catch (std::exception const&) {
+            // a peer can send anything. It mustn't take the worker down
+            ret = verified_item();
+        }
+        return ret;
+    }
+
+    verified_item verify_transaction_item(entry const& value) {
+        verified_item ret;
+        try {
+            ret.tx = transaction(value);
+            ret.valid = !ret.tx.empty() && ret.tx.verify_signature();
+        } catch (std::exception const&) {
+            ret = verified_item();
+        }
+        return ret;
+    }
+
+    void chain_workers::post_impl(aux::bytes const& chain_id, std::function<void()> f) {
+        if (m_stopped) return;
+
+        if (m_shards.empty()) {
+            ip2::post(m_ioc, std::move(f));
+            return;
+        }
+
+        std::size_t const idx = std::hash<std::string_view>{}(std::string_view(
+                reinterpret_cast<char const*>(chain_id.data()), chain_id.size())) % m_shards.size();
+        ip2::post(m_shards[idx]->ioc, std::move(f));
+    }
+}
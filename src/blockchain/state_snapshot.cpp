@@ -0,0 +1,152 @@
+/*
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "ip2/blockchain/state_snapshot.hpp"
+#include "ip2/blockchain/constants.hpp"
+#include "ip2/bdecode.hpp"
+#include "ip2/bencode.hpp"
+#include "ip2/hasher.hpp"
+
+#include <algorithm>
+
+namespace ip2::blockchain {
+
+    namespace {
+        // the snapshot part key suffix
+        const std::string key_suffix_state_snapshot = "state_snapshot";
+
+        // no state is bigger than that
+        constexpr int max_state_arrays = (MAX_ACCOUNT_SIZE + MAX_STATE_ARRAY_SIZE - 1) / MAX_STATE_ARRAY_SIZE;
+    }
+
+    state_snapshot::state_snapshot(std::vector<account> const& accounts) {
+        std::vector<state_array> arrays;
+        std::vector<account> states;
+        for (auto const& act: accounts) {
+            states.push_back(act);
+            if (states.size() == MAX_STATE_ARRAY_SIZE) {
+                arrays.emplace_back(states);
+                states.clear();
+            }
+        }
+
+        // the last one
+        if (!states.empty()) {
+            arrays.emplace_back(states);
+        }
+
+        *this = state_snapshot(std::move(arrays));
+    }
+
+    state_snapshot::state_snapshot(std::vector<state_array> arrays)
+        : m_arrays(std::move(arrays)) {
+        std::vector<sha1_hash> hashes;
+        for (auto const& array: m_arrays) {
+            hashes.push_back(array.sha1());
+        }
+        m_hash_array = state_hash_array(hashes);
+        m_root = m_hash_array.sha1();
+    }
+
+    aux::uri state_snapshot::part_uri(sha1_hash const& root, int const index) {
+        std::string data = root.to_string();
+        data.append(key_suffix_state_snapshot);
+        data.append(std::to_string(index));
+        auto const hash = hasher(data).final();
+
+        return aux::uri(hash.data());
+    }
+
+    int state_snapshot::num_parts() const {
+        int const n = int(m_hash_array.HashArray().size());
+        return (n + state_snapshot_arrays_per_part - 1) / state_snapshot_arrays_per_part;
+    }
+
+    std::string state_snapshot::part(int const index) const {
+        TORRENT_ASSERT(index >= 0 && index < num_parts());
+
+        entry::list_type arrays;
+        int const begin = index * state_snapshot_arrays_per_part;
+        int const end = std::min(begin + state_snapshot_arrays_per_part, int(m_arrays.size()));
+        for (int i = begin; i < end; ++i) {
+            arrays.push_back(m_arrays[std::size_t(i)].get_entry());
+        }
+
+        entry e(entry::dictionary_t);
+        e["p"] = index;
+        e["h"] = m_hash_array.get_entry();
+        e["a"] = arrays;
+
+        std::string encode;
+        bencode(std::back_inserter(encode), e);
+
+        return encode;
+    }
+
+    bool state_snapshot::add_part(int const index, span<char const> blob) {
+        error_code ec;
+        bdecode_node const n = bdecode(blob, ec);
+        if (ec || n.type() != bdecode_node::dict_t) return false;
+
+        bdecode_node const p = n.dict_find_int("p");
+        bdecode_node const h = n.dict_find_list("h");
+        bdecode_node const a = n.dict_find_list("a");
+        if (!p || !h || !a) return false;
+
+        // a valid part replayed under another part's uri would never let
+        // the snapshot complete
+        if (p.int_value() != index) return false;
+
+        // the state hash array has to be the one committed to
+        if (h.list_size() == 0 || h.list_size() > max_state_arrays) return false;
+        std::vector<sha1_hash> hashes;
+        for (int i = 0; i < h.list_size(); ++i) {
+            auto const hash = h.list_string_value_at(i);
+            if (int(hash.size()) != sha1_hash::size()) return false;
+            hashes.emplace_back(hash.data());
+        }
+        state_hash_array hash_array(hashes);
+        if (hash_array.sha1() != m_root) return false;
+
+        if (m_hash_array.empty()) {
+            m_hash_array = hash_array;
+            m_arrays.resize(hashes.size());
+        }
+
+        if (index < 0 || index >= num_parts()) return false;
+
+        int const begin = index * state_snapshot_arrays_per_part;
+        int const count = std::min(state_snapshot_arrays_per_part, int(hashes.size()) - begin);
+        if (a.list_size() != count) return false;
+
+        // every state array is checked before it's decoded
+        std::vector<entry> arrays;
+        for (int i = 0; i < count; ++i) {
+            auto const array = a.list_at(i);
+            if (array.type() != bdecode_node::list_t) return false;
+            if (hasher(array.data_section()).final() != hashes[std::size_t(begin + i)]) return false;
+            arrays.emplace_back(array);
+        }
+
+        for (int i = 0; i < count; ++i) {
+            m_arrays[std::size_t(begin + i)] = state_array(arrays[std::size_t(i)]);
+        }
+
+        return true;
+    }
+
+    bool state_snapshot::complete() const {
+        if (m_hash_array.empty()) return false;
+
+        for (auto const& array: m_arrays) {
+            if (array.empty()) return false;
+        }
+
+        return true;
+    }
+}
@@ -44,6 +44,14 @@ namespace ip2 {
 //
 //            m_refresh_timer.cancel();
 
+            m_commit_timer.cancel();
+            if (!m_message_db->commit_messages()) {
+                log(LOG_ERR, "ERROR: Commit messages fail!");
+            }
+
+            m_retry_timer.cancel();
+            m_deferred.clear();
+
             clear();
 
             log(LOG_INFO, "INFO: Stop Communication...");
@@ -94,6 +102,57 @@ namespace ip2 {
             return true;
         }
 
+        void communication::commit_messages_later() {
+            if (m_commit_timer_armed || m_message_db->uncommitted_messages() == 0) return;
+
+            m_commit_timer_armed = true;
+            m_commit_timer.expires_after(milliseconds(message_db_commit_window));
+            m_commit_timer.async_wait(std::bind(&communication::on_commit_timer, self(), _1));
+        }
+
+        void communication::on_commit_timer(error_code const& e) {
+            m_commit_timer_armed = false;
+            if (e) return;
+
+            if (!m_message_db->commit_messages()) {
+                log(LOG_ERR, "ERROR: Commit messages fail!");
+            }
+        }
+
+        void communication::submit(deferred_rpc rpc) {
+            auto *transporter = m_ses.transporter();
+            api::error_code ok = transporter ? rpc.call() : api::TRANSPORT_STOPPED;
+            if (ok == api::NO_ERROR) return;
+
+            if (ok == api::TRANSPORT_BUFFER_FULL && int(m_deferred.size()) < communication_max_deferred_rpcs) {
+                // the queue of this class is full, keep the rpc and try again
+                // once it has drained a bit
+                log(LOG_INFO, "INFO: %s deferred, error[%d]", rpc.what.c_str(), ok);
+                m_deferred.push_back(std::move(rpc));
+
+                if (!m_retry_timer_armed) {
+                    m_retry_timer_armed = true;
+                    m_retry_timer.expires_after(milliseconds(communication_retry_interval));
+                    m_retry_timer.async_wait(std::bind(&communication::on_retry_timer, self(), _1));
+                }
+                return;
+            }
+
+            log(LOG_ERR, "ERR: %s failed, error[%d]", rpc.what.c_str(), ok);
+        }
+
+        void communication::on_retry_timer(error_code const& e) {
+            m_retry_timer_armed = false;
+            if (e) return;
+
+            // the ones still not taken are deferred again
+            std::vector<deferred_rpc> rpcs;
+            rpcs.swap(m_deferred);
+            for (auto& rpc: rpcs) {
+                submit(std::move(rpc));
+            }
+        }
+
         void communication::clear() {
             m_friends.clear();
 //            m_message_list_map.clear();
@@ -362,6 +421,7 @@ namespace ip2 {
             if (!m_message_db->save_message_if_not_exist(msg)) {
                 log(LOG_ERR, "ERROR: Save message[%s] fail!", msg.to_string().c_str());
             }
+            commit_messages_later();
 
             put_new_message(msg);
 //            add_new_message(msg.receiver(), msg, post_alert);
@@ -861,6 +921,7 @@ namespace ip2 {
                                 if (!m_message_db->save_message_if_not_exist(messageWrapper.msg())) {
                                     log(LOG_ERR, "INFO: Save message[%s] fail.", messageWrapper.msg().to_string().c_str());
                                 }
+                                commit_messages_later();
 
                                 put_confirmation_roots(peer);
 
@@ -1043,29 +1104,42 @@ namespace ip2 {
 //        } // anonymous namespace
 
         void communication::publish(const std::string& salt, const entry& data) {
-            if (!m_ses.dht()) return;
+            if (!m_ses.transporter()) return;
             log(LOG_INFO, "INFO: Publish salt[%s], data[%s]", aux::toHex(salt).c_str(), data.to_string(true).c_str());
-            m_ses.dht()->put_item(data, std::bind(&communication::on_dht_put_mutable_item, self(), _1, _2)
-                    , 1, 8, 16, salt);
+            submit({"Publish salt[" + aux::toHex(salt) + "]", [this, salt, data] {
+                return m_ses.transporter()->put(data, salt
+                        , std::bind(&communication::on_dht_put_mutable_item, self(), _1, _2)
+                        , 1, 8, 16, transport::MAINTENANCE_CLASS);
+            }});
         }
 
         void communication::publish_message_wrapper(dht::public_key const& peer, const sha1_hash &hash, const std::string &salt, const entry &data) {
-            if (!m_ses.dht()) return;
+            if (!m_ses.transporter()) return;
             log(LOG_INFO, "INFO: Publish message wrapper salt[%s], data[%s]", aux::toHex(salt).c_str(), data.to_string(true).c_str());
-            m_ses.dht()->put_item(data, std::bind(&communication::on_dht_put_message_wrapper, self(), peer, hash, _1, _2)
-                    , 1, 8, 16, salt);
+            submit({"Publish message wrapper salt[" + aux::toHex(salt) + "]", [this, peer, hash, salt, data] {
+                return m_ses.transporter()->put(data, salt
+                        , std::bind(&communication::on_dht_put_message_wrapper, self(), peer, hash, _1, _2)
+                        , 1, 8, 16, transport::BLOB_PUT_CLASS);
+            }});
         }
 
         void communication::subscribe(const dht::public_key &peer, const std::string &salt, COMMUNICATION_GET_ITEM_TYPE type, std::int64_t timestamp, int times) {
-            if (!m_ses.dht()) return;
-            m_ses.dht()->get_item(peer, std::bind(&communication::get_mutable_callback, self(), _1, _2, type, timestamp, times), 1, 8, 16, salt, timestamp);
+            if (!m_ses.transporter()) return;
+            submit({"Subscribe from peer[" + aux::toHex(peer.bytes) + "]", [this, peer, salt, type, timestamp, times] {
+                return m_ses.transporter()->get(peer, salt, timestamp
+                        , std::bind(&communication::get_mutable_callback, self(), _1, _2, type, timestamp, times)
+                        , 1, 8, 16, transport::BLOB_GET_CLASS);
+            }});
         }
 
         void communication::send_to(const dht::public_key &peer, const entry &data) {
-            if (!m_ses.dht()) return;
+            if (!m_ses.transporter()) return;
             log(LOG_INFO, "Send [%s] to peer[%s]", data.to_string(true).c_str(), aux::toHex(peer.bytes).c_str());
-            m_ses.dht()->send(peer, data, 1, 8, 16, 1,
-                              std::bind(&communication::on_dht_relay_mutable_item, self(), _1, _2, peer));
+            submit({"Send to peer[" + aux::toHex(peer.bytes) + "]", [this, peer, data] {
+                return m_ses.transporter()->send(peer, data
+                        , std::bind(&communication::on_dht_relay_mutable_item, self(), _1, _2, peer)
+                        , 1, 8, 16, 1, transport::RELAY_CLASS);
+            }});
         }
 
         void communication::send_new_message_signal(const dht::public_key &peer, const sha1_hash &hash) {
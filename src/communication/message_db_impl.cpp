@@ -11,9 +11,37 @@
 #include "ip2/kademlia/types.hpp"
 #include "ip2/communication/message_db_impl.hpp"
 
+#include <algorithm>
+
 namespace ip2 {
     namespace communication {
 
+        namespace {
+            // resets a cached statement when the query is done with it
+            struct statement_reset {
+                explicit statement_reset(sqlite3_stmt *stmt) : m_stmt(stmt) {}
+                statement_reset(statement_reset const&) = delete;
+                statement_reset& operator=(statement_reset const&) = delete;
+                ~statement_reset() {
+                    sqlite3_reset(m_stmt);
+                    sqlite3_clear_bindings(m_stmt);
+                }
+
+            private:
+                sqlite3_stmt *m_stmt;
+            };
+
+            // the latest messages first, ``limit`` of them at most
+            void keep_latest(std::vector<communication::message> &messages, std::size_t limit) {
+                std::stable_sort(messages.begin(), messages.end(), [](message const& l, message const& r) {
+                    return l.timestamp() > r.timestamp();
+                });
+                if (messages.size() > limit) {
+                    messages.resize(limit);
+                }
+            }
+        }
+
 //        namespace {
 //            // friend info key suffix
 //            const std::string key_suffix_friend_info = "fi";
@@ -21,6 +49,30 @@ namespace ip2 {
 //            const std::string key_suffix_message_hash_list = "mhl";
 //        }
 
+        message_db_impl::~message_db_impl() {
+            for (auto const& item: m_statements) {
+                sqlite3_finalize(item.second);
+            }
+        }
+
+        sqlite3_stmt *message_db_impl::statement(char const *sql) {
+            auto it = m_statements.find(sql);
+            if (it != m_statements.end()) {
+                return it->second;
+            }
+
+            sqlite3_stmt * stmt = nullptr;
+            int ok = sqlite3_prepare_v2(m_sqlite, sql, -1, &stmt, nullptr);
+            if (ok != SQLITE_OK) {
+                sqlite3_finalize(stmt);
+                return nullptr;
+            }
+
+            m_statements.emplace(sql, stmt);
+
+            return stmt;
+        }
+
         // table friends: public key
         bool message_db_impl::init() {
             if (!create_table_friends()) {
@@ -49,10 +101,9 @@ namespace ip2 {
         std::vector<dht::public_key> message_db_impl::get_all_friends() {
             std::vector<dht::public_key> friends;
 
-            sqlite3_stmt * stmt;
-            std::string sql = "SELECT * FROM FRIENDS";
-            int ok = sqlite3_prepare_v2(m_sqlite, sql.c_str(), -1, &stmt, nullptr);
-            if (ok == SQLITE_OK) {
+            sqlite3_stmt * stmt = statement("SELECT * FROM FRIENDS");
+            if (stmt != nullptr) {
+                statement_reset reset(stmt);
                 for (;sqlite3_step(stmt) == SQLITE_ROW;) {
                     const char *p = static_cast<const char *>(sqlite3_column_blob(stmt, 0));
                     dht::public_key pubKey(p);
@@ -60,41 +111,35 @@ namespace ip2 {
                 }
             }
 
-            sqlite3_finalize(stmt);
-
             return friends;
         }
 
         bool message_db_impl::save_friend(const ip2::dht::public_key &pubKey) {
-            sqlite3_stmt * stmt;
-            std::string sql = "INSERT INTO FRIENDS VALUES(?)";
-            int ok = sqlite3_prepare_v2(m_sqlite, sql.c_str(), -1, &stmt, nullptr);
-            if (ok != SQLITE_OK) {
+            sqlite3_stmt * stmt = statement("INSERT INTO FRIENDS VALUES(?)");
+            if (stmt == nullptr) {
                 return false;
             }
+            statement_reset reset(stmt);
             sqlite3_bind_blob(stmt, 1, pubKey.bytes.data(), dht::public_key::len, nullptr);
-            ok = sqlite3_step(stmt);
+            int ok = sqlite3_step(stmt);
             if (ok != SQLITE_DONE) {
                 return false;
             }
-            sqlite3_finalize(stmt);
 
             return true;
         }
 
         bool message_db_impl::delete_friend(const dht::public_key &pubKey) {
-            sqlite3_stmt * stmt;
-            std::string sql = "DELETE FROM FRIENDS WHERE PUBKEY=?";
-            int ok = sqlite3_prepare_v2(m_sqlite, sql.c_str(), -1, &stmt, nullptr);
-            if (ok != SQLITE_OK) {
+            sqlite3_stmt * stmt = statement("DELETE FROM FRIENDS WHERE PUBKEY=?");
+            if (stmt == nullptr) {
                 return false;
             }
+            statement_reset reset(stmt);
             sqlite3_bind_blob(stmt, 1, pubKey.bytes.data(), dht::public_key::len, nullptr);
-            ok = sqlite3_step(stmt);
+            int ok = sqlite3_step(stmt);
             if (ok != SQLITE_DONE) {
                 return false;
             }
-            sqlite3_finalize(stmt);
 
             return true;
         }
@@ -112,36 +157,89 @@ namespace ip2 {
         }
 
         bool message_db_impl::save_message_if_not_exist(const message &msg) {
-            sqlite3_stmt * stmt;
-            std::string sql = "INSERT INTO MESSAGES (HASH,SENDER,RECEIVER,TIMESTAMP,PAYLOAD) SELECT ?,?,?,?,? WHERE NOT EXISTS(SELECT * FROM MESSAGES WHERE HASH=?)";
-            int ok = sqlite3_prepare_v2(m_sqlite, sql.c_str(), -1, &stmt, nullptr);
-            if (ok != SQLITE_OK) {
-                return false;
+            if (m_uncommitted.empty()) {
+                m_first_uncommitted = clock_type::now();
+            }
+            m_uncommitted.emplace(msg.sha1(), msg);
+
+            // a burst of messages is committed in one transaction
+            if (int(m_uncommitted.size()) >= message_db_max_uncommitted
+                || clock_type::now() - m_first_uncommitted >= milliseconds(message_db_commit_window)) {
+                return commit_messages();
             }
 
-            sqlite3_bind_blob(stmt, 1, msg.sha1().data(), ip2::sha1_hash::size(), nullptr);
-            sqlite3_bind_blob(stmt, 2, msg.sender().bytes.data(), dht::public_key::len, nullptr);
-            sqlite3_bind_blob(stmt, 3, msg.receiver().bytes.data(), dht::public_key::len, nullptr);
-            sqlite3_bind_int64(stmt, 4, msg.timestamp());
-            sqlite3_bind_blob(stmt, 5, msg.payload().data(), msg.payload().size(), nullptr);
+            return true;
+        }
 
-            ok = sqlite3_step(stmt);
-            if (ok != SQLITE_DONE) {
+        bool message_db_impl::commit_messages() {
+            if (m_uncommitted.empty()) {
+                return true;
+            }
+
+            std::map<sha1_hash, message> messages;
+            messages.swap(m_uncommitted);
+            time_point const first_uncommitted = m_first_uncommitted;
+            m_first_uncommitted = max_time();
+
+            // on failure the messages go back to be committed next time.
+            // Inserting one that did make it is ignored
+            auto restore = [&] {
+                m_uncommitted.insert(messages.begin(), messages.end());
+                m_first_uncommitted = std::min(m_first_uncommitted, first_uncommitted);
                 return false;
+            };
+
+            sqlite3_stmt * stmt = statement("INSERT OR IGNORE INTO MESSAGES (HASH,SENDER,RECEIVER,TIMESTAMP,PAYLOAD) VALUES(?,?,?,?,?)");
+            if (stmt == nullptr) {
+                return restore();
+            }
+
+            // a transaction somebody else began on the connection is left to
+            // them to commit
+            bool const own_transaction = sqlite3_get_autocommit(m_sqlite) != 0;
+            if (own_transaction && sqlite3_exec(m_sqlite, "BEGIN TRANSACTION", nullptr, nullptr, nullptr) != SQLITE_OK) {
+                return restore();
+            }
+
+            bool ret = true;
+            for (auto const& item: messages) {
+                auto const& msg = item.second;
+                statement_reset reset(stmt);
+
+                sqlite3_bind_blob(stmt, 1, msg.sha1().data(), ip2::sha1_hash::size(), nullptr);
+                sqlite3_bind_blob(stmt, 2, msg.sender().bytes.data(), dht::public_key::len, nullptr);
+                sqlite3_bind_blob(stmt, 3, msg.receiver().bytes.data(), dht::public_key::len, nullptr);
+                sqlite3_bind_int64(stmt, 4, msg.timestamp());
+                sqlite3_bind_blob(stmt, 5, msg.payload().data(), int(msg.payload().size()), nullptr);
+
+                if (sqlite3_step(stmt) != SQLITE_DONE) {
+                    ret = false;
+                }
+            }
+
+            if (own_transaction && sqlite3_exec(m_sqlite, "COMMIT TRANSACTION", nullptr, nullptr, nullptr) != SQLITE_OK) {
+                sqlite3_exec(m_sqlite, "ROLLBACK TRANSACTION", nullptr, nullptr, nullptr);
+                return restore();
+            }
+
+            if (!ret) {
+                return restore();
             }
-            sqlite3_finalize(stmt);
 
             return true;
         }
 
         message message_db_impl::get_message_by_hash(const sha1_hash &hash) {
-            message msg;
+            auto it = m_uncommitted.find(hash);
+            if (it != m_uncommitted.end()) {
+                return it->second;
+            }
 
-            sqlite3_stmt * stmt;
-            std::string sql = "SELECT SENDER,RECEIVER,TIMESTAMP,PAYLOAD FROM MESSAGES WHERE HASH=?;";
+            message msg;
 
-            int ok = sqlite3_prepare_v2(m_sqlite, sql.c_str(), -1, &stmt, nullptr);
-            if (ok == SQLITE_OK) {
+            sqlite3_stmt * stmt = statement("SELECT SENDER,RECEIVER,TIMESTAMP,PAYLOAD FROM MESSAGES WHERE HASH=?;");
+            if (stmt != nullptr) {
+                statement_reset reset(stmt);
                 sqlite3_bind_blob(stmt, 1, hash.data(), ip2::sha1_hash::size(), nullptr);
                 if (sqlite3_step(stmt) == SQLITE_ROW) {
                     const char *p = static_cast<const char *>(sqlite3_column_blob(stmt, 0));
@@ -160,20 +258,16 @@ namespace ip2 {
                 }
             }
 
-            sqlite3_finalize(stmt);
-
             return msg;
         }
 
         communication::message
         message_db_impl::get_latest_transaction(const dht::public_key &sender, const dht::public_key &receiver) {
-            communication::message msg;
-
-            sqlite3_stmt * stmt;
-            std::string sql = "SELECT HASH,TIMESTAMP,PAYLOAD FROM MESSAGES WHERE SENDER=? AND RECEIVER=? ORDER BY TIMESTAMP DESC LIMIT 1";
+            std::vector<communication::message> messages;
 
-            int ok = sqlite3_prepare_v2(m_sqlite, sql.c_str(), -1, &stmt, nullptr);
-            if (ok == SQLITE_OK) {
+            sqlite3_stmt * stmt = statement("SELECT HASH,TIMESTAMP,PAYLOAD FROM MESSAGES WHERE SENDER=? AND RECEIVER=? ORDER BY TIMESTAMP DESC LIMIT 1");
+            if (stmt != nullptr) {
+                statement_reset reset(stmt);
                 sqlite3_bind_blob(stmt, 1, sender.bytes.data(), dht::public_key::len, nullptr);
                 sqlite3_bind_blob(stmt, 2, receiver.bytes.data(), dht::public_key::len, nullptr);
                 if (sqlite3_step(stmt) == SQLITE_ROW) {
@@ -186,24 +280,27 @@ namespace ip2 {
                     auto length = sqlite3_column_bytes(stmt, 2);
                     aux::bytes payload(p, p + length);
 
-                    msg = message(timestamp, sender, receiver, payload, hash);
+                    messages.emplace_back(timestamp, sender, receiver, payload, hash);
                 }
             }
 
-            sqlite3_finalize(stmt);
+            for (auto const& item: m_uncommitted) {
+                if (item.second.sender() == sender && item.second.receiver() == receiver) {
+                    messages.push_back(item.second);
+                }
+            }
+            keep_latest(messages, 1);
 
-            return msg;
+            return messages.empty() ? communication::message() : messages.front();
         }
 
         std::vector<communication::message>
         message_db_impl::get_latest_ten_transactions(const dht::public_key &sender, const dht::public_key &receiver) {
             std::vector<communication::message> messages;
 
-            sqlite3_stmt * stmt;
-            std::string sql = "SELECT HASH,TIMESTAMP,PAYLOAD FROM MESSAGES WHERE SENDER=? AND RECEIVER=? ORDER BY TIMESTAMP DESC LIMIT 10";
-
-            int ok = sqlite3_prepare_v2(m_sqlite, sql.c_str(), -1, &stmt, nullptr);
-            if (ok == SQLITE_OK) {
+            sqlite3_stmt * stmt = statement("SELECT HASH,TIMESTAMP,PAYLOAD FROM MESSAGES WHERE SENDER=? AND RECEIVER=? ORDER BY TIMESTAMP DESC LIMIT 10");
+            if (stmt != nullptr) {
+                statement_reset reset(stmt);
                 sqlite3_bind_blob(stmt, 1, sender.bytes.data(), dht::public_key::len, nullptr);
                 sqlite3_bind_blob(stmt, 2, receiver.bytes.data(), dht::public_key::len, nullptr);
                 for (;sqlite3_step(stmt) == SQLITE_ROW;) {
@@ -221,7 +318,15 @@ namespace ip2 {
                 }
             }
 
-            sqlite3_finalize(stmt);
+            // the ones not committed yet are in the latest too, once
+            for (auto const& item: m_uncommitted) {
+                auto const& msg = item.second;
+                if (msg.sender() == sender && msg.receiver() == receiver
+                    && std::none_of(messages.begin(), messages.end(), [&](message const& m) { return m.sha1() == msg.sha1(); })) {
+                    messages.push_back(msg);
+                }
+            }
+            keep_latest(messages, 10);
 
             std::reverse(messages.begin(), messages.end());
 
@@ -229,31 +334,33 @@ namespace ip2 {
         }
 
         bool message_db_impl::delete_message_by_hash(const sha1_hash &hash) {
-            sqlite3_stmt * stmt;
-            std::string sql = "DELETE FROM MESSAGES WHERE HASH=?";
-            int ok = sqlite3_prepare_v2(m_sqlite, sql.c_str(), -1, &stmt, nullptr);
-            if (ok != SQLITE_OK) {
+            m_uncommitted.erase(hash);
+
+            sqlite3_stmt * stmt = statement("DELETE FROM MESSAGES WHERE HASH=?");
+            if (stmt == nullptr) {
                 return false;
             }
+            statement_reset reset(stmt);
             sqlite3_bind_blob(stmt, 1, hash.data(), ip2::sha1_hash::size(), nullptr);
 
-            ok = sqlite3_step(stmt);
+            int ok = sqlite3_step(stmt);
             if (ok != SQLITE_DONE) {
                 return false;
             }
-            sqlite3_finalize(stmt);
 
             return true;
         }
 
         bool message_db_impl::is_message_in_db(const sha1_hash &hash) {
-            bool ret = false;
+            if (m_uncommitted.find(hash) != m_uncommitted.end()) {
+                return true;
+            }
 
-            sqlite3_stmt * stmt;
-            std::string sql = "SELECT COUNT(*) FROM MESSAGES WHERE HASH=?";
+            bool ret = false;
 
-            int ok = sqlite3_prepare_v2(m_sqlite, sql.c_str(), -1, &stmt, nullptr);
-            if (ok == SQLITE_OK) {
+            sqlite3_stmt * stmt = statement("SELECT COUNT(*) FROM MESSAGES WHERE HASH=?");
+            if (stmt != nullptr) {
+                statement_reset reset(stmt);
                 sqlite3_bind_blob(stmt, 1, hash.data(), ip2::sha1_hash::size(), nullptr);
                 if (sqlite3_step(stmt) == SQLITE_ROW) {
                     int num = sqlite3_column_int(stmt, 0);
@@ -263,8 +370,6 @@ namespace ip2 {
                 }
             }
 
-            sqlite3_finalize(stmt);
-
             return ret;
         }
 
@@ -249,4 +249,30 @@ namespace ip2 {
 #endif
 	}
 
+	namespace {
+
+	template <typename Hasher, typename Digest>
+	void hash_batch_impl(span<span<char const> const> in, span<Digest> out)
+	{
+		TORRENT_ASSERT(in.size() == out.size());
+		Hasher h;
+		for (int i = 0; i < int(in.size()); ++i)
+		{
+			if (i > 0) h.reset();
+			if (!in[i].empty()) h.update(in[i]);
+			out[i] = h.final();
+		}
+	}
+
+	}
+
+	void hash_batch(span<span<char const> const> in, span<sha1_hash> out)
+	{
+		hash_batch_impl<hasher>(in, out);
+	}
+
+	void hash_batch(span<span<char const> const> in, span<sha256_hash> out)
+	{
+		hash_batch_impl<hasher256>(in, out);
+	}
 }
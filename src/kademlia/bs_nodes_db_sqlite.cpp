@@ -69,6 +69,19 @@ void bs_nodes_db_sqlite::init()
 			return;
 		}
 
+		for (std::string const* alter : {&add_bs_nodes_rtt_column
+			, &add_bs_nodes_verified_column})
+		{
+			ok = sqlite3_exec(db, alter->c_str(), nullptr, nullptr, &zErrMsg);
+			if (ok != SQLITE_OK)
+			{
+				// the column already exists
+				sql_log(ok, zErrMsg);
+				sqlite3_free(zErrMsg);
+				zErrMsg = nullptr;
+			}
+		}
+
 #ifndef TORRENT_DISABLE_LOGGING
 		if (m_observer->should_log(dht_logger::bs_nodes_db, aux::LOG_INFO))
 		{
@@ -198,6 +211,9 @@ bool bs_nodes_db_sqlite::put(std::vector<bs_node_entry> const& nodes)
 				, ep_str.c_str(), ep_str.size(), nullptr);
 			sqlite3_bind_int(m_insert_or_replace_nodes_stmt, 4
 				, aux::is_v4(n.m_ep) ? 1 : 0);
+			sqlite3_bind_int(m_insert_or_replace_nodes_stmt, 5, n.m_rtt);
+			sqlite3_bind_int(m_insert_or_replace_nodes_stmt, 6
+				, n.m_verified ? 1 : 0);
 
 			ok = sqlite3_step(m_insert_or_replace_nodes_stmt);
 			if (ok != SQLITE_DONE)
@@ -279,7 +295,10 @@ bool bs_nodes_db_sqlite::get(std::vector<bs_node_entry>& nodes
 				ep = aux::read_v6_endpoint<udp::endpoint>(ep_str.c_str());
 			}
 
-			nodes.push_back(bs_node_entry(nid, ep, timestamp(ts_value)));
+			int const rtt = sqlite3_column_int(m_select_nodes_stmt, 4);
+			bool const verified = sqlite3_column_int(m_select_nodes_stmt, 5) != 0;
+
+			nodes.push_back(bs_node_entry(nid, ep, timestamp(ts_value), rtt, verified));
 		}
 
 		int const cost = aux::numeric_cast<int>(total_microseconds(aux::time_now() - start));
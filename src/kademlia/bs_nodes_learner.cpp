@@ -19,6 +19,7 @@ see LICENSE file.
 #include <ip2/kademlia/bs_nodes_learner.hpp>
 #include <ip2/kademlia/node.hpp>
 
+#include <algorithm>
 #include <type_traits>
 #include <functional>
 
@@ -87,17 +88,49 @@ void bs_nodes_learner::add_bootstrap_nodes(std::vector<bs_node_entry> const& nod
 	}
 }
 
-void bs_nodes_learner::tick()
+void bs_nodes_learner::get_warm_start_nodes(std::vector<bs_node_entry>& nodes
+	, int const count)
+{
+	nodes.clear();
+	if (count <= 0) return;
+
+	// nodes not seen for long are unlikely to be alive, so only the
+	// freshest ones are candidates, the best of which are picked
+	int const candidates = count * 4;
+	if (!m_bs_nodes_storage.get(nodes, 0, candidates))
+	{
+#ifndef TORRENT_DISABLE_LOGGING
+		if (m_log->should_log(dht_logger::bs_nodes_db, aux::LOG_ERR))
+		{
+			m_log->log(dht_logger::bs_nodes_db, "get warm start nodes error");
+		}
+#endif
+
+		nodes.clear();
+		return;
+	}
+
+	std::sort(nodes.begin(), nodes.end());
+	if (int(nodes.size()) > count) nodes.erase(nodes.begin() + count, nodes.end());
+}
+
+void bs_nodes_learner::snapshot()
 {
 	time_point const now = aux::time_now();
-	int refresh_period = m_settings.get_int(settings_pack::dht_bs_nodes_db_refresh_time);
-	if (m_last_refresh + seconds(refresh_period) > now) return;
-	m_last_refresh = now;
+	std::int64_t const utc_now = ip2::aux::utcTime();
 
 	// fetch live nodes from routing table and put them into storage.
 	std::vector<bs_node_entry> nodes;
-	m_table.for_each_node([&nodes](node_entry const& e)
-			{ nodes.emplace_back(bs_node_entry(e.id, e.endpoint)); }, nullptr);
+	m_table.for_each_node([&](node_entry const& e)
+		{
+			// record when the node was last heard from, rather than now
+			std::int64_t ts = utc_now;
+			if (e.last_seen != min_time() && e.last_seen < now)
+				ts -= total_seconds(now - e.last_seen);
+
+			nodes.emplace_back(bs_node_entry(e.id, e.endpoint, timestamp(ts)
+				, e.rtt, e.verified));
+		}, nullptr);
 
 #ifndef TORRENT_DISABLE_LOGGING
 	for (auto& bsn : nodes)
@@ -123,6 +156,16 @@ void bs_nodes_learner::tick()
 
 		return;
 	}
+}
+
+void bs_nodes_learner::tick()
+{
+	time_point const now = aux::time_now();
+	int refresh_period = m_settings.get_int(settings_pack::dht_bs_nodes_db_refresh_time);
+	if (m_last_refresh + seconds(refresh_period) > now) return;
+	m_last_refresh = now;
+
+	snapshot();
 
 	m_storage_size = m_bs_nodes_storage.tick();
 }
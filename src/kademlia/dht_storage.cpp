@@ -16,6 +16,7 @@ see LICENSE file.
 #include "ip2/kademlia/dht_storage.hpp"
 #include "ip2/kademlia/node_entry.hpp"
 #include "ip2/kademlia/relay.hpp"
+#include "ip2/kademlia/relay_mailbox.hpp"
 #include "ip2/settings_pack.hpp"
 
 #include <tuple>
@@ -77,6 +78,8 @@ namespace {
 		int num_announcers = 0;
 		// size of malloced space pointed to by value
 		int size = 0;
+		// the key of this item in the eviction index of its table
+		int score = 0;
 	};
 
 	struct dht_mutable_item : dht_immutable_item
@@ -111,46 +114,55 @@ namespace {
 		}
 	}
 
-	// return true of the first argument is a better candidate for removal, i.e.
-	// less important to keep
-	struct immutable_item_comparator
+	// this is a score taking the popularity (number of announcers) and the
+	// fit, in terms of distance from ideal storing node, into account.
+	// each additional 5 announcers is worth one extra bit in the distance.
+	// that is, an item with 10 announcers is allowed to be twice as far
+	// from another item with 5 announcers, from our node ID. Twice as far
+	// because it gets one more bit. The lower, the less important to keep
+	int item_score(node_id const& target, dht_immutable_item const& item
+		, std::vector<node_id> const& node_ids)
 	{
-		explicit immutable_item_comparator(std::vector<node_id> const& node_ids) : m_node_ids(node_ids) {}
-		immutable_item_comparator(immutable_item_comparator const&) = default;
+		return item.num_announcers / 5 - min_distance_exp(target, node_ids);
+	}
 
-		// explicitly disallow assignment, to silence msvc warning
-		immutable_item_comparator& operator=(immutable_item_comparator const&) = delete;
+	// the items of a table ordered by score, then target. The first one is
+	// the least important (i.e. the one the fewest peers are announcing, and
+	// farthest from our node IDs), which is evicted when the table is full
+	using eviction_index = std::set<std::pair<int, node_id>>;
 
-		template <typename Item>
-		bool operator()(std::pair<node_id const, Item> const& lhs
-			, std::pair<node_id const, Item> const& rhs) const
+	// (re)computes the score of the item at ``i`` and moves it in ``index``
+	template <class Item>
+	void index_item(eviction_index& index
+		, typename std::map<node_id, Item>::iterator const i
+		, std::vector<node_id> const& node_ids, bool const indexed)
+	{
+		int const score = item_score(i->first, i->second, node_ids);
+		if (indexed)
 		{
-			int const l_distance = min_distance_exp(lhs.first, m_node_ids);
-			int const r_distance = min_distance_exp(rhs.first, m_node_ids);
-
-			// this is a score taking the popularity (number of announcers) and the
-			// fit, in terms of distance from ideal storing node, into account.
-			// each additional 5 announcers is worth one extra bit in the distance.
-			// that is, an item with 10 announcers is allowed to be twice as far
-			// from another item with 5 announcers, from our node ID. Twice as far
-			// because it gets one more bit.
-			return lhs.second.num_announcers / 5 - l_distance < rhs.second.num_announcers / 5 - r_distance;
+			if (score == i->second.score) return;
+			index.erase({i->second.score, i->first});
 		}
+		i->second.score = score;
+		index.insert({score, i->first});
+	}
 
-	private:
-
-		std::vector<node_id> const& m_node_ids;
-	};
+	template <class Item>
+	void reindex_table(eviction_index& index, std::map<node_id, Item>& table
+		, std::vector<node_id> const& node_ids)
+	{
+		index.clear();
+		for (auto i = table.begin(); i != table.end(); ++i)
+			index_item<Item>(index, i, node_ids, false);
+	}
 
-	// picks the least important one (i.e. the one
-	// the fewest peers are announcing, and farthest
-	// from our node IDs)
-	template<class Item>
-	typename std::map<node_id, Item>::const_iterator pick_least_important_item(
-		std::vector<node_id> const& node_ids, std::map<node_id, Item> const& table)
+	template <class Item>
+	typename std::map<node_id, Item>::iterator erase_item(eviction_index& index
+		, std::map<node_id, Item>& table
+		, typename std::map<node_id, Item>::iterator const i)
 	{
-		return std::min_element(table.begin(), table.end()
-			, immutable_item_comparator(node_ids));
+		index.erase({i->second.score, i->first});
+		return table.erase(i);
 	}
 
 	struct relays_bucket
@@ -353,6 +365,12 @@ namespace {
 		void update_node_ids(std::vector<node_id> const& ids) override
 		{
 			m_node_ids = ids;
+			if (m_backend != nullptr) m_backend->update_node_ids(ids);
+
+			// the distances changed, and the scores with them
+			if (m_node_ids.empty()) return;
+			reindex_table(m_immutable_index, m_immutable_table, m_node_ids);
+			reindex_table(m_mutable_index, m_mutable_table, m_node_ids);
 		}
 
 		void set_backend(std::shared_ptr<dht_storage_interface> backend) override
@@ -360,6 +378,11 @@ namespace {
 			m_backend = std::move(backend);
 		}
 
+		void set_relay_mailbox(std::shared_ptr<relay_mailbox> mailbox) override
+		{
+			m_mailbox = std::move(mailbox);
+		}
+
 		bool get_immutable_item(sha256_hash const& target
 			, entry& item) const override
 		{
@@ -377,16 +400,15 @@ namespace {
 		{
 			TORRENT_ASSERT(!m_node_ids.empty());
 			auto i = m_immutable_table.find(target);
+			bool const indexed = i != m_immutable_table.end();
 			if (i == m_immutable_table.end())
 			{
 				// make sure we don't add too many items
 				if (int(m_immutable_table.size()) >= m_settings.get_int(settings_pack::dht_max_dht_items))
 				{
-					auto const j = pick_least_important_item(m_node_ids
-						, m_immutable_table);
-
-					TORRENT_ASSERT(j != m_immutable_table.end());
-					m_immutable_table.erase(j);
+					TORRENT_ASSERT(!m_immutable_index.empty());
+					erase_item(m_immutable_index, m_immutable_table
+						, m_immutable_table.find(m_immutable_index.begin()->second));
 					m_counters.immutable_data -= 1;
 				}
 				dht_immutable_item to_add;
@@ -400,6 +422,7 @@ namespace {
 //			std::fprintf(stderr, "added immutable item (%d)\n", int(m_immutable_table.size()));
 
 			touch_item(i->second, addr);
+			index_item<dht_immutable_item>(m_immutable_index, i, m_node_ids, indexed);
 		}
 
 		bool get_mutable_item_timestamp(sha256_hash const& target
@@ -488,17 +511,16 @@ namespace {
 
 			TORRENT_ASSERT(!m_node_ids.empty());
 			auto i = m_mutable_table.find(target);
+			bool const indexed = i != m_mutable_table.end();
 			if (i == m_mutable_table.end())
 			{
 				// this is the case where we don't have an item in this slot
 				// make sure we don't add too many items
 				if (int(m_mutable_table.size()) >= m_settings.get_int(settings_pack::dht_max_dht_items))
 				{
-					auto const j = pick_least_important_item(m_node_ids
-						, m_mutable_table);
-
-					TORRENT_ASSERT(j != m_mutable_table.end());
-					m_mutable_table.erase(j);
+					TORRENT_ASSERT(!m_mutable_index.empty());
+					erase_item(m_mutable_index, m_mutable_table
+						, m_mutable_table.find(m_mutable_index.begin()->second));
 					m_counters.mutable_data -= 1;
 				}
 				dht_mutable_item to_add;
@@ -526,6 +548,7 @@ namespace {
 			}
 
 			touch_item(i->second, addr);
+			index_item<dht_mutable_item>(m_mutable_index, i, m_node_ids, indexed);
 		}
 
 		void remove_mutable_item(sha256_hash const& target) override
@@ -538,7 +561,7 @@ namespace {
 
 			auto i = m_mutable_table.find(target);
 			if (i == m_mutable_table.end()) return;
-			m_mutable_table.erase(i);
+			erase_item(m_mutable_index, m_mutable_table, i);
 		}
 
 		void relay_referred(node_id const& peer
@@ -597,6 +620,14 @@ namespace {
 			sha256_hash pl_hash = h.final();
 			sha256_hash k = relay_entry_key(sender, receiver, pl_hash);
 
+			// if the mailbox can't write it (the disk is full, a segment
+			// can't be mapped), the entry is kept in memory instead
+			if (m_mailbox != nullptr
+				&& m_mailbox->put(k, sender, receiver, payload, aux_nodes, protocol, hmac))
+			{
+				return;
+			}
+
 			relay_table_by_key& key_index = m_relay_entries_table.get<key>();
 			relay_table_by_key::iterator it = key_index.find(k);
 			if (it != key_index.end())
@@ -624,6 +655,8 @@ namespace {
 
 		bool get_relay_entry(sha256_hash const& k, entry& re) const override
 		{
+			if (m_mailbox != nullptr && m_mailbox->get(k, re)) return true;
+
 			const relay_table_by_key& key_index = m_relay_entries_table.get<key>();
 			relay_table_by_key::iterator it = key_index.find(k);
 			if (it == key_index.end())
@@ -659,6 +692,8 @@ namespace {
 		bool get_random_relay_entry(sha256_hash const& recver
 			, sha256_hash& key) const override
 		{
+			if (m_mailbox != nullptr && m_mailbox->get_random(recver, key)) return true;
+
 			const relay_table_by_receiver& receiver_index = m_relay_entries_table.get<receiver>();
 			relay_table_by_receiver::iterator it = receiver_index.find(recver);
 			if (it != receiver_index.end())
@@ -672,6 +707,8 @@ namespace {
 
 		void remove_relay_entry(sha256_hash const& k)
 		{
+			if (m_mailbox != nullptr) m_mailbox->remove(k);
+
 			relay_table_by_key& key_index = m_relay_entries_table.get<key>();
 			relay_table_by_key::iterator it = key_index.find(k);
 			if (it != key_index.end())
@@ -683,6 +720,7 @@ namespace {
 		void tick() override
 		{
 			if (m_backend != nullptr) m_backend->tick();
+			if (m_mailbox != nullptr) m_mailbox->tick();
 
 			if (m_settings.get_int(settings_pack::dht_item_lifetime) > 0)
 			{
@@ -703,7 +741,7 @@ namespace {
 							++i;
 							continue;
 						}
-						i = m_immutable_table.erase(i);
+						i = erase_item(m_immutable_index, m_immutable_table, i);
 						m_counters.immutable_data -= 1;
 					}
 				}
@@ -719,7 +757,7 @@ namespace {
 							++i;
 							continue;
 						}
-						i = m_mutable_table.erase(i);
+						i = erase_item(m_mutable_index, m_mutable_table, i);
 						m_counters.mutable_data -= 1;
 					}
 				}
@@ -752,16 +790,20 @@ namespace {
 		void close() override
 		{
 			if (m_backend != nullptr) m_backend->close();
+			if (m_mailbox != nullptr) m_mailbox->close();
 		}
 
 	private:
 		settings_interface const& m_settings;
 		std::shared_ptr<dht_storage_interface> m_backend;
+		std::shared_ptr<relay_mailbox> m_mailbox;
 		dht_storage_counters m_counters;
 
 		std::vector<node_id> m_node_ids;
 		std::map<node_id, dht_immutable_item> m_immutable_table;
 		std::map<node_id, dht_mutable_item> m_mutable_table;
+		eviction_index m_immutable_index;
+		eviction_index m_mutable_index;
 		std::map<node_id, relays_bucket> m_relays_table;
 
 		relay_table m_relay_entries_table;
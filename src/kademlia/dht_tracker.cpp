@@ -195,6 +195,14 @@ namespace ip2::dht {
 
 	void dht_tracker::stop()
 	{
+		// the routing table is saved periodically, save its latest state
+		// too, for the next start
+		if (m_running)
+		{
+			for (auto& n : m_nodes)
+				n.second.dht.snapshot_routing_table();
+		}
+
 		m_running = false;
 		m_key_refresh_timer.cancel();
 		for (auto& n : m_nodes)
@@ -652,10 +660,8 @@ namespace ip2::dht {
 	{
 		if (!it.is_mutable()) return;
 
-		std::string flat_data;
-		bencode(std::back_inserter(flat_data), it.value());
 		sha256_hash target = item_target_id(it.salt(), it.pk());
-		m_storage.put_mutable_item(target, flat_data, it.sig()
+		m_storage.put_mutable_item(target, it.buffer(), it.sig()
 			, it.ts(), it.pk(), it.salt(), address());
 	}
 
@@ -849,6 +855,55 @@ namespace ip2::dht {
 
 	bool dht_tracker::incoming_packet(aux::listen_socket_handle const& s
 		, udp::endpoint const& ep, span<char const> const buf, sha256_hash const& pk)
+	{
+		bool accepted;
+		if (!filter_packet(ep, buf, true, accepted)) return accepted;
+
+		int pos;
+		error_code err;
+		bdecode(buf.data(), buf.data() + buf.size(), m_msg, err, &pos, 10, 500);
+		return handle_packet(s, ep, buf, m_msg, err, pk);
+	}
+
+	bool dht_tracker::incoming_packet(aux::listen_socket_handle const& s
+		, udp::endpoint const& ep, span<char const> const buf
+		, bdecode_node const& msg, error_code const& ec, sha256_hash const& pk)
+	{
+		bool accepted;
+		if (!filter_packet(ep, buf, false, accepted)) return accepted;
+
+		return handle_packet(s, ep, buf, msg, ec, pk);
+	}
+
+	bool dht_tracker::incoming_source(udp::endpoint const& ep)
+	{
+		if (m_settings.get_bool(settings_pack::dht_ignore_dark_internet) && aux::is_v4(ep))
+		{
+			address_v4::bytes_type b = ep.address().to_v4().to_bytes();
+
+			// these are class A networks not available to the public
+			// if we receive messages from here, that seems suspicious
+			static std::uint8_t const class_a[] = { 3, 6, 7, 9, 11, 19, 21, 22, 25
+				, 26, 28, 29, 30, 33, 34, 48, 56 };
+
+			if (std::find(std::begin(class_a), std::end(class_a), b[0]) != std::end(class_a))
+			{
+				m_counters.inc_stats_counter(counters::dht_messages_in_dropped);
+				return false;
+			}
+		}
+
+		if (!m_blocker.incoming(ep.address(), clock_type::now(), m_log))
+		{
+			m_counters.inc_stats_counter(counters::dht_messages_in_dropped);
+			return false;
+		}
+
+		return true;
+	}
+
+	bool dht_tracker::filter_packet(udp::endpoint const& ep
+		, span<char const> const buf, bool const check_source, bool& accepted)
 	{
 		int const buf_size = int(buf.size());
 
@@ -869,37 +924,26 @@ namespace ip2::dht {
 			// Suppose the node network is the mobile telecom network, a attack node
 			// can launch traffic attack. So ingore this incoming packet.
 			// incoming_decryption_error(s, ep, pk);
+			accepted = false;
 			return false;
 		}
 
-		if (m_settings.get_bool(settings_pack::dht_ignore_dark_internet) && aux::is_v4(ep))
+		// a packet decoded off the network thread had its sender checked
+		// before it was
+		if (check_source && !incoming_source(ep))
 		{
-			address_v4::bytes_type b = ep.address().to_v4().to_bytes();
-
-			// these are class A networks not available to the public
-			// if we receive messages from here, that seems suspicious
-			static std::uint8_t const class_a[] = { 3, 6, 7, 9, 11, 19, 21, 22, 25
-				, 26, 28, 29, 30, 33, 34, 48, 56 };
-
-			if (std::find(std::begin(class_a), std::end(class_a), b[0]) != std::end(class_a))
-			{
-				m_counters.inc_stats_counter(counters::dht_messages_in_dropped);
-				return true;
-			}
-		}
-
-		if (!m_blocker.incoming(ep.address(), clock_type::now(), m_log))
-		{
-			m_counters.inc_stats_counter(counters::dht_messages_in_dropped);
-			return true;
+			accepted = true;
+			return false;
 		}
 
-		TORRENT_ASSERT(buf_size > 0);
+		return true;
+	}
 
-		int pos;
-		error_code err;
-		int const ret = bdecode(buf.data(), buf.data() + buf_size, m_msg, err, &pos, 10, 500);
-		if (ret != 0)
+	bool dht_tracker::handle_packet(aux::listen_socket_handle const& s
+		, udp::endpoint const& ep, span<char const> const buf
+		, bdecode_node const& msg, error_code const& ec, sha256_hash const& pk)
+	{
+		if (ec)
 		{
 			m_counters.inc_stats_counter(counters::dht_messages_in_dropped);
 #ifndef TORRENT_DISABLE_LOGGING
@@ -912,7 +956,7 @@ namespace ip2::dht {
 			return false;
 		}
 
-		if (m_msg.type() != bdecode_node::dict_t)
+		if (msg.type() != bdecode_node::dict_t)
 		{
 			m_counters.inc_stats_counter(counters::dht_messages_in_dropped);
 #ifndef TORRENT_DISABLE_LOGGING
@@ -926,7 +970,7 @@ namespace ip2::dht {
 		m_log->log_packet(dht_logger::incoming_message, buf, ep);
 #endif
 
-		ip2::dht::msg const m(m_msg, ep);
+		ip2::dht::msg const m(msg, ep);
 		for (auto& n : m_nodes)
 			n.second.dht.incoming(s, m, pk);
 		return true;
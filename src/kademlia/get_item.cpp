@@ -72,7 +72,8 @@ void get_item::got_data(bdecode_node const& v,
 	// this is mutable data. If it passes the signature
 	// check, remember it. Just keep the version with
 	// the highest timestamp.
-	if (m_data.empty() || m_data.ts() < ts)
+	bool const newer = m_data.empty() || m_data.ts() < ts;
+	if (newer)
 	{
 		if (!m_data.assign(v, salt_copy, ts, pk, sig))
 			return;
@@ -86,9 +87,11 @@ void get_item::got_data(bdecode_node const& v,
 		// m_data_callback(m_data, false);
 	}
 
-	// call data callback anyway.
+	// call data callback anyway. If m_data was just assigned, the
+	// signature is already verified and its buffer is shared
 	item mutable_data(pk, salt_copy);
-	if (mutable_data.assign(v, salt_copy, ts, pk, sig))
+	if (newer) mutable_data = m_data;
+	if (newer || mutable_data.assign(v, salt_copy, ts, pk, sig))
 	{
 		if (m_timestamp != -1 && m_timestamp <= ts.value)
 		{
@@ -18,10 +18,9 @@ see LICENSE file.
 #include <cstdio> // for snprintf
 #include <cinttypes> // for PRId64 et.al.
 #include <algorithm> // for copy
+#include <iterator> // for back_inserter
 
-#if TORRENT_USE_ASSERTS
 #include "ip2/bdecode.hpp"
-#endif
 
 namespace ip2 { namespace dht {
 
@@ -146,13 +145,13 @@ item::item(public_key const& pk, span<char const> salt)
 {}
 
 item::item(entry v)
-	: m_value(std::move(v))
-{}
+{
+	assign(std::move(v));
+}
 
 item::item(bdecode_node const& v)
 {
-	// TODO: implement ctor for entry from bdecode_node?
-	m_value = v;
+	assign(v);
 }
 
 item::item(entry v, span<char const> salt
@@ -161,31 +160,60 @@ item::item(entry v, span<char const> salt
 	assign(std::move(v), salt, ts, pk, sk);
 }
 
+void item::set_buffer(span<char const> v)
+{
+	m_buffer = std::make_shared<std::vector<char> const>(v.begin(), v.end());
+	m_value = entry();
+	m_decoded = false;
+}
+
+void item::clear()
+{
+	m_buffer.reset();
+	m_value = entry();
+	m_decoded = false;
+}
+
+entry const& item::value() const
+{
+	if (!m_decoded && m_buffer)
+	{
+		error_code ec;
+		bdecode_node const n = bdecode(*m_buffer, ec);
+		TORRENT_ASSERT(!ec);
+		m_value = n;
+		m_decoded = true;
+	}
+	return m_value;
+}
+
 void item::assign(entry v)
 {
-	m_mutable = false;
+	std::vector<char> buf;
+	bencode(std::back_inserter(buf), v);
+	assign_bencoded(buf);
+
+	// we already have the decoded form
 	m_value = std::move(v);
+	m_decoded = true;
 }
 
 void item::assign(entry v, span<char const> salt
 	, timestamp const ts, public_key const& pk, secret_key const& sk)
 {
-	std::array<char, 1000> buffer;
-	int const bsize = bencode(buffer.begin(), v);
-	TORRENT_ASSERT(bsize <= 1000);
-	m_sig = sign_mutable_item(span<char const>(buffer).first(bsize)
-		, salt, ts, pk, sk);
-	m_salt.assign(salt.data(), static_cast<std::size_t>(salt.size()));
-	m_pk = pk;
-	m_timestamp = ts;
-	m_mutable = true;
+	std::vector<char> buf;
+	bencode(std::back_inserter(buf), v);
+	TORRENT_ASSERT(buf.size() <= 1000);
+	signature const sig = sign_mutable_item(buf, salt, ts, pk, sk);
+	assign_bencoded(buf, salt, ts, pk, sig);
+
 	m_value = std::move(v);
+	m_decoded = true;
 }
 
 void item::assign(bdecode_node const& v)
 {
-	m_mutable = false;
-	m_value = v;
+	assign_bencoded(v.data_section());
 }
 
 bool item::assign(bdecode_node const& v, span<char const> salt
@@ -194,16 +222,8 @@ bool item::assign(bdecode_node const& v, span<char const> salt
 	TORRENT_ASSERT(v.data_section().size() <= 1000);
 	if (!verify_mutable_item(v.data_section(), salt, ts, pk, sig))
 		return false;
-	m_pk = pk;
-	m_sig = sig;
-	if (!salt.empty())
-		m_salt.assign(salt.data(), static_cast<std::size_t>(salt.size()));
-	else
-		m_salt.clear();
-	m_timestamp = ts;
-	m_mutable = true;
 
-	m_value = v;
+	assign_bencoded(v.data_section(), salt, ts, pk, sig);
 	return true;
 }
 
@@ -211,13 +231,30 @@ void item::assign(entry v, span<char const> salt
 	, timestamp const ts
 	, public_key const& pk, signature const& sig)
 {
+	std::vector<char> buf;
+	bencode(std::back_inserter(buf), v);
+	assign_bencoded(buf, salt, ts, pk, sig);
+
+	m_value = std::move(v);
+	m_decoded = true;
+}
+
+void item::assign_bencoded(span<char const> v)
+{
+	m_mutable = false;
+	set_buffer(v);
+}
 
+void item::assign_bencoded(span<char const> v, span<char const> salt
+	, timestamp const ts
+	, public_key const& pk, signature const& sig)
+{
 	m_pk = pk;
 	m_sig = sig;
 	m_salt.assign(salt.data(), static_cast<std::size_t>(salt.size()));
 	m_timestamp = ts;
 	m_mutable = true;
-	m_value = std::move(v);
+	set_buffer(v);
 }
 
 } } // namespace ip2::dht
@@ -8,6 +8,7 @@ see LICENSE file.
 */
 
 #include <ip2/kademlia/items_db_sqlite.hpp>
+#include <ip2/kademlia/node_id.hpp>
 
 #include <ip2/aux_/socket_io.hpp>
 #include <ip2/aux_/time.hpp>
@@ -54,21 +55,55 @@ void items_db_sqlite::init()
 			return;
 		}
 
-		// create index
-		ok = sqlite3_exec(db, create_ts_index.c_str(), nullptr, nullptr, &zErrMsg);
+		// add the dist column to a table created without it. Its rows are
+		// evicted first
+		sqlite3_stmt* stmt = nullptr;
+		ok = sqlite3_prepare_v2(db, select_dist_column.c_str(), -1, &stmt, nullptr);
+		sqlite3_finalize(stmt);
 		if (ok != SQLITE_OK)
 		{
-			sqlite3_free(zErrMsg);
-#ifndef TORRENT_DISABLE_LOGGING
-			if (m_observer->should_log(dht_logger::items_db, aux::LOG_ERR))
+			ok = sqlite3_exec(db, add_dist_column.c_str(), nullptr, nullptr, &zErrMsg);
+			if (ok != SQLITE_OK)
 			{
-				m_observer->log(dht_logger::items_db, "create index error: %d, %s"
-					, ok, create_ts_index.c_str());
+				sqlite3_free(zErrMsg);
+#ifndef TORRENT_DISABLE_LOGGING
+				if (m_observer->should_log(dht_logger::items_db, aux::LOG_ERR))
+				{
+					m_observer->log(dht_logger::items_db, "add column error: %d, %s"
+						, ok, add_dist_column.c_str());
+				}
+#endif
+				return;
 			}
+		}
+
+		// create index. The ts index isn't used anymore
+		for (std::string const* sql : {&drop_ts_index, &create_eviction_index})
+		{
+			ok = sqlite3_exec(db, sql->c_str(), nullptr, nullptr, &zErrMsg);
+			if (ok != SQLITE_OK)
+			{
+				sqlite3_free(zErrMsg);
+#ifndef TORRENT_DISABLE_LOGGING
+				if (m_observer->should_log(dht_logger::items_db, aux::LOG_ERR))
+				{
+					m_observer->log(dht_logger::items_db, "create index error: %d, %s"
+						, ok, sql->c_str());
+				}
 #endif
 
-			return;
+				return;
+			}
+		}
+
+		// the only time the rows are counted. From now on, puts and
+		// evictions keep the count
+		ok = sqlite3_prepare_v2(db, items_count.c_str(), -1, &stmt, nullptr);
+		if (ok == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
+		{
+			m_count = sqlite3_column_int(stmt, 0);
 		}
+		sqlite3_finalize(stmt);
 
 #ifndef TORRENT_DISABLE_LOGGING
 		if (m_observer->should_log(dht_logger::items_db, aux::LOG_INFO))
@@ -116,41 +151,31 @@ void items_db_sqlite::prepare_statements()
 			return;
 		}
 
-		ok = sqlite3_prepare_v2(db, insert_or_replace_items.c_str(), -1
-			, &m_insert_or_replace_items_stmt, nullptr);
-		if (ok != SQLITE_OK)
-		{
-			error.append(insert_or_replace_items);
-			sql_error(ok, error.c_str());
-
-			return;
-		}
-
-		ok = sqlite3_prepare_v2(db, items_count.c_str(), -1
-			, &m_items_count_stmt, nullptr);
+		ok = sqlite3_prepare_v2(db, update_items.c_str(), -1
+			, &m_update_items_stmt, nullptr);
 		if (ok != SQLITE_OK)
 		{
-			error.append(items_count);
+			error.append(update_items);
 			sql_error(ok, error.c_str());
 
 			return;
 		}
 
-		ok = sqlite3_prepare_v2(db, delete_items.c_str(), -1
-			, &m_delete_items_stmt, nullptr);
+		ok = sqlite3_prepare_v2(db, insert_items.c_str(), -1
+			, &m_insert_items_stmt, nullptr);
 		if (ok != SQLITE_OK)
 		{
-			error.append(delete_items);
+			error.append(insert_items);
 			sql_error(ok, error.c_str());
 
 			return;
 		}
 
-		ok = sqlite3_prepare_v2(db, select_ts_threshold.c_str(), -1
-			, &m_select_ts_threshold_stmt, nullptr);
+		ok = sqlite3_prepare_v2(db, evict_items.c_str(), -1
+			, &m_evict_items_stmt, nullptr);
 		if (ok != SQLITE_OK)
 		{
-			error.append(select_ts_threshold);
+			error.append(evict_items);
 			sql_error(ok, error.c_str());
 
 			return;
@@ -196,9 +221,12 @@ bool items_db_sqlite::get_mutable_item_timestamp(sha256_hash const& target
 		}
 		else
 		{
-			std::string log_msg("can't get timestamp by target:");
-			log_msg.append(aux::to_hex(target));
-			sql_log(ok, log_msg.c_str());
+			if (should_log_sql(aux::LOG_DEBUG))
+			{
+				std::string log_msg("can't get timestamp by target:");
+				log_msg.append(aux::to_hex(target));
+				sql_log(ok, log_msg.c_str());
+			}
 
 			return false;
         }
@@ -274,9 +302,12 @@ bool items_db_sqlite::get_mutable_item(sha256_hash const& target
 					return false;
 				}
 
-				std::string get_log_msg("get item:");
-				get_log_msg.append(item.to_string(true));
-				sql_log(0, get_log_msg.c_str());
+				if (should_log_sql(aux::LOG_DEBUG))
+				{
+					std::string get_log_msg("get item:");
+					get_log_msg.append(item.to_string(true));
+					sql_log(0, get_log_msg.c_str());
+				}
 			}
 
 			// move to the end
@@ -285,9 +316,12 @@ bool items_db_sqlite::get_mutable_item(sha256_hash const& target
         }
         else
         {
-			std::string log_msg("can't get item by target:");
-			log_msg.append(aux::to_hex(target));
-			sql_log(ok, log_msg.c_str());
+			if (should_log_sql(aux::LOG_DEBUG))
+			{
+				std::string log_msg("can't get item by target:");
+				log_msg.append(aux::to_hex(target));
+				sql_log(ok, log_msg.c_str());
+			}
 
 			return false;
         }
@@ -321,7 +355,7 @@ void items_db_sqlite::put_mutable_item(sha256_hash const& target
 {
 	sqlite3* db = m_observer->get_items_database();
 
-	if (db != NULL && m_insert_or_replace_items_stmt != NULL)
+	if (db != NULL && m_update_items_stmt != NULL && m_insert_items_stmt != NULL)
 	{
 		entry e;
 		error_code ec;
@@ -345,23 +379,52 @@ void items_db_sqlite::put_mutable_item(sha256_hash const& target
 		m_mutable_item.clear();
 		bencode(std::back_inserter(m_mutable_item), e);
 
-		sqlite3_reset(m_insert_or_replace_items_stmt);
+		int const dist = m_node_ids.empty() ? 256 : min_distance_exp(target, m_node_ids);
 
-		sqlite3_bind_text(m_insert_or_replace_items_stmt, 1
-			, target.data(), 32, nullptr);
-		sqlite3_bind_int(m_insert_or_replace_items_stmt, 2, aux::numeric_cast<int>(ts.value));
-		sqlite3_bind_text(m_insert_or_replace_items_stmt, 3
+		sqlite3_reset(m_update_items_stmt);
+
+		sqlite3_bind_int(m_update_items_stmt, 1, aux::numeric_cast<int>(ts.value));
+		sqlite3_bind_text(m_update_items_stmt, 2
 			, m_mutable_item.data(), m_mutable_item.size(), SQLITE_STATIC);
+		sqlite3_bind_int(m_update_items_stmt, 3, dist);
+		sqlite3_bind_text(m_update_items_stmt, 4
+			, target.data(), 32, nullptr);
 
 		time_point const start = aux::time_now();
-		int ok = sqlite3_step(m_insert_or_replace_items_stmt);
+		int ok = sqlite3_step(m_update_items_stmt);
+		bool inserted = false;
+		if (ok == SQLITE_DONE && sqlite3_changes(db) == 0)
+		{
+			sqlite3_reset(m_insert_items_stmt);
+
+			sqlite3_bind_text(m_insert_items_stmt, 1
+				, target.data(), 32, nullptr);
+			sqlite3_bind_int(m_insert_items_stmt, 2, aux::numeric_cast<int>(ts.value));
+			sqlite3_bind_text(m_insert_items_stmt, 3
+				, m_mutable_item.data(), m_mutable_item.size(), SQLITE_STATIC);
+			sqlite3_bind_int(m_insert_items_stmt, 4, dist);
+
+			ok = sqlite3_step(m_insert_items_stmt);
+			inserted = ok == SQLITE_DONE;
+		}
 		int const cost = aux::numeric_cast<int>(total_microseconds(aux::time_now() - start));
 		if (ok == SQLITE_DONE)
 		{
 			sql_time_cost(cost, "put item");
-			std::string log_msg("insert or update successfully:");
-			log_msg.append(e.to_string(true));
-			sql_log(ok, log_msg.c_str());
+			if (should_log_sql(aux::LOG_DEBUG))
+			{
+				std::string log_msg("insert or update successfully:");
+				log_msg.append(e.to_string(true));
+				sql_log(ok, log_msg.c_str());
+			}
+
+			// every new row over the max evicts one or more, so the table
+			// never needs a large delete
+			if (inserted)
+			{
+				++m_count;
+				evict();
+			}
 		}
 		else
 		{
@@ -385,103 +448,43 @@ void items_db_sqlite::remove_mutable_item(sha256_hash const& target)
 {
 }
 
-void items_db_sqlite::tick()
+void items_db_sqlite::evict()
 {
-	time_point const now = aux::time_now();
-	int refresh_period = m_settings.get_int(settings_pack::dht_items_db_refresh_time);
-	if (m_last_refresh + seconds(refresh_period) > now) return;
-	m_last_refresh = now;
+	int const max = m_settings.get_int(settings_pack::dht_items_db_max_count);
+	if (m_count <= max) return;
 
-	int max = m_settings.get_int(settings_pack::dht_items_db_max_count);
-	int count = 0;
+	int const batch = std::min(m_count - max
+		, m_settings.get_int(settings_pack::dht_items_db_eviction_batch));
+	if (batch <= 0) return;
 
 	sqlite3* db = m_observer->get_items_database();
 
-	if (db != NULL && m_items_count_stmt != NULL
-		&& m_delete_items_stmt != NULL && m_select_ts_threshold_stmt != NULL)
+	if (db != NULL && m_evict_items_stmt != NULL)
 	{
-		sqlite3_reset(m_items_count_stmt);
+		sqlite3_reset(m_evict_items_stmt);
+		sqlite3_bind_int(m_evict_items_stmt, 1, batch);
 
 		time_point const start = aux::time_now();
-		int ok = sqlite3_step(m_items_count_stmt);
+		int ok = sqlite3_step(m_evict_items_stmt);
 		int const cost = aux::numeric_cast<int>(total_microseconds(aux::time_now() - start));
-		if (ok == SQLITE_ROW)
+		if (ok == SQLITE_DONE)
 		{
-			sql_time_cost(cost, "count:");
+			sql_time_cost(cost, "evict:");
+
+			int const removed = sqlite3_changes(db);
+			m_count -= removed;
 
-            count = sqlite3_column_int(m_items_count_stmt, 0);
 #ifndef TORRENT_DISABLE_LOGGING
-			if (m_observer->should_log(dht_logger::items_db, aux::LOG_INFO))
+			if (m_observer->should_log(dht_logger::items_db, aux::LOG_DEBUG))
 			{
-				m_observer->log(dht_logger::items_db, "items count:%d, max:%d"
-					, count, max);
+				m_observer->log(dht_logger::items_db, "evict %d items, count:%d, max:%d"
+					, removed, m_count, max);
 			}
 #endif
-
-			// move to the end
-			sqlite3_step(m_items_count_stmt);
-        }
-		else
-		{
-			sql_error(ok, items_count.c_str());
-			return;
 		}
-
-		if (count > max)
+		else
 		{
-			int timestamp = 0;
-
-			sqlite3_reset(m_select_ts_threshold_stmt);
-			sqlite3_bind_int(m_select_ts_threshold_stmt, 1, count - max - 1);
-
-			time_point const start1 = aux::time_now();
-			ok = sqlite3_step(m_select_ts_threshold_stmt);
-			int const cost1 = aux::numeric_cast<int>(total_microseconds(aux::time_now() - start1));
-			if (ok == SQLITE_ROW)
-			{
-				sql_time_cost(cost1, "timestamp threshold:");
-				timestamp = sqlite3_column_int(m_select_ts_threshold_stmt, 0);
-
-#ifndef TORRENT_DISABLE_LOGGING
-				if (m_observer->should_log(dht_logger::items_db, aux::LOG_DEBUG))
-				{
-					m_observer->log(dht_logger::items_db, "timestamp threshold:%d"
-						, timestamp);
-				}
-#endif
-
-				// move to the end
-				sqlite3_step(m_select_ts_threshold_stmt);
-			}
-			else
-			{
-				sql_error(ok, select_ts_threshold.c_str());
-				return;
-			}
-
-			sqlite3_reset(m_delete_items_stmt);
-			sqlite3_bind_int(m_delete_items_stmt, 1, timestamp);
-
-			time_point const start2 = aux::time_now();
-			ok = sqlite3_step(m_delete_items_stmt);
-			int const cost2 = aux::numeric_cast<int>(total_microseconds(aux::time_now() - start2));
-			if (ok == SQLITE_DONE)
-			{
-				this->sql_time_cost(cost2, "delete:");
-
-#ifndef TORRENT_DISABLE_LOGGING
-				if (m_observer->should_log(dht_logger::items_db, aux::LOG_INFO))
-				{
-					m_observer->log(dht_logger::items_db, "delete %d items successfully"
-						, count - max);
-				}
-#endif
-			}
-			else
-			{
-				sql_error(ok, delete_items.c_str());
-				return;
-			}
+			sql_error(ok, evict_items.c_str());
 		}
 	}
 	else
@@ -489,20 +492,39 @@ void items_db_sqlite::tick()
 #ifndef TORRENT_DISABLE_LOGGING
 		if (m_observer->should_log(dht_logger::items_db, aux::LOG_ERR))
 		{
-			m_observer->log(dht_logger::items_db, "tick: sqlite databse is invalid");
+			m_observer->log(dht_logger::items_db, "evict: sqlite databse is invalid");
 		}
 #endif
 	}
 }
 
+void items_db_sqlite::tick()
+{
+	time_point const now = aux::time_now();
+	int refresh_period = m_settings.get_int(settings_pack::dht_items_db_refresh_time);
+	if (m_last_refresh + seconds(refresh_period) > now) return;
+	m_last_refresh = now;
+
+#ifndef TORRENT_DISABLE_LOGGING
+	if (m_observer->should_log(dht_logger::items_db, aux::LOG_INFO))
+	{
+		m_observer->log(dht_logger::items_db, "items count:%d, max:%d"
+			, m_count, m_settings.get_int(settings_pack::dht_items_db_max_count));
+	}
+#endif
+
+	// puts keep the table at its max. This catches up, one batch at a
+	// time, after the max was lowered
+	evict();
+}
+
 void items_db_sqlite::close()
 {
 	if (m_select_ts_by_target_stmt != NULL) sqlite3_finalize(m_select_ts_by_target_stmt);
 	if (m_select_item_by_target_stmt != NULL) sqlite3_finalize(m_select_item_by_target_stmt);
-	if (m_insert_or_replace_items_stmt != NULL) sqlite3_finalize(m_insert_or_replace_items_stmt);
-	if (m_items_count_stmt != NULL) sqlite3_finalize(m_items_count_stmt);
-	if (m_delete_items_stmt != NULL) sqlite3_finalize(m_delete_items_stmt);
-	if (m_select_ts_threshold_stmt != NULL) sqlite3_finalize(m_select_ts_threshold_stmt);
+	if (m_update_items_stmt != NULL) sqlite3_finalize(m_update_items_stmt);
+	if (m_insert_items_stmt != NULL) sqlite3_finalize(m_insert_items_stmt);
+	if (m_evict_items_stmt != NULL) sqlite3_finalize(m_evict_items_stmt);
 }
 
 void items_db_sqlite::sql_error(int err_code, const char* err_str) const
@@ -515,6 +537,16 @@ void items_db_sqlite::sql_error(int err_code, const char* err_str) const
 #endif
 }
 
+bool items_db_sqlite::should_log_sql(aux::LOG_LEVEL const log_level) const
+{
+#ifndef TORRENT_DISABLE_LOGGING
+	return m_observer->should_log(dht_logger::items_db, log_level);
+#else
+	TORRENT_UNUSED(log_level);
+	return false;
+#endif
+}
+
 void items_db_sqlite::sql_log(int code, const char* msg) const
 {
 #ifndef TORRENT_DISABLE_LOGGING
@@ -213,19 +213,37 @@ void node::prepare_bootstrap_nodes(std::vector<node_entry>& nodes
 #endif
 		}
 
+		int const warm_start = m_settings.get_int(settings_pack::dht_warm_start_nodes);
+
 		std::vector<bs_node_entry> referred_nodes;
-		m_bs_nodes_learner.get_bootstrap_nodes(referred_nodes, 4);
+		if (warm_start > 0)
+			m_bs_nodes_learner.get_warm_start_nodes(referred_nodes, warm_start);
+		else
+			m_bs_nodes_learner.get_bootstrap_nodes(referred_nodes, 4);
+
+		// the best 4 nodes of the last snapshot bootstrap, the rest are
+		// probed all at once, so the ones still alive are in the routing
+		// table after a single round trip
+		int referred = 0;
 		for (auto& bsn : referred_nodes)
 		{
-			nodes.push_back(node_entry(bsn.m_nid, bsn.m_ep));
+			if (referred++ < 4)
+			{
+				nodes.push_back(node_entry(bsn.m_nid, bsn.m_ep, bsn.m_rtt));
+			}
+			else
+			{
+				add_node(node_entry(bsn.m_nid, bsn.m_ep));
+			}
 
 #ifndef TORRENT_DISABLE_LOGGING
 			if (m_observer != nullptr
 				&& m_observer->should_log(dht_logger::node, aux::LOG_DEBUG))
 			{
-				m_observer->log(dht_logger::node, "add bs referred node:%s, %s"
+				m_observer->log(dht_logger::node, "add bs referred node:%s, %s, rtt:%d, verified:%d"
 					, aux::to_hex(bsn.m_nid).c_str()
-					, aux::print_endpoint(bsn.m_ep).c_str());
+					, aux::print_endpoint(bsn.m_ep).c_str()
+					, int(bsn.m_rtt), int(bsn.m_verified));
 			}
 #endif
 		}
@@ -650,6 +668,11 @@ void node::add_bootstrap_nodes(std::vector<node_entry> const& nodes)
 	m_bs_nodes_learner.add_bootstrap_nodes(bs_nodes);
 }
 
+void node::snapshot_routing_table()
+{
+	m_bs_nodes_learner.snapshot();
+}
+
 void node::add_node(node_entry const& node)
 {
 	if (!native_address(node.ep())) return;
@@ -778,13 +801,12 @@ void construct_mutable_item(item& i
 	, public_key const& pk
 	, secret_key const& sk)
 {
-	entry v = value;
 	std::vector<char> buf;
-	bencode(std::back_inserter(buf), v);
+	bencode(std::back_inserter(buf), value);
 	std::int64_t ts = ip2::aux::utcTime();
 	dht::signature sign = sign_mutable_item(buf, salt
 		, dht::timestamp(ts), pk, sk);
-	i.assign(std::move(v), salt, dht::timestamp(ts), pk, sign);
+	i.assign_bencoded(buf, salt, dht::timestamp(ts), pk, sign);
 }
 
 } // namespace
@@ -1372,9 +1394,19 @@ dht_status node::status() const
 		dht_lookup& lookup = ret.requests.back();
 		r->status(lookup);
 	}
+	ret.completed_requests.assign(m_completed_requests.begin()
+		, m_completed_requests.end());
 	return ret;
 }
 
+void node::traversal_completed(dht_lookup const& l)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (int(m_completed_requests.size()) >= max_completed_requests)
+		m_completed_requests.pop_front();
+	m_completed_requests.push_back(l);
+}
+
 std::tuple<int, int, int, std::int64_t> node::get_stats_counters() const
 {
 	int nodes, replacements;
@@ -1996,9 +2028,7 @@ bool node::incoming_push(msg const& m, entry& e, node_id const& id, item& i)
 
 		if (!mutable_put)
 		{
-			error_code errc;
-			auto v = bdecode(buf.first(buf.size()), errc);
-			i.assign(v);
+			i.assign_bencoded(buf);
 		}
 		else
 		{
@@ -2022,9 +2052,8 @@ bool node::incoming_push(msg const& m, entry& e, node_id const& id, item& i)
 
 			TORRENT_ASSERT(signature::len == msg_keys[4].string_length());
 
-			error_code errc;
-			auto v = bdecode(buf.first(buf.size()), errc);
-			i.assign(v, salt, ts, pk, sig);
+			// the signature is verified, store the bytes it covers
+			i.assign_bencoded(buf, salt, ts, pk, sig);
         }
 	}
 
@@ -0,0 +1,191 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "ip2/kademlia/packet_decoder.hpp"
+#include "ip2/kademlia/ed25519.hpp"
+#include "ip2/crypto.hpp"
+#include "ip2/assert.hpp"
+
+#include <array>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#ifdef TORRENT_ENABLE_UDP_COMPRESS
+#include <snappy-c.h>
+#endif
+
+namespace ip2 {
+namespace dht {
+
+namespace {
+
+	// the max number of exchange keys cached by each worker
+	constexpr std::size_t shard_key_cache_size = 4096;
+
+	// the same limits as dht_tracker::incoming_packet()
+	constexpr int bdecode_depth_limit = 10;
+	constexpr int bdecode_token_limit = 500;
+
+#ifdef TORRENT_ENABLE_UDP_COMPRESS
+	bool uncompress(std::string const& in, std::vector<char>& out)
+	{
+		std::size_t len;
+		if (snappy_uncompressed_length(in.data(), in.size(), &len) != SNAPPY_OK)
+			return false;
+
+		out.resize(len);
+		if (snappy_uncompress(in.data(), in.size(), out.data(), &len) != SNAPPY_OK)
+			return false;
+
+		out.resize(len);
+		return true;
+	}
+#endif
+}
+
+	struct packet_decoder::shard
+	{
+		shard() : work(make_work_guard(ios)) {}
+
+		// only touched by the worker thread
+		std::array<char, 32> exchange_key(sha256_hash const& pk, secret_key const& sk)
+		{
+			// the cache is only valid for our current key
+			if (!(cached_for == sk))
+			{
+				keys.clear();
+				cached_for = sk;
+			}
+
+			auto const it = keys.find(pk);
+			if (it != keys.end()) return it->second;
+
+			if (keys.size() >= shard_key_cache_size) keys.clear();
+
+			std::array<char, 32> const key
+				= ed25519_key_exchange(public_key(pk.data()), sk);
+			keys.emplace(pk, key);
+			return key;
+		}
+
+		io_context ios;
+		executor_work_guard<io_context::executor_type> work;
+		std::thread thread;
+
+		// the packets posted to the worker and not decoded yet. Incremented
+		// on the network thread, decremented by the worker
+		std::atomic<int> pending{0};
+
+		secret_key cached_for{};
+		std::unordered_map<sha256_hash, std::array<char, 32>> keys;
+	};
+
+	packet_decoder::packet_decoder(io_context& ios, int const num_threads
+		, int const max_pending)
+		: m_ios(ios)
+		, m_max_pending(max_pending)
+	{
+		TORRENT_ASSERT(num_threads > 0);
+		TORRENT_ASSERT(max_pending >= 0);
+
+		for (int i = 0; i < num_threads; ++i)
+		{
+			m_shards.emplace_back(new shard);
+			shard& s = *m_shards.back();
+			s.thread = std::thread([&s] { s.ios.run(); });
+		}
+	}
+
+	packet_decoder::~packet_decoder()
+	{
+		stop();
+	}
+
+	void packet_decoder::stop()
+	{
+		for (auto& s : m_shards)
+		{
+			s->work.reset();
+			s->ios.stop();
+		}
+
+		for (auto& s : m_shards)
+		{
+			if (s->thread.joinable()) s->thread.join();
+		}
+
+		m_shards.clear();
+	}
+
+	bool packet_decoder::post(udp::endpoint const& from, sha256_hash const& pk
+		, span<char const> payload, secret_key const& sk, handler done)
+	{
+		if (m_shards.empty()) return false;
+
+		// the public key is already a hash
+		std::size_t const idx = std::hash<sha256_hash>{}(pk) % m_shards.size();
+		shard& s = *m_shards[idx];
+
+		// a flood to one worker must not queue up without bound. Only the
+		// network thread adds to the count, so it can't go past the limit
+		if (m_max_pending > 0
+			&& s.pending.load(std::memory_order_relaxed) >= m_max_pending)
+		{
+			return false;
+		}
+		s.pending.fetch_add(1, std::memory_order_relaxed);
+
+		auto p = std::make_unique<decoded_packet>();
+		p->from = from;
+		p->pk = pk;
+
+		std::string in(payload.data(), std::size_t(payload.size()));
+
+		ip2::post(s.ios, [&ios = m_ios, &s, sk, in = std::move(in)
+			, p = std::move(p), done = std::move(done)]() mutable
+		{
+#ifdef TORRENT_ENABLE_UDP_ENCRYPTION
+			std::array<char, 32> const key = s.exchange_key(p->pk, sk);
+			std::string const keystr(key.data(), key.size());
+
+			std::string plain;
+			std::string err_str;
+			if (!aux::aes_decrypt(in, plain, keystr, err_str)) p->failed = true;
+#else
+			TORRENT_UNUSED(sk);
+			std::string plain = std::move(in);
+#endif
+
+#ifdef TORRENT_ENABLE_UDP_COMPRESS
+			if (!p->failed && !uncompress(plain, p->buf)) p->failed = true;
+#else
+			p->buf.assign(plain.begin(), plain.end());
+#endif
+
+			if (!p->failed)
+			{
+				int pos;
+				p->msg = bdecode(p->buf, p->ec, &pos
+					, bdecode_depth_limit, bdecode_token_limit);
+			}
+
+			s.pending.fetch_sub(1, std::memory_order_relaxed);
+
+			// the vector's storage doesn't move with the packet, so msg
+			// keeps referring to it on the network thread
+			ip2::post(ios, [p = std::move(p), done = std::move(done)]() mutable
+				{ done(std::move(p)); });
+		});
+		return true;
+	}
+
+} // namespace dht
+} // namespace ip2
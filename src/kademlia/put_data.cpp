@@ -98,7 +98,9 @@ bool put_data::invoke(observer_ptr o)
 	e["y"] = "q";
 	e["q"] = "put";
 	entry& a = e["a"];
-	a["v"] = m_data.value();
+	// send the bytes the signature covers as they are
+	span<char const> const v = m_data.buffer();
+	a["v"] = entry::preformatted_type(v.begin(), v.end());
 	a["token"] = ip2_token;
 	if (m_data.is_mutable())
 	{
@@ -0,0 +1,547 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "ip2/kademlia/relay_mailbox.hpp"
+
+#include "ip2/aux_/io_bytes.hpp"
+#include "ip2/aux_/time.hpp" // for time_now
+#include "ip2/bdecode.hpp"
+
+#include <boost/crc.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio> // for snprintf
+#include <cstring>
+#include <filesystem>
+
+#if TORRENT_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ip2 {
+namespace dht {
+
+namespace {
+
+	// every record starts with the size of its body and the crc32 of it
+	constexpr int record_header_size = 8;
+
+	// the layout of a put record body:
+	//   type (1), key (32), sender (32), receiver (32), protocol (1),
+	//   hmac (4), written at, in posix seconds (8),
+	//   payload size (2), payload, aux nodes size (2), aux nodes
+	constexpr int put_fixed_size = 1 + 32 + 32 + 32 + 1 + relay_hmac::len + 8 + 2 + 2;
+	constexpr int timestamp_offset = 1 + 32 + 32 + 32 + 1 + relay_hmac::len;
+
+	// the layout of a remove record body: type (1), key (32)
+	constexpr int remove_size = 1 + 32;
+
+	std::uint32_t crc32(span<char const> buf)
+	{
+		boost::crc_32_type crc;
+		crc.process_bytes(buf.data(), std::size_t(buf.size()));
+		return crc.checksum();
+	}
+
+	std::int64_t posix_now()
+	{
+		return std::chrono::duration_cast<std::chrono::seconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+	}
+}
+
+struct relay_mailbox::segment
+{
+	explicit segment(std::uint32_t const i) : id(i) {}
+
+	segment(segment const&) = delete;
+	segment& operator=(segment const&) = delete;
+
+	~segment()
+	{
+#if TORRENT_HAVE_MMAP
+		if (base != nullptr)
+		{
+			::msync(base, std::size_t(segment_size), MS_ASYNC);
+			::munmap(base, std::size_t(segment_size));
+		}
+		if (fd >= 0) ::close(fd);
+#endif
+	}
+
+	std::uint32_t const id;
+	int fd = -1;
+	char* base = nullptr;
+
+	// where the next record is written
+	int write_pos = 0;
+
+	// the bytes of the records still in the index
+	int live_bytes = 0;
+};
+
+relay_mailbox::relay_mailbox(settings_interface const& settings
+	, dht_observer* observer
+	, std::string dir)
+	: m_settings(settings)
+	, m_observer(observer)
+	, m_dir(std::move(dir))
+{
+	m_record.reserve(2048);
+}
+
+relay_mailbox::~relay_mailbox() = default;
+
+#ifndef TORRENT_DISABLE_LOGGING
+bool relay_mailbox::should_log(aux::LOG_LEVEL const log_level) const
+{
+	return m_observer != nullptr
+		&& m_observer->should_log(dht_logger::relay_mailbox, log_level);
+}
+#endif
+
+std::string relay_mailbox::segment_path(std::uint32_t const id) const
+{
+	char name[32];
+	std::snprintf(name, sizeof(name), "relay-%08x.seg", id);
+	return m_dir + "/" + name;
+}
+
+bool relay_mailbox::open(error_code& ec)
+{
+	close();
+
+	std::error_code fec;
+	std::filesystem::create_directories(m_dir, fec);
+
+	std::vector<std::uint32_t> ids;
+	for (auto const& e : std::filesystem::directory_iterator(m_dir, fec))
+	{
+		unsigned int id = 0;
+		char tail = 0;
+		std::string const name = e.path().filename().string();
+		if (std::sscanf(name.c_str(), "relay-%8x.se%c", &id, &tail) == 2 && tail == 'g')
+			ids.push_back(std::uint32_t(id));
+	}
+	if (fec)
+	{
+		ec.assign(fec.value(), generic_category());
+		return false;
+	}
+
+	std::sort(ids.begin(), ids.end());
+
+	time_point const start = aux::time_now();
+	for (std::uint32_t const id : ids)
+	{
+		error_code sec;
+		std::unique_ptr<segment> s = map_segment(id, false, sec);
+		if (!s)
+		{
+#ifndef TORRENT_DISABLE_LOGGING
+			if (should_log(aux::LOG_ERR))
+			{
+				m_observer->log(dht_logger::relay_mailbox, "failed to map %s: %s"
+					, segment_path(id).c_str(), sec.message().c_str());
+			}
+#endif
+			continue;
+		}
+		m_segments.push_back(std::move(s));
+		replay(*m_segments.back());
+	}
+
+	if (m_segments.empty())
+	{
+		std::unique_ptr<segment> s = map_segment(0, true, ec);
+		if (!s) return false;
+		m_segments.push_back(std::move(s));
+	}
+
+#ifndef TORRENT_DISABLE_LOGGING
+	if (should_log(aux::LOG_INFO))
+	{
+		m_observer->log(dht_logger::relay_mailbox
+			, "recovered %d relay entries from %d segments in %d ms"
+			, size(), int(m_segments.size())
+			, int(total_milliseconds(aux::time_now() - start)));
+	}
+#else
+	TORRENT_UNUSED(start);
+#endif
+
+	return true;
+}
+
+std::unique_ptr<relay_mailbox::segment> relay_mailbox::map_segment(std::uint32_t const id
+	, bool const create, error_code& ec) const
+{
+#if TORRENT_HAVE_MMAP
+	auto s = std::make_unique<segment>(id);
+	std::string const path = segment_path(id);
+
+	s->fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC | (create ? O_CREAT : 0), 0600);
+	if (s->fd < 0)
+	{
+		ec.assign(errno, generic_category());
+		return {};
+	}
+
+	struct ::stat st{};
+	if (::fstat(s->fd, &st) != 0)
+	{
+		ec.assign(errno, generic_category());
+		return {};
+	}
+
+	// segments have a fixed size, the unwritten part is zeros
+	if (st.st_size != segment_size && ::ftruncate(s->fd, segment_size) != 0)
+	{
+		ec.assign(errno, generic_category());
+		return {};
+	}
+
+	void* const base = ::mmap(nullptr, std::size_t(segment_size)
+		, PROT_READ | PROT_WRITE, MAP_SHARED, s->fd, 0);
+	if (base == MAP_FAILED)
+	{
+		ec.assign(errno, generic_category());
+		return {};
+	}
+	s->base = static_cast<char*>(base);
+	return s;
+#else
+	TORRENT_UNUSED(id);
+	TORRENT_UNUSED(create);
+	ec = boost::asio::error::operation_not_supported;
+	return {};
+#endif
+}
+
+void relay_mailbox::replay(segment& s)
+{
+	time_point const now = aux::time_now();
+	std::int64_t const posix = posix_now();
+	auto& key_index = m_index.get<by_key>();
+
+	int pos = 0;
+	bool torn = false;
+	while (pos + record_header_size <= segment_size)
+	{
+		char const* ptr = s.base + pos;
+		std::uint32_t const size = aux::read_uint32(ptr);
+		std::uint32_t const crc = aux::read_uint32(ptr);
+		if (size == 0) break;
+
+		if (size > std::uint32_t(segment_size - pos - record_header_size)
+			|| crc32({ptr, int(size)}) != crc)
+		{
+			torn = true;
+			break;
+		}
+
+		span<char const> const body(ptr, int(size));
+		std::uint8_t const type = std::uint8_t(body[0]);
+		sha256_hash const key(body.data() + 1);
+
+		if (type == put_record && body.size() >= put_fixed_size)
+		{
+			auto const it = key_index.find(key);
+			if (it != key_index.end()) erase(it);
+
+			char const* ts_ptr = body.data() + timestamp_offset;
+			std::int64_t const age = std::max(std::int64_t(0)
+				, posix - aux::read_int64(ts_ptr));
+
+			location l;
+			l.key = key;
+			l.receiver.assign(body.data() + 1 + 32 + 32);
+			l.segment_id = s.id;
+			l.offset = pos;
+			l.size = int(size);
+			l.last_seen = now - seconds(age);
+			m_index.insert(l);
+			s.live_bytes += record_header_size + int(size);
+		}
+		else if (type == remove_record && body.size() >= remove_size)
+		{
+			auto const it = key_index.find(key);
+			if (it != key_index.end()) erase(it);
+		}
+
+		pos += record_header_size + int(size);
+	}
+
+	// a record torn by a crash, and anything after it, is overwritten
+	if (torn) std::memset(s.base + pos, 0, std::size_t(segment_size - pos));
+	s.write_pos = pos;
+}
+
+relay_mailbox::segment* relay_mailbox::find_segment(std::uint32_t const id) const
+{
+	for (auto const& s : m_segments)
+		if (s->id == id) return s.get();
+	return nullptr;
+}
+
+span<char const> relay_mailbox::record(location const& l) const
+{
+	segment const* s = find_segment(l.segment_id);
+	TORRENT_ASSERT(s != nullptr);
+	if (s == nullptr) return {};
+	return {s->base + l.offset + record_header_size, l.size};
+}
+
+bool relay_mailbox::append(span<char const> body, std::uint32_t& segment_id, int& offset)
+{
+	int const need = record_header_size + int(body.size());
+	if (need > segment_size || m_segments.empty()) return false;
+
+	if (m_segments.back()->write_pos + need > segment_size)
+	{
+		error_code ec;
+		std::unique_ptr<segment> s = map_segment(m_segments.back()->id + 1, true, ec);
+		if (!s)
+		{
+#ifndef TORRENT_DISABLE_LOGGING
+			if (should_log(aux::LOG_ERR))
+			{
+				m_observer->log(dht_logger::relay_mailbox, "failed to start a segment: %s"
+					, ec.message().c_str());
+			}
+#endif
+			return false;
+		}
+		m_segments.push_back(std::move(s));
+	}
+
+	segment& s = *m_segments.back();
+	char* ptr = s.base + s.write_pos;
+	aux::write_uint32(body.size(), ptr);
+	aux::write_uint32(crc32(body), ptr);
+	std::memcpy(ptr, body.data(), std::size_t(body.size()));
+
+	segment_id = s.id;
+	offset = s.write_pos;
+	s.write_pos += need;
+	return true;
+}
+
+bool relay_mailbox::put(sha256_hash const& key
+	, sha256_hash const& sender
+	, sha256_hash const& receiver
+	, span<char const> payload
+	, span<char const> aux_nodes
+	, udp const protocol
+	, relay_hmac const& hmac)
+{
+	auto& key_index = m_index.get<by_key>();
+	auto const it = key_index.find(key);
+	if (it != key_index.end())
+	{
+		key_index.modify(it, [](location& l) { l.last_seen = aux::time_now(); });
+		return true;
+	}
+
+	if (payload.size() > 0xffff || aux_nodes.size() > 0xffff) return false;
+
+	m_record.clear();
+	auto out = std::back_inserter(m_record);
+	aux::write_uint8(put_record, out);
+	m_record.insert(m_record.end(), key.begin(), key.end());
+	m_record.insert(m_record.end(), sender.begin(), sender.end());
+	m_record.insert(m_record.end(), receiver.begin(), receiver.end());
+	aux::write_uint8(protocol == udp::v6() ? 6 : 4, out);
+	m_record.insert(m_record.end(), hmac.bytes.begin(), hmac.bytes.end());
+	aux::write_int64(posix_now(), out);
+	aux::write_uint16(payload.size(), out);
+	m_record.insert(m_record.end(), payload.begin(), payload.end());
+	aux::write_uint16(aux_nodes.size(), out);
+	m_record.insert(m_record.end(), aux_nodes.begin(), aux_nodes.end());
+
+	location l;
+	if (!append(m_record, l.segment_id, l.offset)) return false;
+
+	l.key = key;
+	l.receiver = receiver;
+	l.size = int(m_record.size());
+	l.last_seen = aux::time_now();
+	m_index.insert(l);
+	find_segment(l.segment_id)->live_bytes += record_header_size + l.size;
+	return true;
+}
+
+bool relay_mailbox::get(sha256_hash const& key, entry& re) const
+{
+	auto const& key_index = m_index.get<by_key>();
+	auto const it = key_index.find(key);
+	if (it == key_index.end()) return false;
+
+	span<char const> const body = record(*it);
+	if (body.size() < put_fixed_size) return false;
+
+	char const* ptr = body.data() + 1 + 32;
+	re["f"] = std::string(ptr, 32);
+	ptr += 32;
+	re["t"] = std::string(ptr, 32);
+	ptr += 32;
+	bool const v6 = aux::read_uint8(ptr) == 6;
+	relay_hmac const hmac(ptr);
+	re["hmac"] = hmac.bytes;
+	ptr += relay_hmac::len + 8;
+
+	char const* const end = body.data() + body.size();
+	int const payload_size = aux::read_uint16(ptr);
+	if (end - ptr < payload_size + 2) return false;
+	span<char const> const payload(ptr, payload_size);
+	ptr += payload_size;
+	int const aux_size = aux::read_uint16(ptr);
+	if (end - ptr < aux_size) return false;
+	span<char const> const aux_nodes(ptr, aux_size);
+
+	error_code ec;
+	if (!payload.empty()) re["pl"] = bdecode(payload, ec);
+	if (!aux_nodes.empty()) re[v6 ? "rn6" : "rn"] = bdecode(aux_nodes, ec);
+
+	return true;
+}
+
+bool relay_mailbox::get_random(sha256_hash const& receiver, sha256_hash& key) const
+{
+	auto const& receiver_index = m_index.get<by_receiver>();
+	auto const it = receiver_index.find(receiver);
+	if (it == receiver_index.end()) return false;
+
+	key = it->key;
+	return true;
+}
+
+void relay_mailbox::erase(index_t::index<by_key>::type::iterator const it)
+{
+	segment* s = find_segment(it->segment_id);
+	if (s != nullptr) s->live_bytes -= record_header_size + it->size;
+	m_index.get<by_key>().erase(it);
+}
+
+void relay_mailbox::remove(sha256_hash const& key)
+{
+	auto& key_index = m_index.get<by_key>();
+	auto const it = key_index.find(key);
+	if (it == key_index.end()) return;
+
+	erase(it);
+
+	// if the tombstone can't be written, the entry comes back after a
+	// restart, and is relayed once more
+	m_record.clear();
+	m_record.push_back(char(remove_record));
+	m_record.insert(m_record.end(), key.begin(), key.end());
+	std::uint32_t segment_id;
+	int offset;
+	append(m_record, segment_id, offset);
+}
+
+void relay_mailbox::compact_oldest(bool const drop_live)
+{
+	TORRENT_ASSERT(m_segments.size() > 1);
+	std::uint32_t const id = m_segments.front()->id;
+
+	std::vector<sha256_hash> live;
+	for (auto const& l : m_index)
+		if (l.segment_id == id) live.push_back(l.key);
+
+	int moved = 0;
+	auto& key_index = m_index.get<by_key>();
+	time_point const now = aux::time_now();
+	std::int64_t const posix = posix_now();
+	for (auto const& k : live)
+	{
+		auto const it = key_index.find(k);
+		if (!drop_live)
+		{
+			// the record is written again with the time it was last seen
+			span<char const> const body = record(*it);
+			m_record.assign(body.begin(), body.end());
+			char* ts_ptr = m_record.data() + timestamp_offset;
+			aux::write_int64(posix - total_seconds(now - it->last_seen), ts_ptr);
+
+			location l = *it;
+			if (append(m_record, l.segment_id, l.offset))
+			{
+				erase(it);
+				m_index.insert(l);
+				find_segment(l.segment_id)->live_bytes += record_header_size + l.size;
+				++moved;
+				continue;
+			}
+		}
+		erase(it);
+	}
+
+	std::string const path = segment_path(id);
+	m_segments.erase(m_segments.begin());
+	std::error_code fec;
+	std::filesystem::remove(path, fec);
+
+#ifndef TORRENT_DISABLE_LOGGING
+	if (should_log(aux::LOG_INFO))
+	{
+		m_observer->log(dht_logger::relay_mailbox
+			, "compacted segment %x: %d entries moved, %d dropped"
+			, id, moved, int(live.size()) - moved);
+	}
+#endif
+}
+
+void relay_mailbox::tick()
+{
+	if (m_segments.empty()) return;
+
+	if (m_settings.get_int(settings_pack::dht_relay_entry_lifetime) > 0)
+	{
+		time_point const now = aux::time_now();
+		time_duration const lifetime
+			= seconds(m_settings.get_int(settings_pack::dht_relay_entry_lifetime));
+		auto& time_index = m_index.get<by_time>();
+
+		while (!time_index.empty() && time_index.begin()->last_seen + lifetime <= now)
+			erase(m_index.project<by_key>(time_index.begin()));
+	}
+
+	// over its size, the oldest entries are dropped a segment at a time
+	std::int64_t const max_size = m_settings.get_int(settings_pack::dht_relay_mailbox_size);
+	while (m_segments.size() > 1 && disk_size() > max_size)
+		compact_oldest(true);
+
+	// the oldest segment is rewritten once at least half of it is dead.
+	// The live records move to the last segment
+	if (m_segments.size() > 1
+		&& m_segments.front()->live_bytes * 2 <= m_segments.front()->write_pos)
+	{
+		compact_oldest(false);
+	}
+}
+
+void relay_mailbox::close()
+{
+	m_index.clear();
+	m_segments.clear();
+}
+
+std::int64_t relay_mailbox::disk_size() const
+{
+	return std::int64_t(m_segments.size()) * segment_size;
+}
+
+} // namespace dht
+} // namespace ip2
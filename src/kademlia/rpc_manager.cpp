@@ -33,6 +33,7 @@ see LICENSE file.
 #include <ip2/aux_/time.hpp> // for aux::time_now
 #include <ip2/aux_/ip_helpers.hpp> // for is_v6
 
+#include <algorithm>
 #include <type_traits>
 #include <functional>
 
@@ -124,6 +125,12 @@ namespace {
 	, sizeof(get_peers_observer)
 	, sizeof(null_observer)
 	, sizeof(traversal_observer)});
+
+	// the resolution of the request timeouts
+	constexpr time_duration timer_resolution = milliseconds(10);
+
+	// the least time tick() asks to be called again in
+	constexpr time_duration min_tick_interval = milliseconds(50);
 }
 
 rpc_manager::rpc_manager(node_id const& our_id
@@ -134,6 +141,7 @@ rpc_manager::rpc_manager(node_id const& our_id
 	, socket_manager* sock_man
 	, dht_logger* log)
 	: m_pool_allocator(observer_storage_size, 10)
+	, m_timeouts(timer_resolution, aux::time_now())
 	, m_sock(std::move(sock))
 	, m_sock_man(sock_man)
 #ifndef TORRENT_DISABLE_LOGGING
@@ -159,7 +167,7 @@ rpc_manager::~rpc_manager()
 
 	for (auto const& t : m_transactions)
 	{
-		t.second->abort();
+		t.second.o->abort();
 	}
 }
 
@@ -192,11 +200,45 @@ void rpc_manager::check_invariant() const
 {
 	for (auto const& t : m_transactions)
 	{
-		TORRENT_ASSERT(t.second);
+		TORRENT_ASSERT(t.second.o);
 	}
+	TORRENT_ASSERT(m_timeouts.size() == int(m_transactions.size()));
 }
 #endif
 
+void rpc_manager::add_transaction(std::uint16_t const tid, observer_ptr o)
+{
+	udp::endpoint const ep = o->target_ep();
+	time_duration const short_timeout = m_rtt.short_timeout(ep);
+	time_duration const timeout = m_rtt.timeout(ep);
+
+	// the short timeout is skipped if it wouldn't come first
+	bool const is_short = short_timeout < timeout;
+	timer_handle const timer = m_timeouts.add(
+		o->sent() + (is_short ? short_timeout : timeout)
+		, pending_timeout{tid, o.get(), is_short});
+	m_transactions.emplace(tid, transaction{std::move(o), timer});
+}
+
+rpc_manager::transaction_map::iterator rpc_manager::find_transaction(
+	std::uint16_t const tid, observer const* o)
+{
+	auto const range = m_transactions.equal_range(tid);
+	for (auto i = range.first; i != range.second; ++i)
+	{
+		if (i->second.o.get() == o) return i;
+	}
+	return m_transactions.end();
+}
+
+observer_ptr rpc_manager::erase_transaction(transaction_map::iterator const i)
+{
+	observer_ptr o = std::move(i->second.o);
+	m_timeouts.remove(i->second.timer);
+	m_transactions.erase(i);
+	return o;
+}
+
 void rpc_manager::unreachable(udp::endpoint const& ep)
 {
 #ifndef TORRENT_DISABLE_LOGGING
@@ -207,19 +249,18 @@ void rpc_manager::unreachable(udp::endpoint const& ep)
 	}
 #endif
 
-	for (auto i = m_transactions.begin(); i != m_transactions.end();)
+	for (auto i = m_transactions.begin(); i != m_transactions.end(); ++i)
 	{
-		TORRENT_ASSERT(i->second);
-		if (i->second->target_ep() != ep) { ++i; continue; }
-		observer_ptr o = i->second;
+		TORRENT_ASSERT(i->second.o);
+		if (i->second.o->target_ep() != ep) continue;
 #ifndef TORRENT_DISABLE_LOGGING
 		if (m_log->should_log(dht_logger::rpc_manager, aux::LOG_WARNING))
 		{
 			m_log->log(dht_logger::rpc_manager, "[%u] found transaction [ tid: %d ]"
-				, o->algorithm()->id(), i->first);
+				, i->second.o->algorithm()->id(), i->first);
 		}
 #endif
-		i = m_transactions.erase(i);
+		observer_ptr const o = erase_transaction(i);
 		o->timeout();
 		break;
 	}
@@ -248,9 +289,8 @@ bool rpc_manager::incoming(msg const& m, node_id const& nid)
 	auto range = m_transactions.equal_range(tid);
 	for (auto i = range.first; i != range.second; ++i)
 	{
-		if (m.addr.address() != i->second->target_addr()) continue;
-		o = i->second;
-		i = m_transactions.erase(i);
+		if (m.addr.address() != i->second.o->target_addr()) continue;
+		o = erase_transaction(i);
 		break;
 	}
 
@@ -277,6 +317,9 @@ bool rpc_manager::incoming(msg const& m, node_id const& nid)
 
 	time_point const now = clock_type::now();
 
+	// an error is a round trip too
+	m_rtt.sample(o->target_ep(), now - o->sent(), now);
+
 #ifndef TORRENT_DISABLE_LOGGING
 	if (m_log->should_log(dht_logger::rpc_manager, aux::LOG_DEBUG))
 	{
@@ -354,26 +397,24 @@ time_duration rpc_manager::tick()
 {
 	INVARIANT_CHECK;
 
-	constexpr auto short_timeout = seconds(1);
-	// ip2: set timeout into 5s from 15s
-	constexpr auto timeout = seconds(5);
-
 	// look for observers that have timed out
 
-	if (m_transactions.empty()) return short_timeout;
+	time_point const now = aux::time_now();
+
+	std::vector<pending_timeout> expired;
+	m_timeouts.advance(now, expired);
 
 	std::vector<observer_ptr> timeouts;
 	std::vector<observer_ptr> short_timeouts;
 
-	time_duration ret = short_timeout;
-	time_point now = aux::time_now();
-
-	for (auto i = m_transactions.begin(); i != m_transactions.end();)
+	for (auto const& t : expired)
 	{
-		observer_ptr o = i->second;
+		auto const i = find_transaction(t.tid, t.o);
+		TORRENT_ASSERT(i != m_transactions.end());
+		if (i == m_transactions.end()) continue;
+		observer_ptr const& o = i->second.o;
 
-		time_duration diff = now - o->sent();
-		if (diff >= timeout)
+		if (!t.is_short)
 		{
 #ifndef TORRENT_DISABLE_LOGGING
 			if (m_log->should_log(dht_logger::rpc_manager, aux::LOG_WARNING))
@@ -383,37 +424,37 @@ time_duration rpc_manager::tick()
 					, aux::print_endpoint(o->target_ep()).c_str());
 			}
 #endif
-			i = m_transactions.erase(i);
-			timeouts.push_back(o);
+			// the timer already expired, it's not in the wheel anymore
+			timeouts.push_back(std::move(i->second.o));
+			m_transactions.erase(i);
 			continue;
 		}
 
+		i->second.timer = m_timeouts.add(o->sent() + m_rtt.timeout(o->target_ep())
+			, pending_timeout{t.tid, t.o, false});
+
 		// don't call short_timeout() again if we've
 		// already called it once
-		if (diff >= short_timeout && !o->has_short_timeout())
-		{
-#ifndef TORRENT_DISABLE_LOGGING
-			if (m_log->should_log(dht_logger::rpc_manager, aux::LOG_WARNING))
-			{
-				m_log->log(dht_logger::rpc_manager, "[%u] short-timing out transaction id: %d from: %s"
-					, o->algorithm()->id(), i->first
-					, aux::print_endpoint(o->target_ep()).c_str());
-			}
-#endif
-			++i;
+		if (o->has_short_timeout()) continue;
 
-			short_timeouts.push_back(o);
-			continue;
+#ifndef TORRENT_DISABLE_LOGGING
+		if (m_log->should_log(dht_logger::rpc_manager, aux::LOG_WARNING))
+		{
+			m_log->log(dht_logger::rpc_manager, "[%u] short-timing out transaction id: %d from: %s"
+				, o->algorithm()->id(), i->first
+				, aux::print_endpoint(o->target_ep()).c_str());
 		}
-
-		ret = std::min(duration_cast<time_duration>(timeout - diff), ret);
-		++i;
+#endif
+		short_timeouts.push_back(o);
 	}
 
 	std::for_each(timeouts.begin(), timeouts.end(), std::bind(&observer::timeout, _1));
 	std::for_each(short_timeouts.begin(), short_timeouts.end(), std::bind(&observer::short_timeout, _1));
 
-	return std::max(ret, duration_cast<time_duration>(milliseconds(200)));
+	if (m_timeouts.empty()) return rtt_estimator::default_short_timeout;
+
+	time_duration const next = m_timeouts.next_expiry() - aux::time_now();
+	return std::clamp(next, min_tick_interval, rtt_estimator::default_short_timeout);
 }
 
 bool rpc_manager::invoke(entry& e, udp::endpoint const& target_addr
@@ -463,7 +504,7 @@ bool rpc_manager::invoke(entry& e, udp::endpoint const& target_addr
 	{
 		if (!discard_response)
 		{
-			m_transactions.emplace(tid, o);
+			add_transaction(tid, o);
 		}
 #if TORRENT_USE_ASSERTS
 		o->m_was_sent = true;
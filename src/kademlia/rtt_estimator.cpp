@@ -0,0 +1,105 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include <ip2/kademlia/rtt_estimator.hpp>
+
+#include <algorithm>
+
+namespace ip2 {
+namespace dht {
+
+namespace {
+
+	// the clock granularity of RFC 6298, the least the variation counts for
+	constexpr time_duration granularity = milliseconds(10);
+
+	// the timeout is this many retransmission timeouts
+	constexpr int timeout_factor = 4;
+
+	// an estimate not sampled for this long is dropped first when the
+	// table is full
+	constexpr time_duration stale_age = minutes(10);
+
+	time_duration abs(time_duration const d)
+	{
+		return d < time_duration::zero() ? -d : d;
+	}
+}
+
+void rtt_estimator::sample(udp::endpoint const& ep, time_duration const rtt
+	, time_point const now)
+{
+	if (rtt < time_duration::zero()) return;
+
+	auto it = m_estimates.find(ep);
+	if (it == m_estimates.end())
+	{
+		if (int(m_estimates.size()) >= max_endpoints) prune(now);
+
+		// the first sample, RFC 6298 section 2.2
+		m_estimates.emplace(ep, estimate{rtt, rtt / 2, now});
+		return;
+	}
+
+	// RFC 6298 section 2.3, with alpha = 1/8 and beta = 1/4
+	estimate& e = it->second;
+	e.rttvar = (e.rttvar * 3 + abs(e.srtt - rtt)) / 4;
+	e.srtt = (e.srtt * 7 + rtt) / 8;
+	e.last_sample = now;
+}
+
+time_duration rtt_estimator::short_timeout(udp::endpoint const& ep) const
+{
+	estimate const* e = find(ep);
+	if (e == nullptr) return default_short_timeout;
+	return std::clamp(rto(*e), min_short_timeout, max_short_timeout);
+}
+
+time_duration rtt_estimator::timeout(udp::endpoint const& ep) const
+{
+	estimate const* e = find(ep);
+	if (e == nullptr) return default_timeout;
+	return std::clamp(rto(*e) * timeout_factor, min_timeout, max_timeout);
+}
+
+rtt_estimator::estimate const* rtt_estimator::find(udp::endpoint const& ep) const
+{
+	auto const it = m_estimates.find(ep);
+	return it == m_estimates.end() ? nullptr : &it->second;
+}
+
+time_duration rtt_estimator::rto(estimate const& e)
+{
+	return e.srtt + std::max(granularity, e.rttvar * 4);
+}
+
+void rtt_estimator::prune(time_point const now)
+{
+	auto oldest = m_estimates.end();
+	for (auto it = m_estimates.begin(); it != m_estimates.end();)
+	{
+		if (now - it->second.last_sample >= stale_age)
+		{
+			it = m_estimates.erase(it);
+			continue;
+		}
+		if (oldest == m_estimates.end()
+			|| it->second.last_sample < oldest->second.last_sample)
+		{
+			oldest = it;
+		}
+		++it;
+	}
+
+	if (int(m_estimates.size()) >= max_endpoints && oldest != m_estimates.end())
+		m_estimates.erase(oldest);
+}
+
+} // namespace dht
+} // namespace ip2
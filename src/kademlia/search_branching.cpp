@@ -0,0 +1,56 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include <ip2/kademlia/search_branching.hpp>
+
+#include <algorithm>
+#include <limits>
+
+namespace ip2 {
+namespace dht {
+
+namespace {
+
+	std::int8_t clamp_factor(int const f)
+	{
+		return std::int8_t(std::clamp(f, 1, int(std::numeric_limits<std::int8_t>::max())));
+	}
+}
+
+search_branching::search_branching(int const initial, int const max)
+	: m_factor(clamp_factor(initial))
+	, m_max(clamp_factor(max))
+{}
+
+void search_branching::start(int const closest)
+{
+	m_closest = closest;
+}
+
+void search_branching::replied(int const closest)
+{
+	// the nodes of the reply got the lookup closer to the target, it's
+	// converging and can afford more requests in flight
+	if (closest >= m_closest) return;
+	m_closest = closest;
+	if (m_factor < m_max) ++m_factor;
+}
+
+void search_branching::timed_out()
+{
+	m_factor = std::max(std::int8_t(1), std::int8_t(m_factor / 2));
+}
+
+int search_branching::free_slots(int const outstanding, int const late) const
+{
+	return std::max(0, m_factor - (outstanding - late));
+}
+
+} // namespace dht
+} // namespace ip2
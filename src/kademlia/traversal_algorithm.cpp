@@ -61,9 +61,11 @@ observer_ptr traversal_algorithm::new_observer(udp::endpoint const& ep
 traversal_algorithm::traversal_algorithm(node& dht_node, node_id const& target)
 	: m_node(dht_node)
 	, m_target(target)
+	, m_branching(m_node.branch_factor()
+		, m_node.settings().get_int(settings_pack::dht_max_search_branching))
+	, m_start(aux::time_now())
 {
 
-	m_branch_factor = aux::numeric_cast<std::int8_t>(m_node.branch_factor());
 	m_invoke_window = aux::numeric_cast<std::int8_t>(m_node.invoke_window());
 	m_invoke_limit = aux::numeric_cast<std::int8_t>(m_node.invoke_limit());
 #ifndef TORRENT_DISABLE_LOGGING
@@ -272,6 +274,7 @@ void traversal_algorithm::start()
 	// TODO: remove this logic when blockchain can provide more alive nodes.
 	if (m_results.size() < invoke_window()) add_router_entries();
 	init();
+	m_branching.start(closest_distance());
 	bool const is_done = add_requests();
 	if (is_done) done();
 }
@@ -354,7 +357,7 @@ void traversal_algorithm::finished(observer_ptr o)
 	// branch factor for it, and we should restore it
 	if (o->flags & observer::flag_short_timeout)
 	{
-		TORRENT_ASSERT(m_branch_factor > 0);
+		TORRENT_ASSERT(m_branching.factor() > 0);
 		//--m_branch_factor;
 	}
 
@@ -362,6 +365,12 @@ void traversal_algorithm::finished(observer_ptr o)
 	o->flags |= observer::flag_alive;
 
 	++m_responses;
+	if (m_first_response == time_point::max())
+		m_first_response = aux::time_now();
+
+	// the nodes in the reply were added before we get here
+	m_branching.replied(closest_distance());
+
 	bool const is_done = add_requests();
 	if (is_done) done();
 }
@@ -410,7 +419,7 @@ void traversal_algorithm::failed(observer_ptr o, traversal_flags_t const flags)
 		// around for some more, but open up the slot
 		// by increasing the branch factor
 		if (!(o->flags & observer::flag_short_timeout)
-			&& m_branch_factor < std::numeric_limits<std::int8_t>::max())
+			&& m_branching.factor() < std::numeric_limits<std::int8_t>::max())
 		{
 			//++m_branch_factor;
 			o->flags |= observer::flag_short_timeout;
@@ -432,6 +441,7 @@ void traversal_algorithm::failed(observer_ptr o, traversal_flags_t const flags)
 
 		++m_timeouts;
 		TORRENT_ASSERT(m_invoke_count > 0);
+		m_branching.timed_out();
 
 		node_entry *existing;
 		std::tie(existing, std::ignore, std::ignore) = m_node.m_table.find_node(o->target_ep());
@@ -447,7 +457,7 @@ void traversal_algorithm::failed(observer_ptr o, traversal_flags_t const flags)
 
 	if (decrement_branch_factor)
 	{
-		TORRENT_ASSERT(m_branch_factor > 0);
+		TORRENT_ASSERT(m_branching.factor() > 0);
 		//--m_branch_factor;
 		//if (m_branch_factor <= 0) m_branch_factor = 1;
 	}
@@ -466,13 +476,19 @@ void traversal_algorithm::log_timeout(observer_ptr const& o, char const* prefix)
 			, "[%u] %sTIMEOUT id: %s distance: %d addr: %s branch-factor: %d "
 			"invoke-count: %d type: %s"
 			, m_id, prefix, aux::to_hex(o->id()).c_str(), distance_exp(m_target, o->id())
-			, aux::print_address(o->target_addr()).c_str(), m_branch_factor
+			, aux::print_address(o->target_addr()).c_str(), m_branching.factor()
 			, m_invoke_count, name());
 	}
 
 }
 #endif
 
+int traversal_algorithm::closest_distance() const
+{
+	if (m_sorted_results == 0) return 257;
+	return distance_exp(m_target, m_results.front()->id());
+}
+
 void traversal_algorithm::done()
 {
 	TORRENT_ASSERT(m_done == false);
@@ -519,6 +535,10 @@ void traversal_algorithm::done()
 	}
 #endif
 
+	dht_lookup l;
+	status(l);
+	m_node.traversal_completed(l);
+
 	// delete all our references to the observer objects so
 	// they will in turn release the traversal algorithm
 	m_results.clear();
@@ -727,18 +747,20 @@ bool traversal_algorithm::add_requests()
 				o->flags |= observer::flag_failed;
 			}
 		}
+		++m_rounds;
 
 		return true;
 	}
 
-	// the following logic is based on 'alpha == 1'.
-	TORRENT_ASSERT(m_branch_factor == 1);
-
-	// this only counts outstanding requests at the top of the
-	// invoke window. Because in the condition of 'alpha == 1',
-	// the outstanding requests can only happen in invoke window.
+	// this only counts outstanding requests in the invoke window, the
+	// only place requests are sent to.
 	int outstanding = 0;
 
+	// the outstanding requests past their short timeout. They're unlikely
+	// to be answered and don't hold a slot of the in-flight window, but
+	// the traversal still waits for them
+	int late = 0;
+
 	// invoke count in invoke window.
 	int invoke_count_in_window = 0;
 	int j = 0;
@@ -763,7 +785,10 @@ bool traversal_algorithm::add_requests()
 			// if it's queried, not alive and not failed, it
 			// must be currently in flight
 			if (!(o->flags & observer::flag_failed))
+			{
 				++outstanding;
+				if (o->flags & observer::flag_short_timeout) ++late;
+			}
 
 			invoke_count_in_window++;
 			continue;
@@ -788,8 +813,12 @@ bool traversal_algorithm::add_requests()
 	std::uint32_t random_max = int(m_results.size()) >= m_invoke_window ?
 		std::uint32_t(m_invoke_window) - 1 : std::uint32_t(m_results.size()) - 1;
 
-	// Find the first node in invoke window that hasn't already been queried.
-	while (m_invoke_count < m_invoke_limit
+	bool sent = false;
+
+	// Keep branch factor requests in flight, to nodes in the invoke
+	// window that haven't already been queried.
+	while (m_branching.free_slots(outstanding, late) > 0
+		&& m_invoke_count < m_invoke_limit
 		&& invoke_count_in_window < m_invoke_window
 		&& invoke_count_in_window < aux::numeric_cast<std::int16_t>(m_results.size())
 	)
@@ -822,9 +851,9 @@ bool traversal_algorithm::add_requests()
 		{
 			logger->log(dht_logger::traversal
 				, "[%u] INVOKE node-index: %d outstanding: %d "
-				"invoke-count: %d invoke-window: %d invoke-limit: %d "
+				"invoke-count: %d branch-factor: %d invoke-window: %d invoke-limit: %d "
 				"distance: %d id: %s addr: %s type: %s"
-				, m_id, r, outstanding, int(m_invoke_count)
+				, m_id, r, outstanding, int(m_invoke_count), m_branching.factor()
 				, int(m_invoke_window), int(m_invoke_limit)
 				, distance_exp(m_target, o->id()), aux::to_hex(o->id()).c_str()
 				, aux::print_address(o->target_addr()).c_str(), name());
@@ -839,7 +868,7 @@ bool traversal_algorithm::add_requests()
 		{
 			TORRENT_ASSERT(m_invoke_count < std::numeric_limits<std::int8_t>::max());
 			++outstanding;
-			break; // alpha == 1, so just invoke once
+			sent = true;
 		}
 		else
 		{
@@ -853,6 +882,8 @@ bool traversal_algorithm::add_requests()
 		}
 	}
 
+	if (sent) ++m_rounds;
+
 	// 1. 'invoke_count_in_window == m_invoke_window':
 	//      the nodes in invoke window all have been invoked.
 	// 2. 'invoke_count_in_window == m_results.size()':
@@ -929,7 +960,9 @@ void traversal_algorithm::status(dht_lookup& l)
 	l.timeouts = m_timeouts;
 	l.responses = m_responses;
 	l.outstanding_requests = m_invoke_count;
-	l.branch_factor = m_branch_factor;
+	l.branch_factor = m_branching.factor();
+	l.rounds = m_rounds;
+	l.rpcs = m_invoke_count;
 	l.type = name();
 	l.nodes_left = 0;
 	l.first_timeout = 0;
@@ -938,6 +971,9 @@ void traversal_algorithm::status(dht_lookup& l)
 
 	int last_sent = INT_MAX;
 	time_point const now = aux::time_now();
+	l.duration = int(total_milliseconds(now - m_start));
+	l.first_response = m_first_response == time_point::max() ? -1
+		: int(total_milliseconds(m_first_response - m_start));
 	for (auto const& r : m_results)
 	{
 		observer const& o = *r;
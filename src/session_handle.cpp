@@ -561,6 +561,75 @@ namespace ip2 {
 			, receiver, message);
 	}
 
+	void session_handle::async_put_data_into_swarm(std::vector<char> blob
+		, std::array<char, 20> const& uri)
+	{
+		aux::submission s;
+		s.type = aux::submission::put_data;
+		s.uri = uri;
+		s.payload = std::move(blob);
+		submit(std::move(s));
+	}
+
+	void session_handle::async_relay_data_uri(std::array<char, 32> const& receiver
+		, std::array<char, 20> const& uri
+		, std::int64_t const timestamp)
+	{
+		aux::submission s;
+		s.type = aux::submission::relay_data_uri;
+		s.peer = receiver;
+		s.uri = uri;
+		s.timestamp = timestamp;
+		submit(std::move(s));
+	}
+
+	void session_handle::async_get_data_from_swarm(std::array<char, 32> const& sender
+		, std::array<char, 20> const& uri
+		, std::int64_t const timestamp)
+	{
+		aux::submission s;
+		s.type = aux::submission::get_data;
+		s.peer = sender;
+		s.uri = uri;
+		s.timestamp = timestamp;
+		submit(std::move(s));
+	}
+
+	void session_handle::async_relay_message(std::array<char, 32> const& receiver
+		, std::vector<char> message)
+	{
+		aux::submission s;
+		s.type = aux::submission::relay_message;
+		s.peer = receiver;
+		s.payload = std::move(message);
+		submit(std::move(s));
+	}
+
+	void session_handle::submit(aux::submission s) const
+	{
+		std::shared_ptr<session_impl> ses = m_impl.lock();
+		if (!ses) aux::throw_ex<system_error>(errors::invalid_session_handle);
+
+		switch (ses->submissions().push(std::move(s)))
+		{
+			case aux::submission_queue::push_result::queued_first:
+				// the first request of a batch schedules the drain, the
+				// others ride along with it
+				async_call(&session_impl::drain_submissions);
+				break;
+			case aux::submission_queue::push_result::queued:
+				break;
+			case aux::submission_queue::push_result::full:
+				// alerts are only posted from the network thread. The alert
+				// only tells which request was rejected, so the payload is
+				// freed here rather than carried over with it
+				s.payload = std::vector<char>();
+				async_call(&session_impl::post_submission_alert, std::move(s)
+					, ip2::api::TRANSPORT_BUFFER_FULL);
+				break;
+		}
+	}
+
 	void session_handle::set_ip_filter(ip_filter f)
 	{
 		std::shared_ptr<ip_filter> copy = std::make_shared<ip_filter>(std::move(f));
@@ -25,6 +25,7 @@ see LICENSE file.
 
 #include <ctime>
 #include <algorithm>
+#include <array>
 #include <cctype>
 #include <cstdio> // for snprintf
 #include <cinttypes> // for PRId64 et.al.
@@ -177,6 +178,12 @@ namespace ip2::aux {
 	bool _handler_logger_registered = false;
 #endif
 
+namespace {
+	// the prefix of the uTP packets of the direct channel, to tell them
+	// apart from the encrypted DHT packets on the same socket
+	constexpr std::array<char, 4> utp_packet_magic = {{'I', 'P', '2', 'U'}};
+}
+
 void apply_deprecated_dht_settings(settings_pack& sett, bdecode_node const& s)
 {
 	bdecode_node val;
@@ -460,6 +467,16 @@ void apply_deprecated_dht_settings(settings_pack& sett, bdecode_node const& s)
 		, m_io_context(ioc)
 		, m_alerts(m_settings.get_int(settings_pack::alert_queue_size)
 			, alert_category_t{static_cast<unsigned int>(m_settings.get_int(settings_pack::alert_mask))})
+		, m_submissions(m_settings.get_int(settings_pack::submission_queue_size))
+		, m_utp_socket_manager(
+			[this](std::weak_ptr<utp_socket_interface> sock, udp::endpoint const& ep
+				, span<char const> p, error_code& ec, udp_send_flags_t const flags)
+			{ send_utp_packet(std::move(sock), ep, p, ec, flags); }
+			, [this](socket_type s) { on_incoming_utp(std::move(s)); }
+			, m_io_context
+			, m_settings
+			, m_stats_counters
+			, nullptr)
 		, m_host_resolver(m_io_context)
 		, m_work(make_work_guard(m_io_context))
 		, m_timer(m_io_context)
@@ -547,6 +564,7 @@ void apply_deprecated_dht_settings(settings_pack& sett, bdecode_node const& s)
 		// this is a debug facility
 		// see single_threaded in debug.hpp
 		thread_started();
+		m_alerts.thread_started();
 
 		TORRENT_ASSERT(is_single_thread());
 
@@ -589,6 +607,8 @@ void apply_deprecated_dht_settings(settings_pack& sett, bdecode_node const& s)
 			m_timer.async_wait([this](error_code const& e) {
 					this->wrap(&session_impl::on_tick, e); });
 
+			m_utp_socket_manager.tick(aux::time_now());
+
             //peer check and reopen
 		    if (m_dht)
 			    m_dht->update_stats_counters(m_stats_counters);
@@ -1931,6 +1951,66 @@ namespace {
 		}
 	}
 
+	void session_impl::send_utp_packet(std::weak_ptr<utp_socket_interface> sock
+		, udp::endpoint const& ep
+		, span<char const> p
+		, error_code& ec
+		, udp_send_flags_t const flags)
+	{
+		m_utp_send_buffer.clear();
+		m_utp_send_buffer.insert(m_utp_send_buffer.end()
+			, utp_packet_magic.begin(), utp_packet_magic.end());
+		m_utp_send_buffer.insert(m_utp_send_buffer.end(), p.begin(), p.end());
+
+		send_udp_packet(std::move(sock), ep, m_utp_send_buffer, ec, flags);
+	}
+
+	void session_impl::on_incoming_utp(socket_type s)
+	{
+		auto* const stream = std::get_if<utp_stream>(&s);
+		if (stream == nullptr || !m_assembler) return;
+
+		m_assembler->on_incoming_direct(std::make_unique<utp_stream>(std::move(*stream)));
+	}
+
+	std::unique_ptr<utp_stream> session_impl::open_direct_stream(udp::endpoint const& ep)
+	{
+		auto const ls = std::find_if(m_listening_sockets.begin(), m_listening_sockets.end()
+			, [&](std::shared_ptr<listen_socket_t> const& e)
+		{
+			return e->udp_sock
+				&& e->local_endpoint.address().is_v4() == ep.address().is_v4();
+		});
+		if (ls == m_listening_sockets.end()) return nullptr;
+
+		auto ret = std::make_unique<utp_stream>(m_io_context);
+		ret->set_impl(m_utp_socket_manager.new_utp_socket(ret.get()));
+		ret->get_impl()->m_sock = *ls;
+		return ret;
+	}
+
+	udp::endpoint session_impl::direct_endpoint() const
+	{
+		if (!m_settings.get_bool(settings_pack::enable_direct_transfer))
+			return {};
+
+		// a port mapped on the router is reachable from anywhere
+		udp::endpoint const mapped = external_udp_endpoint();
+		if (mapped.port() != 0) return mapped;
+
+		// otherwise only a socket that isn't behind a NAT is, i.e. one
+		// whose address is the external address other nodes see
+		for (auto const& i : m_listening_sockets)
+		{
+			if (!i->udp_sock || !i->local_endpoint.address().is_v4()) continue;
+			if (i->external_address.external_address() != i->local_endpoint.address())
+				continue;
+			return {i->local_endpoint.address(), std::uint16_t(i->udp_external_port())};
+		}
+
+		return {};
+	}
+
 	void session_impl::send_udp_packet_listen_encryption(aux::listen_socket_handle const& sock
 		, udp::endpoint const& ep
 		, sha256_hash const& pk
@@ -2116,6 +2196,27 @@ namespace {
 		return ret;
 	}
 
+	void session_impl::on_decoded_dht_packet(std::weak_ptr<listen_socket_t> const& ls
+		, std::unique_ptr<dht::decoded_packet> p)
+	{
+		if (p->failed)
+		{
+#ifndef TORRENT_DISABLE_LOGGING
+			if (should_log())
+				session_log("failed to decode UDP packet from: %s"
+					, print_endpoint(p->from).c_str());
+#endif
+			return;
+		}
+
+		auto listen_socket = ls.lock();
+		if (m_dht && p->buf.size() > 20 && listen_socket)
+		{
+			m_dht->incoming_packet(listen_socket, p->from, p->buf
+				, p->msg, p->ec, p->pk);
+		}
+	}
+
 	void session_impl::on_udp_packet(std::weak_ptr<session_udp_socket> socket
 		, std::weak_ptr<listen_socket_t> ls, transport const ssl, error_code const& ec)
 	{
@@ -2170,9 +2271,34 @@ namespace {
 
 				span<char const> const buf = packet.data;
 
+				if (buf.size() > std::ptrdiff_t(utp_packet_magic.size())
+					&& std::equal(utp_packet_magic.begin(), utp_packet_magic.end(), buf.begin())
+					&& m_utp_socket_manager.incoming_packet(ls, packet.from
+						, buf.subspan(std::ptrdiff_t(utp_packet_magic.size()))))
+				{
+					continue;
+				}
+
 				if (buf.size() >= 64) // 32 public key bytes and encrypted data
 				{
 					sha256_hash pk(buf);
+
+					if (m_packet_decoder)
+					{
+						// senders that are blocked or rate limited are turned
+						// away before they cost a copy and a decryption
+						if (m_dht && !m_dht->incoming_source(packet.from)) continue;
+
+						if (!m_packet_decoder->post(packet.from, pk, buf.subspan(32)
+							, m_account_manager->priv_key()
+							, [this, ls](std::unique_ptr<dht::decoded_packet> p)
+							{ on_decoded_dht_packet(ls, std::move(p)); }))
+						{
+							m_stats_counters.inc_stats_counter(counters::dht_packets_decode_dropped);
+						}
+						continue;
+					}
+
 					m_raw_recv_udp_packet.clear();
 					m_raw_recv_udp_packet.insert(0
 						, buf.subspan(32).data()
@@ -2292,6 +2418,9 @@ namespace {
 			}
 		}
 
+		// send the acks deferred while the socket was being read
+		m_utp_socket_manager.socket_drained();
+
 		ADD_OUTSTANDING_ASYNC("session_impl::on_udp_packet");
 		s->sock.async_read(make_handler([this, socket, ls, ssl](error_code const& e)
 			{ this->on_udp_packet(std::move(socket), std::move(ls), ssl, e); }
@@ -2583,7 +2712,8 @@ namespace {
 			// for backwards compatibility, still post an empty alert if we don't
 			// have any active DHT nodes
 			m_alerts.emplace_alert<dht_stats_alert>(std::vector<dht_routing_bucket>{}
-				, std::vector<dht_lookup>{}, dht::node_id{}, udp::endpoint{});
+				, std::vector<dht_lookup>{}, std::vector<dht_lookup>{}
+				, dht::node_id{}, udp::endpoint{});
 		}
 		else
 		{
@@ -2591,6 +2721,7 @@ namespace {
 			{
 				m_alerts.emplace_alert<dht_stats_alert>(
 					std::move(s.table), std::move(s.requests)
+					, std::move(s.completed_requests)
 					, s.our_id, s.local_endpoint);
 			}
 		}
@@ -3163,6 +3294,24 @@ namespace {
 		m_items_db = std::make_shared<dht::items_db_sqlite>(
 			m_settings, static_cast<dht::dht_observer*>(this));
 		m_dht_storage->set_backend(m_items_db);
+		if (m_settings.get_int(settings_pack::dht_relay_mailbox_size) > 0)
+		{
+			m_relay_mailbox = std::make_shared<dht::relay_mailbox>(m_settings
+				, static_cast<dht::dht_observer*>(this), m_bs_nodes_dir + "/relay_mailbox");
+			error_code ec;
+			if (m_relay_mailbox->open(ec))
+			{
+				m_dht_storage->set_relay_mailbox(m_relay_mailbox);
+			}
+			else
+			{
+#ifndef TORRENT_DISABLE_LOGGING
+				session_log("failed to open relay mailbox, keeping relay entries in memory: %s"
+					, ec.message().c_str());
+#endif
+				m_relay_mailbox.reset();
+			}
+		}
 		m_bs_nodes_storage = std::make_unique<dht::bs_nodes_db_sqlite>(
 			m_settings, static_cast<dht::dht_observer*>(this));
 
@@ -3184,6 +3333,14 @@ namespace {
 			, *m_bs_nodes_storage
 			, m_bs_nodes_dir);
 
+		int const packet_threads = m_settings.get_int(settings_pack::dht_packet_threads);
+		if (packet_threads > 0)
+		{
+			m_packet_decoder = std::make_unique<dht::packet_decoder>(
+				m_io_context, packet_threads
+				, m_settings.get_int(settings_pack::dht_packet_queue_size));
+		}
+
 		m_dht->install_bootstrap_nodes();
 
 		for (auto& s : m_listening_sockets)
@@ -3251,6 +3408,12 @@ namespace {
 		session_log("about to stop DHT, running: %s", m_dht ? "true" : "false");
 #endif
 
+		if (m_packet_decoder)
+		{
+			m_packet_decoder->stop();
+			m_packet_decoder.reset();
+		}
+
 		if (m_dht)
 		{
 			m_dht->stop();
@@ -3261,6 +3424,7 @@ namespace {
 		if (m_bs_nodes_storage != nullptr) m_bs_nodes_storage->close();
 		m_dht_storage.reset();
 		m_items_db.reset();
+		m_relay_mailbox.reset();
 		m_bs_nodes_storage.reset();
 	}
 
@@ -3632,6 +3796,67 @@ namespace {
 		return ip2::api::ABORT_ERROR;
 	}
 
+	void session_impl::drain_submissions()
+	{
+		m_submissions.pop_all(m_submission_batch);
+
+		for (submission const& s : m_submission_batch)
+		{
+			ip2::api::error_code ec = ip2::api::ABORT_ERROR;
+
+			if (m_assembler)
+			{
+				switch (s.type)
+				{
+					case submission::put_data:
+						ec = m_assembler->put(span<char const>(s.payload)
+							, aux::uri(s.uri.data()));
+						break;
+					case submission::get_data:
+						ec = m_assembler->get(dht::public_key(s.peer.data())
+							, aux::uri(s.uri.data()), dht::timestamp(s.timestamp));
+						break;
+					case submission::relay_data_uri:
+						ec = m_assembler->relay_uri(dht::public_key(s.peer.data())
+							, aux::uri(s.uri.data()), dht::timestamp(s.timestamp));
+						break;
+					case submission::relay_message:
+						ec = m_assembler->relay_message(dht::public_key(s.peer.data())
+							, span<char const>(s.payload));
+						break;
+				}
+			}
+
+			// accepted requests are reported by the assemble module when
+			// they complete
+			if (ec != ip2::api::NO_ERROR) post_submission_alert(s, ec);
+		}
+
+		m_submission_batch.clear();
+	}
+
+	void session_impl::post_submission_alert(submission const& s
+		, ip2::api::error_code const ec)
+	{
+		switch (s.type)
+		{
+			case submission::put_data:
+				m_alerts.emplace_alert<put_data_alert>(s.uri, ec);
+				break;
+			case submission::get_data:
+				m_alerts.emplace_alert<get_data_alert>(s.peer, s.uri, s.timestamp
+					, nullptr, ec);
+				break;
+			case submission::relay_data_uri:
+				m_alerts.emplace_alert<relay_data_uri_alert>(s.peer, s.uri
+					, s.timestamp, ec);
+				break;
+			case submission::relay_message:
+				m_alerts.emplace_alert<relay_message_alert>(s.peer, ec);
+				break;
+		}
+	}
+
 	// transport
 	void session_impl::start_transporter()
 	{
@@ -3683,6 +3908,8 @@ namespace {
 
 		m_assembler = std::make_shared<ip2::assemble::assembler>(
 			m_io_context, *this, m_settings, m_stats_counters);
+		if (m_settings.get_int(settings_pack::assemble_segment_cache_disk_size) > 0)
+			m_assembler->open_segment_cache(m_bs_nodes_dir + "/segment_cache");
 
 #ifndef TORRENT_DISABLE_LOGGING
 		session_log("starting assemble");
@@ -4061,6 +4288,12 @@ namespace {
 	void session_impl::update_alert_queue_size()
 	{
 		m_alerts.set_alert_queue_size_limit(m_settings.get_int(settings_pack::alert_queue_size));
+		m_alerts.set_log_queue_size_limit(m_settings.get_int(settings_pack::alert_log_queue_size));
+	}
+
+	void session_impl::update_submission_queue_size()
+	{
+		m_submissions.set_capacity(m_settings.get_int(settings_pack::submission_queue_size));
 	}
 
 	void session_impl::update_dht_upload_rate_limit()
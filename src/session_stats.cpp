@@ -164,6 +164,176 @@ namespace {
 		// this measure the number of tracker announces currently in the
 		// queue
 		METRIC(tracker, num_queued_tracker_announces)
+
+		// the number of rpcs enqueued to the transporter, dispatched to the
+		// DHT and completed, by type
+		METRIC(transport, transport_get_enqueued)
+		METRIC(transport, transport_put_enqueued)
+		METRIC(transport, transport_send_enqueued)
+		METRIC(transport, transport_get_dispatched)
+		METRIC(transport, transport_put_dispatched)
+		METRIC(transport, transport_send_dispatched)
+		METRIC(transport, transport_get_completed)
+		METRIC(transport, transport_put_completed)
+		METRIC(transport, transport_send_completed)
+
+		// the rpcs dispatched by the transporter of each priority class, the
+		// milliseconds they waited in the queue in total, and the number
+		// queued
+		METRIC(transport, transport_relay_dispatched)
+		METRIC(transport, transport_blob_get_dispatched)
+		METRIC(transport, transport_blob_put_dispatched)
+		METRIC(transport, transport_chain_sync_dispatched)
+		METRIC(transport, transport_maintenance_dispatched)
+		METRIC(transport, transport_relay_wait)
+		METRIC(transport, transport_blob_get_wait)
+		METRIC(transport, transport_blob_put_wait)
+		METRIC(transport, transport_chain_sync_wait)
+		METRIC(transport, transport_maintenance_wait)
+		METRIC(transport, transport_relay_queued)
+		METRIC(transport, transport_blob_get_queued)
+		METRIC(transport, transport_blob_put_queued)
+		METRIC(transport, transport_chain_sync_queued)
+		METRIC(transport, transport_maintenance_queued)
+
+		// latency histograms of the transporter. Each counter counts the
+		// samples below 1 << n milliseconds (and at least half of that),
+		// where n is the number at the end of the counter name. The last
+		// counter of each histogram counts everything above 16 seconds.
+		// transport_queue_wait is the time an rpc spends in the queue, the
+		// others measure from dispatching an rpc to its callback
+		METRIC(transport, transport_queue_wait0)
+		METRIC(transport, transport_queue_wait1)
+		METRIC(transport, transport_queue_wait2)
+		METRIC(transport, transport_queue_wait3)
+		METRIC(transport, transport_queue_wait4)
+		METRIC(transport, transport_queue_wait5)
+		METRIC(transport, transport_queue_wait6)
+		METRIC(transport, transport_queue_wait7)
+		METRIC(transport, transport_queue_wait8)
+		METRIC(transport, transport_queue_wait9)
+		METRIC(transport, transport_queue_wait10)
+		METRIC(transport, transport_queue_wait11)
+		METRIC(transport, transport_queue_wait12)
+		METRIC(transport, transport_queue_wait13)
+		METRIC(transport, transport_queue_wait14)
+		METRIC(transport, transport_queue_wait15)
+		METRIC(transport, transport_get_latency0)
+		METRIC(transport, transport_get_latency1)
+		METRIC(transport, transport_get_latency2)
+		METRIC(transport, transport_get_latency3)
+		METRIC(transport, transport_get_latency4)
+		METRIC(transport, transport_get_latency5)
+		METRIC(transport, transport_get_latency6)
+		METRIC(transport, transport_get_latency7)
+		METRIC(transport, transport_get_latency8)
+		METRIC(transport, transport_get_latency9)
+		METRIC(transport, transport_get_latency10)
+		METRIC(transport, transport_get_latency11)
+		METRIC(transport, transport_get_latency12)
+		METRIC(transport, transport_get_latency13)
+		METRIC(transport, transport_get_latency14)
+		METRIC(transport, transport_get_latency15)
+		METRIC(transport, transport_put_latency0)
+		METRIC(transport, transport_put_latency1)
+		METRIC(transport, transport_put_latency2)
+		METRIC(transport, transport_put_latency3)
+		METRIC(transport, transport_put_latency4)
+		METRIC(transport, transport_put_latency5)
+		METRIC(transport, transport_put_latency6)
+		METRIC(transport, transport_put_latency7)
+		METRIC(transport, transport_put_latency8)
+		METRIC(transport, transport_put_latency9)
+		METRIC(transport, transport_put_latency10)
+		METRIC(transport, transport_put_latency11)
+		METRIC(transport, transport_put_latency12)
+		METRIC(transport, transport_put_latency13)
+		METRIC(transport, transport_put_latency14)
+		METRIC(transport, transport_put_latency15)
+		METRIC(transport, transport_send_latency0)
+		METRIC(transport, transport_send_latency1)
+		METRIC(transport, transport_send_latency2)
+		METRIC(transport, transport_send_latency3)
+		METRIC(transport, transport_send_latency4)
+		METRIC(transport, transport_send_latency5)
+		METRIC(transport, transport_send_latency6)
+		METRIC(transport, transport_send_latency7)
+		METRIC(transport, transport_send_latency8)
+		METRIC(transport, transport_send_latency9)
+		METRIC(transport, transport_send_latency10)
+		METRIC(transport, transport_send_latency11)
+		METRIC(transport, transport_send_latency12)
+		METRIC(transport, transport_send_latency13)
+		METRIC(transport, transport_send_latency14)
+		METRIC(transport, transport_send_latency15)
+
+		// the number of times a blob segment (or its index) was put or
+		// requested again after the previous attempt failed
+		METRIC(assemble, assemble_put_retries)
+		METRIC(assemble, assemble_get_retries)
+		METRIC(assemble, assemble_direct_gets)
+		METRIC(assemble, assemble_direct_segments)
+		METRIC(assemble, assemble_direct_fallbacks)
+		METRIC(assemble, assemble_direct_served)
+		METRIC(assemble, assemble_cache_hits)
+		METRIC(assemble, assemble_cache_misses)
+		METRIC(assemble, assemble_cache_bytes_saved)
+
+		// end-to-end latency histograms of putting and getting blobs and of
+		// relaying messages and data uris, laid out like the transport
+		// histograms above
+		METRIC(assemble, assemble_put_latency0)
+		METRIC(assemble, assemble_put_latency1)
+		METRIC(assemble, assemble_put_latency2)
+		METRIC(assemble, assemble_put_latency3)
+		METRIC(assemble, assemble_put_latency4)
+		METRIC(assemble, assemble_put_latency5)
+		METRIC(assemble, assemble_put_latency6)
+		METRIC(assemble, assemble_put_latency7)
+		METRIC(assemble, assemble_put_latency8)
+		METRIC(assemble, assemble_put_latency9)
+		METRIC(assemble, assemble_put_latency10)
+		METRIC(assemble, assemble_put_latency11)
+		METRIC(assemble, assemble_put_latency12)
+		METRIC(assemble, assemble_put_latency13)
+		METRIC(assemble, assemble_put_latency14)
+		METRIC(assemble, assemble_put_latency15)
+		METRIC(assemble, assemble_get_latency0)
+		METRIC(assemble, assemble_get_latency1)
+		METRIC(assemble, assemble_get_latency2)
+		METRIC(assemble, assemble_get_latency3)
+		METRIC(assemble, assemble_get_latency4)
+		METRIC(assemble, assemble_get_latency5)
+		METRIC(assemble, assemble_get_latency6)
+		METRIC(assemble, assemble_get_latency7)
+		METRIC(assemble, assemble_get_latency8)
+		METRIC(assemble, assemble_get_latency9)
+		METRIC(assemble, assemble_get_latency10)
+		METRIC(assemble, assemble_get_latency11)
+		METRIC(assemble, assemble_get_latency12)
+		METRIC(assemble, assemble_get_latency13)
+		METRIC(assemble, assemble_get_latency14)
+		METRIC(assemble, assemble_get_latency15)
+		METRIC(assemble, assemble_relay_latency0)
+		METRIC(assemble, assemble_relay_latency1)
+		METRIC(assemble, assemble_relay_latency2)
+		METRIC(assemble, assemble_relay_latency3)
+		METRIC(assemble, assemble_relay_latency4)
+		METRIC(assemble, assemble_relay_latency5)
+		METRIC(assemble, assemble_relay_latency6)
+		METRIC(assemble, assemble_relay_latency7)
+		METRIC(assemble, assemble_relay_latency8)
+		METRIC(assemble, assemble_relay_latency9)
+		METRIC(assemble, assemble_relay_latency10)
+		METRIC(assemble, assemble_relay_latency11)
+		METRIC(assemble, assemble_relay_latency12)
+		METRIC(assemble, assemble_relay_latency13)
+		METRIC(assemble, assemble_relay_latency14)
+		METRIC(assemble, assemble_relay_latency15)
+
+		// incoming DHT packets dropped before they were decrypted, because
+		// the decoder worker of their sender was too far behind
+		METRIC(dht, dht_packets_decode_dropped)
 		// ... more
 	}});
 #undef METRIC
@@ -198,6 +198,8 @@ namespace ip2 {
 		SET(auto_relay, false, &session_impl::update_auto_relay),
 		SET(enable_communication, false, nullptr),
 		SET(enable_blockchain, false, nullptr),
+		SET(enable_direct_transfer, true, nullptr),
+		SET(blockchain_fast_join, true, nullptr),
 	}});
 
 	CONSTEXPR_SETTINGS
@@ -373,6 +375,24 @@ namespace ip2 {
 		SET(log_level, aux::LOG_LEVEL::LOG_DEBUG, &session_impl::update_log_level),
 		SET(transport_invoking_interval, 50, nullptr),
 		SET(transport_invoking_queue_max_size, 10000, nullptr),
+		SET(dht_packet_threads, 0, nullptr),
+		SET(submission_queue_size, 10000, &session_impl::update_submission_queue_size),
+		SET(direct_transfer_timeout, 5, nullptr),
+		SET(direct_transfer_cache_size, 4 * 1024 * 1024, nullptr),
+		SET(dht_relay_mailbox_size, 64 * 1024 * 1024, nullptr),
+		SET(dht_items_db_eviction_batch, 64, nullptr),
+		SET(assemble_segment_cache_size, 8 * 1024 * 1024, nullptr),
+		SET(assemble_segment_cache_disk_size, 64 * 1024 * 1024, nullptr),
+		SET(transport_relay_weight, 8, nullptr),
+		SET(transport_blob_get_weight, 4, nullptr),
+		SET(transport_blob_put_weight, 2, nullptr),
+		SET(transport_chain_sync_weight, 2, nullptr),
+		SET(transport_maintenance_weight, 1, nullptr),
+		SET(dht_max_search_branching, 4, nullptr),
+		SET(alert_log_queue_size, 0, &session_impl::update_alert_queue_size),
+		SET(blockchain_verify_threads, 2, nullptr),
+		SET(dht_packet_queue_size, 1000, nullptr),
+		SET(dht_warm_start_nodes, 16, nullptr),
 	}});
 
 #undef SET
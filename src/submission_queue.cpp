@@ -0,0 +1,49 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "ip2/aux_/submission_queue.hpp"
+#include "ip2/assert.hpp"
+
+namespace ip2::aux {
+
+	submission_queue::submission_queue(int const capacity)
+		: m_capacity(capacity)
+	{}
+
+	submission_queue::push_result submission_queue::push(submission&& s)
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+
+		if (int(m_queue.size()) >= m_capacity) return push_result::full;
+
+		m_queue.push_back(std::move(s));
+		return m_queue.size() == 1 ? push_result::queued_first : push_result::queued;
+	}
+
+	void submission_queue::pop_all(std::vector<submission>& batch)
+	{
+		TORRENT_ASSERT(batch.empty());
+		batch.clear();
+
+		std::lock_guard<std::mutex> l(m_mutex);
+		m_queue.swap(batch);
+	}
+
+	void submission_queue::set_capacity(int const capacity)
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		m_capacity = capacity;
+	}
+
+	int submission_queue::size() const
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		return int(m_queue.size());
+	}
+}
@@ -10,15 +10,15 @@ see LICENSE file.
 #include "ip2/transport/transporter.hpp"
 
 #include "ip2/aux_/session_interface.hpp"
-#ifndef TORRENT_DISABLE_LOGGING
-#include "ip2/hex.hpp" // to_hex
-#endif
 #include "ip2/error_code.hpp"
 #include <ip2/time.hpp>
 #include "ip2/aux_/alert_manager.hpp" // for alert_manager
+#include "ip2/aux_/latency_histogram.hpp"
 #include <ip2/aux_/time.hpp> // for aux::time_now
+#include "ip2/performance_counters.hpp"
 #include "ip2/kademlia/dht_tracker.hpp"
 
+#include <algorithm>
 #include <vector>
 
 using namespace std::placeholders;
@@ -28,6 +28,57 @@ namespace ip2 {
 
 namespace transport {
 
+namespace {
+
+	// the stats counters of each rpc type, indexed by rpc_type
+	struct rpc_counters
+	{
+		int enqueued;
+		int dispatched;
+		int completed;
+		int latency;
+	};
+
+	rpc_counters const rpc_stats[] = {
+		{ counters::transport_get_enqueued, counters::transport_get_dispatched
+			, counters::transport_get_completed, counters::transport_get_latency0 },
+		{ counters::transport_put_enqueued, counters::transport_put_dispatched
+			, counters::transport_put_completed, counters::transport_put_latency0 },
+		{ counters::transport_send_enqueued, counters::transport_send_dispatched
+			, counters::transport_send_completed, counters::transport_send_latency0 },
+	};
+
+	// the stats counters and weight setting of each priority class,
+	// indexed by priority_class
+	struct class_info
+	{
+		int queued;
+		int dispatched;
+		int wait;
+		int weight;
+	};
+
+	class_info const classes[] = {
+		{ counters::transport_relay_queued, counters::transport_relay_dispatched
+			, counters::transport_relay_wait, settings_pack::transport_relay_weight },
+		{ counters::transport_blob_get_queued, counters::transport_blob_get_dispatched
+			, counters::transport_blob_get_wait, settings_pack::transport_blob_get_weight },
+		{ counters::transport_blob_put_queued, counters::transport_blob_put_dispatched
+			, counters::transport_blob_put_wait, settings_pack::transport_blob_put_weight },
+		{ counters::transport_chain_sync_queued, counters::transport_chain_sync_dispatched
+			, counters::transport_chain_sync_wait, settings_pack::transport_chain_sync_weight },
+		{ counters::transport_maintenance_queued, counters::transport_maintenance_dispatched
+			, counters::transport_maintenance_wait, settings_pack::transport_maintenance_weight },
+	};
+
+	static_assert(sizeof(classes) / sizeof(classes[0]) == NUM_PRIORITY_CLASSES
+		, "every priority class needs its counters");
+
+	// a dispatch advances the start tag of its class by this, divided by
+	// the class weight
+	constexpr std::int64_t tag_scale = 1 << 20;
+}
+
 transporter::transporter(io_context& ios
 	, aux::session_interface& session
 	, aux::session_settings const& settings
@@ -63,6 +114,16 @@ void transporter::log(aux::LOG_LEVEL log_level, char const* fmt, ...) noexcept t
 catch (std::exception const&)
 {}
 
+void transporter::log_record(aux::LOG_LEVEL, char const* fmt
+	, span<char const> record) noexcept try
+{
+#ifndef TORRENT_DISABLE_LOGGING
+	m_session.alerts().emplace_alert<transport_log_alert>(fmt, record);
+#endif
+}
+catch (std::exception const&)
+{}
+
 void transporter::start()
 {
 	if (m_running) return;
@@ -85,14 +146,19 @@ void transporter::stop()
 
 	m_running = false;
 	m_invoking_timer.cancel();
-	// clear invoking queue
-	std::queue<rpc> empty;
-	m_rpc_queue.swap(empty);
+	// clear invoking queues
+	for (int c = 0; c < NUM_PRIORITY_CLASSES; ++c)
+	{
+		m_counters.inc_stats_counter(classes[c].queued
+			, -std::int64_t(m_rpc_queues[c].size()));
+		std::queue<rpc> empty;
+		m_rpc_queues[c].swap(empty);
+	}
 }
 
-bool transporter::has_enough_buffer(std::int32_t slots)
+bool transporter::has_enough_buffer(std::int32_t slots, priority_class const cls)
 {
-	return m_rpc_queue.size() + slots <=
+	return int(m_rpc_queues[cls].size()) + slots <=
 		m_settings.get_int(settings_pack::transport_invoking_queue_max_size);
 }
 
@@ -102,27 +168,19 @@ api::error_code transporter::get(dht::public_key const& key
 	, std::function<void(dht::item const&, bool)> cb
 	, std::int8_t invoke_branch // alpha
 	, std::int8_t invoke_window
-	, std::int8_t invoke_limit)
+	, std::int8_t invoke_limit
+	, priority_class const cls)
 {
 	if (!m_running) return api::TRANSPORT_STOPPED;
-	if (m_rpc_queue.size() >= (long)m_settings.get_int(
-			settings_pack::transport_invoking_queue_max_size))
-	{
-		return api::TRANSPORT_BUFFER_FULL;
-	}
+	if (!has_enough_buffer(1, cls)) return api::TRANSPORT_BUFFER_FULL;
 
-#ifndef TORRENT_DISABLE_LOGGING
-	char hex_key[65];
-	char hex_salt[129]; // 64*2 + 1
-	aux::to_hex(key.bytes, hex_key);
-	aux::to_hex(salt, hex_salt);
-	log(aux::LOG_INFO, "enqueue get req for [k:%s, s:%s, window:%d, limit:%d, qs:%d]"
-		, hex_key, hex_salt, invoke_window, invoke_limit
-		, (int)m_rpc_queue.size());
-#endif
+	log_lazy(aux::LOG_INFO, "enqueue get req for [k:%s, s:%s, window:%d, limit:%d, c:%d, qs:%d]"
+		, aux::hex_arg(key.bytes), aux::hex_arg(salt), invoke_window, invoke_limit
+		, int(cls), m_rpc_queues[cls].size());
 
 	std::shared_ptr<get_ctx> ctx = std::make_shared<get_ctx>(key, salt, timestamp
 		, invoke_branch, invoke_window, invoke_limit);
+	ctx->m_class = cls;
 	std::function<void(dht::item const&, bool)> callback
 		= std::bind(&transporter::get_callback, this, _1, _2, ctx, cb);
 
@@ -135,7 +193,7 @@ api::error_code transporter::get(dht::public_key const& key
 		, ctx->m_pubkey, std::move(callback)
 		, invoke_branch, invoke_window, invoke_limit
 		, ctx->m_salt, ctx->m_timestamp);
-	m_rpc_queue.push(rpc(std::move(method)));
+	enqueue(rpc(std::move(method), std::move(ctx)));
 
 	return api::NO_ERROR;
 }
@@ -145,25 +203,20 @@ api::error_code transporter::put(entry const& data
 	, std::function<void(dht::item const&, int)> cb
 	, std::int8_t invoke_branch
 	, std::int8_t invoke_window
-	, std::int8_t invoke_limit)
+	, std::int8_t invoke_limit
+	, priority_class const cls)
 {
 	if (!m_running) return api::TRANSPORT_STOPPED;
-	if (m_rpc_queue.size() >= (long)m_settings.get_int(
-		settings_pack::transport_invoking_queue_max_size))
-	{
-		return api::TRANSPORT_BUFFER_FULL;
-	}
+	if (!has_enough_buffer(1, cls)) return api::TRANSPORT_BUFFER_FULL;
 
-#ifndef TORRENT_DISABLE_LOGGING
-	char hex_salt[129]; // 64*2 + 1
-	aux::to_hex(salt, hex_salt);
-	log(aux::LOG_INFO
-		, "enqueue put req [s:%s, window:%d, limit:%d, qs:%d]"
-		, hex_salt, invoke_window, invoke_limit, (int)m_rpc_queue.size());
-#endif
+	log_lazy(aux::LOG_INFO
+		, "enqueue put req [s:%s, window:%d, limit:%d, c:%d, qs:%d]"
+		, aux::hex_arg(salt), invoke_window, invoke_limit, int(cls)
+		, m_rpc_queues[cls].size());
 
 	std::shared_ptr<put_ctx> ctx = std::make_shared<put_ctx>(data, salt
 		, invoke_branch, invoke_window, invoke_limit);
+	ctx->m_class = cls;
 	std::function<void(dht::item const&, int responses)> callback
 		= std::bind(&transporter::put_callback, this, _1, _2, ctx, cb);
 
@@ -175,7 +228,7 @@ api::error_code transporter::put(entry const& data
 	rpc_method method = std::bind(put, m_session.dht()->self()
 		, ctx->m_data, std::move(callback)
 		, invoke_branch, invoke_window, invoke_limit, ctx->m_salt);
-	m_rpc_queue.push(rpc(std::move(method)));
+	enqueue(rpc(std::move(method), std::move(ctx)));
 
 	return api::NO_ERROR;
 }
@@ -187,24 +240,18 @@ api::error_code transporter::send(dht::public_key const& to
 	, std::int8_t invoke_branch
 	, std::int8_t invoke_window
 	, std::int8_t invoke_limit
-	, std::int8_t hit_limit)
+	, std::int8_t hit_limit
+	, priority_class const cls)
 {
 	if (!m_running) return api::TRANSPORT_STOPPED;
-	if (m_rpc_queue.size() >= (long)m_settings.get_int(
-		settings_pack::transport_invoking_queue_max_size))
-	{
-		return api::TRANSPORT_BUFFER_FULL;
-	}
+	if (!has_enough_buffer(1, cls)) return api::TRANSPORT_BUFFER_FULL;
 
-#ifndef TORRENT_DISABLE_LOGGING
-	char hex_to[65];
-	aux::to_hex(to.bytes, hex_to);
-	log(aux::LOG_INFO, "enqueue send req [t:%s, qs:%d]", hex_to
-		, (int)m_rpc_queue.size());
-#endif
+	log_lazy(aux::LOG_INFO, "enqueue send req [t:%s, c:%d, qs:%d]", aux::hex_arg(to.bytes)
+		, int(cls), m_rpc_queues[cls].size());
 
 	std::shared_ptr<relay_ctx> ctx = std::make_shared<relay_ctx>(to, payload
 		, invoke_branch, invoke_window, invoke_limit);
+	ctx->m_class = cls;
 	std::function<void(entry const&
 			, std::vector<std::pair<dht::node_entry, bool>> const& success_nodes)>
 		callback = std::bind(&transporter::send_callback, this, _1, _2, ctx, cb);
@@ -219,7 +266,7 @@ api::error_code transporter::send(dht::public_key const& to
 	rpc_method method = std::bind(send, m_session.dht()->self()
 		, ctx->m_to, ctx->m_payload
 		, invoke_branch, invoke_window, invoke_limit, hit_limit, std::move(callback));
-	m_rpc_queue.push(rpc(std::move(method)));
+	enqueue(rpc(std::move(method), std::move(ctx)));
 
 	return api::NO_ERROR;
 }
@@ -229,14 +276,23 @@ void transporter::get_callback(dht::item const& it, bool authoritative
 	, std::function<void(dht::item const&, bool)> f)
 {
 #ifndef TORRENT_DISABLE_LOGGING
-	char hex_key[65];
-	char hex_salt[129]; // 64*2 + 1
-	aux::to_hex(ctx->m_pubkey.bytes, hex_key);
-	aux::to_hex(ctx->m_salt, hex_salt);
-	log(aux::LOG_INFO, "get cb for [ k:%s, s:%s, v:%s]"
-		, hex_key, hex_salt, it.value().to_string(true).c_str());
+	// rendering the value is expensive, only do it if it's logged
+	if (should_log(aux::LOG_DEBUG))
+	{
+		log_lazy(aux::LOG_DEBUG, "get cb for [ k:%s, s:%s, v:%s]"
+			, aux::hex_arg(ctx->m_pubkey.bytes), aux::hex_arg(ctx->m_salt)
+			, it.value().to_string(true));
+	}
+	else
+	{
+		log_lazy(aux::LOG_INFO, "get cb for [ k:%s, s:%s, auth:%d]"
+			, aux::hex_arg(ctx->m_pubkey.bytes), aux::hex_arg(ctx->m_salt)
+			, authoritative);
+	}
 #endif
 
+	if (authoritative) on_completed(*ctx);
+
 	f(it, authoritative);
 }
 
@@ -244,11 +300,10 @@ void transporter::put_callback(dht::item const& it, int responses
 	, std::shared_ptr<put_ctx> ctx
 	, std::function<void(dht::item const&, int)> f)
 {
-#ifndef TORRENT_DISABLE_LOGGING
-	char hex_salt[129]; // 64*2 + 1
-	aux::to_hex(ctx->m_salt, hex_salt);
-	log(aux::LOG_INFO, "put cb for [s:%s, r:%d]", hex_salt, responses);
-#endif
+	log_lazy(aux::LOG_INFO, "put cb for [s:%s, r:%d]", aux::hex_arg(ctx->m_salt)
+		, responses);
+
+	on_completed(*ctx);
 
 	f(it, responses);
 }
@@ -259,24 +314,82 @@ void transporter::send_callback(entry const& it
 	, std::function<void(entry const&
 		, std::vector<std::pair<dht::node_entry, bool>> const&)> f)
 {
-#ifndef TORRENT_DISABLE_LOGGING
-	char hex_to[65];
-	aux::to_hex(ctx->m_to.bytes, hex_to);
-	log(aux::LOG_INFO, "send cb for [t:%s, sn:%d]", hex_to, (int)success_nodes.size());
-#endif
+	log_lazy(aux::LOG_INFO, "send cb for [t:%s, sn:%d]", aux::hex_arg(ctx->m_to.bytes)
+		, success_nodes.size());
+
+	on_completed(*ctx);
 
 	f(it, success_nodes);
 }
 
+void transporter::enqueue(rpc r)
+{
+	priority_class const cls = r.m_ctx->m_class;
+	r.m_ctx->m_enqueued = aux::time_now();
+	m_counters.inc_stats_counter(rpc_stats[r.m_ctx->m_type].enqueued);
+	m_counters.inc_stats_counter(classes[cls].queued);
+
+	// a class that was idle doesn't get to catch up on the dispatches it
+	// didn't need
+	if (m_rpc_queues[cls].empty())
+		m_start_tags[cls] = std::max(m_start_tags[cls], m_virtual_time);
+
+	m_rpc_queues[cls].push(std::move(r));
+}
+
+priority_class transporter::next_class() const
+{
+	// on a tie, the class listed first (the more interactive) wins
+	priority_class ret = NUM_PRIORITY_CLASSES;
+	for (int c = 0; c < NUM_PRIORITY_CLASSES; ++c)
+	{
+		if (m_rpc_queues[c].empty()) continue;
+		if (ret == NUM_PRIORITY_CLASSES || m_start_tags[c] < m_start_tags[ret])
+			ret = priority_class(c);
+	}
+	return ret;
+}
+
+void transporter::on_completed(rpc_ctx& ctx)
+{
+	if (ctx.m_completed) return;
+	ctx.m_completed = true;
+
+	rpc_counters const& c = rpc_stats[ctx.m_type];
+	m_counters.inc_stats_counter(c.completed);
+	aux::record_latency(m_counters, c.latency, aux::time_now() - ctx.m_dispatched);
+}
+
 void transporter::invoking_timeout(error_code const& e)
 {
 	if (e || !m_running) return;
 
-	if (m_rpc_queue.size() > 0 && m_session.dht_nodes() > 0)
+	priority_class const cls = next_class();
+
+	// the DHT's upload quota (dht_upload_rate_limit) is the budget all
+	// classes share. While it's used up, no new traversal is started
+	if (cls != NUM_PRIORITY_CLASSES && m_session.dht_nodes() > 0
+		&& m_session.dht() && m_session.dht()->has_upload_quota())
 	{
-		auto const& r = m_rpc_queue.front();
+		auto& q = m_rpc_queues[cls];
+		rpc const r = std::move(q.front());
+		q.pop();
+
+		m_virtual_time = m_start_tags[cls];
+		m_start_tags[cls] += tag_scale
+			/ std::max(1, m_settings.get_int(classes[cls].weight));
+
+		rpc_ctx& ctx = *r.m_ctx;
+		ctx.m_dispatched = aux::time_now();
+		m_counters.inc_stats_counter(rpc_stats[ctx.m_type].dispatched);
+		m_counters.inc_stats_counter(classes[cls].queued, -1);
+		m_counters.inc_stats_counter(classes[cls].dispatched);
+		m_counters.inc_stats_counter(classes[cls].wait
+			, total_milliseconds(ctx.m_dispatched - ctx.m_enqueued));
+		aux::record_latency(m_counters, counters::transport_queue_wait0
+			, ctx.m_dispatched - ctx.m_enqueued);
+
 		r.m_method();
-		m_rpc_queue.pop();
 
 		m_congestion_controller.tick();
 	}
@@ -43,7 +43,14 @@ namespace ip2::aux {
 		m_restrict_mtu.fill(65536);
 	}
 
-	utp_socket_manager::~utp_socket_manager() = default;
+	utp_socket_manager::~utp_socket_manager()
+	{
+		// the sockets give their packets back to m_packet_pool, which is
+		// destructed before them
+		m_last_socket = nullptr;
+		m_deferred_ack = nullptr;
+		m_utp_sockets.clear();
+	}
 
 	void utp_socket_manager::tick(time_point now)
 	{
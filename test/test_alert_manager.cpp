@@ -311,6 +311,72 @@ TORRENT_TEST(alerts_dropped_alert)
 	TEST_CHECK(a->dropped_alerts[torrent_finished_alert::alert_type] == true);
 }
 
+TORRENT_TEST(log_queue)
+{
+	aux::alert_manager mgr(10, alert_category::all);
+	mgr.set_log_queue_size_limit(100);
+	TEST_EQUAL(mgr.log_queue_size_limit(), 100);
+
+	// a flood of log alerts doesn't take the space of the others
+	for (int i = 0; i < 50; ++i)
+		mgr.emplace_alert<log_alert>("log");
+	for (int i = 0; i < 5; ++i)
+		mgr.emplace_alert<dht_bootstrap_alert>();
+
+	std::vector<alert*> alerts;
+	mgr.get_all(alerts);
+	TEST_EQUAL(alerts.size(), 55);
+
+	// and they're popped before it
+	for (int i = 0; i < 5; ++i)
+		TEST_EQUAL(alerts[std::size_t(i)]->type(), dht_bootstrap_alert::alert_type);
+	TEST_EQUAL(alerts.back()->type(), log_alert::alert_type);
+
+	// without a log queue, they fill the one queue
+	mgr.set_log_queue_size_limit(0);
+	for (int i = 0; i < 50; ++i)
+		mgr.emplace_alert<log_alert>("log");
+	mgr.emplace_alert<dht_bootstrap_alert>();
+
+	mgr.get_all(alerts);
+	auto const* d = alert_cast<alerts_dropped_alert>(alerts.back());
+	TEST_CHECK(d != nullptr);
+	if (d != nullptr)
+		TEST_CHECK(d->dropped_alerts.test(dht_bootstrap_alert::alert_type));
+}
+
+TORRENT_TEST(concurrent_pop)
+{
+	int const inf = std::numeric_limits<int>::max();
+	aux::alert_manager mgr(inf, alert_category::all);
+	mgr.set_log_queue_size_limit(inf);
+
+	int const num_alerts = 100000;
+	std::thread producer([&mgr]
+	{
+		for (int i = 0; i < num_alerts; ++i)
+		{
+			if (i % 2) mgr.emplace_alert<log_alert>("log");
+			else mgr.emplace_alert<dht_bootstrap_alert>();
+		}
+	});
+
+	// every alert posted is popped once, while the producer posts
+	int received = 0;
+	std::vector<alert*> alerts;
+	while (received < num_alerts)
+	{
+		mgr.wait_for_alert(milliseconds(100));
+		mgr.get_all(alerts);
+		received += int(alerts.size());
+	}
+	producer.join();
+	mgr.get_all(alerts);
+
+	TEST_EQUAL(received, num_alerts);
+	TEST_CHECK(alerts.empty());
+}
+
 #ifndef TORRENT_DISABLE_EXTENSIONS
 struct post_plugin : lt::plugin
 {
@@ -232,6 +232,53 @@ TORRENT_TEST(dht_live_nodes_alert)
 	TEST_CHECK(v == nodes);
 }
 
+TORRENT_TEST(dht_stats_alert)
+{
+	aux::alert_manager mgr(1, {});
+
+	dht_lookup active{};
+	active.type = "get";
+	active.outstanding_requests = 2;
+	active.branch_factor = 3;
+
+	dht_lookup completed{};
+	completed.type = "put_data";
+	completed.timeouts = 1;
+	completed.responses = 7;
+	completed.branch_factor = 4;
+	completed.rounds = 3;
+	completed.rpcs = 8;
+	completed.first_response = 120;
+	completed.duration = 900;
+
+	sha256_hash const nid("01234567890123456789012345678901");
+	mgr.emplace_alert<dht_stats_alert>(std::vector<dht_routing_bucket>()
+		, std::vector<dht_lookup>{active}, std::vector<dht_lookup>{completed}
+		, nid, rand_udp_ep(rand_v4));
+
+	auto const* a = alert_cast<dht_stats_alert>(mgr.wait_for_alert(seconds(0)));
+	TEST_CHECK(a != nullptr);
+	TEST_CHECK(a->nid == nid);
+
+	TEST_EQUAL(int(a->active_requests.size()), 1);
+	TEST_EQUAL(a->active_requests[0].outstanding_requests, 2);
+
+	// the stats of the lookups that are over
+	TEST_EQUAL(int(a->completed_requests.size()), 1);
+	dht_lookup const& l = a->completed_requests[0];
+	TEST_EQUAL(std::string(l.type), "put_data");
+	TEST_EQUAL(l.timeouts, 1);
+	TEST_EQUAL(l.responses, 7);
+	TEST_EQUAL(l.branch_factor, 4);
+	TEST_EQUAL(l.rounds, 3);
+	TEST_EQUAL(l.rpcs, 8);
+	TEST_EQUAL(l.first_response, 120);
+	TEST_EQUAL(l.duration, 900);
+#ifndef TORRENT_DISABLE_ALERT_MSG
+	TEST_CHECK(a->message().find("completed: 1") != std::string::npos);
+#endif
+}
+
 TORRENT_TEST(session_stats_alert)
 {
 	aux::alert_manager mgr(1, {});
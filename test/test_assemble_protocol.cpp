@@ -0,0 +1,174 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "ip2/config.hpp"
+#include "test.hpp"
+#include "ip2/assemble/protocol.hpp"
+#include "ip2/bencode.hpp"
+#include "ip2/bdecode.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace lt;
+namespace protocol = lt::assemble::protocol;
+
+namespace {
+
+std::vector<char> bencoded(entry const& e)
+{
+	std::vector<char> buf;
+	bencode(std::back_inserter(buf), e);
+	return buf;
+}
+
+} // anonymous namespace
+
+TORRENT_TEST(assemble_protocol_seg_layout)
+{
+	std::string const seg = "hello";
+	entry const e = protocol::encode<protocol::blob_seg_schema>(span<char const>(seg));
+
+	TEST_EQUAL(e.type(), entry::preformatted_t);
+
+	// the same message built as an entry tree bencodes identically
+	entry tree;
+	tree["v"] = std::string("S\0\0\0", 4);
+	tree["n"] = std::string("s");
+	tree["a"]["v"] = seg;
+	TEST_CHECK(bencoded(e) == bencoded(tree));
+}
+
+TORRENT_TEST(assemble_protocol_seg_roundtrip)
+{
+	std::string const seg(protocol::blob_seg_mtu, 'x');
+	std::vector<char> const buf = bencoded(
+		protocol::encode<protocol::blob_seg_schema>(span<char const>(seg)));
+
+	lt::error_code ec;
+	bdecode_node const n = bdecode(buf, ec);
+	TEST_CHECK(!ec);
+	TEST_EQUAL(protocol::message_name(n), 's');
+
+	protocol::blob_seg_schema::view v;
+	TEST_EQUAL(protocol::decode<protocol::blob_seg_schema>(n, v), api::NO_ERROR);
+	TEST_CHECK(std::string(v.value.data(), std::size_t(v.value.size())) == seg);
+
+	// decoding from an entry gives the same result
+	entry const e = bdecode(buf);
+	protocol::blob_seg_schema::view ev;
+	TEST_EQUAL(protocol::decode<protocol::blob_seg_schema>(e, ev), api::NO_ERROR);
+	TEST_CHECK(std::string(ev.value.data(), std::size_t(ev.value.size())) == seg);
+}
+
+TORRENT_TEST(assemble_protocol_index_roundtrip)
+{
+	std::vector<sha1_hash> hashes;
+	for (int i = 0; i < 3; ++i)
+	{
+		sha1_hash h;
+		h[0] = std::uint8_t(i + 1);
+		hashes.push_back(h);
+	}
+
+	std::vector<char> const buf = bencoded(
+		protocol::encode<protocol::blob_index_schema>(hashes));
+
+	lt::error_code ec;
+	bdecode_node const n = bdecode(buf, ec);
+	TEST_CHECK(!ec);
+
+	protocol::blob_index_schema::view v;
+	TEST_EQUAL(protocol::decode<protocol::blob_index_schema>(n, v), api::NO_ERROR);
+	TEST_EQUAL(v.count(), 3);
+	for (int i = 0; i < 3; ++i) TEST_CHECK(v.hash(i) == hashes[std::size_t(i)]);
+}
+
+TORRENT_TEST(assemble_protocol_relay_msg_roundtrip)
+{
+	std::string const msg = "relayed message";
+	std::vector<char> const buf = bencoded(
+		protocol::encode<protocol::relay_msg_schema>(span<char const>(msg)));
+
+	lt::error_code ec;
+	bdecode_node const n = bdecode(buf, ec);
+	TEST_CHECK(!ec);
+	TEST_EQUAL(protocol::message_name(n), 'm');
+
+	protocol::relay_msg_schema::view v;
+	TEST_EQUAL(protocol::decode<protocol::relay_msg_schema>(n, v), api::NO_ERROR);
+	TEST_CHECK(std::string(v.msg.data(), std::size_t(v.msg.size())) == msg);
+}
+
+TORRENT_TEST(assemble_protocol_relay_uri_roundtrip)
+{
+	dht::public_key pk;
+	pk.bytes.fill('k');
+	aux::uri blob_uri;
+	blob_uri.bytes.fill('u');
+	udp::endpoint const ep(make_address_v4("10.0.0.1"), 6881);
+
+	std::vector<char> const buf = bencoded(protocol::encode<protocol::relay_uri_schema>(
+		pk, blob_uri, dht::timestamp(1650000000), ep));
+
+	lt::error_code ec;
+	bdecode_node const n = bdecode(buf, ec);
+	TEST_CHECK(!ec);
+	TEST_EQUAL(protocol::message_name(n), 'u');
+
+	protocol::relay_uri_schema::view v;
+	TEST_EQUAL(protocol::decode<protocol::relay_uri_schema>(n, v), api::NO_ERROR);
+	TEST_CHECK(v.pk == pk);
+	TEST_CHECK(v.blob_uri.bytes == blob_uri.bytes);
+	TEST_EQUAL(v.ts.value, 1650000000);
+	TEST_EQUAL(v.ep, ep);
+
+	// without an endpoint, as sent by older nodes
+	std::vector<char> const old = bencoded(protocol::encode<protocol::relay_uri_schema>(
+		pk, blob_uri, dht::timestamp(1650000000)));
+	bdecode_node const on = bdecode(old, ec);
+	TEST_CHECK(!ec);
+	protocol::relay_uri_schema::view ov;
+	TEST_EQUAL(protocol::decode<protocol::relay_uri_schema>(on, ov), api::NO_ERROR);
+	TEST_EQUAL(ov.ep.port(), 0);
+}
+
+TORRENT_TEST(assemble_protocol_decode_errors)
+{
+	std::string const seg = "data";
+	std::vector<char> const buf = bencoded(
+		protocol::encode<protocol::blob_seg_schema>(span<char const>(seg)));
+
+	lt::error_code ec;
+	bdecode_node const n = bdecode(buf, ec);
+	TEST_CHECK(!ec);
+
+	// a segment isn't an index
+	protocol::blob_index_schema::view iv;
+	TEST_EQUAL(protocol::decode<protocol::blob_index_schema>(n, iv)
+		, api::ASSEMBLE_NAME_ERROR);
+
+	entry e;
+	e["n"] = std::string("s");
+	e["a"]["v"] = seg;
+	protocol::blob_seg_schema::view sv;
+	TEST_EQUAL(protocol::decode<protocol::blob_seg_schema>(e, sv)
+		, api::ASSEMBLE_VERSION_ERROR);
+
+	e["v"] = std::string("X\0\0\0", 4);
+	TEST_EQUAL(protocol::decode<protocol::blob_seg_schema>(e, sv)
+		, api::ASSEMBLE_PROTOCOL_VER_MISMATCH);
+
+	e["v"] = std::string("S\0\0\0", 4);
+	e["a"]["v"] = std::string(protocol::blob_seg_mtu + 1, 'x');
+	TEST_EQUAL(protocol::decode<protocol::blob_seg_schema>(e, sv)
+		, api::ASSEMBLE_PROTOCOL_FORMAT_ERROR);
+
+	TEST_EQUAL(protocol::message_name(entry(entry::list_t)), 0);
+}
@@ -0,0 +1,69 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "ip2/config.hpp"
+#include "test.hpp"
+#include "ip2/aux_/binary_log.hpp"
+#include "ip2/sha1_hash.hpp"
+
+#include <array>
+#include <cinttypes>
+#include <string>
+
+using namespace lt;
+
+namespace {
+
+template <typename... Args>
+std::string format(char const* fmt, Args const&... args)
+{
+	span<char const> const record = aux::write_log_record(args...);
+	return aux::format_log_record(fmt, record);
+}
+
+} // anonymous namespace
+
+TORRENT_TEST(binary_log_integers)
+{
+	TEST_EQUAL(format("[%u] size:%d", std::uint32_t(7), -3), "[7] size:-3");
+	TEST_EQUAL(format("%" PRId64 " %lu", std::int64_t(1) << 40, std::size_t(12))
+		, "1099511627776 12");
+	TEST_EQUAL(format("%5d|%-3d|%03d", 42, 1, 7), "   42|1  |007");
+	TEST_EQUAL(format("%x %c", 255u, 'a'), "ff a");
+	TEST_EQUAL(format("%d", std::int8_t(-1)), "-1");
+	TEST_EQUAL(format("100%% %d", 1), "100% 1");
+}
+
+TORRENT_TEST(binary_log_strings)
+{
+	std::string const s = "hello";
+	char const arr[] = "array";
+	TEST_EQUAL(format("%s %s %s", "literal", s, arr), "literal hello array");
+	TEST_EQUAL(format("[%4s]", "ab"), "[  ab]");
+	TEST_EQUAL(format("%s", static_cast<char const*>(nullptr)), "(null)");
+	TEST_EQUAL(format("%.2f", 1.005 + 1), "2.00");
+}
+
+TORRENT_TEST(binary_log_hex)
+{
+	std::array<char, 3> const bytes{{'\x01', '\xab', '\xff'}};
+	TEST_EQUAL(format("k:%s", aux::hex_arg(bytes)), "k:01abff");
+
+	sha1_hash h;
+	h[0] = 0x12;
+	TEST_EQUAL(format("%s", aux::hex_arg(h)).substr(0, 4), "1200");
+	TEST_EQUAL(format("%s", aux::hex_arg(h)).size(), 40);
+}
+
+TORRENT_TEST(binary_log_mismatch)
+{
+	TEST_EQUAL(format("%d %d", 1), "1 <missing>");
+	TEST_EQUAL(format("no args", 1), "no args");
+	TEST_EQUAL(format("%"), "");
+}
@@ -0,0 +1,122 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "ip2/config.hpp"
+#include "test.hpp"
+#include "ip2/assemble/blob_buffer.hpp"
+
+#include <string>
+#include <thread>
+
+using namespace lt;
+using lt::assemble::blob_buffer;
+
+namespace {
+
+std::string make_seg(char c, int len) { return std::string(std::size_t(len), c); }
+
+} // anonymous namespace
+
+TORRENT_TEST(blob_buffer_in_order)
+{
+	blob_buffer b(3, 4);
+
+	TEST_EQUAL(b.is_complete(), false);
+	TEST_EQUAL(b.size(), 0);
+
+	TEST_CHECK(b.write_segment(0, make_seg('a', 4)));
+	TEST_EQUAL(b.contiguous_segments(), 1);
+	TEST_EQUAL(b.size(), 4);
+
+	TEST_CHECK(b.write_segment(1, make_seg('b', 4)));
+	TEST_CHECK(b.write_segment(2, make_seg('c', 2)));
+
+	TEST_EQUAL(b.is_complete(), true);
+	TEST_EQUAL(b.size(), 10);
+	TEST_CHECK(std::string(b.data().data(), 10) == "aaaabbbbcc");
+}
+
+TORRENT_TEST(blob_buffer_out_of_order)
+{
+	blob_buffer b(3, 4);
+
+	TEST_CHECK(b.write_segment(2, make_seg('c', 3)));
+	TEST_EQUAL(b.contiguous_segments(), 0);
+	TEST_EQUAL(b.size(), 0);
+
+	TEST_CHECK(b.write_segment(0, make_seg('a', 4)));
+	TEST_EQUAL(b.contiguous_segments(), 1);
+	TEST_EQUAL(b.size(), 4);
+
+	TEST_CHECK(b.write_segment(1, make_seg('b', 4)));
+	TEST_EQUAL(b.contiguous_segments(), 3);
+	TEST_EQUAL(b.is_complete(), true);
+	TEST_CHECK(std::string(b.data().data(), std::size_t(b.size())) == "aaaabbbbccc");
+}
+
+TORRENT_TEST(blob_buffer_invalid_segment)
+{
+	blob_buffer b(2, 4);
+
+	// only the last segment may be short
+	TEST_CHECK(!b.write_segment(0, make_seg('a', 3)));
+	TEST_CHECK(!b.write_segment(1, make_seg('a', 5)));
+	TEST_CHECK(!b.write_segment(1, span<char const>()));
+	TEST_CHECK(!b.write_segment(2, make_seg('a', 4)));
+	TEST_CHECK(!b.write_segment(-1, make_seg('a', 4)));
+	TEST_EQUAL(b.has_segment(0), false);
+	TEST_EQUAL(b.has_segment(1), false);
+}
+
+TORRENT_TEST(blob_buffer_rewrite)
+{
+	blob_buffer b(1, 4);
+
+	TEST_CHECK(b.write_segment(0, make_seg('a', 4)));
+	// segments are never modified once written
+	TEST_CHECK(b.write_segment(0, make_seg('b', 4)));
+	TEST_CHECK(std::string(b.data().data(), 4) == "aaaa");
+}
+
+TORRENT_TEST(blob_buffer_copy)
+{
+	std::string const content = "hello world";
+	blob_buffer b(content);
+
+	TEST_EQUAL(b.is_complete(), true);
+	TEST_EQUAL(b.size(), int(content.size()));
+	TEST_CHECK(std::string(b.data().data(), content.size()) == content);
+}
+
+TORRENT_TEST(blob_buffer_concurrent_read)
+{
+	// the client reads the prefix while the network thread writes
+	int const num_segments = 200;
+	blob_buffer b(num_segments, 64);
+
+	std::thread writer([&b] {
+		for (int i = 0; i < num_segments; ++i)
+			b.write_segment(i, make_seg(char('a' + i % 26), i == num_segments - 1 ? 7 : 64));
+	});
+
+	bool ok = true;
+	int last = 0;
+	while (!b.is_complete())
+	{
+		span<char const> const d = b.data();
+		if (d.size() < last) ok = false;
+		for (std::ptrdiff_t i = 0; i < d.size(); ++i)
+			if (d[i] != char('a' + (i / 64) % 26)) ok = false;
+		last = int(d.size());
+	}
+	writer.join();
+
+	TEST_CHECK(ok);
+	TEST_EQUAL(b.size(), (num_segments - 1) * 64 + 7);
+}
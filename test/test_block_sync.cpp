@@ -0,0 +1,291 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "ip2/config.hpp"
+#include "test.hpp"
+#include "ip2/blockchain/block_sync.hpp"
+#include "ip2/bdecode.hpp"
+#include "ip2/bencode.hpp"
+#include "ip2/hasher.hpp"
+
+#include <cstdio>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace lt;
+using namespace lt::blockchain;
+
+namespace {
+
+	sha1_hash block_hash(int const number)
+	{
+		return hasher(std::to_string(number)).final();
+	}
+
+	// the ancestors list a node publishes for block ``number``
+	std::vector<sha1_hash> ancestors(int number)
+	{
+		std::vector<sha1_hash> ret;
+		while (number > 0 && int(ret.size()) < blockchain_checkpoint_interval)
+		{
+			ret.push_back(block_hash(number - 1));
+			if ((number - 1) % blockchain_checkpoint_interval == 0) break;
+			--number;
+		}
+		return ret;
+	}
+
+	struct chain
+	{
+		// we have the blocks up to ``known``, the peer up to ``head``
+		chain(int const known, int const head)
+		{
+			for (int i = 0; i <= head; ++i)
+			{
+				numbers[block_hash(i)] = i;
+				if (i <= known) have[block_hash(i)] = true;
+			}
+		}
+
+		bool has(sha1_hash const& h) const
+		{
+			auto const it = have.find(h);
+			return it != have.end() && it->second;
+		}
+
+		std::map<sha1_hash, int> numbers;
+		std::map<sha1_hash, bool> have;
+	};
+
+	// every request of a round is answered in the next one. Returns the
+	// number of round trips it took to fetch all the blocks
+	int simulate(block_sync& sync, chain& c, int const head, bool const publish_lists
+		, int& blocks_fetched)
+	{
+		dht::public_key const peer;
+		blocks_fetched = 0;
+
+		sync.missing(peer, block_hash(head), block_hash(head - 1));
+		int rounds = 0;
+		while (!sync.idle())
+		{
+			auto const reqs = sync.pop_requests();
+			TEST_CHECK(!reqs.empty());
+			if (reqs.empty()) break;
+			++rounds;
+
+			std::vector<std::pair<sha1_hash, sha1_hash>> missing;
+			for (auto const& r : reqs)
+			{
+				if (r.kind == block_sync::request::ancestors)
+				{
+					if (publish_lists)
+						sync.ancestors_received(r.hash, ancestors(c.numbers[r.hash])
+							, [&](sha1_hash const& h) { return c.has(h); });
+					else
+						sync.ancestors_failed(r.hash);
+					continue;
+				}
+
+				TEST_CHECK(!c.has(r.hash));
+				c.have[r.hash] = true;
+				++blocks_fetched;
+				sync.block_done(r.hash);
+
+				// the way the blockchain finds the next missing block when
+				// it walks the branch
+				int const n = c.numbers[r.hash];
+				if (n > 0 && !c.has(block_hash(n - 1)))
+					missing.emplace_back(r.hash, block_hash(n - 1));
+			}
+
+			if (publish_lists) continue;
+			for (auto const& m : missing) sync.missing(peer, m.first, m.second);
+		}
+
+		return rounds;
+	}
+}
+
+TORRENT_TEST(sync_max_blocks)
+{
+	// we have the genesis block and the peer's head, the sync is as long as
+	// the blockchain lets it be
+	int const head = blockchain_max_sync_blocks + 1;
+
+	// a block a round trip, the way it is without the lists
+	chain sequential_chain(0, head);
+	block_sync sequential(blockchain_max_sync_in_flight, blockchain_max_sync_blocks);
+	int sequential_blocks = 0;
+	int const sequential_rounds = simulate(sequential, sequential_chain, head, false
+		, sequential_blocks);
+	TEST_EQUAL(sequential_blocks, head - 1);
+
+	chain pipelined_chain(0, head);
+	block_sync pipelined(blockchain_max_sync_in_flight, blockchain_max_sync_blocks);
+	int pipelined_blocks = 0;
+	int const pipelined_rounds = simulate(pipelined, pipelined_chain, head, true
+		, pipelined_blocks);
+	TEST_EQUAL(pipelined_blocks, head - 1);
+
+	std::printf("round trips to sync %d blocks: sequential %d pipelined %d\n"
+		, head - 1, sequential_rounds, pipelined_rounds);
+
+	// bound by the window, not by the round trip a block. The first list
+	// and the last blocks take a round of their own
+	int const window_rounds = (head - 1 + blockchain_max_sync_in_flight - 1)
+		/ blockchain_max_sync_in_flight;
+	TEST_CHECK(sequential_rounds >= head - 1);
+	TEST_CHECK(pipelined_rounds <= window_rounds + 2);
+	TEST_CHECK(pipelined.idle());
+}
+
+TORRENT_TEST(stop_at_known_block)
+{
+	int const head = 100;
+	chain c(60, head);
+	block_sync sync;
+	int blocks = 0;
+	simulate(sync, c, head, true, blocks);
+
+	// only the blocks after the ones we have are fetched
+	TEST_EQUAL(blocks, head - 61);
+	TEST_CHECK(sync.idle());
+}
+
+TORRENT_TEST(max_blocks)
+{
+	int const head = 1000;
+	chain c(0, head);
+	block_sync sync(blockchain_max_sync_in_flight, 100);
+	int blocks = 0;
+	simulate(sync, c, head, true, blocks);
+	TEST_EQUAL(blocks, 100);
+	TEST_CHECK(sync.idle());
+}
+
+TORRENT_TEST(window)
+{
+	block_sync sync(4);
+	dht::public_key const peer;
+	sync.missing(peer, block_hash(100), block_hash(99));
+
+	auto reqs = sync.pop_requests();
+	TEST_EQUAL(int(reqs.size()), 2);
+
+	std::vector<sha1_hash> const hashes = ancestors(99);
+	TEST_EQUAL(int(hashes.size()), 24);
+	for (auto const& r : reqs)
+	{
+		if (r.kind == block_sync::request::ancestors)
+		{
+			TEST_CHECK(r.hash == block_hash(100));
+			sync.ancestors_received(r.hash, ancestors(100), [](sha1_hash const&) { return false; });
+		}
+	}
+
+	// the list is queued behind the block in flight, up to the window
+	reqs = sync.pop_requests();
+	int num_blocks = 0;
+	for (auto const& r : reqs)
+		if (r.kind == block_sync::request::block) ++num_blocks;
+	TEST_EQUAL(num_blocks, 3);
+	TEST_EQUAL(sync.in_flight(), 4);
+	TEST_CHECK(sync.pop_requests().empty());
+
+	// a block is done, the next one goes out
+	sync.block_done(block_hash(99));
+	reqs = sync.pop_requests();
+	TEST_EQUAL(int(reqs.size()), 1);
+	TEST_EQUAL(sync.in_flight(), 4);
+}
+
+TORRENT_TEST(duplicates)
+{
+	block_sync sync;
+	dht::public_key const peer;
+	sync.missing(peer, block_hash(10), block_hash(9));
+	sync.missing(peer, block_hash(10), block_hash(9));
+
+	auto const reqs = sync.pop_requests();
+	TEST_EQUAL(int(reqs.size()), 2);
+	TEST_CHECK(sync.pop_requests().empty());
+
+	// a list nobody asked for changes nothing
+	sync.ancestors_received(block_hash(5), ancestors(5), [](sha1_hash const&) { return false; });
+	TEST_CHECK(sync.pop_requests().empty());
+
+	// the list repeats the block in flight
+	sync.ancestors_received(block_hash(10), ancestors(10), [](sha1_hash const&) { return false; });
+	for (auto const& r : sync.pop_requests())
+		TEST_CHECK(r.hash != block_hash(9));
+
+	sync.block_done(block_hash(9));
+	sync.block_done(block_hash(9));
+	TEST_CHECK(!sync.idle());
+}
+
+TORRENT_TEST(list_failed)
+{
+	block_sync sync;
+	dht::public_key const peer;
+	sync.missing(peer, block_hash(10), block_hash(9));
+	sync.pop_requests();
+
+	sync.ancestors_failed(block_hash(10));
+	TEST_CHECK(!sync.idle());
+	sync.block_done(block_hash(9));
+	TEST_CHECK(sync.idle());
+
+	// the sync is over, the same block can be synced again
+	sync.missing(peer, block_hash(10), block_hash(9));
+	TEST_EQUAL(int(sync.pop_requests().size()), 2);
+}
+
+TORRENT_TEST(ancestors_entry)
+{
+	std::vector<sha1_hash> const hashes = ancestors(50);
+	entry const e = block_sync::ancestors_entry(hashes);
+
+	std::vector<sha1_hash> parsed;
+	TEST_CHECK(block_sync::parse_ancestors(e, parsed));
+	TEST_CHECK(parsed == hashes);
+
+	// round trip through the encoding
+	std::vector<char> buf;
+	bencode(std::back_inserter(buf), e);
+	TEST_CHECK(block_sync::parse_ancestors(entry(bdecode(buf)), parsed));
+	TEST_CHECK(parsed == hashes);
+
+	TEST_CHECK(block_sync::parse_ancestors(entry(entry::list_t), parsed));
+	TEST_CHECK(parsed.empty());
+}
+
+TORRENT_TEST(bad_ancestors_entry)
+{
+	std::vector<sha1_hash> parsed;
+	TEST_CHECK(!block_sync::parse_ancestors(entry("not a list"), parsed));
+
+	entry::list_type short_hash;
+	short_hash.push_back(block_hash(1).to_string());
+	short_hash.push_back(std::string("short"));
+	TEST_CHECK(!block_sync::parse_ancestors(short_hash, parsed));
+	TEST_CHECK(parsed.empty());
+
+	entry::list_type not_a_string;
+	not_a_string.push_back(entry(1));
+	TEST_CHECK(!block_sync::parse_ancestors(not_a_string, parsed));
+
+	entry::list_type too_long;
+	for (int i = 0; i <= blockchain_checkpoint_interval; ++i)
+		too_long.push_back(block_hash(i).to_string());
+	TEST_CHECK(!block_sync::parse_ancestors(too_long, parsed));
+}
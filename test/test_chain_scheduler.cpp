@@ -0,0 +1,166 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "ip2/config.hpp"
+#include "test.hpp"
+#include "ip2/blockchain/chain_scheduler.hpp"
+
+#include <vector>
+
+using namespace lt;
+using namespace lt::blockchain;
+
+namespace {
+
+	constexpr time_duration resolution = milliseconds(blockchain_mining_timer_resolution);
+
+	aux::bytes chain(char const c)
+	{
+		return aux::bytes(8, c);
+	}
+}
+
+TORRENT_TEST(not_loaded_at_start)
+{
+	chain_scheduler s(resolution, clock_type::now());
+
+	// the chains followed aren't connected until they're used, or found
+	// worth it in the background
+	TEST_CHECK(!s.is_loaded(chain('a')));
+	TEST_CHECK(!s.is_parked(chain('a')));
+	TEST_CHECK(!s.wants_connect(chain('a'), 0));
+	TEST_CHECK(s.loaded_chains().empty());
+	TEST_CHECK(s.next_expiry() == max_time());
+}
+
+TORRENT_TEST(activate_loads)
+{
+	chain_scheduler s(resolution, clock_type::now());
+
+	// the first use connects the chain, the next ones don't
+	TEST_CHECK(s.activate(chain('a'), 1000));
+	s.loaded(chain('a'), 1000);
+	TEST_CHECK(s.is_loaded(chain('a')));
+	TEST_CHECK(!s.wants_connect(chain('a'), 1000));
+	TEST_CHECK(!s.activate(chain('a'), 2000));
+	TEST_EQUAL(int(s.loaded_chains().size()), 1);
+}
+
+TORRENT_TEST(idle_chain_parked)
+{
+	time_point const start = clock_type::now();
+	chain_scheduler s(resolution, start);
+
+	s.loaded(chain('a'), 0);
+	s.schedule(chain('a'), start + seconds(5));
+	s.loaded(chain('b'), 0);
+	s.activate(chain('b'), blockchain_chain_idle_time);
+
+	std::int64_t const now = blockchain_chain_idle_time + 1;
+	TEST_CHECK(s.is_idle(chain('a'), now));
+	TEST_CHECK(!s.is_idle(chain('b'), now));
+	// a chain never used isn't idle
+	TEST_CHECK(!s.is_idle(chain('c'), now));
+
+	s.park(chain('a'));
+	TEST_CHECK(s.is_parked(chain('a')));
+	TEST_CHECK(!s.is_loaded(chain('a')));
+	TEST_CHECK(!s.is_scheduled(chain('a')));
+	TEST_CHECK(!s.wants_connect(chain('a'), now));
+	TEST_CHECK(s.next_expiry() == max_time());
+	TEST_CHECK(s.advance(start + seconds(10)).empty());
+
+	// until it's used again
+	TEST_CHECK(s.activate(chain('a'), now));
+	s.loaded(chain('a'), now);
+	TEST_CHECK(!s.is_parked(chain('a')));
+	TEST_CHECK(!s.is_idle(chain('a'), now));
+}
+
+TORRENT_TEST(background_connect)
+{
+	chain_scheduler s(resolution, clock_type::now());
+	std::int64_t const now = 10 * blockchain_chain_idle_time;
+
+	// a chain with a recent block is connected in the background, one whose
+	// last block is older than blockchain_chain_idle_time isn't
+	s.record_activity(chain('a'), now - 1000);
+	s.record_activity(chain('b'), now - blockchain_chain_idle_time - 1);
+	TEST_CHECK(s.wants_connect(chain('a'), now));
+	TEST_CHECK(!s.wants_connect(chain('b'), now));
+
+	// an older block doesn't take the activity back
+	s.record_activity(chain('a'), 0);
+	TEST_CHECK(s.wants_connect(chain('a'), now));
+
+	// the chains we mine are, with or without activity
+	s.set_miner(chain('b'));
+	s.set_miner(chain('c'));
+	TEST_CHECK(s.wants_connect(chain('b'), now));
+	TEST_CHECK(s.wants_connect(chain('c'), now));
+
+	// a chain no longer wants to be connected once it's loaded
+	s.loaded(chain('a'), now);
+	TEST_CHECK(!s.wants_connect(chain('a'), now));
+
+	// or parked, until it's used
+	s.park(chain('c'));
+	TEST_CHECK(!s.wants_connect(chain('c'), now));
+	TEST_CHECK(!s.is_miner(chain('c')));
+
+	// a chain with no activity and no miner waits to be activated
+	TEST_CHECK(!s.wants_connect(chain('d'), now));
+	TEST_CHECK(s.activate(chain('d'), now));
+}
+
+TORRENT_TEST(next_expiry_earliest)
+{
+	time_point const start = clock_type::now();
+	chain_scheduler s(resolution, start);
+
+	s.schedule(chain('a'), start + seconds(5));
+	TEST_CHECK(s.next_expiry() > start);
+	TEST_CHECK(s.next_expiry() <= start + seconds(5));
+
+	// a chain due earlier moves the timer before it
+	s.schedule(chain('b'), start + milliseconds(300));
+	TEST_CHECK(s.next_expiry() <= start + milliseconds(300));
+	TEST_CHECK(s.advance(start + milliseconds(200)).empty());
+	TEST_CHECK(s.advance(start + milliseconds(300)) == std::vector<aux::bytes>{chain('b')});
+	TEST_CHECK(!s.is_scheduled(chain('b')));
+
+	// and it's re-armed to the one left
+	TEST_CHECK(s.next_expiry() > start + milliseconds(300));
+	TEST_CHECK(s.next_expiry() <= start + seconds(5));
+
+	// rescheduled, a chain is due once, at the new time
+	s.schedule(chain('a'), start + seconds(1));
+	TEST_CHECK(s.advance(start + seconds(1)) == std::vector<aux::bytes>{chain('a')});
+	TEST_CHECK(s.advance(start + seconds(6)).empty());
+	TEST_CHECK(s.next_expiry() == max_time());
+}
+
+TORRENT_TEST(unschedule_while_mining)
+{
+	time_point const start = clock_type::now();
+	chain_scheduler s(resolution, start);
+
+	s.schedule(chain('a'), start + milliseconds(100));
+	s.schedule(chain('b'), start + milliseconds(100));
+
+	// mining the first chain due may unschedule or schedule the other one,
+	// whose timer expired with it
+	auto const chains = s.advance(start + milliseconds(100));
+	TEST_EQUAL(int(chains.size()), 2);
+	TEST_CHECK(!s.is_scheduled(chain('a')));
+	TEST_CHECK(!s.is_scheduled(chain('b')));
+	s.unschedule(chains[1]);
+	s.schedule(chains[1], start + milliseconds(200));
+	TEST_CHECK(s.advance(start + milliseconds(200)) == std::vector<aux::bytes>{chains[1]});
+}
@@ -0,0 +1,162 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "ip2/config.hpp"
+#include "test.hpp"
+#include "ip2/blockchain/chain_workers.hpp"
+#include "ip2/io_context.hpp"
+
+#include <atomic>
+#include <map>
+#include <thread>
+#include <vector>
+
+using namespace lt;
+using namespace lt::blockchain;
+
+namespace {
+
+	aux::bytes chain(char const c)
+	{
+		return aux::bytes(8, c);
+	}
+}
+
+TORRENT_TEST(work_on_worker)
+{
+	io_context ios;
+	chain_workers workers(ios, 2);
+	TEST_EQUAL(workers.num_threads(), 2);
+
+	auto work = make_work_guard(ios);
+
+	std::thread::id const network_thread = std::this_thread::get_id();
+	std::thread::id worker_thread;
+
+	int result = 0;
+	workers.post(chain('a'), [&] {
+			worker_thread = std::this_thread::get_id();
+			return 42;
+		}
+		, [&](int r) {
+			TEST_CHECK(std::this_thread::get_id() == network_thread);
+			result = r;
+			work.reset();
+		});
+
+	ios.run();
+
+	TEST_EQUAL(result, 42);
+	TEST_CHECK(worker_thread != network_thread);
+}
+
+TORRENT_TEST(in_order_per_chain)
+{
+	io_context ios;
+	chain_workers workers(ios, 4);
+
+	auto work = make_work_guard(ios);
+
+	// the work of a chain never runs on two threads at once, and comes
+	// back in order
+	std::map<char, std::vector<int>> order;
+	std::map<char, std::atomic<int>> running;
+	std::atomic<bool> overlap{false};
+	int done = 0;
+	for (int i = 0; i < 100; ++i)
+	{
+		for (char const c : {'a', 'b', 'c'})
+		{
+			std::atomic<int>& r = running[c];
+			workers.post(chain(c), [&r, &overlap, i] {
+					if (r.fetch_add(1) != 0) overlap = true;
+					std::this_thread::yield();
+					r.fetch_sub(1);
+					return i;
+				}
+				, [&, c](int const n) {
+					order[c].push_back(n);
+					if (++done == 300) work.reset();
+				});
+		}
+	}
+
+	ios.run();
+
+	TEST_CHECK(!overlap);
+	for (char const c : {'a', 'b', 'c'})
+	{
+		TEST_EQUAL(int(order[c].size()), 100);
+		for (int i = 0; i < int(order[c].size()); ++i)
+			TEST_EQUAL(order[c][std::size_t(i)], i);
+	}
+}
+
+TORRENT_TEST(no_threads)
+{
+	io_context ios;
+	chain_workers workers(ios, 0);
+
+	std::thread::id const network_thread = std::this_thread::get_id();
+
+	// the work is still done after post() returns
+	int result = 0;
+	workers.post(chain('a'), [&] {
+			TEST_CHECK(std::this_thread::get_id() == network_thread);
+			return 1;
+		}
+		, [&](int r) { result = r; });
+	TEST_EQUAL(result, 0);
+
+	ios.run();
+	TEST_EQUAL(result, 1);
+}
+
+TORRENT_TEST(stopped)
+{
+	io_context ios;
+	chain_workers workers(ios, 2);
+	workers.stop();
+	TEST_EQUAL(workers.num_threads(), 0);
+
+	bool called = false;
+	workers.post(chain('a'), [] { return 1; }, [&](int) { called = true; });
+
+	ios.run();
+	TEST_CHECK(!called);
+}
+
+TORRENT_TEST(malformed_item)
+{
+	io_context ios;
+	chain_workers workers(ios, 1);
+
+	auto work = make_work_guard(ios);
+
+	// items a peer may send that aren't lists, or lists of the wrong things.
+	// They're not valid, and the worker is still there for the next one
+	std::vector<entry> const items = {
+		entry("not a list"), entry(42), entry(entry::dictionary_t)
+		, entry(entry::list_type(11, entry(1))), entry(entry::list_type(7, entry(1)))};
+
+	int done = 0;
+	for (auto const& e : items)
+	{
+		workers.post(chain('a'), [e] {
+				return !verify_block_item(e).valid && !verify_transaction_item(e).valid;
+			}
+			, [&](bool const rejected) {
+				TEST_CHECK(rejected);
+				if (++done == int(items.size())) work.reset();
+			});
+	}
+
+	ios.run();
+	TEST_EQUAL(done, int(items.size()));
+}
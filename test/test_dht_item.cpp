@@ -0,0 +1,124 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "ip2/config.hpp"
+#include "test.hpp"
+#include "ip2/kademlia/item.hpp"
+#include "ip2/kademlia/ed25519.hpp"
+#include "ip2/bencode.hpp"
+#include "ip2/bdecode.hpp"
+
+#include <tuple>
+
+using namespace lt;
+
+namespace {
+
+	std::vector<char> bencoded(entry const& e)
+	{
+		std::vector<char> ret;
+		bencode(std::back_inserter(ret), e);
+		return ret;
+	}
+
+	std::tuple<dht::public_key, dht::secret_key> keys()
+	{
+		std::array<char, 32> seed{};
+		seed[0] = 'a';
+		return dht::ed25519_create_keypair(seed);
+	}
+}
+
+TORRENT_TEST(bencoded_value_is_kept)
+{
+	// a dictionary with its keys out of order is valid bencoding, but isn't
+	// what bencoding an entry produces. The item must keep it as it was
+	// signed
+	std::string const raw = "d1:bi1e1:ai2ee";
+
+	dht::item i;
+	i.assign_bencoded(raw);
+	TEST_CHECK(!i.empty());
+	TEST_CHECK(!i.is_mutable());
+	TEST_EQUAL(std::string(i.buffer().begin(), i.buffer().end()), raw);
+
+	// decoded on demand
+	TEST_EQUAL(i.value()["a"].integer(), 2);
+	TEST_EQUAL(i.value()["b"].integer(), 1);
+	TEST_EQUAL(std::string(i.buffer().begin(), i.buffer().end()), raw);
+}
+
+TORRENT_TEST(assign_bdecode_node)
+{
+	std::string const raw = "d1:v5:helloe";
+	error_code ec;
+	bdecode_node const n = bdecode(raw, ec);
+	TEST_CHECK(!ec);
+
+	dht::item i(n.dict_find("v"));
+	TEST_EQUAL(std::string(i.buffer().begin(), i.buffer().end()), "5:hello");
+	TEST_EQUAL(i.value().string(), "hello");
+}
+
+TORRENT_TEST(assign_entry)
+{
+	entry e;
+	e["x"] = "y";
+
+	dht::item i(e);
+	TEST_CHECK(i.buffer() == span<char const>(bencoded(e)));
+	TEST_CHECK(i.value() == e);
+
+	i.clear();
+	TEST_CHECK(i.empty());
+	TEST_CHECK(i.buffer().empty());
+}
+
+TORRENT_TEST(copies_share_buffer)
+{
+	dht::item a;
+	a.assign_bencoded(std::string("4:spam"));
+	dht::item const b = a;
+	TEST_CHECK(a.buffer().data() == b.buffer().data());
+	TEST_EQUAL(b.value().string(), "spam");
+}
+
+TORRENT_TEST(mutable_sign_and_verify)
+{
+	dht::public_key pk;
+	dht::secret_key sk;
+	std::tie(pk, sk) = keys();
+
+	std::string const salt = "salt";
+	entry v;
+	v["msg"] = "hello";
+
+	dht::item signed_item(v, salt, dht::timestamp(5), pk, sk);
+	TEST_CHECK(signed_item.is_mutable());
+
+	// the signature covers exactly the buffer
+	TEST_CHECK(dht::verify_mutable_item(signed_item.buffer(), salt
+		, dht::timestamp(5), pk, signed_item.sig()));
+
+	// a receiver verifies the bytes it got
+	std::vector<char> const wire = bencoded(v);
+	error_code ec;
+	bdecode_node const n = bdecode(wire, ec);
+	TEST_CHECK(!ec);
+
+	dht::item received;
+	TEST_CHECK(received.assign(n, salt, dht::timestamp(5), pk, signed_item.sig()));
+	TEST_CHECK(received.buffer() == signed_item.buffer());
+	TEST_EQUAL(received.value()["msg"].string(), "hello");
+
+	// a different timestamp doesn't verify
+	dht::item bad;
+	TEST_CHECK(!bad.assign(n, salt, dht::timestamp(6), pk, signed_item.sig()));
+	TEST_CHECK(bad.empty());
+}
@@ -412,6 +412,43 @@ TORRENT_TEST(update_node_ids)
 	TEST_CHECK(r);
 }
 
+TORRENT_TEST(popular_item_is_kept)
+{
+	auto const sett = test_settings();
+	std::unique_ptr<dht_storage_interface> s(dht_default_storage_constructor(sett));
+	s->update_node_ids({to_hash("0000000000000000000000000000000000000200")});
+
+	sha1_hash const h1 = to_hash("0000000000000000000000000000000000010200");
+	sha1_hash const h2 = to_hash("0000000000000000000000000000000000020200");
+	sha1_hash const h3 = to_hash("0000000000000000000000000000000000018200");
+
+	// h2 is a bit farther than h1, but every 5 announcers are worth a bit
+	s->put_immutable_item(h1, {"123", 3}, addr("124.31.75.21"));
+	for (int i = 0; i < 10; ++i)
+	{
+		char ip[20];
+		std::snprintf(ip, sizeof(ip), "124.31.75.%d", i + 100);
+		s->put_immutable_item(h2, {"123", 3}, addr(ip));
+	}
+
+	// the table is full, the least important one (h1) makes room for h3
+	s->put_immutable_item(h3, {"123", 3}, addr("124.31.75.21"));
+	TEST_EQUAL(s->counters().immutable_data, 2);
+
+	entry item;
+	TEST_CHECK(!s->get_immutable_item(h1, item));
+	TEST_CHECK(s->get_immutable_item(h2, item));
+	TEST_CHECK(s->get_immutable_item(h3, item));
+
+	// once our node id moves next to h1's slot, h3 is closer than h2 is
+	// popular, and h2 goes first
+	s->update_node_ids({to_hash("0000000000000000000000000000000000018201")});
+	s->put_immutable_item(h1, {"123", 3}, addr("124.31.75.21"));
+	TEST_CHECK(s->get_immutable_item(h1, item));
+	TEST_CHECK(!s->get_immutable_item(h2, item));
+	TEST_CHECK(s->get_immutable_item(h3, item));
+}
+
 TORRENT_TEST(infohashes_sample)
 {
 	auto sett = test_settings();
@@ -0,0 +1,343 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "ip2/config.hpp"
+#include "test.hpp"
+
+#include "ip2/assemble/direct_channel.hpp"
+#include "ip2/assemble/protocol.hpp"
+#include "ip2/aux_/ip_voter.hpp"
+#include "ip2/aux_/session_interface.hpp"
+#include "ip2/aux_/session_settings.hpp"
+#include "ip2/aux_/socket_type.hpp"
+#include "ip2/aux_/utp_socket_manager.hpp"
+#include "ip2/aux_/utp_stream.hpp"
+#include "ip2/hasher.hpp"
+#include "ip2/io_context.hpp"
+#include "ip2/performance_counters.hpp"
+#include "ip2/time.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+using namespace lt;
+
+namespace {
+
+	struct null_logger final : assemble::assemble_logger
+	{
+		bool should_log(aux::LOG_LEVEL) const override { return false; }
+		void log(aux::LOG_LEVEL, char const*, ...) override {}
+		void log_record(aux::LOG_LEVEL, char const*, span<char const>) override {}
+	};
+
+	struct loopback_socket final : aux::utp_socket_interface
+	{
+		explicit loopback_socket(udp::endpoint const& ep) : m_ep(ep) {}
+		udp::endpoint get_local_endpoint() override { return m_ep; }
+	private:
+		udp::endpoint m_ep;
+	};
+
+	// a node with a direct channel, whose uTP packets are delivered to the
+	// other node through the io_context. Only the part of the session the
+	// direct channel uses is there
+	struct node final : aux::session_interface
+	{
+		node(io_context& ios, udp::endpoint const& ep, aux::session_settings const& sett)
+			: m_ios(ios)
+			, m_ep(ep)
+			, m_settings(sett)
+			, m_sock(std::make_shared<loopback_socket>(ep))
+			, m_utp([this](std::weak_ptr<aux::utp_socket_interface>, udp::endpoint const&
+					, span<char const> p, lt::error_code&, aux::udp_send_flags_t)
+				{ send(p); }
+				, [this](aux::socket_type s) { incoming(std::move(s)); }
+				, ios, m_settings, m_counters, nullptr)
+			, channel(std::make_shared<assemble::direct_channel>(ios, *this
+				, m_settings, m_counters, m_logger))
+		{}
+
+		~node() override { channel->stop(); }
+
+		void send(span<char const> p)
+		{
+			if (mute || remote == nullptr) return;
+			std::vector<char> buf(p.begin(), p.end());
+			post(m_ios, [to = remote, from = m_ep, buf = std::move(buf)]
+			{
+				to->m_utp.incoming_packet(to->m_sock, from, buf);
+				to->m_utp.socket_drained();
+			});
+		}
+
+		void incoming(aux::socket_type s)
+		{
+			auto* const stream = std::get_if<aux::utp_stream>(&s);
+			if (stream == nullptr) return;
+			channel->incoming(std::make_unique<aux::utp_stream>(std::move(*stream)));
+		}
+
+		std::unique_ptr<aux::utp_stream> open_direct_stream(udp::endpoint const&) override
+		{
+			auto ret = std::make_unique<aux::utp_stream>(m_ios);
+			ret->set_impl(m_utp.new_utp_socket(ret.get()));
+			ret->get_impl()->m_sock = m_sock;
+			return ret;
+		}
+
+		std::int64_t counter(int const c) const { return m_counters[c]; }
+
+#ifndef TORRENT_DISABLE_LOGGING
+		bool should_log() const override { return false; }
+		bool should_log(aux::LOG_LEVEL) const override { return false; }
+		void session_log(char const*, ...) const override {}
+#endif
+#if TORRENT_USE_ASSERTS
+		bool is_single_thread() const override { return true; }
+#endif
+
+		void set_external_address(tcp::endpoint const&, address const&
+			, aux::ip_source_t, address const&) override {}
+		aux::external_ip external_address() const override { std::abort(); }
+		aux::alert_manager& alerts() override { std::abort(); }
+		io_context& get_context() override { return m_ios; }
+		aux::resolver_interface& get_resolver() override { std::abort(); }
+		port_filter const& get_port_filter() const override { std::abort(); }
+		void ban_ip(address) override {}
+		std::uint16_t session_time() const override { return 0; }
+		time_point session_start_time() const override { return time_point(); }
+		bool is_aborted() const override { return false; }
+		void trigger_optimistic_unchoke() noexcept override {}
+		void trigger_unchoke() noexcept override {}
+		int num_connections() const override { return 0; }
+		int get_log_level() const override { return 0; }
+		void for_each_listen_socket(std::function<void(aux::listen_socket_handle const&)>) override {}
+		bool verify_bound_address(address const&, bool, lt::error_code&) override { return true; }
+		aux::proxy_settings proxy() const override { std::abort(); }
+		void apply_settings_pack(std::shared_ptr<settings_pack>) override {}
+		aux::session_settings const& settings() const override { return m_settings; }
+		peer_class_pool const& peer_classes() const override { std::abort(); }
+		peer_class_pool& peer_classes() override { std::abort(); }
+		void sent_bytes(int, int) override {}
+		void received_bytes(int, int) override {}
+		void trancieve_ip_packet(int, bool) override {}
+		void sent_syn(bool) override {}
+		void received_synack(bool) override {}
+		void inc_boost_connections() override {}
+		bool announce_dht() const override { return false; }
+		bool has_dht() const override { return false; }
+		int external_udp_port(address const&) const override { return -1; }
+		udp::endpoint external_udp_endpoint() const override { return {}; }
+		udp::endpoint direct_endpoint() const override { return m_ep; }
+		dht::dht_tracker* dht() override { return nullptr; }
+		int dht_nodes() override { return 0; }
+		assemble::assembler* assembler() override { return nullptr; }
+		transport::transporter* transporter() override { return nullptr; }
+		leveldb::DB* kvdb() override { return nullptr; }
+		sqlite3* sqldb() override { return nullptr; }
+		std::int64_t timer_coe() override { return 0; }
+		dht::public_key* pubkey() override { return nullptr; }
+		dht::secret_key* serkey() override { return nullptr; }
+		counters& stats_counters() override { return m_counters; }
+		void received_buffer(int) override {}
+		void sent_buffer(int) override {}
+
+		node* remote = nullptr;
+
+		// drop every packet sent
+		bool mute = false;
+
+	private:
+		io_context& m_ios;
+		udp::endpoint const m_ep;
+		aux::session_settings const& m_settings;
+		counters m_counters;
+		null_logger m_logger;
+		std::shared_ptr<loopback_socket> m_sock;
+		aux::utp_socket_manager m_utp;
+
+	public:
+		std::shared_ptr<assemble::direct_channel> channel;
+	};
+
+	aux::session_settings test_settings()
+	{
+		aux::session_settings sett;
+		sett.set_bool(settings_pack::enable_direct_transfer, true);
+		sett.set_int(settings_pack::direct_transfer_timeout, 1);
+		return sett;
+	}
+
+	std::vector<char> make_blob(int const size, char const seed)
+	{
+		std::vector<char> ret(static_cast<std::size_t>(size));
+		for (std::size_t i = 0; i < ret.size(); ++i)
+			ret[i] = char(seed + char(i * 7));
+		return ret;
+	}
+
+	std::vector<sha1_hash> segment_hashes(std::vector<char> const& blob)
+	{
+		std::vector<sha1_hash> ret;
+		for (int off = 0; off < int(blob.size()); off += assemble::protocol::blob_seg_mtu)
+		{
+			int const size = std::min(assemble::protocol::blob_seg_mtu, int(blob.size()) - off);
+			ret.push_back(hasher(blob.data() + off, size).final());
+		}
+		return ret;
+	}
+
+	// a getter and a sender, the sender at ``sender_ep``
+	struct pair_setup
+	{
+		pair_setup()
+			: sett(test_settings())
+			, getter(ios, udp::endpoint(make_address_v4("10.0.0.1"), 6881), sett)
+			, sender(ios, sender_ep, sett)
+		{
+			getter.remote = &sender;
+			sender.remote = &getter;
+		}
+
+		~pair_setup()
+		{
+			// the handlers aborted by closing the streams hold their
+			// connections until they run
+			getter.channel->stop();
+			sender.channel->stop();
+			ios.restart();
+			ios.poll();
+		}
+
+		// runs until the fetch is done, at most ``limit``
+		void run(bool const& done, time_duration const limit)
+		{
+			time_point const end = clock_type::now() + limit;
+			while (!done && clock_type::now() < end)
+			{
+				ios.restart();
+				ios.run_one_until(end);
+			}
+		}
+
+		udp::endpoint const sender_ep{make_address_v4("10.0.0.2"), 6881};
+		io_context ios;
+		aux::session_settings sett;
+		node getter;
+		node sender;
+	};
+}
+
+TORRENT_TEST(serve_fetch)
+{
+	pair_setup p;
+
+	std::vector<char> const blob = make_blob(2500, 'a');
+	std::vector<sha1_hash> hashes = segment_hashes(blob);
+	TEST_EQUAL(int(hashes.size()), 3);
+	p.sender.channel->serve(blob, hashes);
+
+	// a segment the sender doesn't have is left to the DHT
+	sha1_hash const unknown = hasher("unknown", 7).final();
+	hashes.push_back(unknown);
+
+	std::vector<std::vector<char>> got;
+	std::vector<sha1_hash> missing;
+	bool done = false;
+	TEST_CHECK(p.getter.channel->fetch(p.sender_ep, hashes
+		, [&](sha1_hash const& h, span<char const> seg)
+		{
+			TEST_CHECK(hasher(seg).final() == h);
+			got.emplace_back(seg.begin(), seg.end());
+			return true;
+		}
+		, [&](std::vector<sha1_hash> m)
+		{
+			missing = std::move(m);
+			done = true;
+		}));
+
+	p.run(done, seconds(5));
+	TEST_CHECK(done);
+	TEST_EQUAL(int(got.size()), 3);
+	TEST_CHECK(missing == std::vector<sha1_hash>{unknown});
+
+	std::vector<char> assembled;
+	for (auto const& seg : got) assembled.insert(assembled.end(), seg.begin(), seg.end());
+	TEST_CHECK(assembled == blob);
+
+	TEST_EQUAL(p.getter.counter(counters::assemble_direct_segments), 3);
+	TEST_EQUAL(p.sender.counter(counters::assemble_direct_served), 3);
+}
+
+TORRENT_TEST(hash_mismatch)
+{
+	pair_setup p;
+
+	// the sender serves a blob under the hashes of another one
+	std::vector<char> const blob = make_blob(2500, 'a');
+	std::vector<sha1_hash> const hashes = segment_hashes(make_blob(2500, 'b'));
+	p.sender.channel->serve(blob, hashes);
+
+	int calls = 0;
+	std::vector<sha1_hash> missing;
+	bool done = false;
+	TEST_CHECK(p.getter.channel->fetch(p.sender_ep, hashes
+		, [&](sha1_hash const& h, span<char const> seg)
+		{
+			++calls;
+			return hasher(seg).final() == h;
+		}
+		, [&](std::vector<sha1_hash> m)
+		{
+			missing = std::move(m);
+			done = true;
+		}));
+
+	p.run(done, seconds(5));
+	TEST_CHECK(done);
+
+	// the stream is closed at the first bad segment, all of them are left
+	// to the DHT
+	TEST_EQUAL(calls, 1);
+	TEST_CHECK(missing == hashes);
+	TEST_EQUAL(p.getter.counter(counters::assemble_direct_segments), 0);
+}
+
+TORRENT_TEST(fetch_timeout)
+{
+	pair_setup p;
+
+	std::vector<char> const blob = make_blob(2500, 'a');
+	std::vector<sha1_hash> const hashes = segment_hashes(blob);
+	p.sender.channel->serve(blob, hashes);
+
+	// the sender never answers
+	p.sender.mute = true;
+
+	std::vector<sha1_hash> missing;
+	bool done = false;
+	time_point const start = clock_type::now();
+	TEST_CHECK(p.getter.channel->fetch(p.sender_ep, hashes
+		, [&](sha1_hash const&, span<char const>) { return true; }
+		, [&](std::vector<sha1_hash> m)
+		{
+			missing = std::move(m);
+			done = true;
+		}));
+
+	p.run(done, seconds(5));
+	TEST_CHECK(done);
+	TEST_CHECK(clock_type::now() - start >= seconds(1));
+	TEST_CHECK(missing == hashes);
+	TEST_EQUAL(p.getter.channel->num_connections(), 0);
+}
@@ -15,7 +15,10 @@ see LICENSE file.
 
 #include "test.hpp"
 
+#include <algorithm>
 #include <iostream>
+#include <string>
+#include <vector>
 
 using namespace lt;
 
@@ -121,3 +124,55 @@ TORRENT_TEST(hasher256)
 	}
 }
 
+
+TORRENT_TEST(hasher_split_updates)
+{
+	// feeding the bytes in pieces that straddle the blocks must agree with
+	// hashing them in one update
+	std::string buf(64 * 37 + 13, '\0');
+	for (std::size_t i = 0; i < buf.size(); ++i) buf[i] = char(i * 7 + 3);
+
+	sha1_hash const h1 = hasher(buf).final();
+	sha256_hash const h256 = hasher256(buf).final();
+
+	for (int const step : {1, 5, 63, 64, 65, 200})
+	{
+		hasher h;
+		hasher256 h2;
+		for (std::size_t i = 0; i < buf.size(); i += std::size_t(step))
+		{
+			int const len = int(std::min(buf.size() - i, std::size_t(step)));
+			h.update(buf.data() + i, len);
+			h2.update(buf.data() + i, len);
+		}
+		TEST_EQUAL(h.final(), h1);
+		TEST_EQUAL(h2.final(), h256);
+	}
+
+	// "a" a million times, in one go
+	std::string const a(1000000, 'a');
+	TEST_EQUAL(aux::to_hex(hasher(a).final()), "34aa973cd4c4daa4f61eeb2bdbad27316534016f");
+	TEST_EQUAL(aux::to_hex(hasher256(a).final())
+		, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+}
+
+TORRENT_TEST(hash_batch)
+{
+	std::vector<std::string> in;
+	for (int i = 0; i < 20; ++i)
+		in.push_back(std::string(std::size_t(i * 97), char('a' + i)));
+
+	std::vector<span<char const>> segs(in.begin(), in.end());
+	std::vector<sha1_hash> out1(in.size());
+	std::vector<sha256_hash> out256(in.size());
+	hash_batch(segs, out1);
+	hash_batch(segs, out256);
+
+	for (std::size_t i = 0; i < in.size(); ++i)
+	{
+		// the empty buffer is at index 0
+		TEST_EQUAL(out1[i], (i == 0 ? hasher() : hasher(in[i])).final());
+		TEST_EQUAL(out256[i], (i == 0 ? hasher256() : hasher256(in[i])).final());
+	}
+	TEST_EQUAL(aux::to_hex(out1[0]), "da39a3ee5e6b4b0d3255bfef95601890afd80709");
+}
@@ -0,0 +1,156 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "ip2/config.hpp"
+#include "test.hpp"
+#include "ip2/kademlia/items_db_sqlite.hpp"
+#include "ip2/aux_/session_settings.hpp"
+#include "ip2/address.hpp"
+#include "ip2/bencode.hpp"
+
+using namespace lt;
+using namespace lt::dht;
+
+namespace {
+
+	// an observer without a session. The items database is in memory
+	struct db_observer final : dht_observer
+	{
+		db_observer() { sqlite3_open(":memory:", &m_db); }
+		~db_observer() { sqlite3_close(m_db); }
+
+		void set_external_address(aux::listen_socket_handle const&
+			, address const&, address const&) override {}
+		int get_listen_port(aux::transport, aux::listen_socket_handle const&) override
+		{ return 0; }
+		void get_peers(sha256_hash const&) override {}
+		void outgoing_get_peers(sha256_hash const&
+			, sha256_hash const&, udp::endpoint const&) override {}
+		void announce(sha256_hash const&, address const&, int) override {}
+		bool on_dht_request(string_view, dht::msg const&, entry&) override
+		{ return false; }
+		void on_dht_item(dht::item&) override {}
+		std::int64_t get_time() override { return 0; }
+		void on_dht_relay(public_key const&, entry const&) override {}
+		sqlite3* get_items_database() override { return m_db; }
+
+#ifndef TORRENT_DISABLE_LOGGING
+		bool should_log(module_t) const override { return false; }
+		bool should_log(module_t, aux::LOG_LEVEL) const override { return false; }
+		void log(module_t, char const*, ...) override {}
+		void log_packet(message_direction_t, span<char const>
+			, udp::endpoint const&) override {}
+#endif
+
+		int count()
+		{
+			sqlite3_stmt* stmt = nullptr;
+			sqlite3_prepare_v2(m_db, "SELECT COUNT(*) FROM mutable_items;", -1, &stmt, nullptr);
+			int ret = -1;
+			if (sqlite3_step(stmt) == SQLITE_ROW) ret = sqlite3_column_int(stmt, 0);
+			sqlite3_finalize(stmt);
+			return ret;
+		}
+
+	private:
+		sqlite3* m_db = nullptr;
+	};
+
+	std::string const value = "5:hello";
+	public_key const pk{};
+	signature const sig{};
+	address const addr = make_address_v4("10.0.0.1");
+
+	sha256_hash target(int const i, std::uint8_t const first = 0)
+	{
+		sha256_hash ret;
+		ret[0] = first;
+		ret[30] = std::uint8_t(i >> 8);
+		ret[31] = std::uint8_t(i);
+		return ret;
+	}
+
+	void put(items_db_sqlite& db, sha256_hash const& t, std::int64_t const ts)
+	{
+		db.put_mutable_item(t, value, sig, timestamp(ts), pk, {}, addr);
+	}
+
+	bool has(items_db_sqlite& db, sha256_hash const& t)
+	{
+		entry e;
+		return db.get_mutable_item(t, timestamp(0), true, e);
+	}
+}
+
+TORRENT_TEST(updates_are_not_counted)
+{
+	db_observer observer;
+	aux::session_settings sett;
+	sett.set_int(settings_pack::dht_items_db_max_count, 10);
+	items_db_sqlite db(sett, &observer);
+
+	for (int i = 0; i < 10; ++i) put(db, target(i), i);
+	for (int i = 0; i < 10; ++i) put(db, target(i), i + 100);
+	TEST_EQUAL(observer.count(), 10);
+	for (int i = 0; i < 10; ++i) TEST_CHECK(has(db, target(i)));
+	db.close();
+}
+
+TORRENT_TEST(oldest_items_are_evicted)
+{
+	db_observer observer;
+	aux::session_settings sett;
+	sett.set_int(settings_pack::dht_items_db_max_count, 100);
+	items_db_sqlite db(sett, &observer);
+
+	for (int i = 0; i < 150; ++i) put(db, target(i), i);
+	TEST_EQUAL(observer.count(), 100);
+	for (int i = 0; i < 150; ++i) TEST_EQUAL(has(db, target(i)), i >= 50);
+	db.close();
+}
+
+TORRENT_TEST(far_items_are_evicted_first)
+{
+	db_observer observer;
+	aux::session_settings sett;
+	sett.set_int(settings_pack::dht_items_db_max_count, 20);
+	items_db_sqlite db(sett, &observer);
+	db.update_node_ids({node_id()});
+
+	// the far items are newer, but still go first
+	for (int i = 0; i < 20; ++i) put(db, target(i), i);
+	for (int i = 0; i < 10; ++i) put(db, target(i, 0x80), 1000 + i);
+	TEST_EQUAL(observer.count(), 20);
+	for (int i = 0; i < 20; ++i) TEST_CHECK(has(db, target(i)));
+	for (int i = 0; i < 10; ++i) TEST_CHECK(!has(db, target(i, 0x80)));
+	db.close();
+}
+
+TORRENT_TEST(lowered_max_is_caught_up_in_batches)
+{
+	db_observer observer;
+	aux::session_settings sett;
+	sett.set_int(settings_pack::dht_items_db_max_count, 1000);
+	sett.set_int(settings_pack::dht_items_db_eviction_batch, 100);
+	sett.set_int(settings_pack::dht_items_db_refresh_time, 0);
+	items_db_sqlite db(sett, &observer);
+
+	for (int i = 0; i < 500; ++i) put(db, target(i), i);
+	sett.set_int(settings_pack::dht_items_db_max_count, 200);
+
+	db.tick();
+	TEST_EQUAL(observer.count(), 400);
+	db.tick();
+	db.tick();
+	db.tick();
+	TEST_EQUAL(observer.count(), 200);
+	db.tick();
+	TEST_EQUAL(observer.count(), 200);
+	db.close();
+}
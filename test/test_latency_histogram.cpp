@@ -0,0 +1,51 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "ip2/config.hpp"
+#include "test.hpp"
+#include "ip2/aux_/latency_histogram.hpp"
+#include "ip2/performance_counters.hpp"
+#include "ip2/session_stats.hpp"
+
+using namespace lt;
+
+TORRENT_TEST(latency_bucket)
+{
+	TEST_EQUAL(aux::latency_bucket(microseconds(500)), 0);
+	TEST_EQUAL(aux::latency_bucket(milliseconds(1)), 1);
+	TEST_EQUAL(aux::latency_bucket(milliseconds(2)), 2);
+	TEST_EQUAL(aux::latency_bucket(milliseconds(3)), 2);
+	TEST_EQUAL(aux::latency_bucket(milliseconds(4)), 3);
+	TEST_EQUAL(aux::latency_bucket(milliseconds(1000)), 10);
+	TEST_EQUAL(aux::latency_bucket(seconds(16)), 14);
+	TEST_EQUAL(aux::latency_bucket(seconds(17)), aux::latency_buckets - 1);
+	TEST_EQUAL(aux::latency_bucket(hours(1)), aux::latency_buckets - 1);
+}
+
+TORRENT_TEST(record_latency)
+{
+	counters cnt;
+	aux::record_latency(cnt, counters::transport_get_latency0, milliseconds(5));
+	aux::record_latency(cnt, counters::transport_get_latency0, milliseconds(6));
+	aux::record_latency(cnt, counters::transport_get_latency0, hours(1));
+
+	TEST_EQUAL(cnt[counters::transport_get_latency3], 2);
+	TEST_EQUAL(cnt[counters::transport_get_latency15], 1);
+	TEST_EQUAL(cnt[counters::transport_put_latency0], 0);
+}
+
+TORRENT_TEST(latency_metrics)
+{
+	TEST_EQUAL(find_metric_idx("transport.transport_queue_wait0")
+		, counters::transport_queue_wait0);
+	TEST_EQUAL(find_metric_idx("assemble.assemble_get_latency15")
+		, counters::assemble_get_latency15);
+	TEST_EQUAL(find_metric_idx("assemble.assemble_get_retries")
+		, counters::assemble_get_retries);
+}
@@ -0,0 +1,178 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "ip2/config.hpp"
+#include "test.hpp"
+#include "ip2/communication/message_db_impl.hpp"
+
+#include <vector>
+
+using namespace lt;
+using namespace lt::communication;
+
+namespace {
+
+	struct memory_db
+	{
+		memory_db() { sqlite3_open(":memory:", &db); }
+		~memory_db() { sqlite3_close_v2(db); }
+
+		int count()
+		{
+			sqlite3_stmt* stmt = nullptr;
+			sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM MESSAGES;", -1, &stmt, nullptr);
+			int ret = -1;
+			if (sqlite3_step(stmt) == SQLITE_ROW) ret = sqlite3_column_int(stmt, 0);
+			sqlite3_finalize(stmt);
+			return ret;
+		}
+
+		sqlite3* db = nullptr;
+	};
+
+	dht::public_key key(char const c)
+	{
+		dht::public_key ret;
+		ret.bytes.fill(c);
+		return ret;
+	}
+
+	message make_message(std::int64_t const ts, char const sender = 'a', char const receiver = 'b')
+	{
+		aux::bytes payload(10, char(ts & 0xff));
+		return message(ts, key(sender), key(receiver), payload);
+	}
+}
+
+TORRENT_TEST(uncommitted_messages_are_seen)
+{
+	memory_db mem;
+	message_db_impl db(mem.db);
+	TEST_CHECK(db.init());
+
+	message const m1 = make_message(1);
+	message const m2 = make_message(2);
+	TEST_CHECK(db.save_message_if_not_exist(m1));
+	TEST_CHECK(db.save_message_if_not_exist(m2));
+	TEST_CHECK(db.save_message_if_not_exist(m2));
+
+	// saved, not committed yet
+	TEST_EQUAL(db.uncommitted_messages(), 2);
+	TEST_EQUAL(mem.count(), 0);
+	TEST_CHECK(db.is_message_in_db(m1.sha1()));
+	TEST_CHECK(db.get_message_by_hash(m2.sha1()).sha1() == m2.sha1());
+	TEST_CHECK(db.get_latest_transaction(key('a'), key('b')).sha1() == m2.sha1());
+	TEST_CHECK(db.get_latest_transaction(key('b'), key('a')).empty());
+
+	TEST_CHECK(db.commit_messages());
+	TEST_EQUAL(db.uncommitted_messages(), 0);
+	TEST_EQUAL(mem.count(), 2);
+	TEST_CHECK(db.is_message_in_db(m1.sha1()));
+	TEST_CHECK(db.get_message_by_hash(m1.sha1()).payload() == m1.payload());
+
+	// the same message again isn't an error
+	TEST_CHECK(db.save_message_if_not_exist(m1));
+	TEST_CHECK(db.commit_messages());
+	TEST_EQUAL(mem.count(), 2);
+}
+
+TORRENT_TEST(latest_ten)
+{
+	memory_db mem;
+	message_db_impl db(mem.db);
+	TEST_CHECK(db.init());
+
+	// the latest ten out of the committed and the uncommitted ones
+	for (int i = 0; i < 8; ++i) TEST_CHECK(db.save_message_if_not_exist(make_message(i)));
+	TEST_CHECK(db.commit_messages());
+	for (int i = 8; i < 14; ++i) TEST_CHECK(db.save_message_if_not_exist(make_message(i)));
+	TEST_CHECK(db.save_message_if_not_exist(make_message(100, 'c', 'b')));
+
+	auto const messages = db.get_latest_ten_transactions(key('a'), key('b'));
+	TEST_EQUAL(int(messages.size()), 10);
+	for (int i = 0; i < int(messages.size()); ++i)
+		TEST_EQUAL(messages[std::size_t(i)].timestamp(), i + 4);
+}
+
+TORRENT_TEST(group_commit)
+{
+	memory_db mem;
+	message_db_impl db(mem.db);
+	TEST_CHECK(db.init());
+
+	// a burst is committed as soon as it's big enough
+	for (int i = 0; i < message_db_max_uncommitted - 1; ++i)
+		TEST_CHECK(db.save_message_if_not_exist(make_message(i)));
+	TEST_EQUAL(mem.count(), 0);
+	TEST_CHECK(db.save_message_if_not_exist(make_message(message_db_max_uncommitted)));
+	TEST_EQUAL(mem.count(), message_db_max_uncommitted);
+	TEST_EQUAL(db.uncommitted_messages(), 0);
+}
+
+TORRENT_TEST(delete_uncommitted)
+{
+	memory_db mem;
+	message_db_impl db(mem.db);
+	TEST_CHECK(db.init());
+
+	message const m = make_message(1);
+	TEST_CHECK(db.save_message_if_not_exist(m));
+	TEST_CHECK(db.delete_message_by_hash(m.sha1()));
+	TEST_CHECK(!db.is_message_in_db(m.sha1()));
+	TEST_CHECK(db.commit_messages());
+	TEST_EQUAL(mem.count(), 0);
+}
+
+TORRENT_TEST(friends)
+{
+	memory_db mem;
+	message_db_impl db(mem.db);
+	TEST_CHECK(db.init());
+
+	// the cached statements are used again
+	for (int i = 0; i < 3; ++i)
+	{
+		TEST_CHECK(db.save_friend(key('x')));
+		TEST_EQUAL(int(db.get_all_friends().size()), 1);
+		TEST_CHECK(db.delete_friend(key('x')));
+		TEST_CHECK(db.get_all_friends().empty());
+	}
+}
+
+TORRENT_TEST(failed_commit_is_retried)
+{
+	memory_db mem;
+	message_db_impl db(mem.db);
+	TEST_CHECK(db.init());
+
+	message const m1 = make_message(1);
+	message const m2 = make_message(2);
+	TEST_CHECK(db.save_message_if_not_exist(m1));
+
+	// the insert statement can't be prepared
+	sqlite3_exec(mem.db, "DROP TABLE MESSAGES;", nullptr, nullptr, nullptr);
+	TEST_CHECK(!db.commit_messages());
+	TEST_EQUAL(db.uncommitted_messages(), 1);
+
+	TEST_CHECK(db.init());
+	TEST_CHECK(db.commit_messages());
+	TEST_EQUAL(db.uncommitted_messages(), 0);
+	TEST_EQUAL(mem.count(), 1);
+
+	// the cached insert statement fails to step
+	TEST_CHECK(db.save_message_if_not_exist(m2));
+	sqlite3_exec(mem.db, "DROP TABLE MESSAGES;", nullptr, nullptr, nullptr);
+	TEST_CHECK(!db.commit_messages());
+	TEST_EQUAL(db.uncommitted_messages(), 1);
+
+	TEST_CHECK(db.init());
+	TEST_CHECK(db.commit_messages());
+	TEST_EQUAL(mem.count(), 1);
+	TEST_CHECK(db.is_message_in_db(m2.sha1()));
+}
@@ -0,0 +1,170 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "ip2/config.hpp"
+#include "test.hpp"
+#include "ip2/kademlia/packet_decoder.hpp"
+#include "ip2/io_context.hpp"
+
+#include <thread>
+
+using namespace lt;
+
+#if !defined TORRENT_ENABLE_UDP_ENCRYPTION && !defined TORRENT_ENABLE_UDP_COMPRESS
+
+namespace {
+
+	udp::endpoint ep(char const* ip, int port)
+	{
+		return udp::endpoint(make_address(ip), std::uint16_t(port));
+	}
+
+	sha256_hash sender(char const c)
+	{
+		sha256_hash ret;
+		ret[0] = std::uint8_t(c);
+		return ret;
+	}
+}
+
+TORRENT_TEST(decode_on_worker)
+{
+	io_context ios;
+	dht::packet_decoder decoder(ios, 2, 0);
+	TEST_EQUAL(decoder.num_threads(), 2);
+
+	// the network thread has no work of its own while the packet is being
+	// decoded
+	auto work = make_work_guard(ios);
+
+	std::thread::id const network_thread = std::this_thread::get_id();
+	std::string const payload = "d1:q4:ping1:t2:aa1:y1:qe";
+
+	std::unique_ptr<dht::decoded_packet> result;
+	decoder.post(ep("1.2.3.4", 1000), sender('a'), payload, dht::secret_key()
+		, [&](std::unique_ptr<dht::decoded_packet> p)
+		{
+			TEST_CHECK(std::this_thread::get_id() == network_thread);
+			result = std::move(p);
+			work.reset();
+		});
+
+	ios.run();
+
+	TEST_CHECK(result);
+	TEST_CHECK(!result->failed);
+	TEST_CHECK(!result->ec);
+	TEST_CHECK(result->from == ep("1.2.3.4", 1000));
+	TEST_CHECK(result->pk == sender('a'));
+	TEST_EQUAL(std::string(result->buf.begin(), result->buf.end()), payload);
+	TEST_EQUAL(result->msg.type(), bdecode_node::dict_t);
+	TEST_EQUAL(result->msg.dict_find_string_value("q"), "ping");
+}
+
+TORRENT_TEST(invalid_bencoding)
+{
+	io_context ios;
+	dht::packet_decoder decoder(ios, 1, 0);
+
+	auto work = make_work_guard(ios);
+
+	std::unique_ptr<dht::decoded_packet> result;
+	decoder.post(ep("1.2.3.4", 1000), sender('a'), "d1:q4:pi", dht::secret_key()
+		, [&](std::unique_ptr<dht::decoded_packet> p)
+		{
+			result = std::move(p);
+			work.reset();
+		});
+
+	ios.run();
+
+	TEST_CHECK(result);
+	TEST_CHECK(!result->failed);
+	TEST_CHECK(result->ec);
+}
+
+TORRENT_TEST(in_order_per_sender)
+{
+	io_context ios;
+	dht::packet_decoder decoder(ios, 4, 0);
+
+	auto work = make_work_guard(ios);
+
+	std::vector<int> order;
+	for (int i = 0; i < 50; ++i)
+	{
+		std::string const payload = "i" + std::to_string(i) + "e";
+		decoder.post(ep("1.2.3.4", 1000), sender('b'), payload, dht::secret_key()
+			, [&](std::unique_ptr<dht::decoded_packet> p)
+			{
+				order.push_back(int(p->msg.int_value()));
+				if (order.size() == 50) work.reset();
+			});
+	}
+
+	ios.run();
+
+	TEST_EQUAL(int(order.size()), 50);
+	for (int i = 0; i < int(order.size()); ++i)
+		TEST_EQUAL(order[std::size_t(i)], i);
+}
+
+TORRENT_TEST(bounded_queue)
+{
+	io_context ios;
+	dht::packet_decoder decoder(ios, 1, 4);
+
+	auto work = make_work_guard(ios);
+
+	// a flood from one sender. What the worker has no room for is dropped,
+	// everything taken is decoded
+	int const num_packets = 2000;
+	std::string const payload = "d1:q4:ping1:t2:aa1:y1:qe";
+	int accepted = 0;
+	int delivered = 0;
+	for (int i = 0; i < num_packets; ++i)
+	{
+		if (decoder.post(ep("1.2.3.4", 1000), sender('c'), payload, dht::secret_key()
+			, [&](std::unique_ptr<dht::decoded_packet>) { ++delivered; }))
+		{
+			++accepted;
+		}
+	}
+
+	TEST_CHECK(accepted >= 4);
+	TEST_CHECK(accepted <= num_packets);
+
+	while (delivered < accepted) ios.run_one();
+
+	TEST_EQUAL(delivered, accepted);
+
+	// once the worker has caught up, the next packet is taken again
+	bool called = false;
+	TEST_CHECK(decoder.post(ep("1.2.3.4", 1000), sender('c'), payload, dht::secret_key()
+		, [&](std::unique_ptr<dht::decoded_packet>) { called = true; work.reset(); }));
+	ios.run();
+	TEST_CHECK(called);
+}
+
+TORRENT_TEST(stopped)
+{
+	io_context ios;
+	dht::packet_decoder decoder(ios, 2, 0);
+	decoder.stop();
+	TEST_EQUAL(decoder.num_threads(), 0);
+
+	bool called = false;
+	TEST_CHECK(!decoder.post(ep("1.2.3.4", 1000), sender('a'), "de", dht::secret_key()
+		, [&](std::unique_ptr<dht::decoded_packet>) { called = true; }));
+
+	ios.run();
+	TEST_CHECK(!called);
+}
+
+#endif
@@ -0,0 +1,237 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "ip2/config.hpp"
+#include "test.hpp"
+#include "ip2/kademlia/relay_mailbox.hpp"
+#include "ip2/kademlia/dht_storage.hpp"
+#include "ip2/aux_/session_settings.hpp"
+#include "ip2/bencode.hpp"
+
+#include <filesystem>
+
+using namespace lt;
+using namespace lt::dht;
+
+#if TORRENT_HAVE_MMAP
+
+namespace {
+
+	std::string const dir = "relay_mailbox_test";
+
+	sha256_hash key(int const i)
+	{
+		sha256_hash ret;
+		ret[0] = std::uint8_t(i);
+		ret[1] = std::uint8_t(i >> 8);
+		ret[31] = 0xff;
+		return ret;
+	}
+
+	std::string payload(int const i)
+	{
+		entry e;
+		e["m"] = std::string(700, char('a' + i % 26));
+		e["n"] = i;
+		std::string ret;
+		bencode(std::back_inserter(ret), e);
+		return ret;
+	}
+
+	relay_hmac const hmac("hmac");
+
+	sha256_hash const sender = key(1000);
+	sha256_hash const receiver = key(2000);
+
+	void put(relay_mailbox& mb, int const i)
+	{
+		std::string const pl = payload(i);
+		TEST_CHECK(mb.put(key(i), sender, receiver, pl, {}, udp::v4(), hmac));
+	}
+
+	bool check(relay_mailbox const& mb, int const i)
+	{
+		entry re;
+		if (!mb.get(key(i), re)) return false;
+		TEST_EQUAL(re["f"].string(), std::string(sender.data(), 32));
+		TEST_EQUAL(re["t"].string(), std::string(receiver.data(), 32));
+		TEST_EQUAL(re["hmac"].string(), "hmac");
+		TEST_EQUAL(re["pl"]["n"].integer(), i);
+		return true;
+	}
+}
+
+TORRENT_TEST(put_get_remove)
+{
+	std::filesystem::remove_all(dir);
+	aux::session_settings sett;
+	relay_mailbox mb(sett, nullptr, dir);
+	error_code ec;
+	TEST_CHECK(mb.open(ec));
+	TEST_CHECK(!ec);
+
+	put(mb, 1);
+	put(mb, 2);
+	TEST_EQUAL(mb.size(), 2);
+	TEST_CHECK(check(mb, 1));
+	TEST_CHECK(check(mb, 2));
+
+	// putting the same entry again only touches it
+	put(mb, 1);
+	TEST_EQUAL(mb.size(), 2);
+
+	sha256_hash k;
+	TEST_CHECK(mb.get_random(receiver, k));
+	TEST_CHECK(k == key(1) || k == key(2));
+	TEST_CHECK(!mb.get_random(sender, k));
+
+	mb.remove(key(1));
+	TEST_EQUAL(mb.size(), 1);
+	TEST_CHECK(!check(mb, 1));
+	TEST_CHECK(check(mb, 2));
+}
+
+TORRENT_TEST(entries_survive_reopen)
+{
+	std::filesystem::remove_all(dir);
+	aux::session_settings sett;
+	{
+		relay_mailbox mb(sett, nullptr, dir);
+		error_code ec;
+		TEST_CHECK(mb.open(ec));
+		for (int i = 0; i < 10; ++i) put(mb, i);
+		mb.remove(key(3));
+	}
+
+	relay_mailbox mb(sett, nullptr, dir);
+	error_code ec;
+	TEST_CHECK(mb.open(ec));
+	TEST_EQUAL(mb.size(), 9);
+	for (int i = 0; i < 10; ++i)
+		TEST_EQUAL(check(mb, i), i != 3);
+}
+
+TORRENT_TEST(torn_record_ends_segment)
+{
+	std::filesystem::remove_all(dir);
+	aux::session_settings sett;
+	{
+		relay_mailbox mb(sett, nullptr, dir);
+		error_code ec;
+		TEST_CHECK(mb.open(ec));
+		for (int i = 0; i < 3; ++i) put(mb, i);
+	}
+
+	// corrupt the last record, as if the write was cut short
+	{
+		std::string const path = dir + "/relay-00000000.seg";
+		std::FILE* f = std::fopen(path.c_str(), "r+b");
+		TEST_CHECK(f != nullptr);
+		std::vector<char> buf(std::size_t(relay_mailbox::segment_size));
+		TEST_EQUAL(std::fread(buf.data(), 1, buf.size(), f), buf.size());
+		auto const last = std::find_if(buf.rbegin(), buf.rend()
+			, [](char c) { return c != 0; });
+		std::fseek(f, long(std::distance(last, buf.rend()) - 1), SEEK_SET);
+		std::fputc(*last ^ 0x55, f);
+		std::fclose(f);
+	}
+
+	relay_mailbox mb(sett, nullptr, dir);
+	error_code ec;
+	TEST_CHECK(mb.open(ec));
+	TEST_EQUAL(mb.size(), 2);
+	TEST_CHECK(check(mb, 0));
+	TEST_CHECK(check(mb, 1));
+
+	// the torn record is overwritten
+	put(mb, 5);
+	TEST_CHECK(check(mb, 5));
+}
+
+TORRENT_TEST(bounded_by_size)
+{
+	std::filesystem::remove_all(dir);
+	aux::session_settings sett;
+	sett.set_int(settings_pack::dht_relay_mailbox_size, 2 * relay_mailbox::segment_size);
+	relay_mailbox mb(sett, nullptr, dir);
+	error_code ec;
+	TEST_CHECK(mb.open(ec));
+
+	// about 1300 records fit in a segment
+	int const count = 5000;
+	for (int i = 0; i < count; ++i)
+	{
+		put(mb, i);
+		mb.tick();
+	}
+
+	TEST_CHECK(mb.disk_size() <= 2 * relay_mailbox::segment_size);
+	TEST_CHECK(mb.size() < count);
+	TEST_CHECK(!check(mb, 0));
+	TEST_CHECK(check(mb, count - 1));
+}
+
+TORRENT_TEST(compaction_keeps_live_entries)
+{
+	std::filesystem::remove_all(dir);
+	aux::session_settings sett;
+	relay_mailbox mb(sett, nullptr, dir);
+	error_code ec;
+	TEST_CHECK(mb.open(ec));
+
+	// fill two segments, then remove most of the first one
+	int const count = 2000;
+	for (int i = 0; i < count; ++i) put(mb, i);
+	TEST_EQUAL(mb.disk_size(), 2 * relay_mailbox::segment_size);
+	for (int i = 0; i < count; ++i)
+		if (i % 10 != 0) mb.remove(key(i));
+
+	mb.tick();
+	TEST_EQUAL(mb.disk_size(), relay_mailbox::segment_size);
+	TEST_EQUAL(mb.size(), count / 10);
+	for (int i = 0; i < count; i += 10) TEST_CHECK(check(mb, i));
+
+	// and they are found again after a restart, with the removed ones
+	// still removed
+	mb.close();
+	relay_mailbox mb2(sett, nullptr, dir);
+	TEST_CHECK(mb2.open(ec));
+	TEST_EQUAL(mb2.size(), count / 10);
+	for (int i = 0; i < count; ++i) TEST_EQUAL(check(mb2, i), i % 10 == 0);
+}
+
+TORRENT_TEST(storage_falls_back_to_memory)
+{
+	std::filesystem::remove_all(dir);
+	aux::session_settings sett;
+	std::unique_ptr<dht_storage_interface> s(dht_default_storage_constructor(sett));
+
+	// a mailbox that isn't open can't write anything
+	auto mb = std::make_shared<relay_mailbox>(sett, nullptr, dir);
+	s->set_relay_mailbox(mb);
+
+	std::string const pl = payload(1);
+	s->put_relay_entry(sender, receiver, pl, {}, udp::v4(), hmac);
+	TEST_EQUAL(mb->size(), 0);
+
+	sha256_hash k;
+	TEST_CHECK(s->get_random_relay_entry(receiver, k));
+	entry re;
+	TEST_CHECK(s->get_relay_entry(k, re));
+	TEST_EQUAL(re["pl"]["n"].integer(), 1);
+
+	s->remove_relay_entry(k);
+	TEST_CHECK(!s->get_random_relay_entry(receiver, k));
+}
+
+#else
+
+TORRENT_TEST(dummy) {}
+
+#endif
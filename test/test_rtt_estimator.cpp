@@ -0,0 +1,89 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "ip2/config.hpp"
+#include "test.hpp"
+#include "ip2/kademlia/rtt_estimator.hpp"
+#include "ip2/address.hpp"
+
+using namespace lt;
+using namespace lt::dht;
+
+namespace {
+
+	udp::endpoint ep(int const i)
+	{
+		return {make_address_v4("10.0.0." + std::to_string(i)), 6881};
+	}
+}
+
+TORRENT_TEST(unknown_endpoint)
+{
+	rtt_estimator r;
+	TEST_CHECK(r.short_timeout(ep(1)) == rtt_estimator::default_short_timeout);
+	TEST_CHECK(r.timeout(ep(1)) == rtt_estimator::default_timeout);
+}
+
+TORRENT_TEST(fast_endpoint)
+{
+	rtt_estimator r;
+	time_point const now = clock_type::now();
+	for (int i = 0; i < 20; ++i) r.sample(ep(1), milliseconds(5), now);
+
+	// a LAN peer is failed over to another much sooner than the defaults
+	TEST_CHECK(r.short_timeout(ep(1)) == rtt_estimator::min_short_timeout);
+	TEST_CHECK(r.timeout(ep(1)) == rtt_estimator::min_timeout);
+
+	// the other endpoints keep the defaults
+	TEST_CHECK(r.short_timeout(ep(2)) == rtt_estimator::default_short_timeout);
+}
+
+TORRENT_TEST(slow_endpoint)
+{
+	rtt_estimator r;
+	time_point const now = clock_type::now();
+	for (int i = 0; i < 20; ++i) r.sample(ep(1), milliseconds(1500), now);
+
+	// a peer slower than the default short timeout isn't timed out while
+	// its reply is on the way
+	TEST_CHECK(r.short_timeout(ep(1)) > milliseconds(1500));
+	TEST_CHECK(r.timeout(ep(1)) > rtt_estimator::default_timeout);
+	TEST_CHECK(r.timeout(ep(1)) <= rtt_estimator::max_timeout);
+}
+
+TORRENT_TEST(variation_widens_timeout)
+{
+	rtt_estimator r;
+	rtt_estimator steady;
+	time_point const now = clock_type::now();
+	for (int i = 0; i < 20; ++i)
+	{
+		r.sample(ep(1), milliseconds(i % 2 ? 50 : 350), now);
+		steady.sample(ep(1), milliseconds(200), now);
+	}
+
+	TEST_CHECK(r.short_timeout(ep(1)) > steady.short_timeout(ep(1)));
+}
+
+TORRENT_TEST(bounded_size)
+{
+	rtt_estimator r;
+	time_point const now = clock_type::now();
+	for (int i = 0; i < rtt_estimator::max_endpoints + 100; ++i)
+	{
+		udp::endpoint const e(make_address_v4(address_v4::uint_type(0x0a000000 + i)), 6881);
+		r.sample(e, milliseconds(100), now + milliseconds(i));
+	}
+	TEST_CHECK(r.size() <= rtt_estimator::max_endpoints);
+
+	// the most recent sample is kept
+	udp::endpoint const last(make_address_v4(address_v4::uint_type(
+		0x0a000000 + rtt_estimator::max_endpoints + 99)), 6881);
+	TEST_CHECK(r.short_timeout(last) != rtt_estimator::default_short_timeout);
+}
@@ -0,0 +1,97 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "ip2/config.hpp"
+#include "test.hpp"
+#include "ip2/kademlia/search_branching.hpp"
+
+using namespace lt;
+using namespace lt::dht;
+
+TORRENT_TEST(initial_factor)
+{
+	search_branching b(3, 4);
+	b.start(200);
+	TEST_EQUAL(b.factor(), 3);
+	TEST_EQUAL(b.free_slots(0, 0), 3);
+}
+
+TORRENT_TEST(widen_on_closer_reply)
+{
+	search_branching b(3, 5);
+	b.start(200);
+
+	// a reply bringing the lookup closer widens the window by one
+	b.replied(180);
+	TEST_EQUAL(b.factor(), 4);
+
+	// one that doesn't, doesn't
+	b.replied(180);
+	TEST_EQUAL(b.factor(), 4);
+	b.replied(190);
+	TEST_EQUAL(b.factor(), 4);
+
+	// up to dht_max_search_branching
+	b.replied(170);
+	TEST_EQUAL(b.factor(), 5);
+	b.replied(160);
+	b.replied(150);
+	TEST_EQUAL(b.factor(), 5);
+}
+
+TORRENT_TEST(narrow_on_timeout)
+{
+	search_branching b(8, 8);
+	b.start(200);
+
+	// a timeout halves the window, never below one
+	b.timed_out();
+	TEST_EQUAL(b.factor(), 4);
+	b.timed_out();
+	TEST_EQUAL(b.factor(), 2);
+	b.timed_out();
+	TEST_EQUAL(b.factor(), 1);
+	b.timed_out();
+	TEST_EQUAL(b.factor(), 1);
+
+	// and it widens again as the lookup converges
+	b.replied(150);
+	TEST_EQUAL(b.factor(), 2);
+}
+
+TORRENT_TEST(short_timeout_releases_slot)
+{
+	search_branching b(3, 4);
+	b.start(200);
+
+	TEST_EQUAL(b.free_slots(3, 0), 0);
+
+	// a request past its short timeout doesn't hold a slot, another one is
+	// sent in its place
+	TEST_EQUAL(b.free_slots(3, 1), 1);
+	TEST_EQUAL(b.free_slots(3, 3), 3);
+
+	// the slot is taken by the request sent in its place
+	TEST_EQUAL(b.free_slots(4, 1), 0);
+}
+
+TORRENT_TEST(bounds)
+{
+	// a window of zero would never send anything
+	search_branching b(0, 0);
+	TEST_EQUAL(b.factor(), 1);
+	b.start(200);
+	b.replied(100);
+	TEST_EQUAL(b.factor(), 1);
+
+	// more in flight than the window, after a timeout narrowed it
+	search_branching c(4, 4);
+	c.timed_out();
+	TEST_EQUAL(c.free_slots(4, 0), 0);
+}
@@ -0,0 +1,155 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "ip2/config.hpp"
+#include "test.hpp"
+#include "ip2/assemble/segment_cache.hpp"
+#include "ip2/aux_/session_settings.hpp"
+#include "ip2/hasher.hpp"
+
+#include <filesystem>
+
+using namespace lt;
+using namespace lt::assemble;
+
+namespace {
+
+	std::string const dir = "segment_cache_test";
+
+	struct null_logger final : assemble_logger
+	{
+		bool should_log(aux::LOG_LEVEL) const override { return false; }
+		void log(aux::LOG_LEVEL, char const*, ...) override {}
+		void log_record(aux::LOG_LEVEL, char const*, span<char const>) override {}
+	};
+
+	std::string segment(int const i)
+	{
+		return std::string(1000, char('a' + i % 26)) + std::to_string(i);
+	}
+
+	sha1_hash hash(std::string const& seg)
+	{
+		return hasher(seg).final();
+	}
+
+	bool has(segment_cache& c, std::string const& seg)
+	{
+		span<char const> const got = c.get(hash(seg));
+		return std::string(got.begin(), got.end()) == seg;
+	}
+
+	void set_limits(aux::session_settings& sett, int const memory, int const disk)
+	{
+		sett.set_int(settings_pack::assemble_segment_cache_size, memory);
+		sett.set_int(settings_pack::assemble_segment_cache_disk_size, disk);
+	}
+}
+
+TORRENT_TEST(put_get_remove)
+{
+	null_logger logger;
+	aux::session_settings sett;
+	set_limits(sett, 64 * 1024, 0);
+	segment_cache c(sett, logger);
+
+	TEST_CHECK(c.get(hash(segment(0))).empty());
+
+	for (int i = 0; i < 10; ++i) c.put(hash(segment(i)), segment(i));
+	for (int i = 0; i < 10; ++i) TEST_CHECK(has(c, segment(i)));
+
+	c.remove(hash(segment(3)));
+	TEST_CHECK(c.get(hash(segment(3))).empty());
+	TEST_CHECK(has(c, segment(4)));
+	TEST_EQUAL(c.disk_size(), 0);
+}
+
+TORRENT_TEST(memory_only_drops_least_recently_used)
+{
+	null_logger logger;
+	aux::session_settings sett;
+	set_limits(sett, 5 * 1010, 64 * 1024);
+	segment_cache c(sett, logger);
+
+	for (int i = 0; i < 5; ++i) c.put(hash(segment(i)), segment(i));
+
+	// using segment 0 makes segment 1 the least recently used one
+	TEST_CHECK(has(c, segment(0)));
+	c.put(hash(segment(5)), segment(5));
+
+	TEST_CHECK(c.get(hash(segment(1))).empty());
+	TEST_CHECK(has(c, segment(0)));
+	TEST_CHECK(has(c, segment(5)));
+	TEST_CHECK(c.memory_size() <= 5 * 1010);
+
+	// there's no directory, so nothing is written
+	TEST_EQUAL(c.disk_size(), 0);
+}
+
+TORRENT_TEST(spill_to_disk_and_reopen)
+{
+	std::error_code ec;
+	std::filesystem::remove_all(dir, ec);
+
+	null_logger logger;
+	aux::session_settings sett;
+	set_limits(sett, 3 * 1010, 64 * 1024);
+	{
+		segment_cache c(sett, logger);
+		c.open(dir);
+		for (int i = 0; i < 10; ++i) c.put(hash(segment(i)), segment(i));
+
+		TEST_CHECK(c.memory_size() <= 3 * 1010);
+		TEST_CHECK(c.disk_size() > 0);
+
+		// a segment dropped from memory is read back from its file
+		for (int i = 0; i < 10; ++i) TEST_CHECK(has(c, segment(i)));
+	}
+
+	// the segments still in memory were lost, the ones written weren't
+	segment_cache c(sett, logger);
+	c.open(dir);
+	TEST_CHECK(c.disk_size() > 0);
+	TEST_CHECK(has(c, segment(0)));
+
+	c.remove(hash(segment(0)));
+	TEST_CHECK(c.get(hash(segment(0))).empty());
+
+	std::filesystem::remove_all(dir, ec);
+}
+
+TORRENT_TEST(disk_size_is_bounded)
+{
+	std::error_code ec;
+	std::filesystem::remove_all(dir, ec);
+
+	null_logger logger;
+	aux::session_settings sett;
+	set_limits(sett, 1010, 4 * 1010);
+	segment_cache c(sett, logger);
+	c.open(dir);
+	for (int i = 0; i < 20; ++i) c.put(hash(segment(i)), segment(i));
+
+	TEST_CHECK(c.disk_size() <= 4 * 1010);
+
+	// the oldest segments were deleted, the newest are kept
+	TEST_CHECK(c.get(hash(segment(0))).empty());
+	TEST_CHECK(has(c, segment(18)));
+	TEST_CHECK(has(c, segment(19)));
+
+	int files = 0;
+	for (auto const& e : std::filesystem::directory_iterator(dir, ec))
+	{
+		TORRENT_UNUSED(e);
+		++files;
+	}
+	TEST_CHECK(files <= 4);
+
+	std::filesystem::remove_all(dir, ec);
+}
@@ -0,0 +1,139 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "ip2/config.hpp"
+#include "test.hpp"
+#include "ip2/blockchain/state_snapshot.hpp"
+#include "ip2/blockchain/constants.hpp"
+#include "ip2/assemble/protocol.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace lt;
+using namespace lt::blockchain;
+
+namespace {
+
+	std::vector<account> accounts(int const n)
+	{
+		std::vector<account> ret;
+		for (int i = 0; i < n; ++i)
+		{
+			dht::public_key pk;
+			pk.bytes[0] = char(i & 0xff);
+			pk.bytes[1] = char(i >> 8);
+			ret.emplace_back(pk, 1000000 + i, i, i % 7);
+		}
+		return ret;
+	}
+
+	span<char const> as_span(std::string const& s)
+	{
+		return {s.data(), static_cast<std::ptrdiff_t>(s.size())};
+	}
+}
+
+TORRENT_TEST(root_is_state_root)
+{
+	auto const acts = accounts(100);
+	state_snapshot const snapshot(acts);
+
+	// the arrays and root an epoch block is mined with
+	std::vector<sha1_hash> hashes;
+	int n = 0;
+	for (auto const& a : snapshot.arrays())
+	{
+		TEST_CHECK(int(a.StateArray().size()) <= MAX_STATE_ARRAY_SIZE);
+		n += int(a.StateArray().size());
+		hashes.push_back(a.sha1());
+	}
+	TEST_EQUAL(n, 100);
+	TEST_CHECK(snapshot.root() == state_hash_array(hashes).sha1());
+
+	// the same state gives the same snapshot
+	state_snapshot const again(acts);
+	TEST_CHECK(again.root() == snapshot.root());
+	TEST_EQUAL(again.num_parts(), snapshot.num_parts());
+	for (int i = 0; i < snapshot.num_parts(); ++i)
+		TEST_CHECK(again.part(i) == snapshot.part(i));
+}
+
+TORRENT_TEST(import)
+{
+	state_snapshot const exported(accounts(MAX_ACCOUNT_SIZE));
+	TEST_CHECK(exported.num_parts() > 1);
+
+	state_snapshot imported(exported.root());
+	TEST_EQUAL(imported.num_parts(), 0);
+	TEST_CHECK(!imported.complete());
+
+	// the parts fit in a blob and may arrive in any order
+	for (int i = exported.num_parts() - 1; i >= 0; --i)
+	{
+		std::string const part = exported.part(i);
+		TEST_CHECK(int(part.size()) <= assemble::protocol::blob_mtu);
+		TEST_CHECK(imported.add_part(i, as_span(part)));
+		TEST_EQUAL(imported.num_parts(), exported.num_parts());
+		TEST_EQUAL(imported.complete(), i == 0);
+	}
+
+	TEST_EQUAL(imported.arrays().size(), exported.arrays().size());
+	for (std::size_t i = 0; i < exported.arrays().size(); ++i)
+		TEST_CHECK(imported.arrays()[i].sha1() == exported.arrays()[i].sha1());
+	TEST_CHECK(imported.hash_array().sha1() == exported.root());
+}
+
+TORRENT_TEST(wrong_root)
+{
+	state_snapshot const exported(accounts(50));
+	state_snapshot other(state_snapshot(accounts(51)).root());
+	TEST_CHECK(!other.add_part(0, as_span(exported.part(0))));
+	TEST_EQUAL(other.num_parts(), 0);
+}
+
+TORRENT_TEST(tampered_part)
+{
+	state_snapshot const exported(accounts(50));
+	std::string part = exported.part(0);
+
+	// flip a byte of a balance, at the end of the part
+	part[part.size() - 20] ^= 1;
+	state_snapshot imported(exported.root());
+	TEST_CHECK(!imported.add_part(0, as_span(part)));
+	TEST_CHECK(!imported.complete());
+
+	TEST_CHECK(!imported.add_part(0, as_span(std::string("garbage"))));
+	TEST_CHECK(!imported.add_part(0, as_span(std::string("de"))));
+
+	// the untouched part is still taken
+	TEST_CHECK(imported.add_part(0, as_span(exported.part(0))));
+	TEST_CHECK(imported.complete());
+}
+
+TORRENT_TEST(replayed_part)
+{
+	state_snapshot const exported(accounts(MAX_ACCOUNT_SIZE));
+	TEST_CHECK(exported.num_parts() > 1);
+	state_snapshot imported(exported.root());
+
+	// part 0 is valid, but not as any other part
+	std::string const part0 = exported.part(0);
+	for (int i = 1; i < exported.num_parts(); ++i)
+		TEST_CHECK(!imported.add_part(i, as_span(part0)));
+	TEST_EQUAL(imported.num_parts(), 0);
+
+	TEST_CHECK(imported.add_part(0, as_span(part0)));
+	TEST_CHECK(!imported.add_part(1, as_span(part0)));
+	TEST_CHECK(!imported.complete());
+
+	for (int i = 1; i < exported.num_parts(); ++i)
+		TEST_CHECK(imported.add_part(i, as_span(exported.part(i))));
+	TEST_CHECK(imported.complete());
+}
@@ -0,0 +1,123 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "ip2/config.hpp"
+#include "test.hpp"
+#include "ip2/aux_/submission_queue.hpp"
+
+#include <atomic>
+#include <thread>
+
+using namespace lt;
+
+namespace {
+
+	aux::submission message(int const i)
+	{
+		aux::submission s;
+		s.type = aux::submission::relay_message;
+		s.timestamp = i;
+		s.payload.resize(100, 'a');
+		return s;
+	}
+}
+
+TORRENT_TEST(first_push_schedules_drain)
+{
+	aux::submission_queue q(10);
+	using r = aux::submission_queue::push_result;
+
+	TEST_CHECK(q.push(message(0)) == r::queued_first);
+	TEST_CHECK(q.push(message(1)) == r::queued);
+	TEST_CHECK(q.push(message(2)) == r::queued);
+	TEST_EQUAL(q.size(), 3);
+
+	std::vector<aux::submission> batch;
+	q.pop_all(batch);
+	TEST_EQUAL(int(batch.size()), 3);
+	TEST_EQUAL(q.size(), 0);
+	for (int i = 0; i < 3; ++i)
+		TEST_EQUAL(batch[std::size_t(i)].timestamp, i);
+
+	// the queue is empty again, the next push starts a new batch
+	batch.clear();
+	TEST_CHECK(q.push(message(3)) == r::queued_first);
+}
+
+TORRENT_TEST(payload_is_moved)
+{
+	aux::submission_queue q(10);
+
+	aux::submission s = message(0);
+	char const* data = s.payload.data();
+	q.push(std::move(s));
+
+	std::vector<aux::submission> batch;
+	q.pop_all(batch);
+	TEST_EQUAL(int(batch.size()), 1);
+	TEST_CHECK(batch[0].payload.data() == data);
+}
+
+TORRENT_TEST(full)
+{
+	aux::submission_queue q(2);
+	using r = aux::submission_queue::push_result;
+
+	TEST_CHECK(q.push(message(0)) == r::queued_first);
+	TEST_CHECK(q.push(message(1)) == r::queued);
+
+	// a rejected submission is left to the caller to report
+	aux::submission s = message(2);
+	TEST_CHECK(q.push(std::move(s)) == r::full);
+	TEST_EQUAL(int(s.payload.size()), 100);
+	TEST_EQUAL(q.size(), 2);
+
+	q.set_capacity(3);
+	TEST_CHECK(q.push(std::move(s)) == r::queued);
+}
+
+TORRENT_TEST(multiple_producers)
+{
+	aux::submission_queue q(100000);
+	using r = aux::submission_queue::push_result;
+
+	int const num_threads = 4;
+	int const per_thread = 1000;
+	std::atomic<int> drains_scheduled{0};
+
+	std::vector<std::thread> producers;
+	for (int t = 0; t < num_threads; ++t)
+	{
+		producers.emplace_back([&, t]
+		{
+			for (int i = 0; i < per_thread; ++i)
+			{
+				if (q.push(message(t * per_thread + i)) == r::queued_first)
+					++drains_scheduled;
+			}
+		});
+	}
+
+	int received = 0;
+	int batches = 0;
+	std::vector<aux::submission> batch;
+	while (received < num_threads * per_thread)
+	{
+		q.pop_all(batch);
+		if (!batch.empty()) ++batches;
+		received += int(batch.size());
+		batch.clear();
+	}
+
+	for (auto& t : producers) t.join();
+
+	TEST_EQUAL(received, num_threads * per_thread);
+	// every non-empty batch was started by exactly one scheduled drain
+	TEST_EQUAL(drains_scheduled.load(), batches);
+}
@@ -0,0 +1,131 @@
+/*
+
+Copyright (c) 2022, Xianshui Sheng
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "ip2/config.hpp"
+#include "test.hpp"
+#include "ip2/aux_/timer_wheel.hpp"
+#include "ip2/aux_/random.hpp"
+
+#include <algorithm>
+#include <map>
+
+using namespace lt;
+
+namespace {
+
+	constexpr time_duration resolution = milliseconds(10);
+
+	std::vector<int> advance(aux::timer_wheel<int>& w, time_point const now)
+	{
+		std::vector<int> ret;
+		w.advance(now, ret);
+		return ret;
+	}
+}
+
+TORRENT_TEST(expire_in_order)
+{
+	time_point const start = clock_type::now();
+	aux::timer_wheel<int> w(resolution, start);
+
+	w.add(start + milliseconds(30), 3);
+	w.add(start + milliseconds(10), 1);
+	w.add(start + milliseconds(20), 2);
+	TEST_EQUAL(w.size(), 3);
+
+	TEST_CHECK(advance(w, start + milliseconds(9)).empty());
+	TEST_CHECK(advance(w, start + milliseconds(10)) == std::vector<int>{1});
+	TEST_CHECK(advance(w, start + milliseconds(35)) == (std::vector<int>{2, 3}));
+	TEST_CHECK(w.empty());
+}
+
+TORRENT_TEST(never_early)
+{
+	time_point const start = clock_type::now();
+	aux::timer_wheel<int> w(resolution, start);
+
+	// a deadline in the middle of a tick waits for the next one
+	w.add(start + milliseconds(15), 1);
+	TEST_CHECK(advance(w, start + milliseconds(14)).empty());
+	TEST_CHECK(advance(w, start + milliseconds(19)).empty());
+	TEST_CHECK(advance(w, start + milliseconds(20)) == std::vector<int>{1});
+
+	// a deadline that has passed expires on the next advance
+	w.add(start, 2);
+	TEST_CHECK(advance(w, start + milliseconds(30)) == std::vector<int>{2});
+}
+
+TORRENT_TEST(remove)
+{
+	time_point const start = clock_type::now();
+	aux::timer_wheel<int> w(resolution, start);
+
+	auto const h1 = w.add(start + milliseconds(100), 1);
+	w.add(start + milliseconds(100), 2);
+	auto const h3 = w.add(start + seconds(100), 3);
+	TEST_EQUAL(w.value(h1), 1);
+
+	w.remove(h1);
+	w.remove(h3);
+	TEST_EQUAL(w.size(), 1);
+	TEST_CHECK(advance(w, start + seconds(200)) == std::vector<int>{2});
+	TEST_CHECK(w.empty());
+}
+
+TORRENT_TEST(upper_levels)
+{
+	time_point const start = clock_type::now();
+	aux::timer_wheel<int> w(resolution, start);
+
+	// beyond level 0 (640 ms), beyond level 1 (41 s) and beyond the wheel
+	// (44 minutes)
+	w.add(start + seconds(1), 1);
+	w.add(start + seconds(60), 2);
+	w.add(start + minutes(60), 3);
+
+	TEST_CHECK(w.next_expiry() <= start + seconds(1));
+
+	TEST_CHECK(advance(w, start + milliseconds(990)).empty());
+	TEST_CHECK(advance(w, start + seconds(1)) == std::vector<int>{1});
+	TEST_CHECK(advance(w, start + milliseconds(59990)).empty());
+	TEST_CHECK(advance(w, start + seconds(60)) == std::vector<int>{2});
+	TEST_CHECK(advance(w, start + minutes(59)).empty());
+	TEST_CHECK(advance(w, start + minutes(60)) == std::vector<int>{3});
+}
+
+TORRENT_TEST(random_deadlines)
+{
+	time_point const start = clock_type::now();
+	aux::timer_wheel<int> w(resolution, start);
+
+	// every timer expires in the first advance at or after its deadline,
+	// and no later than one tick after it
+	std::map<int, time_point> deadlines;
+	for (int i = 0; i < 2000; ++i)
+	{
+		time_point const d = start + milliseconds(aux::random(100000));
+		deadlines[i] = d;
+		w.add(d, i);
+	}
+
+	time_point now = start;
+	while (!w.empty())
+	{
+		now += milliseconds(1 + aux::random(50));
+		for (int const i : advance(w, now))
+		{
+			TEST_CHECK(deadlines[i] <= now);
+			TEST_CHECK(now - deadlines[i] < resolution + milliseconds(51));
+			deadlines.erase(i);
+		}
+		for (auto const& d : deadlines) TEST_CHECK(d.second > now - resolution);
+		if (now > start + seconds(200)) break;
+	}
+	TEST_CHECK(deadlines.empty());
+}